@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if ESP_PLATFORM
+#include "esp_cpu.h"
+#else
+#include <time.h>
+#endif
+
+#define BENCH_LINE_LEN 160
+
+const char* Bench_Unit( void )
+{
+#if ESP_PLATFORM
+  return "cycles";
+#else
+  return "ns";
+#endif
+}
+
+uint64_t Bench_Now( void )
+{
+#if ESP_PLATFORM
+  /* 32 bit counter, wraps after ~17 s at 240 MHz, a single run stays far below */
+  return esp_cpu_get_cycle_count();
+#else
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static uint64_t _elapsed( uint64_t start )
+{
+#if ESP_PLATFORM
+  return (uint32_t) ( (uint32_t) Bench_Now() - (uint32_t) start );
+#else
+  return Bench_Now() - start;
+#endif
+}
+
+static uint64_t _time_run( const bench_case_t* bench, uint32_t iterations )
+{
+  uint64_t start = Bench_Now();
+
+  for ( uint32_t i = 0; i < iterations; i++ )
+  {
+    bench->run( i );
+  }
+
+  return _elapsed( start );
+}
+
+static void _sort( uint64_t* values, uint32_t count )
+{
+  for ( uint32_t i = 1; i < count; i++ )
+  {
+    uint64_t value = values[i];
+    uint32_t j = i;
+    for ( ; ( j > 0 ) && ( values[j - 1] > value ); j-- )
+    {
+      values[j] = values[j - 1];
+    }
+    values[j] = value;
+  }
+}
+
+bool Bench_Run( const bench_case_t* cases, uint32_t count, const char* name, uint32_t iterations,
+                void ( *write )( const char* line, void* arg ), void* arg )
+{
+  char line[BENCH_LINE_LEN];
+  uint64_t runs[BENCH_REPEATS];
+  bool pending = false;
+
+  if ( iterations == 0 )
+  {
+    return false;
+  }
+
+  snprintf( line, sizeof( line ), "{\"unit\": \"%s\", \"iterations\": %lu, \"repeats\": %d, \"results\": [", Bench_Unit(),
+            (unsigned long) iterations, BENCH_REPEATS );
+  write( line, arg );
+
+  for ( uint32_t i = 0; i < count; i++ )
+  {
+    const bench_case_t* bench = &cases[i];
+    if ( ( name != NULL ) && ( strcmp( name, bench->name ) != 0 ) )
+    {
+      continue;
+    }
+
+    if ( bench->setup != NULL )
+    {
+      bench->setup();
+    }
+
+    /* warm up caches and lazy init before the timed runs */
+    _time_run( bench, iterations / 10 + 1 );
+
+    for ( int r = 0; r < BENCH_REPEATS; r++ )
+    {
+      runs[r] = _time_run( bench, iterations );
+    }
+    _sort( runs, BENCH_REPEATS );
+
+    /* the previous result gets its separator once another one follows */
+    if ( pending )
+    {
+      strcat( line, "," );
+      write( line, arg );
+    }
+
+    snprintf( line, sizeof( line ), "  {\"name\": \"%s\", \"best\": %.2f, \"median\": %.2f}", bench->name,
+              (double) runs[0] / iterations, (double) runs[BENCH_REPEATS / 2] / iterations );
+    pending = true;
+  }
+
+  if ( pending )
+  {
+    write( line, arg );
+  }
+  write( "]}", arg );
+
+  return pending;
+}
@@ -0,0 +1,32 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Micro benchmark harness shared by the target unit test app and the host
+ * build. Every case is timed BENCH_REPEATS times over the same number of
+ * iterations, the best and the median run are reported. The host counts
+ * nanoseconds of CLOCK_MONOTONIC, the target counts CPU cycles. Results are
+ * written as JSON lines, tools/bench_diff.py compares two runs. */
+
+#define BENCH_REPEATS 5
+
+typedef struct
+{
+  const char* name;
+  void ( *setup )( void );          // optional, not timed
+  void ( *run )( uint32_t iteration );
+} bench_case_t;
+
+const char* Bench_Unit( void );    // "ns" or "cycles"
+uint64_t Bench_Now( void );
+
+/* NULL name runs every case, returns false when the name matches none */
+bool Bench_Run( const bench_case_t* cases, uint32_t count, const char* name, uint32_t iterations,
+                void ( *write )( const char* line, void* arg ), void* arg );
+
+/* Cases of this project, see bench_cases.c */
+const bench_case_t* Bench_GetCases( uint32_t* count );
+
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "bench.h"
+#include "dictionary.h"
+#include "measure.h"
+#include "menu_fmt.h"
+#include "param_store.h"
+#include "parameters.h"
+#include "oled.h"
+#include "ssdFigure.h"
+#include "text_cache.h"
+#include "trace.h"
+
+#define TRACE_DECODE_RECORDS 16
+
+static volatile uint32_t sink;
+static uint32_t filter_table[FILTER_TABLE_SIZE];
+static trace_record_t trace_records[TRACE_DECODE_RECORDS];
+
+static void _filter_setup( void )
+{
+  for ( int i = 0; i < FILTER_TABLE_SIZE; i++ )
+  {
+    filter_table[i] = 2000 + i * 13;
+  }
+}
+
+static void _filter_step( uint32_t iteration )
+{
+  filter_table[iteration % FILTER_TABLE_SIZE] = 1900 + ( iteration & 0xFF );
+  sink = measure_filter( filter_table, FILTER_TABLE_SIZE );
+}
+
+static void _sprite_signal( uint32_t iteration )
+{
+  drawSignal( 100, 0, iteration % 6 );
+}
+
+static void _sprite_valve( uint32_t iteration )
+{
+  ssdFigure_DrawValve( 20 * ( iteration % 5 ), 20, iteration & 1 );
+}
+
+static void _param_get( uint32_t iteration )
+{
+  sink = parameters_getValue( PARAM_PULSES_PER_LITER + iteration % 3 );
+}
+
+static void _param_set( uint32_t iteration )
+{
+  parameters_setValue( PARAM_LAT_COUNT, iteration );
+}
+
+static void _store_get( uint32_t iteration )
+{
+  sink = ParamStore_Get( PARAM_PULSES_PER_LITER + iteration % 3 );
+}
+
+static void _store_set( uint32_t iteration )
+{
+  ParamStore_Set( PARAM_LAT_COUNT, iteration );
+}
+
+static void _dict_lookup( uint32_t iteration )
+{
+  sink = (uint32_t) (uintptr_t) dictionary_get_string( iteration % DICT_TOP );
+}
+
+static void _fmt_row( uint32_t iteration )
+{
+  char buff[32];
+  menu_fmt_t fmt;
+
+  MenuFmt_Init( &fmt, buff, sizeof( buff ) );
+  MenuFmt_Str( &fmt, "Voltage:      " );
+  MenuFmt_Fixed( &fmt, iteration % 2000, 2 );
+  MenuFmt_Str( &fmt, " V" );
+  sink = buff[0];
+}
+
+/* A menu title through the label cache, hit and miss, against printing it */
+static void _text_setup( void )
+{
+  TextCache_Invalidate();
+}
+
+static void _text_hit( uint32_t iteration )
+{
+  TextCache_PrintFixed( 2, 0, "Settings", OLED_FONT_SIZE_16 );
+}
+
+static void _text_miss( uint32_t iteration )
+{
+  TextCache_Invalidate();
+  TextCache_PrintFixed( 2, 0, "Settings", OLED_FONT_SIZE_16 );
+}
+
+static void _text_direct( uint32_t iteration )
+{
+  oled_printFixed( 2, 0, "Settings", OLED_FONT_SIZE_16 );
+}
+
+static void _trace_encode( uint32_t iteration )
+{
+  Trace_Write( TRACE_ID_MEAS_ADC_AVG, iteration & 1, iteration, iteration >> 1 );
+}
+
+static void _trace_decode_setup( void )
+{
+  for ( int i = 0; i < TRACE_DECODE_RECORDS; i++ )
+  {
+    Trace_Write( TRACE_ID_MEAS_ADC_AVG, 0, i, i );
+  }
+}
+
+static void _trace_decode( uint32_t iteration )
+{
+  (void) iteration;
+  sink = Trace_Snapshot( trace_records, TRACE_DECODE_RECORDS );
+}
+
+static const bench_case_t cases[] =
+  {
+    {.name = "filter_step",   .setup = _filter_setup,       .run = _filter_step  },
+    { .name = "sprite_signal", .run = _sprite_signal                               },
+    { .name = "sprite_valve",  .run = _sprite_valve                                },
+    { .name = "param_get",     .run = _param_get                                   },
+    { .name = "param_set",     .run = _param_set                                   },
+    { .name = "store_get",     .setup = ParamStore_Init,     .run = _store_get    },
+    { .name = "store_set",     .setup = ParamStore_Init,     .run = _store_set    },
+    { .name = "dict_lookup",   .run = _dict_lookup                                 },
+    { .name = "fmt_row",       .run = _fmt_row                                     },
+    { .name = "text_hit",      .setup = _text_setup,         .run = _text_hit     },
+    { .name = "text_miss",     .run = _text_miss                                   },
+    { .name = "text_direct",   .run = _text_direct                                 },
+    { .name = "trace_encode",  .run = _trace_encode                                },
+    { .name = "trace_decode",  .setup = _trace_decode_setup, .run = _trace_decode },
+};
+
+const bench_case_t* Bench_GetCases( uint32_t* count )
+{
+  *count = sizeof( cases ) / sizeof( cases[0] );
+  return cases;
+}
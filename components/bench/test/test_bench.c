@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "unity.h"
+
+#define BENCH_ITERATIONS 2000
+
+static void _write_line( const char* line, void* arg )
+{
+  (void) arg;
+  printf( "%s\n", line );
+}
+
+TEST_CASE( "Micro benchmarks", "[bench]" )
+{
+  uint32_t count;
+  const bench_case_t* cases = Bench_GetCases( &count );
+
+  TEST_ASSERT_TRUE( Bench_Run( cases, count, NULL, BENCH_ITERATIONS, _write_line, NULL ) );
+}
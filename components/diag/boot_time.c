@@ -0,0 +1,92 @@
+#include "boot_time.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "parameters.h"
+
+#define MODULE_NAME "[BOOT] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_BOOT_TIME
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  boot_time_mark_t marks[BOOT_TIME_MARKS];
+  uint32_t cnt;
+  uint32_t lost;
+  uint32_t last_us;    // latest end
+  uint32_t ready_us;
+} boot_time_t;
+
+static boot_time_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+void BootTime_Add( const char* step, uint32_t start_us, uint32_t end_us )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.cnt < BOOT_TIME_MARKS )
+  {
+    ctx.marks[ctx.cnt++] = ( boot_time_mark_t ) {
+      .step = step,
+      .start_us = start_us,
+      .end_us = end_us,
+    };
+  }
+  else
+  {
+    ctx.lost++;
+  }
+  ctx.last_us = end_us > ctx.last_us ? end_us : ctx.last_us;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void BootTime_Mark( const char* step )
+{
+  BootTime_Add( step, ctx.last_us, (uint32_t) esp_timer_get_time() );
+}
+
+void BootTime_Ready( const char* device )
+{
+  if ( ctx.ready_us != 0 )
+  {
+    return;
+  }
+
+  BootTime_Mark( "ready" );
+  ctx.ready_us = (uint32_t) esp_timer_get_time();
+  parameters_setValue( PARAM_BOOT_READY_MS, ctx.ready_us / 1000 );
+
+  for ( uint32_t i = 0; i < ctx.cnt; i++ )
+  {
+    LOG( PRINT_INFO, "%-14s %6lu..%6lu ms  %5lu ms", ctx.marks[i].step, ctx.marks[i].start_us / 1000,
+         ctx.marks[i].end_us / 1000, ( ctx.marks[i].end_us - ctx.marks[i].start_us ) / 1000 );
+  }
+  LOG( PRINT_INFO, "%s ready in %lu ms, %lu marks lost", device, ctx.ready_us / 1000, ctx.lost );
+}
+
+uint32_t BootTime_GetReadyMs( void )
+{
+  return ctx.ready_us / 1000;
+}
+
+uint32_t BootTime_Get( boot_time_mark_t* marks, uint32_t size )
+{
+  uint32_t cnt = 0;
+
+  portENTER_CRITICAL( &ctx.lock );
+  for ( ; ( cnt < ctx.cnt ) && ( cnt < size ); cnt++ )
+  {
+    marks[cnt] = ctx.marks[cnt];
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return cnt;
+}
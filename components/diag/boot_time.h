@@ -0,0 +1,30 @@
+#ifndef BOOT_TIME_H_
+#define BOOT_TIME_H_
+
+#include "app_config.h"
+
+/* Boot timeline. Each init step marks its end with a static name, the
+ * time since the timer start is kept so the whole sequence is printed once
+ * the device is ready and the time to ready goes to PARAM_BOOT_READY_MS,
+ * the server controller exposes it through the parameters API. Steps run
+ * concurrently by init_graph.h add their own start. */
+
+#define BOOT_TIME_MARKS 32
+
+typedef struct
+{
+  const char* step;
+  uint32_t start_us;    // end of the latest mark before for BootTime_Mark()
+  uint32_t end_us;
+} boot_time_mark_t;
+
+void BootTime_Mark( const char* step );
+void BootTime_Add( const char* step, uint32_t start_us, uint32_t end_us );
+
+/* Last mark, prints the timeline once */
+void BootTime_Ready( const char* device );
+
+uint32_t BootTime_GetReadyMs( void );
+uint32_t BootTime_Get( boot_time_mark_t* marks, uint32_t size );
+
+#endif
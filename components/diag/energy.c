@@ -0,0 +1,259 @@
+#include "energy.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "param_store.h"
+#include "parameters.h"
+
+typedef struct
+{
+  uint16_t mv;
+  uint8_t percent;
+} soc_point_t;
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  bool started;
+  bool on[ENERGY_LOAD_TOP];
+  int64_t on_since_us[ENERGY_LOAD_TOP];
+  energy_load_stats_t loads[ENERGY_LOAD_TOP];
+  uint32_t battery_mv;
+  int64_t last_sample_us;
+  uint64_t last_charge_uams;
+  uint32_t avg_ua;
+  uint32_t soc_percent;
+  uint32_t remaining_min;
+} energy_t;
+
+static energy_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char* load_name[] =
+  {
+#define ENERGY_LOAD( _id, _name, _current_ua ) [_id] = _name,
+    ENERGY_LOAD_LIST
+#undef ENERGY_LOAD
+};
+
+static const uint32_t load_current_ua[] =
+  {
+#define ENERGY_LOAD( _id, _name, _current_ua ) [_id] = _current_ua,
+    ENERGY_LOAD_LIST
+#undef ENERGY_LOAD
+};
+
+/* Single cell Li-ion open circuit voltage under a light load, falling */
+static const soc_point_t soc_curve[] =
+  {
+    {4200, 100},
+    { 4100, 90 },
+    { 4000, 80 },
+    { 3900, 65 },
+    { 3800, 50 },
+    { 3700, 30 },
+    { 3600, 15 },
+    { 3500, 7  },
+    { 3400, 3  },
+    { 3300, 0  },
+};
+
+static void _add( energy_load_t load, uint64_t us )
+{
+  ctx.loads[load].on_us += us;
+  ctx.loads[load].charge_uams += (uint64_t) load_current_ua[load] * us / 1000;
+}
+
+/* Charges an on load up to now, lock held */
+static void _integrate( energy_load_t load, int64_t now )
+{
+  if ( ctx.on[load] )
+  {
+    _add( load, now - ctx.on_since_us[load] );
+    ctx.on_since_us[load] = now;
+  }
+}
+
+static uint32_t _soc_percent( uint32_t mv )
+{
+  const uint32_t points = sizeof( soc_curve ) / sizeof( soc_curve[0] );
+
+  if ( mv >= soc_curve[0].mv )
+  {
+    return 100;
+  }
+
+  for ( uint32_t i = 1; i < points; i++ )
+  {
+    if ( mv >= soc_curve[i].mv )
+    {
+      const soc_point_t* hi = &soc_curve[i - 1];
+      const soc_point_t* lo = &soc_curve[i];
+      return lo->percent + ( mv - lo->mv ) * ( hi->percent - lo->percent ) / ( hi->mv - lo->mv );
+    }
+  }
+
+  return 0;
+}
+
+void Energy_Start( void )
+{
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.started = true;
+  ctx.last_sample_us = now;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  Energy_SetOn( ENERGY_LOAD_IDLE, true );
+}
+
+void Energy_SetOn( energy_load_t load, bool on )
+{
+  assert( load < ENERGY_LOAD_TOP );
+
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.on[load] != on )
+  {
+    _integrate( load, now );
+    ctx.on[load] = on;
+    ctx.on_since_us[load] = now;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void Energy_AddActive( energy_load_t load, uint32_t us )
+{
+  assert( load < ENERGY_LOAD_TOP );
+
+  portENTER_CRITICAL( &ctx.lock );
+  _add( load, us );
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void Energy_SetBatteryVoltage( float voltage )
+{
+  ctx.battery_mv = (uint32_t) ( voltage * 1000.0f );
+}
+
+void Energy_Sample( void )
+{
+  if ( !ctx.started )
+  {
+    return;
+  }
+
+  int64_t now = esp_timer_get_time();
+  uint64_t charge_uams = 0;
+
+  portENTER_CRITICAL( &ctx.lock );
+  for ( int i = 0; i < ENERGY_LOAD_TOP; i++ )
+  {
+    _integrate( i, now );
+    charge_uams += ctx.loads[i].charge_uams;
+  }
+  uint64_t window_ms = ( now - ctx.last_sample_us ) / 1000;
+  uint64_t window_uams = charge_uams - ctx.last_charge_uams;
+  ctx.last_sample_us = now;
+  ctx.last_charge_uams = charge_uams;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( window_ms == 0 )
+  {
+    return;
+  }
+
+  uint32_t window_ua = window_uams / window_ms;
+  if ( ctx.avg_ua == 0 )
+  {
+    ctx.avg_ua = window_ua;
+  }
+  else
+  {
+    ctx.avg_ua = ctx.avg_ua + ( (int32_t) ( window_ua - ctx.avg_ua ) >> ENERGY_AVG_SHIFT );
+  }
+
+  /* capacity [mAh] * soc [%] / 100 / avg [mA] hours */
+  ctx.soc_percent = _soc_percent( ctx.battery_mv );
+  ctx.remaining_min = ctx.avg_ua > 0 ? (uint64_t) parameters_getValue( PARAM_BATTERY_CAPACITY ) * ctx.soc_percent * 600 / ctx.avg_ua : 0;
+
+  parameters_setValue( PARAM_ENERGY_USED_MAH, charge_uams / 3600000000ull );
+  parameters_setValue( PARAM_ENERGY_AVG_UA, ctx.avg_ua );
+  parameters_setValue( PARAM_ENERGY_REMAINING_MIN, ctx.remaining_min );
+
+  if ( ParamStore_Take( PARAM_ENERGY_PRINT ) )
+  {
+    Energy_Print();
+  }
+}
+
+void Energy_GetLoad( energy_load_t load, energy_load_stats_t* stats )
+{
+  assert( load < ENERGY_LOAD_TOP );
+  assert( stats );
+
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.loads[load];
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+const char* Energy_GetLoadName( energy_load_t load )
+{
+  return load < ENERGY_LOAD_TOP ? load_name[load] : "?";
+}
+
+uint32_t Energy_GetAverageUa( void )
+{
+  return ctx.avg_ua;
+}
+
+uint32_t Energy_GetSocPercent( void )
+{
+  return ctx.soc_percent;
+}
+
+uint32_t Energy_GetRemainingMin( void )
+{
+  return ctx.remaining_min;
+}
+
+void Energy_Print( void )
+{
+  energy_load_stats_t loads[ENERGY_LOAD_TOP];
+  uint64_t total_uams = 0;
+  int top = -1;
+
+  for ( int i = 0; i < ENERGY_LOAD_TOP; i++ )
+  {
+    Energy_GetLoad( i, &loads[i] );
+    total_uams += loads[i].charge_uams;
+
+    /* the idle floor is not something to optimize */
+    if ( ( i != ENERGY_LOAD_IDLE ) && ( ( top < 0 ) || ( loads[i].charge_uams > loads[top].charge_uams ) ) )
+    {
+      top = i;
+    }
+  }
+
+  printf( "ENERGY: avg %lu uA battery %lu mV soc %lu%% remaining %lu min\n", (unsigned long) ctx.avg_ua,
+          (unsigned long) ctx.battery_mv, (unsigned long) ctx.soc_percent, (unsigned long) ctx.remaining_min );
+  printf( "ENERGY: %-8s %10s %10s %6s\n", "load", "on_ms", "uAh", "share" );
+  for ( int i = 0; i < ENERGY_LOAD_TOP; i++ )
+  {
+    printf( "ENERGY: %-8s %10lu %10lu %5lu%%\n", load_name[i], (unsigned long) ( loads[i].on_us / 1000 ),
+            (unsigned long) ( loads[i].charge_uams / 3600000 ),
+            (unsigned long) ( total_uams > 0 ? loads[i].charge_uams * 100 / total_uams : 0 ) );
+  }
+
+  if ( top >= 0 )
+  {
+    printf( "ENERGY: top load %s\n", load_name[top] );
+  }
+}
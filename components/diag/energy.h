@@ -0,0 +1,56 @@
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "app_config.h"
+
+/* Energy model of the remote. Every load has a nominal current, the model
+ * integrates the time each load is on into a charge. Loads with a state
+ * (display, radio listening, buzzer, leds) are switched with Energy_SetOn(),
+ * bursts (radio transmit, CPU time from the task stats window) are added as
+ * durations. Energy_Sample() averages the current, estimates the state of
+ * charge from the battery voltage and publishes the remaining time. The
+ * currents are datasheet estimates, the shares tell which load to cut first. */
+
+/* ENERGY_LOAD(id, name, current_ua) */
+#define ENERGY_LOAD_LIST                                 \
+  ENERGY_LOAD( ENERGY_LOAD_IDLE, "idle", 15000 )         \
+  ENERGY_LOAD( ENERGY_LOAD_CPU, "cpu", 25000 )           \
+  ENERGY_LOAD( ENERGY_LOAD_WIFI_RX, "wifi_rx", 80000 )   \
+  ENERGY_LOAD( ENERGY_LOAD_WIFI_TX, "wifi_tx", 170000 )  \
+  ENERGY_LOAD( ENERGY_LOAD_DISPLAY, "display", 12000 )   \
+  ENERGY_LOAD( ENERGY_LOAD_BUZZER, "buzzer", 25000 )     \
+  ENERGY_LOAD( ENERGY_LOAD_LEDS, "leds", 5000 )
+
+typedef enum
+{
+#define ENERGY_LOAD( _id, _name, _current_ua ) _id,
+  ENERGY_LOAD_LIST
+#undef ENERGY_LOAD
+  ENERGY_LOAD_TOP,
+} energy_load_t;
+
+#define ENERGY_AVG_SHIFT 3    // average current follows 1/8 of each sample
+
+typedef struct
+{
+  uint64_t on_us;
+  uint64_t charge_uams;    // uA * ms
+} energy_load_stats_t;
+
+/* Only a started model samples and publishes, the idle load is on from here */
+void Energy_Start( void );
+
+void Energy_SetOn( energy_load_t load, bool on );
+void Energy_AddActive( energy_load_t load, uint32_t us );
+void Energy_SetBatteryVoltage( float voltage );
+
+void Energy_Sample( void );
+
+void Energy_GetLoad( energy_load_t load, energy_load_stats_t* stats );
+const char* Energy_GetLoadName( energy_load_t load );
+uint32_t Energy_GetAverageUa( void );
+uint32_t Energy_GetSocPercent( void );
+uint32_t Energy_GetRemainingMin( void );    // 0 until the first sample
+void Energy_Print( void );
+
+#endif
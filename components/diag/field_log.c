@@ -0,0 +1,504 @@
+#include "field_log.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "parameters.h"
+
+#define MODULE_NAME "[FIELD_LOG] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_FIELD_LOG
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define RECORD_SIZE ( sizeof( field_log_record_t ) )
+#define PATH_SIZE   ( sizeof( FIELD_LOG_BASE_PATH "/flog4294967295.bin" ) )
+#define BOOT_MAX    2    // records a boot writes, BOOT and CLOCK
+
+_Static_assert( FIELD_LOG_BLOCK_SIZE % sizeof( field_log_record_t ) == 0, "block size not a multiple of the record" );
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  SemaphoreHandle_t file_lock;
+  field_log_record_t queue[FIELD_LOG_QUEUE];
+  uint32_t queue_head;
+  uint32_t queue_cnt;
+  uint32_t seq[FIELD_LOG_BLOCKS];     // 0 for an empty slot
+  uint32_t used[FIELD_LOG_BLOCKS];    // bytes of whole records
+  uint32_t block;
+  uint32_t boot;
+  bool reopen;    // a failed append may have left a partial record
+  bool clocked;
+  bool sampled;
+  uint32_t silo;
+  uint32_t supply;
+  field_log_stats_t stats;
+} field_log_t;
+
+static field_log_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint16_t _check( const field_log_record_t* record )
+{
+  return esp_rom_crc32_le( 0, (const uint8_t*) record, offsetof( field_log_record_t, check ) ) & 0xFFFF;
+}
+
+bool FieldLog_CheckRecord( const field_log_record_t* record )
+{
+  return record->check == _check( record );
+}
+
+static void _fill( field_log_record_t* record, field_log_type_t type, uint8_t arg, uint32_t value )
+{
+  record->time_ms = ST2MS( xTaskGetTickCount() );
+  record->value = value;
+  record->type = type;
+  record->arg = arg;
+  record->check = _check( record );
+}
+
+static void _path( uint32_t block, char* path )
+{
+  snprintf( path, PATH_SIZE, FIELD_LOG_BASE_PATH "/flog%u.bin", (unsigned) block );
+}
+
+static void _lock( void )
+{
+  if ( ctx.file_lock != NULL )
+  {
+    xSemaphoreTake( ctx.file_lock, portMAX_DELAY );
+  }
+}
+
+static void _unlock( void )
+{
+  if ( ctx.file_lock != NULL )
+  {
+    xSemaphoreGive( ctx.file_lock );
+  }
+}
+
+/* Length of the valid records of a block, 0 when it does not start with a
+ * block record. Raises boot to the highest boot count in it, whole is false
+ * after a torn append. */
+static uint32_t _scan( uint32_t block, uint32_t* seq, uint32_t* boot, bool* whole )
+{
+  char path[PATH_SIZE];
+  field_log_record_t record;
+  uint32_t used = 0;
+
+  *whole = false;
+  _path( block, path );
+  FILE* f = fopen( path, "rb" );
+  if ( f == NULL )
+  {
+    return 0;
+  }
+
+  while ( ( used < FIELD_LOG_BLOCK_SIZE ) && ( fread( &record, RECORD_SIZE, 1, f ) == 1 ) && FieldLog_CheckRecord( &record ) )
+  {
+    if ( used == 0 )
+    {
+      if ( record.type != FIELD_LOG_BLOCK )
+      {
+        break;
+      }
+      *seq = record.value;
+    }
+    if ( ( record.type == FIELD_LOG_BOOT ) && ( record.value > *boot ) )
+    {
+      *boot = record.value;
+    }
+    used += RECORD_SIZE;
+  }
+  *whole = ( fseek( f, 0, SEEK_END ) == 0 ) && ( ftell( f ) == (long) used );
+  fclose( f );
+
+  return used;
+}
+
+static uint32_t _newest_seq( void )
+{
+  uint32_t newest = 0;
+
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    newest = ctx.seq[i] > newest ? ctx.seq[i] : newest;
+  }
+
+  return newest;
+}
+
+/* The boot count and, once the wall clock is set, the time */
+static uint32_t _boot_records( field_log_record_t* records, bool boot )
+{
+  time_t now = time( NULL );
+  uint32_t cnt = 0;
+
+  _fill( &records[cnt++], FIELD_LOG_BOOT, boot ? 1 : 0, ctx.boot );
+  if ( now >= FIELD_LOG_CLOCK_VALID )
+  {
+    _fill( &records[cnt++], FIELD_LOG_CLOCK, 0, (uint32_t) now );
+    ctx.clocked = true;
+  }
+
+  return cnt;
+}
+
+/* Drops the oldest block when all are taken */
+static bool _open_block( bool boot )
+{
+  char path[PATH_SIZE];
+  field_log_record_t records[1 + BOOT_MAX];
+  uint32_t seq = _newest_seq() + 1;
+  uint32_t block = 0;
+
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    if ( ctx.seq[i] < ctx.seq[block] )
+    {
+      block = i;
+    }
+  }
+
+  ctx.block = block;
+  ctx.seq[block] = 0;
+  ctx.used[block] = 0;
+  ctx.reopen = true;
+
+  _path( block, path );
+  FILE* f = fopen( path, "wb" );
+  if ( f == NULL )
+  {
+    ctx.stats.write_errors++;
+    return false;
+  }
+
+  _fill( &records[0], FIELD_LOG_BLOCK, boot ? 1 : 0, seq );
+  uint32_t cnt = 1 + _boot_records( &records[1], boot );
+  bool ret = fwrite( records, RECORD_SIZE, cnt, f ) == cnt;
+  ret = ( fclose( f ) == 0 ) && ret;
+
+  if ( !ret )
+  {
+    ctx.stats.write_errors++;
+    return false;
+  }
+
+  ctx.seq[block] = seq;
+  ctx.used[block] = cnt * RECORD_SIZE;
+  ctx.reopen = false;
+  ctx.stats.blocks++;
+  return true;
+}
+
+static bool _append( const field_log_record_t* records, uint32_t cnt )
+{
+  char path[PATH_SIZE];
+
+  while ( cnt > 0 )
+  {
+    if ( ( ctx.reopen || ( ctx.used[ctx.block] + RECORD_SIZE > FIELD_LOG_BLOCK_SIZE ) ) && !_open_block( false ) )
+    {
+      return false;
+    }
+
+    uint32_t room = ( FIELD_LOG_BLOCK_SIZE - ctx.used[ctx.block] ) / RECORD_SIZE;
+    uint32_t run = cnt < room ? cnt : room;
+
+    _path( ctx.block, path );
+    FILE* f = fopen( path, "ab" );
+    bool ret = ( f != NULL ) && ( fwrite( records, RECORD_SIZE, run, f ) == run );
+    if ( f != NULL )
+    {
+      ret = ( fclose( f ) == 0 ) && ret;
+    }
+
+    if ( !ret )
+    {
+      ctx.reopen = true;
+      ctx.stats.write_errors++;
+      return false;
+    }
+
+    ctx.used[ctx.block] += run * RECORD_SIZE;
+    records += run;
+    cnt -= run;
+  }
+
+  return true;
+}
+
+void FieldLog_Init( void )
+{
+  bool whole[FIELD_LOG_BLOCKS];
+  uint32_t newest = 0;
+
+  if ( ctx.file_lock == NULL )
+  {
+    ctx.file_lock = xSemaphoreCreateMutex();
+  }
+
+  _lock();
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.queue_head = 0;
+  ctx.queue_cnt = 0;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  ctx.sampled = false;
+  ctx.clocked = false;
+  ctx.boot = 0;
+  memset( &ctx.stats, 0, sizeof( ctx.stats ) );
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    ctx.seq[i] = 0;
+    ctx.used[i] = _scan( i, &ctx.seq[i], &ctx.boot, &whole[i] );
+    if ( ctx.used[i] == 0 )
+    {
+      ctx.seq[i] = 0;
+    }
+    if ( ctx.seq[i] > ctx.seq[newest] )
+    {
+      newest = i;
+    }
+  }
+
+  /* A boot goes on in the newest block when it ended clean */
+  ctx.boot++;
+  if ( ( ctx.seq[newest] != 0 ) && whole[newest] && ( ctx.used[newest] + BOOT_MAX * RECORD_SIZE <= FIELD_LOG_BLOCK_SIZE ) )
+  {
+    field_log_record_t records[BOOT_MAX];
+
+    ctx.block = newest;
+    ctx.reopen = false;
+    _append( records, _boot_records( records, true ) );
+  }
+  else
+  {
+    _open_block( true );
+  }
+  _unlock();
+
+  LOG( PRINT_INFO, "boot %lu block %lu seq %lu", ctx.boot, ctx.block, ctx.seq[ctx.block] );
+}
+
+void FieldLog_Record( field_log_type_t type, uint8_t arg, uint32_t value )
+{
+  field_log_record_t record;
+
+  _fill( &record, type, arg, value );
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.queue_cnt < FIELD_LOG_QUEUE )
+  {
+    ctx.queue[( ctx.queue_head + ctx.queue_cnt ) % FIELD_LOG_QUEUE] = record;
+    ctx.queue_cnt++;
+    ctx.stats.records++;
+  }
+  else
+  {
+    ctx.stats.lost++;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+bool FieldLog_Flush( void )
+{
+  field_log_record_t records[FIELD_LOG_QUEUE];
+  uint32_t cnt = 0;
+
+  _lock();
+  portENTER_CRITICAL( &ctx.lock );
+  while ( ctx.queue_cnt > 0 )
+  {
+    records[cnt++] = ctx.queue[ctx.queue_head];
+    ctx.queue_head = ( ctx.queue_head + 1 ) % FIELD_LOG_QUEUE;
+    ctx.queue_cnt--;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  bool ret = _append( records, cnt );
+  _unlock();
+
+  if ( !ret )
+  {
+    LOG( PRINT_ERROR, "append of %lu records failed", cnt );
+  }
+
+  return ret;
+}
+
+static bool _moved( uint32_t a, uint32_t b, uint32_t band )
+{
+  return ( a > b ? a - b : b - a ) >= band;
+}
+
+void FieldLog_Sample( void )
+{
+  uint32_t silo = parameters_getValue( PARAM_SILOS_LEVEL );
+  uint32_t supply = parameters_getValue( PARAM_VOLTAGE_ACCUM );
+  time_t now = time( NULL );
+
+  /* The clock set after the boot records, by SNTP */
+  if ( !ctx.clocked && ( now >= FIELD_LOG_CLOCK_VALID ) )
+  {
+    FieldLog_Record( FIELD_LOG_CLOCK, 0, (uint32_t) now );
+    ctx.clocked = true;
+  }
+
+  if ( !ctx.sampled || _moved( silo, ctx.silo, FIELD_LOG_SILO_BAND ) )
+  {
+    FieldLog_Record( FIELD_LOG_SILO, 0, silo );
+    ctx.silo = silo;
+  }
+
+  if ( !ctx.sampled || _moved( supply, ctx.supply, FIELD_LOG_SUPPLY_BAND ) )
+  {
+    FieldLog_Record( FIELD_LOG_SUPPLY, 0, supply );
+    ctx.supply = supply;
+  }
+
+  ctx.sampled = true;
+}
+
+/* Block indexes from the oldest to the newest */
+static uint32_t _order( uint32_t* order )
+{
+  uint32_t cnt = 0;
+
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    if ( ctx.seq[i] == 0 )
+    {
+      continue;
+    }
+
+    uint32_t j = cnt++;
+    for ( ; ( j > 0 ) && ( ctx.seq[order[j - 1]] > ctx.seq[i] ); j-- )
+    {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  return cnt;
+}
+
+uint32_t FieldLog_GetSize( void )
+{
+  uint32_t size = 0;
+
+  _lock();
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    size += ctx.seq[i] != 0 ? ctx.used[i] : 0;
+  }
+  _unlock();
+
+  return size;
+}
+
+uint32_t FieldLog_GetFirstSeq( void )
+{
+  uint32_t first = 0;
+
+  _lock();
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    if ( ( ctx.seq[i] != 0 ) && ( ( first == 0 ) || ( ctx.seq[i] < first ) ) )
+    {
+      first = ctx.seq[i];
+    }
+  }
+  _unlock();
+
+  return first;
+}
+
+uint32_t FieldLog_Read( uint32_t offset, void* data, uint32_t len )
+{
+  uint32_t order[FIELD_LOG_BLOCKS];
+  char path[PATH_SIZE];
+  uint8_t* out = data;
+  uint32_t done = 0;
+
+  _lock();
+  uint32_t cnt = _order( order );
+  for ( uint32_t i = 0; ( i < cnt ) && ( done < len ); i++ )
+  {
+    uint32_t used = ctx.used[order[i]];
+
+    if ( offset >= used )
+    {
+      offset -= used;
+      continue;
+    }
+
+    uint32_t chunk = used - offset < len - done ? used - offset : len - done;
+    _path( order[i], path );
+    FILE* f = fopen( path, "rb" );
+    if ( f == NULL )
+    {
+      break;
+    }
+
+    bool ret = ( fseek( f, offset, SEEK_SET ) == 0 ) && ( fread( out + done, 1, chunk, f ) == chunk );
+    fclose( f );
+    if ( !ret )
+    {
+      break;
+    }
+
+    done += chunk;
+    offset = 0;
+  }
+  _unlock();
+
+  return done;
+}
+
+void FieldLog_GetStats( field_log_stats_t* stats )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.stats;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+static void _task( void* arg )
+{
+  TickType_t last_sample = xTaskGetTickCount();
+
+  FieldLog_Sample();
+
+  while ( 1 )
+  {
+    vTaskDelay( MS2ST( FIELD_LOG_FLUSH_MS ) );
+
+    if ( ST2MS( xTaskGetTickCount() - last_sample ) >= FIELD_LOG_SAMPLE_MS )
+    {
+      last_sample = xTaskGetTickCount();
+      FieldLog_Sample();
+    }
+
+    FieldLog_Flush();
+  }
+}
+
+void FieldLog_Start( void )
+{
+  FieldLog_Init();
+  xTaskCreate( _task, "field_log", 3072, NULL, 2, NULL );
+}
@@ -0,0 +1,83 @@
+#ifndef FIELD_LOG_H_
+#define FIELD_LOG_H_
+
+#include "app_config.h"
+
+/* Field data log of the server controller in the storage partition, for
+ * billing and for our own analysis. Records are 12 bytes and go to a RAM
+ * queue first, the log task appends them in batches to the current block
+ * file. Blocks rotate over FIELD_LOG_BLOCKS files, the oldest is dropped.
+ * Every block begins with a FIELD_LOG_BLOCK record, so the download is a
+ * flat array of records in block order. A record with a bad check ends its
+ * block (torn append), the next boot then opens a new block; otherwise a
+ * boot goes on in the newest one. time_ms restarts with each boot: a boot
+ * writes FIELD_LOG_BOOT with a count one above the highest in the log, and
+ * every block repeats it after its block record, followed by
+ * FIELD_LOG_CLOCK when the wall clock is set. A clock set later in the boot
+ * is logged at the next sample.
+ * The storage partition is mounted by ParamProfile_Init(). */
+
+#ifndef FIELD_LOG_BASE_PATH
+#define FIELD_LOG_BASE_PATH "/storage"
+#endif
+#define FIELD_LOG_BLOCK_SIZE  4092    // a multiple of the record size
+#define FIELD_LOG_BLOCKS      8
+#define FIELD_LOG_QUEUE       64
+#define FIELD_LOG_FLUSH_MS    5000
+#define FIELD_LOG_SAMPLE_MS   60000
+#define FIELD_LOG_SILO_BAND   2       // percent
+#define FIELD_LOG_SUPPLY_BAND 1000    // 0.1 mV, as PARAM_VOLTAGE_ACCUM
+#define FIELD_LOG_CLOCK_VALID 1577836800    // 2020-01-01, below it the clock was never set
+
+typedef enum
+{
+  FIELD_LOG_BLOCK,     // arg 1 when opened by a boot, value block sequence
+  FIELD_LOG_VALVE,     // arg valve index, value 0 off 1 on
+  FIELD_LOG_DOSE,      // value centiliters dosed in an add water cycle
+  FIELD_LOG_FLOW,      // value PARAM_WATER_FLOW_STATE
+  FIELD_LOG_SILO,      // value level in percent
+  FIELD_LOG_SUPPLY,    // value supply voltage in 0.1 mV
+  FIELD_LOG_BOOT,      // arg 1 where the boot starts, 0 heading a later block, value boot count
+  FIELD_LOG_CLOCK,     // value seconds since 1970 at time_ms
+} field_log_type_t;
+
+typedef struct
+{
+  uint32_t time_ms;    // since boot
+  uint32_t value;
+  uint8_t type;
+  uint8_t arg;
+  uint16_t check;    // low half of the CRC-32 of the bytes before it
+} field_log_record_t;
+
+typedef struct
+{
+  uint32_t records;
+  uint32_t lost;    // queue full
+  uint32_t blocks;
+  uint32_t write_errors;
+} field_log_stats_t;
+
+/* Finds the newest block and the boot count, writes the boot records, no task */
+void FieldLog_Init( void );
+void FieldLog_Start( void );
+
+/* Never blocks, callable from callbacks */
+void FieldLog_Record( field_log_type_t type, uint8_t arg, uint32_t value );
+
+/* Queued records to flash */
+bool FieldLog_Flush( void );
+
+/* Silo level and supply voltage when they moved out of their band */
+void FieldLog_Sample( void );
+
+/* The blocks in order as one stream of records. Appends keep the offsets,
+ * dropping the oldest block changes the first sequence and shifts them. */
+uint32_t FieldLog_GetSize( void );
+uint32_t FieldLog_GetFirstSeq( void );
+uint32_t FieldLog_Read( uint32_t offset, void* data, uint32_t len );
+
+bool FieldLog_CheckRecord( const field_log_record_t* record );
+void FieldLog_GetStats( field_log_stats_t* stats );
+
+#endif
@@ -0,0 +1,423 @@
+#include "heap_prof.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "param_store.h"
+#include "parameters.h"
+
+#define MODULE_NAME "[HEAP] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_HEAP_PROF
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define HEAP_PROF_TASKS  24
+#define TASK_PREFIX_SIZE 12
+#define SLOT_MASK        ( CONFIG_HEAP_PROF_SLOTS - 1 )
+#define SIZE_SHIFT       8
+#define MODULE_MASK      0xFF
+
+_Static_assert( ( CONFIG_HEAP_PROF_SLOTS & SLOT_MASK ) == 0, "CONFIG_HEAP_PROF_SLOTS must be a power of two" );
+_Static_assert( HEAP_PROF_TLS_INDEX < CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS, "no thread local storage pointer for the heap profiler" );
+
+#if CONFIG_FREERTOS_PLACE_FUNCTIONS_INTO_FLASH
+#error "the heap hooks call FreeRTOS task functions, they must stay in IRAM"
+#endif
+
+typedef struct
+{
+  uintptr_t ptr;
+  uint32_t size_module;    // size << SIZE_SHIFT | module
+} heap_slot_t;
+
+typedef struct
+{
+  bool used;
+  uint8_t module;    // from the task name
+  uint8_t scope;     // innermost open scope or HEAP_MOD_NONE
+} heap_task_t;
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  heap_slot_t slots[CONFIG_HEAP_PROF_SLOTS];
+  heap_task_t tasks[HEAP_PROF_TASKS];
+  heap_mod_stats_t modules[HEAP_MOD_TOP];
+  uint32_t untracked;
+
+  heap_sample_t history[HEAP_PROF_HISTORY];
+  uint32_t history_cnt;
+  uint32_t sample_cnt;
+  bool below_watermark;
+} heap_prof_t;
+
+static heap_prof_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char* module_name[] =
+  {
+#define HEAP_MODULE( _id, _name, _task_prefix ) [_id] = _name,
+    HEAP_MODULE_LIST
+#undef HEAP_MODULE
+};
+
+/* Read from the heap hooks, in DRAM with the characters in place */
+DRAM_ATTR static const char task_prefix[HEAP_MOD_TOP][TASK_PREFIX_SIZE] =
+  {
+#define HEAP_MODULE( _id, _name, _task_prefix ) [_id] = _task_prefix,
+    HEAP_MODULE_LIST
+#undef HEAP_MODULE
+};
+
+/* Everything below runs from the heap hooks and stays in IRAM, flash may be
+ * disabled while they run */
+IRAM_ATTR static uint8_t _module_by_name( const char* name )
+{
+  for ( int i = 0; i < HEAP_MOD_TOP; i++ )
+  {
+    int c = 0;
+
+    while ( ( task_prefix[i][c] != '\0' ) && ( task_prefix[i][c] == name[c] ) )
+    {
+      c++;
+    }
+
+    if ( ( c > 0 ) && ( task_prefix[i][c] == '\0' ) )
+    {
+      return i;
+    }
+  }
+
+  return HEAP_MOD_OTHER;
+}
+
+/* FreeRTOS calls it when the task is deleted */
+static void _task_deleted( int index, void* entry )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  ( (heap_task_t*) entry )->used = false;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+/* The task name is only looked up on the first allocation of a task.
+ * Called with the lock held, NULL when the table is full. */
+IRAM_ATTR static heap_task_t* _task( void* handle )
+{
+  heap_task_t* task = pvTaskGetThreadLocalStoragePointer( handle, HEAP_PROF_TLS_INDEX );
+
+  if ( task != NULL )
+  {
+    return task;
+  }
+
+  for ( int i = 0; i < HEAP_PROF_TASKS; i++ )
+  {
+    if ( !ctx.tasks[i].used )
+    {
+      task = &ctx.tasks[i];
+      task->used = true;
+      task->module = _module_by_name( pcTaskGetName( handle ) );
+      task->scope = HEAP_MOD_NONE;
+      vTaskSetThreadLocalStoragePointerAndDelCallback( handle, HEAP_PROF_TLS_INDEX, task, _task_deleted );
+      return task;
+    }
+  }
+
+  return NULL;
+}
+
+IRAM_ATTR static uint8_t _current_module( void )
+{
+  if ( xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED )
+  {
+    return HEAP_MOD_OTHER;
+  }
+
+  heap_task_t* task = _task( xTaskGetCurrentTaskHandle() );
+
+  if ( task == NULL )
+  {
+    return HEAP_MOD_OTHER;
+  }
+
+  return task->scope != HEAP_MOD_NONE ? task->scope : task->module;
+}
+
+IRAM_ATTR static uint32_t _hash( uintptr_t ptr )
+{
+  return ( (uint32_t) ( ptr >> 3 ) * 2654435761u ) & SLOT_MASK;
+}
+
+IRAM_ATTR static heap_slot_t* _find( uintptr_t ptr )
+{
+  for ( uint32_t i = _hash( ptr ), n = 0; n < CONFIG_HEAP_PROF_SLOTS; i = ( i + 1 ) & SLOT_MASK, n++ )
+  {
+    if ( ctx.slots[i].ptr == ptr )
+    {
+      return &ctx.slots[i];
+    }
+
+    if ( ctx.slots[i].ptr == 0 )
+    {
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+IRAM_ATTR static bool _insert( uintptr_t ptr, uint32_t size_module )
+{
+  for ( uint32_t i = _hash( ptr ), n = 0; n < CONFIG_HEAP_PROF_SLOTS; i = ( i + 1 ) & SLOT_MASK, n++ )
+  {
+    if ( ctx.slots[i].ptr == 0 )
+    {
+      ctx.slots[i].ptr = ptr;
+      ctx.slots[i].size_module = size_module;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Linear probing delete, pulls back later entries of the same run */
+IRAM_ATTR static void _remove( heap_slot_t* slot )
+{
+  uint32_t hole = slot - ctx.slots;
+  uint32_t i = hole;
+
+  while ( 1 )
+  {
+    i = ( i + 1 ) & SLOT_MASK;
+    if ( ctx.slots[i].ptr == 0 )
+    {
+      break;
+    }
+
+    uint32_t home = _hash( ctx.slots[i].ptr );
+    bool movable = hole <= i ? ( home <= hole ) || ( home > i ) : ( home <= hole ) && ( home > i );
+
+    if ( movable )
+    {
+      ctx.slots[hole] = ctx.slots[i];
+      hole = i;
+    }
+  }
+
+  ctx.slots[hole].ptr = 0;
+}
+
+heap_mod_t HeapProf_ScopeEnter( heap_mod_t module )
+{
+  heap_mod_t prev = HEAP_MOD_NONE;
+
+  portENTER_CRITICAL( &ctx.lock );
+  heap_task_t* task = _task( xTaskGetCurrentTaskHandle() );
+  if ( task != NULL )
+  {
+    prev = task->scope;
+    task->scope = module;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return prev;
+}
+
+void HeapProf_ScopeExit( heap_mod_t prev )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  heap_task_t* task = _task( xTaskGetCurrentTaskHandle() );
+  if ( task != NULL )
+  {
+    task->scope = prev;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+IRAM_ATTR void HeapProf_OnAlloc( void* ptr, uint32_t size )
+{
+  if ( ptr == NULL )
+  {
+    return;
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  uint8_t module = _current_module();
+  heap_mod_stats_t* stats = &ctx.modules[module];
+
+  if ( _insert( (uintptr_t) ptr, ( size << SIZE_SHIFT ) | module ) )
+  {
+    stats->allocs++;
+    stats->current += size;
+    if ( stats->current > stats->peak )
+    {
+      stats->peak = stats->current;
+    }
+  }
+  else
+  {
+    ctx.untracked++;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+IRAM_ATTR void HeapProf_OnFree( void* ptr )
+{
+  if ( ptr == NULL )
+  {
+    return;
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  heap_slot_t* slot = _find( (uintptr_t) ptr );
+  if ( slot != NULL )
+  {
+    heap_mod_stats_t* stats = &ctx.modules[slot->size_module & MODULE_MASK];
+    stats->frees++;
+    stats->current -= slot->size_module >> SIZE_SHIFT;
+    _remove( slot );
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+
+IRAM_ATTR void esp_heap_trace_alloc_hook( void* ptr, size_t size, uint32_t caps )
+{
+  (void) caps;
+  HeapProf_OnAlloc( ptr, size );
+}
+
+IRAM_ATTR void esp_heap_trace_free_hook( void* ptr )
+{
+  HeapProf_OnFree( ptr );
+}
+
+#endif
+
+void HeapProf_GetModule( heap_mod_t module, heap_mod_stats_t* stats )
+{
+  assert( module < HEAP_MOD_TOP );
+
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.modules[module];
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+const char* HeapProf_GetModuleName( heap_mod_t module )
+{
+  return module < HEAP_MOD_TOP ? module_name[module] : "none";
+}
+
+uint32_t HeapProf_GetCurrent( void )
+{
+  uint32_t current = 0;
+
+  portENTER_CRITICAL( &ctx.lock );
+  for ( int i = 0; i < HEAP_MOD_TOP; i++ )
+  {
+    current += ctx.modules[i].current;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return current;
+}
+
+uint32_t HeapProf_GetUntracked( void )
+{
+  return ctx.untracked;
+}
+
+uint32_t HeapProf_GetHistory( heap_sample_t* samples, uint32_t size )
+{
+  uint32_t cnt = ctx.history_cnt < HEAP_PROF_HISTORY ? ctx.history_cnt : HEAP_PROF_HISTORY;
+  uint32_t first = ctx.history_cnt - cnt;
+
+  if ( cnt > size )
+  {
+    first += cnt - size;
+    cnt = size;
+  }
+
+  /* Oldest first */
+  for ( uint32_t i = 0; i < cnt; i++ )
+  {
+    samples[i] = ctx.history[( first + i ) % HEAP_PROF_HISTORY];
+  }
+
+  return cnt;
+}
+
+void HeapProf_Sample( void )
+{
+  heap_sample_t sample =
+    {
+      .free = heap_caps_get_free_size( MALLOC_CAP_8BIT ),
+      .largest = heap_caps_get_largest_free_block( MALLOC_CAP_8BIT ),
+    };
+  uint32_t watermark = parameters_getValue( PARAM_HEAP_WATERMARK );
+
+  if ( ctx.sample_cnt++ % HEAP_PROF_HISTORY_EVERY == 0 )
+  {
+    ctx.history[ctx.history_cnt++ % HEAP_PROF_HISTORY] = sample;
+  }
+
+  parameters_setValue( PARAM_HEAP_FREE, sample.free );
+  parameters_setValue( PARAM_HEAP_MIN_FREE, heap_caps_get_minimum_free_size( MALLOC_CAP_8BIT ) );
+  parameters_setValue( PARAM_HEAP_LARGEST, sample.largest );
+
+  if ( !ctx.below_watermark && ( sample.free < watermark ) )
+  {
+    ctx.below_watermark = true;
+    LOG( PRINT_WARNING, "free heap %u below %u", sample.free, watermark );
+    HeapProf_Print();
+  }
+  else if ( ctx.below_watermark && ( sample.free > watermark + HEAP_PROF_HYSTERESIS ) )
+  {
+    ctx.below_watermark = false;
+  }
+
+  if ( ParamStore_Take( PARAM_HEAP_PRINT ) )
+  {
+    HeapProf_Print();
+  }
+}
+
+void HeapProf_Print( void )
+{
+  heap_mod_stats_t stats;
+  heap_sample_t history[HEAP_PROF_HISTORY];
+  uint32_t history_cnt = HeapProf_GetHistory( history, HEAP_PROF_HISTORY );
+
+  printf( "HEAP: free %lu min %lu largest %lu untracked %lu\n",
+          (unsigned long) heap_caps_get_free_size( MALLOC_CAP_8BIT ),
+          (unsigned long) heap_caps_get_minimum_free_size( MALLOC_CAP_8BIT ),
+          (unsigned long) heap_caps_get_largest_free_block( MALLOC_CAP_8BIT ), (unsigned long) ctx.untracked );
+  printf( "HEAP: %-12s %8s %8s %8s %8s\n", "module", "current", "peak", "allocs", "frees" );
+
+  for ( int i = 0; i < HEAP_MOD_TOP; i++ )
+  {
+    HeapProf_GetModule( i, &stats );
+    printf( "HEAP: %-12s %8lu %8lu %8lu %8lu\n", module_name[i], (unsigned long) stats.current,
+            (unsigned long) stats.peak, (unsigned long) stats.allocs, (unsigned long) stats.frees );
+  }
+
+  /* free/largest, a growing gap between them is fragmentation */
+  for ( uint32_t i = 0; i < history_cnt; i++ )
+  {
+    printf( "HEAP: history %2lu %8lu %8lu\n", (unsigned long) i, (unsigned long) history[i].free,
+            (unsigned long) history[i].largest );
+  }
+}
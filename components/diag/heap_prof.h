@@ -0,0 +1,76 @@
+#ifndef HEAP_PROF_H_
+#define HEAP_PROF_H_
+
+#include "app_config.h"
+
+/* Heap use per module. The heap hooks (CONFIG_HEAP_USE_HOOKS, on the host the
+ * simulator malloc wrappers) report every allocation, it is charged to the
+ * innermost open scope of the calling task, else to the module matching the
+ * task name prefix, else to "other". Frees are matched through a table of
+ * live allocations, allocations which do not fit are only counted. A task
+ * finds its entry through a thread local storage pointer whose deletion
+ * callback frees the entry with the task.
+ *
+ * HeapProf_Sample() is called once per task stats window, it keeps the free
+ * heap and largest free block history and prints the summary once when the
+ * free heap drops below PARAM_HEAP_WATERMARK. */
+
+/* HEAP_MODULE(id, name, task_prefix), "" for modules only charged through
+ * scopes */
+#define HEAP_MODULE_LIST                                         \
+  HEAP_MODULE( HEAP_MOD_OTHER, "other", "" )                     \
+  HEAP_MODULE( HEAP_MOD_HTTP_SERVER, "http_server", "httpd" )    \
+  HEAP_MODULE( HEAP_MOD_MONGOOSE, "mongoose", "mongoose" )       \
+  HEAP_MODULE( HEAP_MOD_HTTP_CLIENT, "http_client", "" )         \
+  HEAP_MODULE( HEAP_MOD_WIFIDRV, "wifidrv", "wifi" )             \
+  HEAP_MODULE( HEAP_MOD_LWIP, "lwip", "tiT" )                    \
+  HEAP_MODULE( HEAP_MOD_PARAMETERS, "parameters", "" )           \
+  HEAP_MODULE( HEAP_MOD_OTA, "ota", "ota" )                      \
+  HEAP_MODULE( HEAP_MOD_MENU, "menu", "menu" )                   \
+  HEAP_MODULE( HEAP_MOD_CONTROLLER, "controller", "srvrControl" )
+
+typedef enum
+{
+#define HEAP_MODULE( _id, _name, _task_prefix ) _id,
+  HEAP_MODULE_LIST
+#undef HEAP_MODULE
+  HEAP_MOD_TOP,
+  HEAP_MOD_NONE = HEAP_MOD_TOP,
+} heap_mod_t;
+
+#define HEAP_PROF_HISTORY        32       // free heap samples kept
+#define HEAP_PROF_HISTORY_EVERY  10       // sample calls per history entry
+#define HEAP_PROF_HYSTERESIS     4096     // bytes above the watermark to re-arm the summary
+#define HEAP_PROF_TLS_INDEX      1        // thread local storage pointer of a task's entry, 0 is pthread's
+
+typedef struct
+{
+  uint32_t current;
+  uint32_t peak;
+  uint32_t allocs;
+  uint32_t frees;
+} heap_mod_stats_t;
+
+typedef struct
+{
+  uint32_t free;
+  uint32_t largest;
+} heap_sample_t;
+
+/* Scopes nest per task, exit restores what enter returned */
+heap_mod_t HeapProf_ScopeEnter( heap_mod_t module );
+void HeapProf_ScopeExit( heap_mod_t prev );
+
+void HeapProf_OnAlloc( void* ptr, uint32_t size );
+void HeapProf_OnFree( void* ptr );
+
+void HeapProf_GetModule( heap_mod_t module, heap_mod_stats_t* stats );
+const char* HeapProf_GetModuleName( heap_mod_t module );
+uint32_t HeapProf_GetCurrent( void );    // all tracked modules
+uint32_t HeapProf_GetUntracked( void );  // allocations the live table had no room for
+uint32_t HeapProf_GetHistory( heap_sample_t* samples, uint32_t size );
+
+void HeapProf_Sample( void );
+void HeapProf_Print( void );
+
+#endif
@@ -0,0 +1,135 @@
+#include "init_graph.h"
+
+#include "boot_time.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#define MODULE_NAME "[INIT] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_BOOT_TIME
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+typedef struct
+{
+  init_step_t* step;
+  QueueHandle_t done;
+} init_job_t;
+
+static void _run( init_step_t* step )
+{
+  step->start_us = (uint32_t) esp_timer_get_time();
+  step->run();
+  step->end_us = (uint32_t) esp_timer_get_time();
+}
+
+static void _task( void* arg )
+{
+  init_job_t* job = arg;
+  init_step_t* step = job->step;
+
+  _run( step );
+  xQueueSend( job->done, &step, portMAX_DELAY );
+  vTaskDelete( NULL );
+}
+
+/* Kahn's order on the masks, every step reachable */
+static bool _check( const init_step_t* steps, uint32_t cnt, uint32_t all )
+{
+  uint32_t done = 0;
+  bool progress = true;
+
+  while ( progress && ( done != all ) )
+  {
+    progress = false;
+    for ( uint32_t i = 0; i < cnt; i++ )
+    {
+      if ( !( done & INIT_AFTER( i ) ) && ( ( steps[i].after & ~done ) == 0 ) )
+      {
+        done |= INIT_AFTER( i );
+        progress = true;
+      }
+    }
+  }
+
+  return done == all;
+}
+
+bool InitGraph_Run( init_step_t* steps, uint32_t cnt )
+{
+  init_job_t jobs[INIT_GRAPH_STEPS_MAX];
+  uint32_t all = cnt <= INIT_GRAPH_STEPS_MAX ? ( 1u << cnt ) - 1 : 0;
+  uint32_t started = 0;
+  uint32_t done = 0;
+
+  if ( ( cnt > INIT_GRAPH_STEPS_MAX ) || !_check( steps, cnt, all ) )
+  {
+    LOG( PRINT_ERROR, "steps never ready" );
+    return false;
+  }
+
+  QueueHandle_t queue = xQueueCreate( cnt, sizeof( init_step_t* ) );
+  uint32_t start_us = (uint32_t) esp_timer_get_time();
+  uint32_t busy_us = 0;
+
+  while ( done != all )
+  {
+    init_step_t* next = NULL;
+
+    /* All tasks first, then one step on this task */
+    for ( uint32_t i = 0; i < cnt; i++ )
+    {
+      init_step_t* step = &steps[i];
+
+      if ( ( started & INIT_AFTER( i ) ) || ( ( step->after & ~done ) != 0 ) )
+      {
+        continue;
+      }
+
+      jobs[i] = ( init_job_t ) {
+        .step = step,
+        .done = queue,
+      };
+
+      if ( ( step->stack > 0 ) && ( queue != NULL )
+           && ( xTaskCreate( _task, step->name, step->stack, &jobs[i], INIT_GRAPH_PRIO, NULL ) == pdPASS ) )
+      {
+        started |= INIT_AFTER( i );
+      }
+      else if ( next == NULL )
+      {
+        next = step;
+      }
+    }
+
+    /* The check made sure a step is ready or running */
+    if ( next != NULL )
+    {
+      started |= INIT_AFTER( next - steps );
+      _run( next );
+    }
+    else
+    {
+      xQueueReceive( queue, &next, portMAX_DELAY );
+    }
+
+    done |= INIT_AFTER( next - steps );
+    busy_us += next->end_us - next->start_us;
+    BootTime_Add( next->name, next->start_us, next->end_us );
+  }
+
+  if ( queue != NULL )
+  {
+    vQueueDelete( queue );
+  }
+
+  LOG( PRINT_INFO, "%lu steps in %lu ms, %lu ms one after the other", cnt,
+       ( (uint32_t) esp_timer_get_time() - start_us ) / 1000, busy_us / 1000 );
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef INIT_GRAPH_H_
+#define INIT_GRAPH_H_
+
+#include "app_config.h"
+
+/* Init steps with declared dependencies. InitGraph_Run() starts every step
+ * whose dependencies are done, each in its own short lived task, so
+ * independent subsystems come up concurrently. Steps without a stack run
+ * on the caller's task in between, as does any step whose task could not
+ * be created. Each step's start and end go to the boot timeline. */
+
+#define INIT_GRAPH_STEPS_MAX 24
+#define INIT_GRAPH_PRIO      5
+
+#define INIT_AFTER( _step ) ( 1u << ( _step ) )
+
+typedef struct
+{
+  const char* name;
+  void ( *run )( void );
+  uint32_t after;    // INIT_AFTER() of the steps it needs
+  uint32_t stack;    // 0 on the caller's task
+  uint32_t start_us;
+  uint32_t end_us;
+} init_step_t;
+
+/* Steps in any order of the enum indexing them, false on a dependency
+ * which can never be met, nothing is started then */
+bool InitGraph_Run( init_step_t* steps, uint32_t cnt );
+
+#endif
@@ -0,0 +1,220 @@
+#include "latency_trace.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "parameters.h"
+
+#define LAT_RECORDS_CNT 4
+#define LAT_NO_STAMP    -1
+
+typedef struct
+{
+  uint32_t id;
+  lat_hop_t first_hop;
+  int64_t stamp_us[LAT_HOP_TOP];
+} lat_record_t;
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  lat_record_t records[LAT_RECORDS_CNT];
+  uint8_t next_record;
+  uint32_t next_id;
+  uint32_t pending_id;
+  lat_hist_t hist[LAT_HOP_TOP];
+} latency_trace_t;
+
+static latency_trace_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static lat_record_t* _find( uint32_t id )
+{
+  for ( uint8_t i = 0; i < LAT_RECORDS_CNT; i++ )
+  {
+    if ( ctx.records[i].id == id )
+    {
+      return &ctx.records[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Reuses the oldest slot, records which never reach their last hop age out */
+static lat_record_t* _alloc( uint32_t id, lat_hop_t first_hop )
+{
+  lat_record_t* record = &ctx.records[ctx.next_record];
+  ctx.next_record = ( ctx.next_record + 1 ) % LAT_RECORDS_CNT;
+
+  record->id = id;
+  record->first_hop = first_hop;
+  for ( int i = 0; i < LAT_HOP_TOP; i++ )
+  {
+    record->stamp_us[i] = LAT_NO_STAMP;
+  }
+
+  return record;
+}
+
+static uint8_t _bucket( uint32_t us )
+{
+  if ( us == 0 )
+  {
+    return 0;
+  }
+
+  uint8_t bucket = 31 - __builtin_clz( us );
+  return bucket < LAT_HIST_BUCKETS ? bucket : LAT_HIST_BUCKETS - 1;
+}
+
+void LatencyTrace_HistAdd( lat_hist_t* hist, uint32_t us )
+{
+  hist->count++;
+  hist->buckets[_bucket( us )]++;
+  if ( us > hist->max_us )
+  {
+    hist->max_us = us;
+  }
+}
+
+static void _fold( lat_record_t* record )
+{
+  int64_t start = record->stamp_us[record->first_hop];
+
+  for ( int hop = record->first_hop + 1; hop < LAT_HOP_TOP; hop++ )
+  {
+    if ( record->stamp_us[hop] != LAT_NO_STAMP )
+    {
+      int64_t delta = record->stamp_us[hop] - start;
+      LatencyTrace_HistAdd( &ctx.hist[hop], delta > UINT32_MAX ? UINT32_MAX : (uint32_t) delta );
+    }
+  }
+
+  record->id = 0;
+}
+
+uint32_t LatencyTrace_Begin( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ++ctx.next_id == 0 )
+  {
+    ctx.next_id = 1;
+  }
+  uint32_t id = ctx.next_id;
+  lat_record_t* record = _alloc( id, LAT_HOP_BUTTON );
+  record->stamp_us[LAT_HOP_BUTTON] = esp_timer_get_time();
+  ctx.pending_id = id;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return id;
+}
+
+uint32_t LatencyTrace_TakePending( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  uint32_t id = ctx.pending_id;
+  ctx.pending_id = 0;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return id;
+}
+
+void LatencyTrace_Mark( uint32_t id, lat_hop_t hop )
+{
+  if ( ( id == 0 ) || ( hop >= LAT_HOP_TOP ) )
+  {
+    return;
+  }
+
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL( &ctx.lock );
+  lat_record_t* record = _find( id );
+  if ( record == NULL )
+  {
+    record = _alloc( id, hop );
+  }
+
+  if ( record->stamp_us[hop] == LAT_NO_STAMP )
+  {
+    record->stamp_us[hop] = now;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void LatencyTrace_End( uint32_t id, lat_hop_t hop )
+{
+  if ( ( id == 0 ) || ( hop >= LAT_HOP_TOP ) )
+  {
+    return;
+  }
+
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL( &ctx.lock );
+  lat_record_t* record = _find( id );
+  if ( record != NULL )
+  {
+    record->stamp_us[hop] = now;
+    _fold( record );
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void LatencyTrace_GetHistogram( lat_hop_t hop, lat_hist_t* hist )
+{
+  assert( hop < LAT_HOP_TOP );
+  assert( hist );
+
+  portENTER_CRITICAL( &ctx.lock );
+  *hist = ctx.hist[hop];
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+/* Upper edge of the bucket holding the percentile, clamped to the maximum seen */
+uint32_t LatencyTrace_Percentile( const lat_hist_t* hist, uint8_t percent )
+{
+  assert( hist );
+
+  if ( hist->count == 0 )
+  {
+    return 0;
+  }
+
+  uint64_t target = ( (uint64_t) hist->count * percent + 99 ) / 100;
+  uint64_t seen = 0;
+
+  for ( uint8_t i = 0; i < LAT_HIST_BUCKETS; i++ )
+  {
+    seen += hist->buckets[i];
+    if ( ( seen >= target ) && ( seen > 0 ) )
+    {
+      uint64_t edge = ( 2ull << i ) - 1;
+      return edge < hist->max_us ? edge : hist->max_us;
+    }
+  }
+
+  return hist->max_us;
+}
+
+void LatencyTrace_Publish( lat_hop_t hop )
+{
+  lat_hist_t hist;
+
+  LatencyTrace_GetHistogram( hop, &hist );
+  parameters_setValue( PARAM_LAT_COUNT, hist.count );
+  parameters_setValue( PARAM_LAT_P50_US, LatencyTrace_Percentile( &hist, 50 ) );
+  parameters_setValue( PARAM_LAT_P99_US, LatencyTrace_Percentile( &hist, 99 ) );
+  parameters_setValue( PARAM_LAT_MAX_US, hist.max_us );
+}
+
+void LatencyTrace_Reset( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  memset( ctx.records, 0, sizeof( ctx.records ) );
+  memset( ctx.hist, 0, sizeof( ctx.hist ) );
+  ctx.pending_id = 0;
+  portEXIT_CRITICAL( &ctx.lock );
+}
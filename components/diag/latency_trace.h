@@ -0,0 +1,45 @@
+#ifndef LATENCY_TRACE_H_
+#define LATENCY_TRACE_H_
+
+#include "app_config.h"
+
+/* Button to valve latency. Each valve toggle on the remote gets a correlation
+ * id which is sent to the controller in PARAM_LAT_CORR_ID. Every device stamps
+ * the hops it sees and keeps a histogram of the time from its first stamp of
+ * a record to each later hop. */
+
+#define LAT_HIST_BUCKETS 24    // bucket n counts [2^n, 2^(n+1)) us
+
+typedef enum
+{
+  LAT_HOP_BUTTON,            // remote: button callback
+  LAT_HOP_BACKEND_SEND,      // remote: backend sends the valve state
+  LAT_HOP_REQUEST_RECEIVED,  // controller: http server got the request
+  LAT_HOP_PARAM_SET,         // controller: parameter store updated
+  LAT_HOP_CONTROLLER_READ,   // controller: state machine read the new state
+  LAT_HOP_GPIO_SET,          // controller: valve gpio edge
+  LAT_HOP_TOP,
+} lat_hop_t;
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t max_us;
+  uint32_t buckets[LAT_HIST_BUCKETS];
+} lat_hist_t;
+
+/* Remote side */
+uint32_t LatencyTrace_Begin( void );
+uint32_t LatencyTrace_TakePending( void );
+
+/* Both sides, id 0 is ignored */
+void LatencyTrace_Mark( uint32_t id, lat_hop_t hop );
+void LatencyTrace_End( uint32_t id, lat_hop_t hop );
+
+void LatencyTrace_GetHistogram( lat_hop_t hop, lat_hist_t* hist );
+void LatencyTrace_HistAdd( lat_hist_t* hist, uint32_t us );
+uint32_t LatencyTrace_Percentile( const lat_hist_t* hist, uint8_t percent );
+void LatencyTrace_Publish( lat_hop_t hop );
+void LatencyTrace_Reset( void );
+
+#endif
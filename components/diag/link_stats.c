@@ -0,0 +1,129 @@
+#include "link_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#define LINK_LINE_LEN 320
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  link_band_stats_t bands[LINK_BAND_TOP];
+} link_stats_t;
+
+static link_stats_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char* band_name[] =
+  {
+#define LINK_BAND( _id, _name, _rssi_min ) [_id] = _name,
+    LINK_BAND_LIST
+#undef LINK_BAND
+};
+
+static const int32_t band_rssi_min[] =
+  {
+#define LINK_BAND( _id, _name, _rssi_min ) [_id] = _rssi_min,
+    LINK_BAND_LIST
+#undef LINK_BAND
+};
+
+link_band_t LinkStats_Band( int rssi )
+{
+  for ( int band = 0; band < LINK_BAND_TOP - 1; band++ )
+  {
+    if ( rssi >= band_rssi_min[band] )
+    {
+      return band;
+    }
+  }
+
+  return LINK_BAND_TOP - 1;
+}
+
+const char* LinkStats_GetBandName( link_band_t band )
+{
+  return band < LINK_BAND_TOP ? band_name[band] : "?";
+}
+
+void LinkStats_Record( int rssi, uint32_t latency_us, link_result_t result )
+{
+  link_band_stats_t* band = &ctx.bands[LinkStats_Band( rssi )];
+
+  portENTER_CRITICAL( &ctx.lock );
+  switch ( result )
+  {
+    case LINK_RESULT_OK:
+      LatencyTrace_HistAdd( &band->hist, latency_us );
+      break;
+
+    case LINK_RESULT_TIMEOUT:
+      band->timeouts++;
+      break;
+
+    default:
+      band->fails++;
+      break;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void LinkStats_GetBand( link_band_t band, link_band_stats_t* stats )
+{
+  assert( band < LINK_BAND_TOP );
+  assert( stats );
+
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.bands[band];
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void LinkStats_Reset( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  memset( ctx.bands, 0, sizeof( ctx.bands ) );
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void LinkStats_Export( void ( *write )( const char* line, void* arg ), void* arg )
+{
+  char line[LINK_LINE_LEN];
+  link_band_stats_t stats;
+  int len;
+
+  len = snprintf( line, sizeof( line ), "band,requests,timeouts,fails,p50_us,p90_us,max_us" );
+  for ( int i = 0; ( i < LAT_HIST_BUCKETS ) && ( len < (int) sizeof( line ) ); i++ )
+  {
+    len += snprintf( &line[len], sizeof( line ) - len, ",b%d", i );
+  }
+  write( line, arg );
+
+  for ( int band = 0; band < LINK_BAND_TOP; band++ )
+  {
+    LinkStats_GetBand( band, &stats );
+    len = snprintf( line, sizeof( line ), "%s,%lu,%lu,%lu,%lu,%lu,%lu", band_name[band],
+                    (unsigned long) stats.hist.count, (unsigned long) stats.timeouts, (unsigned long) stats.fails,
+                    (unsigned long) LatencyTrace_Percentile( &stats.hist, 50 ),
+                    (unsigned long) LatencyTrace_Percentile( &stats.hist, 90 ), (unsigned long) stats.hist.max_us );
+    for ( int i = 0; ( i < LAT_HIST_BUCKETS ) && ( len < (int) sizeof( line ) ); i++ )
+    {
+      len += snprintf( &line[len], sizeof( line ) - len, ",%lu", (unsigned long) stats.hist.buckets[i] );
+    }
+    write( line, arg );
+  }
+}
+
+static void _print_line( const char* line, void* arg )
+{
+  (void) arg;
+  printf( "LINK: %s\n", line );
+}
+
+void LinkStats_Print( void )
+{
+  LinkStats_Export( _print_line, NULL );
+}
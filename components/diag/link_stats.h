@@ -0,0 +1,53 @@
+#ifndef LINK_STATS_H_
+#define LINK_STATS_H_
+
+#include "app_config.h"
+#include "latency_trace.h"
+
+/* Request latency of the remote parameters client split by the RSSI seen
+ * when the request started. Timeouts and failures are only counted, the
+ * histogram holds completed requests. The band edges follow the signal
+ * levels drawn in the status bar. */
+
+/* LINK_BAND(id, name, rssi_min) */
+#define LINK_BAND_LIST                           \
+  LINK_BAND( LINK_BAND_EXCELLENT, ">-55", -55 )  \
+  LINK_BAND( LINK_BAND_GOOD, ">-65", -65 )       \
+  LINK_BAND( LINK_BAND_FAIR, ">-72", -72 )       \
+  LINK_BAND( LINK_BAND_WEAK, ">-80", -80 )       \
+  LINK_BAND( LINK_BAND_BAD, "<-80", INT32_MIN )
+
+typedef enum
+{
+#define LINK_BAND( _id, _name, _rssi_min ) _id,
+  LINK_BAND_LIST
+#undef LINK_BAND
+  LINK_BAND_TOP,
+} link_band_t;
+
+typedef enum
+{
+  LINK_RESULT_OK,
+  LINK_RESULT_TIMEOUT,
+  LINK_RESULT_FAIL,
+} link_result_t;
+
+typedef struct
+{
+  lat_hist_t hist;
+  uint32_t timeouts;
+  uint32_t fails;
+} link_band_stats_t;
+
+link_band_t LinkStats_Band( int rssi );
+const char* LinkStats_GetBandName( link_band_t band );
+void LinkStats_Record( int rssi, uint32_t latency_us, link_result_t result );
+void LinkStats_GetBand( link_band_t band, link_band_stats_t* stats );
+void LinkStats_Reset( void );
+
+/* One CSV line per band: band,requests,timeouts,fails,p50_us,p90_us,max_us
+ * and the histogram buckets */
+void LinkStats_Export( void ( *write )( const char* line, void* arg ), void* arg );
+void LinkStats_Print( void );
+
+#endif
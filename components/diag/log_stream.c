@@ -0,0 +1,232 @@
+#include "log_stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "field_log.h"
+#include "freertos/FreeRTOS.h"
+#include "trace.h"
+
+#define MODULE_NAME "[LOG_STREAM] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_LOG_STREAM
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define RANGE_UNIT "bytes="
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  uint32_t field_seq;    // first block when the transfer opened
+  log_stream_stats_t stats;
+  /* Off the httpd stack, which also holds the field log flush. Transfers
+   * run one at a time in the single task of the log server. */
+  uint8_t chunk[LOG_STREAM_CHUNK];
+} log_stream_t;
+
+static log_stream_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t _field_open( uint32_t* tag )
+{
+  FieldLog_Flush();
+  ctx.field_seq = FieldLog_GetFirstSeq();
+  *tag = ctx.field_seq;
+  return FieldLog_GetSize();
+}
+
+/* Checked after the read, a block dropped meanwhile shifted the offsets */
+static uint32_t _field_read( uint32_t offset, void* data, uint32_t len )
+{
+  uint32_t done = FieldLog_Read( offset, data, len );
+  return FieldLog_GetFirstSeq() == ctx.field_seq ? done : 0;
+}
+
+static void _field_close( void )
+{
+}
+
+static const log_stream_source_t sources[] =
+  {
+    {
+      .name = "field",
+      .open = _field_open,
+      .read = _field_read,
+      .close = _field_close,
+    },
+    {
+      .name = "trace",
+      .open = Trace_DumpBegin,
+      .read = Trace_DumpRead,
+      .close = Trace_DumpEnd,
+    },
+};
+
+const log_stream_source_t* LogStream_Find( const char* name )
+{
+  for ( uint32_t i = 0; i < sizeof( sources ) / sizeof( sources[0] ); i++ )
+  {
+    if ( strcmp( sources[i].name, name ) == 0 )
+    {
+      return &sources[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Saturates, false without a digit */
+static bool _number( const char** str, uint32_t* value )
+{
+  const char* p = *str;
+
+  *value = 0;
+  for ( ; ( *p >= '0' ) && ( *p <= '9' ); p++ )
+  {
+    uint32_t digit = *p - '0';
+    *value = *value > ( UINT32_MAX - digit ) / 10 ? UINT32_MAX : *value * 10 + digit;
+  }
+
+  bool ret = p != *str;
+  *str = p;
+  return ret;
+}
+
+log_range_t LogStream_ParseRange( const char* range, uint32_t size, uint32_t* first, uint32_t* last )
+{
+  uint32_t a;
+  uint32_t b;
+
+  if ( ( range == NULL ) || ( strncmp( range, RANGE_UNIT, strlen( RANGE_UNIT ) ) != 0 ) )
+  {
+    return LOG_RANGE_NONE;
+  }
+
+  const char* p = range + strlen( RANGE_UNIT );
+  bool has_first = _number( &p, &a );
+  if ( *p++ != '-' )
+  {
+    return LOG_RANGE_NONE;
+  }
+  bool has_last = _number( &p, &b );
+
+  /* Several ranges or a reversed one are ignored, the whole log is sent */
+  if ( ( *p != '\0' ) || ( !has_first && !has_last ) || ( has_first && has_last && ( b < a ) ) )
+  {
+    return LOG_RANGE_NONE;
+  }
+
+  if ( !has_first )
+  {
+    if ( ( b == 0 ) || ( size == 0 ) )
+    {
+      return LOG_RANGE_UNSATISFIABLE;
+    }
+    *first = b < size ? size - b : 0;
+    *last = size - 1;
+    return LOG_RANGE_OK;
+  }
+
+  if ( a >= size )
+  {
+    return LOG_RANGE_UNSATISFIABLE;
+  }
+
+  *first = a;
+  *last = has_last && ( b < size - 1 ) ? b : size - 1;
+  return LOG_RANGE_OK;
+}
+
+static void _count( uint32_t* counter, uint32_t add )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  *counter += add;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+bool LogStream_Serve( const log_stream_source_t* source, const char* range, const char* if_range, const log_stream_io_t* io )
+{
+  assert( source );
+  assert( io );
+
+  char tag_str[LOG_STREAM_TAG_SIZE];
+  char content_range[40];
+  log_range_t ret = LOG_RANGE_NONE;
+  uint32_t tag;
+  uint32_t first = 0;
+  uint32_t last = 0;
+
+  uint32_t size = source->open( &tag );
+  snprintf( tag_str, sizeof( tag_str ), "\"%08lx\"", (unsigned long) tag );
+  _count( &ctx.stats.transfers, 1 );
+
+  /* A stale If-Range turns the resume into a full download */
+  if ( ( if_range == NULL ) || ( strcmp( if_range, tag_str ) == 0 ) )
+  {
+    ret = LogStream_ParseRange( range, size, &first, &last );
+  }
+
+  if ( ret == LOG_RANGE_UNSATISFIABLE )
+  {
+    snprintf( content_range, sizeof( content_range ), "bytes */%lu", (unsigned long) size );
+    io->status( io->arg, 416 );
+    io->header( io->arg, "Content-Range", content_range );
+    bool sent = io->send( io->arg, NULL, 0 );
+    source->close();
+    return sent;
+  }
+
+  io->status( io->arg, ret == LOG_RANGE_OK ? 206 : 200 );
+  io->header( io->arg, "Accept-Ranges", "bytes" );
+  io->header( io->arg, "ETag", tag_str );
+  if ( ret == LOG_RANGE_OK )
+  {
+    snprintf( content_range, sizeof( content_range ), "bytes %lu-%lu/%lu", (unsigned long) first, (unsigned long) last,
+              (unsigned long) size );
+    io->header( io->arg, "Content-Range", content_range );
+    _count( &ctx.stats.resumed, 1 );
+  }
+  else
+  {
+    first = 0;
+    last = size - 1;
+  }
+
+  uint32_t offset = first;
+  uint32_t end = size > 0 ? last + 1 : 0;
+  bool sent = true;
+  while ( sent && ( offset < end ) )
+  {
+    uint32_t len = source->read( offset, ctx.chunk, end - offset < sizeof( ctx.chunk ) ? end - offset : sizeof( ctx.chunk ) );
+
+    /* The log changed under the transfer, the client sees it cut short */
+    sent = ( len > 0 ) && io->send( io->arg, ctx.chunk, len );
+    offset += sent ? len : 0;
+    _count( &ctx.stats.bytes, sent ? len : 0 );
+  }
+
+  sent = sent && io->send( io->arg, NULL, 0 );
+  source->close();
+
+  if ( !sent )
+  {
+    _count( &ctx.stats.aborted, 1 );
+    LOG( PRINT_WARNING, "%s aborted at %lu of %lu", source->name, offset, size );
+  }
+
+  return sent;
+}
+
+void LogStream_GetStats( log_stream_stats_t* stats )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.stats;
+  portEXIT_CRITICAL( &ctx.lock );
+}
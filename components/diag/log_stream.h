@@ -0,0 +1,62 @@
+#ifndef LOG_STREAM_H_
+#define LOG_STREAM_H_
+
+#include "app_config.h"
+
+/* Ranged downloads of the on-device logs. A source gives its size and a
+ * tag of its content when a transfer opens and is then read by offset, so
+ * a transfer holds one chunk in RAM whatever the size of the log. A Range
+ * request resumes a dropped transfer; with If-Range it only does when the
+ * tag still matches, otherwise the whole log is sent again (blocks rotated,
+ * new traces). The HTTP side is in log_stream_http.c, LogStream_Serve()
+ * only talks to a log_stream_io_t. */
+
+#define LOG_STREAM_CHUNK     1020    // whole field log records
+#define LOG_STREAM_HTTP_PORT 8081
+#define LOG_STREAM_TAG_SIZE  12      // quoted 8 hex digits
+
+typedef struct
+{
+  const char* name;                            // GET /log/<name>
+  uint32_t ( *open )( uint32_t* tag );        // size, the content below it stays until close
+  uint32_t ( *read )( uint32_t offset, void* data, uint32_t len );    // short when the log changed
+  void ( *close )( void );
+} log_stream_source_t;
+
+typedef struct
+{
+  void ( *status )( void* arg, uint16_t code );
+  void ( *header )( void* arg, const char* field, const char* value );    // values live until the end
+  bool ( *send )( void* arg, const void* data, uint32_t len );           // len 0 ends the response
+  void* arg;
+} log_stream_io_t;
+
+typedef enum
+{
+  LOG_RANGE_NONE,    // absent or not understood, the whole log
+  LOG_RANGE_OK,
+  LOG_RANGE_UNSATISFIABLE,
+} log_range_t;
+
+typedef struct
+{
+  uint32_t transfers;
+  uint32_t resumed;    // answered 206
+  uint32_t aborted;    // client gone or log changed under the transfer
+  uint32_t bytes;
+} log_stream_stats_t;
+
+/* bytes=first-last, bytes=first- and bytes=-suffix, one range only */
+log_range_t LogStream_ParseRange( const char* range, uint32_t size, uint32_t* first, uint32_t* last );
+
+/* Whole response for one request, false when it did not complete. Not
+ * reentrant, the chunk buffer is shared by all transfers. */
+bool LogStream_Serve( const log_stream_source_t* source, const char* range, const char* if_range, const log_stream_io_t* io );
+
+const log_stream_source_t* LogStream_Find( const char* name );
+void LogStream_GetStats( log_stream_stats_t* stats );
+
+/* GET /log/field and /log/trace on LOG_STREAM_HTTP_PORT */
+void LogStream_StartServer( void );
+
+#endif
@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "log_stream.h"
+
+#define MODULE_NAME "[LOG_STREAM] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_LOG_STREAM
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define URI_PREFIX      "/log/"
+#define RANGE_HDR_SIZE  48
+#define TAG_HDR_SIZE    ( LOG_STREAM_TAG_SIZE + 4 )
+
+static void _status( void* arg, uint16_t code )
+{
+  httpd_req_t* req = arg;
+
+  switch ( code )
+  {
+    case 206:
+      httpd_resp_set_status( req, "206 Partial Content" );
+      break;
+
+    case 416:
+      httpd_resp_set_status( req, "416 Range Not Satisfiable" );
+      break;
+
+    default:
+      httpd_resp_set_status( req, HTTPD_200 );
+      break;
+  }
+}
+
+static void _header( void* arg, const char* field, const char* value )
+{
+  httpd_resp_set_hdr( arg, field, value );
+}
+
+static bool _send( void* arg, const void* data, uint32_t len )
+{
+  return httpd_resp_send_chunk( arg, data, len ) == ESP_OK;
+}
+
+static esp_err_t _get_handler( httpd_req_t* req )
+{
+  char range[RANGE_HDR_SIZE];
+  char if_range[TAG_HDR_SIZE];
+  const log_stream_io_t io =
+    {
+      .status = _status,
+      .header = _header,
+      .send = _send,
+      .arg = req,
+    };
+
+  const log_stream_source_t* source = LogStream_Find( req->uri + strlen( URI_PREFIX ) );
+  if ( source == NULL )
+  {
+    httpd_resp_send_err( req, HTTPD_404_NOT_FOUND, NULL );
+    return ESP_FAIL;
+  }
+
+  bool has_range = httpd_req_get_hdr_value_str( req, "Range", range, sizeof( range ) ) == ESP_OK;
+  bool has_if_range = httpd_req_get_hdr_value_str( req, "If-Range", if_range, sizeof( if_range ) ) == ESP_OK;
+
+  httpd_resp_set_type( req, "application/octet-stream" );
+  return LogStream_Serve( source, has_range ? range : NULL, has_if_range ? if_range : NULL, &io ) ? ESP_OK : ESP_FAIL;
+}
+
+/* Own server instance, the parameters server keeps its port and handlers */
+void LogStream_StartServer( void )
+{
+  static const httpd_uri_t uri =
+    {
+      .uri = URI_PREFIX "*",
+      .method = HTTP_GET,
+      .handler = _get_handler,
+    };
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  httpd_handle_t server = NULL;
+
+  config.server_port = LOG_STREAM_HTTP_PORT;
+  config.ctrl_port = LOG_STREAM_HTTP_PORT + 1;
+  config.max_open_sockets = 1;    // LogStream_Serve() handles one transfer at a time
+  config.max_uri_handlers = 1;
+  config.stack_size = 4096;
+  config.uri_match_fn = httpd_uri_match_wildcard;
+
+  if ( httpd_start( &server, &config ) != ESP_OK )
+  {
+    LOG( PRINT_ERROR, "server start failed" );
+    return;
+  }
+
+  httpd_register_uri_handler( server, &uri );
+}
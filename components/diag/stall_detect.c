@@ -0,0 +1,322 @@
+#include "stall_detect.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "nvs.h"
+#include "param_store.h"
+#include "parameters.h"
+
+#if CONFIG_ESP_TASK_WDT_EN
+#include "esp_task_wdt.h"
+#endif
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+#include "esp_debug_helpers.h"
+#include "freertos/task_snapshot.h"
+#include "xtensa_context.h"
+#endif
+
+#define MODULE_NAME "[STALL] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_STALL_DETECT
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define STALL_NVS_NAMESPACE "stall"
+#define STALL_NVS_KEY       "log"
+#define STALL_LOG_VERSION   1
+
+typedef struct
+{
+  uint32_t version;
+  uint32_t count;    // entries ever logged
+  stall_entry_t entries[STALL_LOG_SIZE];
+} stall_log_t;
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  stall_watch_t* first;
+  stall_log_t log;
+  bool dirty;
+} stall_detect_t;
+
+static stall_detect_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+void StallDetect_Checkin( stall_watch_t* watch )
+{
+  TickType_t now = xTaskGetTickCount();
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( !watch->registered )
+  {
+    watch->registered = true;
+    watch->next = ctx.first;
+    ctx.first = watch;
+  }
+
+  watch->task = xTaskGetCurrentTaskHandle();
+  watch->checkin = now;
+  watch->armed = true;
+  watch->reported = false;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void StallDetect_Disarm( stall_watch_t* watch )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  watch->armed = false;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+
+/* Return addresses keep the call window size in the top bits */
+static uint32_t _stack_pc( uint32_t pc )
+{
+  if ( pc & 0x80000000 )
+  {
+    pc = ( pc & 0x3fffffff ) | 0x40000000;
+  }
+
+  return pc - 3;
+}
+
+/* The saved frame on top of a task which is not running gives the starting
+ * point, a running task on the other core has no stable frame to walk */
+static uint8_t _backtrace( TaskHandle_t task, uint32_t* pc, uint8_t size )
+{
+  TaskSnapshot_t snapshot;
+  esp_backtrace_frame_t frame = { 0 };
+  uint8_t depth = 0;
+
+  if ( ( eTaskGetState( task ) == eRunning ) || !vTaskGetSnapshot( task, &snapshot ) )
+  {
+    return 0;
+  }
+
+  XtExcFrame* exc_frame = (XtExcFrame*) snapshot.pxTopOfStack;
+  if ( exc_frame->exit == 0 )
+  {
+    XtSolFrame* sol_frame = (XtSolFrame*) snapshot.pxTopOfStack;
+    frame.pc = sol_frame->pc;
+    frame.sp = sol_frame->a1;
+    frame.next_pc = sol_frame->a0;
+  }
+  else
+  {
+    frame.pc = exc_frame->pc;
+    frame.sp = exc_frame->a1;
+    frame.next_pc = exc_frame->a0;
+  }
+
+  while ( depth < size )
+  {
+    pc[depth++] = _stack_pc( frame.pc );
+    if ( ( frame.next_pc == 0 ) || !esp_backtrace_get_next_frame( &frame ) )
+    {
+      break;
+    }
+  }
+
+  return depth;
+}
+
+#else
+
+static uint8_t _backtrace( TaskHandle_t task, uint32_t* pc, uint8_t size )
+{
+  (void) task;
+  (void) pc;
+  (void) size;
+  return 0;
+}
+
+#endif
+
+static void _load( void )
+{
+  nvs_handle_t handle;
+  size_t size = sizeof( ctx.log );
+
+  if ( nvs_open( STALL_NVS_NAMESPACE, NVS_READONLY, &handle ) != ESP_OK )
+  {
+    return;
+  }
+
+  if ( ( nvs_get_blob( handle, STALL_NVS_KEY, &ctx.log, &size ) != ESP_OK ) || ( size != sizeof( ctx.log ) )
+       || ( ctx.log.version != STALL_LOG_VERSION ) )
+  {
+    memset( &ctx.log, 0, sizeof( ctx.log ) );
+  }
+  nvs_close( handle );
+}
+
+static void _save( void )
+{
+  nvs_handle_t handle;
+
+  if ( nvs_open( STALL_NVS_NAMESPACE, NVS_READWRITE, &handle ) != ESP_OK )
+  {
+    LOG( PRINT_ERROR, "nvs open failed" );
+    return;
+  }
+
+  ctx.log.version = STALL_LOG_VERSION;
+  if ( ( nvs_set_blob( handle, STALL_NVS_KEY, &ctx.log, sizeof( ctx.log ) ) != ESP_OK ) || ( nvs_commit( handle ) != ESP_OK ) )
+  {
+    LOG( PRINT_ERROR, "nvs write failed" );
+  }
+  nvs_close( handle );
+}
+
+static void _report( stall_watch_t* watch, uint32_t late_ms )
+{
+  stall_entry_t entry = { 0 };
+
+  entry.uptime_ms = (uint32_t) ( esp_timer_get_time() / 1000 );
+  entry.late_ms = late_ms;
+  snprintf( entry.task, sizeof( entry.task ), "%s", watch->name );
+  if ( watch->sm != NULL )
+  {
+    snprintf( entry.state, sizeof( entry.state ), "%s", StateMachine_GetStateName( watch->sm, watch->sm->state ) );
+  }
+  entry.depth = _backtrace( watch->task, entry.pc, STALL_BT_DEPTH );
+
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.log.entries[ctx.log.count % STALL_LOG_SIZE] = entry;
+  ctx.log.count++;
+  ctx.dirty = true;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  LOG( PRINT_WARNING, "%s stalled in %s, %lu ms late", entry.task, entry.state, late_ms );
+}
+
+void StallDetect_Check( void )
+{
+  TickType_t now = xTaskGetTickCount();
+
+  for ( stall_watch_t* watch = ctx.first; watch != NULL; watch = watch->next )
+  {
+    portENTER_CRITICAL( &ctx.lock );
+    uint32_t elapsed_ms = ST2MS( now - watch->checkin );
+    bool stalled = watch->armed && !watch->reported && ( elapsed_ms > watch->deadline_ms );
+    if ( stalled )
+    {
+      watch->reported = true;
+    }
+    portEXIT_CRITICAL( &ctx.lock );
+
+    if ( stalled )
+    {
+      _report( watch, elapsed_ms - watch->deadline_ms );
+    }
+  }
+
+  /* NVS writes stay out of the critical section and off the watched tasks */
+  if ( ctx.dirty )
+  {
+    ctx.dirty = false;
+    _save();
+  }
+}
+
+uint32_t StallDetect_GetCount( void )
+{
+  return ctx.log.count < STALL_LOG_SIZE ? ctx.log.count : STALL_LOG_SIZE;
+}
+
+bool StallDetect_Get( uint32_t index, stall_entry_t* entry )
+{
+  uint32_t count = StallDetect_GetCount();
+
+  if ( index >= count )
+  {
+    return false;
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  *entry = ctx.log.entries[( ctx.log.count - count + index ) % STALL_LOG_SIZE];
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return true;
+}
+
+void StallDetect_Clear( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  memset( &ctx.log, 0, sizeof( ctx.log ) );
+  portEXIT_CRITICAL( &ctx.lock );
+  _save();
+}
+
+void StallDetect_Print( void )
+{
+  stall_entry_t entry;
+
+  printf( "STALL: %lu logged, last %lu\n", (unsigned long) ctx.log.count, (unsigned long) StallDetect_GetCount() );
+  for ( uint32_t i = 0; StallDetect_Get( i, &entry ); i++ )
+  {
+    printf( "STALL: %-12s %-20s up %lu ms late %lu ms bt", entry.task, entry.state, (unsigned long) entry.uptime_ms,
+            (unsigned long) entry.late_ms );
+    for ( uint8_t j = 0; j < entry.depth; j++ )
+    {
+      printf( " 0x%08lx", (unsigned long) entry.pc[j] );
+    }
+    printf( "\n" );
+  }
+}
+
+static void _task( void* arg )
+{
+#if CONFIG_ESP_TASK_WDT_EN
+  esp_task_wdt_user_handle_t wdt_user;
+  bool wdt = esp_task_wdt_add_user( "stall_mon", &wdt_user ) == ESP_OK;
+#endif
+
+  while ( 1 )
+  {
+    vTaskDelay( MS2ST( STALL_CHECK_MS ) );
+
+    StallDetect_Check();
+    parameters_setValue( PARAM_STALL_COUNT, ctx.log.count );
+
+    if ( ParamStore_Take( PARAM_STALL_PRINT ) )
+    {
+      StallDetect_Print();
+    }
+
+    if ( ParamStore_Take( PARAM_STALL_CLEAR ) )
+    {
+      StallDetect_Clear();
+    }
+
+#if CONFIG_ESP_TASK_WDT_EN
+    if ( wdt )
+    {
+      esp_task_wdt_reset_user( wdt_user );
+    }
+#endif
+  }
+}
+
+void StallDetect_Start( void )
+{
+  _load();
+  if ( ctx.log.count > 0 )
+  {
+    StallDetect_Print();
+  }
+
+  /* Above the watched tasks, a busy loop in one of them still gets reported */
+  xTaskCreate( _task, "stall_mon", 3072, NULL, 12, NULL );
+}
@@ -0,0 +1,68 @@
+#ifndef STALL_DETECT_H_
+#define STALL_DETECT_H_
+
+#include "app_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "state_machine.h"
+
+/* Stall detector. A task which may block checks in on its watch, a monitor
+ * task reports a watch which misses its deadline: it captures the backtrace
+ * of the watched task and the current state of its state machine and appends
+ * both to a log kept in NVS, so stalls in the field survive the reboot.
+ * A watch reports once per stall, the next check in re-arms it. The monitor
+ * is a task watchdog user, a stalled monitor is caught by the watchdog. */
+
+#define STALL_LOG_SIZE       8
+#define STALL_BT_DEPTH       8
+#define STALL_CHECK_MS       250
+#define STALL_TASK_NAME_LEN  16
+#define STALL_STATE_NAME_LEN 24
+
+typedef struct stall_watch
+{
+  const char* name;
+  uint32_t deadline_ms;
+  state_machine_t* sm;    // optional, its current state goes to the log
+  TaskHandle_t task;      // set by the first check in
+  TickType_t checkin;
+  bool armed;
+  bool reported;
+  bool registered;
+  struct stall_watch* next;
+} stall_watch_t;
+
+typedef struct
+{
+  uint32_t uptime_ms;
+  uint32_t late_ms;
+  char task[STALL_TASK_NAME_LEN];
+  char state[STALL_STATE_NAME_LEN];
+  uint8_t depth;
+  uint32_t pc[STALL_BT_DEPTH];
+} stall_entry_t;
+
+#define STALL_WATCH_DEFINE( _var, _name, _deadline_ms, _sm ) \
+  static stall_watch_t _var =                                \
+    {                                                        \
+      .name = _name,                                         \
+      .deadline_ms = _deadline_ms,                           \
+      .sm = _sm,                                             \
+  }
+
+void StallDetect_Start( void );
+
+/* Arms the watch for the calling task and restarts its deadline */
+void StallDetect_Checkin( stall_watch_t* watch );
+/* Leaving a section which checks in, an idle task is not a stalled one */
+void StallDetect_Disarm( stall_watch_t* watch );
+
+/* One monitor pass, called by the monitor task every STALL_CHECK_MS */
+void StallDetect_Check( void );
+
+uint32_t StallDetect_GetCount( void );    // entries in the log, oldest first
+bool StallDetect_Get( uint32_t index, stall_entry_t* entry );
+void StallDetect_Clear( void );
+void StallDetect_Print( void );
+
+#endif
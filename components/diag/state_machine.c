@@ -0,0 +1,121 @@
+#include "state_machine.h"
+
+#include <stdio.h>
+
+#include "freertos/task.h"
+
+#define MODULE_NAME "[SM] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_STATE_MACHINE
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  state_machine_t* first;
+} state_machines_t;
+
+static state_machines_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void _account( sm_state_stats_t* stats, uint32_t stay_ms )
+{
+  stats->total_ms += stay_ms;
+  if ( stay_ms > stats->longest_ms )
+  {
+    stats->longest_ms = stay_ms;
+  }
+}
+
+bool StateMachine_Change( state_machine_t* sm, uint32_t new_state )
+{
+  if ( new_state >= sm->states_cnt )
+  {
+    LOG( PRINT_ERROR, "%s: bad state %ld", sm->name, new_state );
+    return false;
+  }
+
+  if ( new_state == sm->state )
+  {
+    return false;
+  }
+
+  TickType_t now = xTaskGetTickCount();
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( !sm->registered )
+  {
+    sm->registered = true;
+    sm->next = ctx.first;
+    ctx.first = sm;
+  }
+
+  _account( &sm->stats[sm->state], ST2MS( now - sm->entered ) );
+  sm->stats[new_state].entries++;
+  sm->transitions++;
+  sm->state = new_state;
+  sm->entered = now;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  LOG( PRINT_INFO, "%s: %s", sm->name, sm->state_names[new_state] );
+  return true;
+}
+
+const char* StateMachine_GetStateName( const state_machine_t* sm, uint32_t state )
+{
+  if ( ( state >= sm->states_cnt ) || ( sm->state_names[state] == NULL ) )
+  {
+    return "?";
+  }
+
+  return sm->state_names[state];
+}
+
+void StateMachine_GetStats( state_machine_t* sm, uint32_t state, sm_state_stats_t* stats )
+{
+  *stats = (sm_state_stats_t) { 0 };
+
+  if ( state >= sm->states_cnt )
+  {
+    return;
+  }
+
+  TickType_t now = xTaskGetTickCount();
+
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = sm->stats[state];
+  if ( state == sm->state )
+  {
+    _account( stats, ST2MS( now - sm->entered ) );
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+state_machine_t* StateMachine_GetFirst( void )
+{
+  return ctx.first;
+}
+
+void StateMachine_Print( void )
+{
+  sm_state_stats_t stats;
+
+  printf( "SM: %-12s %-22s %8s %10s %10s\n", "machine", "state", "entries", "total_ms", "longest_ms" );
+  for ( state_machine_t* sm = StateMachine_GetFirst(); sm != NULL; sm = sm->next )
+  {
+    for ( uint32_t i = 0; i < sm->states_cnt; i++ )
+    {
+      StateMachine_GetStats( sm, i, &stats );
+      printf( "SM: %-12s %-21s%c %8lu %10lu %10lu\n", sm->name, StateMachine_GetStateName( sm, i ),
+              i == sm->state ? '*' : ' ', (unsigned long) stats.entries, (unsigned long) stats.total_ms,
+              (unsigned long) stats.longest_ms );
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef STATE_MACHINE_H_
+#define STATE_MACHINE_H_
+
+#include "app_config.h"
+#include "freertos/FreeRTOS.h"
+
+/* Transition bookkeeping shared by the module state machines. Each machine
+ * counts entries into every state, the time spent in it and the longest
+ * single stay. Machines register on their first transition and are listed
+ * by StateMachine_Print() and the remote diagnostics screen. */
+
+typedef struct
+{
+  uint32_t entries;
+  uint32_t total_ms;
+  uint32_t longest_ms;
+} sm_state_stats_t;
+
+typedef struct state_machine
+{
+  const char* name;
+  const char* const* state_names;
+  sm_state_stats_t* stats;
+  uint8_t states_cnt;
+  uint8_t state;
+  bool registered;
+  uint32_t transitions;
+  TickType_t entered;
+  struct state_machine* next;
+} state_machine_t;
+
+/* STATE_MACHINE_DEFINE(sm, "start_menu", [STATE_INIT] = "INIT", ...)
+ * defines a static machine starting in state 0 */
+#define STATE_MACHINE_DEFINE( _var, _name, ... )                                             \
+  static const char* const _var##_names[] = { __VA_ARGS__ };                                 \
+  static sm_state_stats_t _var##_stats[sizeof( _var##_names ) / sizeof( _var##_names[0] )];  \
+  static state_machine_t _var =                                                              \
+    {                                                                                        \
+      .name = _name,                                                                         \
+      .state_names = _var##_names,                                                           \
+      .stats = _var##_stats,                                                                 \
+      .states_cnt = sizeof( _var##_names ) / sizeof( _var##_names[0] ),                      \
+  }
+
+/* For state lists of _S(state, "NAME") entries, see trace_states.h:
+ *   typedef enum { LIST( STATE_MACHINE_ENUM ) STATE_TOP } state_t;
+ *   STATE_MACHINE_DEFINE( sm, "module", LIST( STATE_MACHINE_NAME ) ); */
+#define STATE_MACHINE_ENUM( _state, _name ) _state,
+#define STATE_MACHINE_NAME( _state, _name ) [_state] = _name,
+
+/* false when new_state is out of range or already the current one */
+bool StateMachine_Change( state_machine_t* sm, uint32_t new_state );
+const char* StateMachine_GetStateName( const state_machine_t* sm, uint32_t state );
+/* The ongoing stay is included for the current state */
+void StateMachine_GetStats( state_machine_t* sm, uint32_t state, sm_state_stats_t* stats );
+state_machine_t* StateMachine_GetFirst( void );
+void StateMachine_Print( void );
+
+#endif
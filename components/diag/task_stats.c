@@ -0,0 +1,351 @@
+#include "task_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "energy.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "heap_prof.h"
+#include "param_store.h"
+#include "parameters.h"
+#include "state_machine.h"
+#include "trace.h"
+
+#define MODULE_NAME "[TSTATS] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_TASK_STATS
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define WINDOW_SAMPLES ( TASK_STATS_WINDOW_MS / TASK_STATS_SAMPLE_MS )
+#define STATUS_SLACK   4    // status entries beyond the current task count
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  bool publish;
+  uint32_t count;
+  uint32_t cpu_load;
+  task_stats_entry_t entries[TASK_STATS_MAX];
+} task_stats_t;
+
+static task_stats_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+/* Collector state, only touched by the collector task */
+typedef struct
+{
+  uint32_t number;
+  uint32_t window_runtime;
+  uint16_t samples;
+  uint16_t blocked;
+  bool used;
+  bool seen;
+} task_track_t;
+
+/* uxTaskGetSystemState() fills nothing when there are more tasks than
+ * entries, so the status array follows the task count. Only the first
+ * TASK_STATS_MAX tasks are tracked. */
+static TaskStatus_t* status;
+static uint32_t status_size;
+static task_track_t tracks[TASK_STATS_MAX];
+static task_stats_entry_t window[TASK_STATS_MAX];
+static uint32_t window_total;
+
+static task_track_t* _track( uint32_t number, uint32_t runtime )
+{
+  task_track_t* free_slot = NULL;
+
+  for ( int i = 0; i < TASK_STATS_MAX; i++ )
+  {
+    if ( tracks[i].used && ( tracks[i].number == number ) )
+    {
+      return &tracks[i];
+    }
+
+    if ( !tracks[i].used && ( free_slot == NULL ) )
+    {
+      free_slot = &tracks[i];
+    }
+  }
+
+  if ( free_slot != NULL )
+  {
+    /* New task, its first window starts now */
+    memset( free_slot, 0, sizeof( *free_slot ) );
+    free_slot->used = true;
+    free_slot->number = number;
+    free_slot->window_runtime = runtime;
+  }
+
+  return free_slot;
+}
+
+static void _sort( task_stats_entry_t* entries, uint32_t count )
+{
+  for ( uint32_t i = 1; i < count; i++ )
+  {
+    task_stats_entry_t entry = entries[i];
+    uint32_t j = i;
+
+    while ( ( j > 0 ) && ( entries[j - 1].number > entry.number ) )
+    {
+      entries[j] = entries[j - 1];
+      j--;
+    }
+
+    entries[j] = entry;
+  }
+}
+
+static void _publish_params( void )
+{
+  uint32_t min_stack = UINT32_MAX;
+  task_stats_entry_t selected = { 0 };
+  uint32_t sel = parameters_getValue( PARAM_DIAG_TASK_SEL );
+
+  for ( uint32_t i = 0; i < ctx.count; i++ )
+  {
+    if ( ctx.entries[i].stack_free < min_stack )
+    {
+      min_stack = ctx.entries[i].stack_free;
+    }
+  }
+
+  if ( sel < ctx.count )
+  {
+    selected = ctx.entries[sel];
+  }
+
+  /* First four name characters, enough to tell the tasks apart over the API */
+  uint32_t tag = 0;
+  memcpy( &tag, selected.name, sizeof( tag ) );
+
+  parameters_setValue( PARAM_DIAG_CPU_LOAD, ctx.cpu_load );
+  parameters_setValue( PARAM_DIAG_MIN_STACK, ctx.count > 0 ? min_stack : 0 );
+  parameters_setValue( PARAM_DIAG_TASK_CNT, ctx.count );
+  parameters_setValue( PARAM_DIAG_TASK_TAG, tag );
+  parameters_setValue( PARAM_DIAG_TASK_CPU, selected.cpu_permille );
+  parameters_setValue( PARAM_DIAG_TASK_STACK, selected.stack_free );
+  parameters_setValue( PARAM_DIAG_TASK_BLOCKED, selected.blocked_percent );
+}
+
+static void _close_window( uint32_t count, uint32_t total )
+{
+  uint64_t elapsed = (uint64_t) ( total - window_total ) * portNUM_PROCESSORS;
+  uint32_t idle = 0;
+  uint32_t used = 0;
+  window_total = total;
+
+  for ( uint32_t i = 0; i < count; i++ )
+  {
+    task_track_t* track = _track( status[i].xTaskNumber, status[i].ulRunTimeCounter );
+
+    if ( track == NULL )
+    {
+      continue;
+    }
+
+    task_stats_entry_t* entry = &window[used++];
+
+    uint32_t cpu = elapsed > 0 ? ( (uint64_t) ( status[i].ulRunTimeCounter - track->window_runtime ) * 1000 ) / elapsed : 0;
+
+    snprintf( entry->name, sizeof( entry->name ), "%s", status[i].pcTaskName );
+    entry->number = status[i].xTaskNumber;
+    entry->cpu_permille = cpu > 1000 ? 1000 : cpu;
+    entry->blocked_percent = track->samples > 0 ? track->blocked * 100 / track->samples : 0;
+    entry->priority = status[i].uxCurrentPriority;
+    entry->stack_free = status[i].usStackHighWaterMark;
+
+    if ( strncmp( entry->name, "IDLE", 4 ) == 0 )
+    {
+      idle += entry->cpu_permille;
+    }
+
+    track->window_runtime = status[i].ulRunTimeCounter;
+    track->samples = 0;
+    track->blocked = 0;
+  }
+
+  /* Tasks deleted during the window give their slot back */
+  for ( int i = 0; i < TASK_STATS_MAX; i++ )
+  {
+    if ( !tracks[i].seen )
+    {
+      tracks[i].used = false;
+    }
+
+    tracks[i].seen = false;
+  }
+
+  _sort( window, used );
+
+  portENTER_CRITICAL( &ctx.lock );
+  memcpy( ctx.entries, window, used * sizeof( window[0] ) );
+  ctx.count = used;
+  ctx.cpu_load = idle < 1000 ? 1000 - idle : 0;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( ctx.publish )
+  {
+    _publish_params();
+  }
+}
+
+static bool _status_fit( void )
+{
+  uint32_t tasks = uxTaskGetNumberOfTasks();
+
+  if ( tasks <= status_size )
+  {
+    return true;
+  }
+
+  TaskStatus_t* grown = realloc( status, ( tasks + STATUS_SLACK ) * sizeof( status[0] ) );
+  if ( grown == NULL )
+  {
+    LOG( PRINT_ERROR, "no memory for %lu task states", tasks );
+    return false;
+  }
+
+  status = grown;
+  status_size = tasks + STATUS_SLACK;
+  return true;
+}
+
+static uint32_t _sample( uint32_t* total )
+{
+  uint32_t count = 0;
+
+  /* A second try when tasks were created since the array was sized */
+  for ( int i = 0; ( i < 2 ) && ( count == 0 ) && _status_fit(); i++ )
+  {
+    count = uxTaskGetSystemState( status, status_size, total );
+  }
+
+  if ( count == 0 )
+  {
+    LOG( PRINT_WARNING, "no task states, %lu tasks", (uint32_t) uxTaskGetNumberOfTasks() );
+  }
+
+  for ( uint32_t i = 0; i < count; i++ )
+  {
+    task_track_t* track = _track( status[i].xTaskNumber, status[i].ulRunTimeCounter );
+
+    if ( track == NULL )
+    {
+      continue;
+    }
+
+    track->seen = true;
+    track->samples++;
+    if ( status[i].eCurrentState == eBlocked )
+    {
+      track->blocked++;
+    }
+  }
+
+  return count;
+}
+
+static void _task( void* arg )
+{
+  uint32_t total = 0;
+  uint32_t samples = 0;
+
+  _sample( &window_total );
+
+  while ( 1 )
+  {
+    vTaskDelay( MS2ST( TASK_STATS_SAMPLE_MS ) );
+
+    uint32_t count = _sample( &total );
+
+    if ( ++samples >= WINDOW_SAMPLES )
+    {
+      samples = 0;
+      _close_window( count, total );
+      HeapProf_Sample();
+      /* ms times permille is us busy in the window */
+      Energy_AddActive( ENERGY_LOAD_CPU, TASK_STATS_WINDOW_MS * TaskStats_GetCpuLoad() );
+      Energy_Sample();
+    }
+
+    if ( ctx.publish && ParamStore_Take( PARAM_DIAG_PRINT ) )
+    {
+      TaskStats_Print();
+      StateMachine_Print();
+    }
+
+    /* Printing the ring takes long, here it does not hold up the valve
+     * control of the controller task */
+    if ( ctx.publish && ParamStore_Take( PARAM_TRACE_DUMP ) )
+    {
+      Trace_DumpConsole();
+    }
+  }
+}
+
+void TaskStats_Start( bool publish )
+{
+  ctx.publish = publish;
+  xTaskCreate( _task, "task_stats", 3072, NULL, 1, NULL );
+}
+
+#else
+
+void TaskStats_Start( bool publish )
+{
+  (void) publish;
+  LOG( PRINT_INFO, "FreeRTOS run time stats disabled" );
+}
+
+#endif
+
+uint32_t TaskStats_GetCount( void )
+{
+  return ctx.count;
+}
+
+bool TaskStats_Get( uint32_t index, task_stats_entry_t* entry )
+{
+  bool ret = false;
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( index < ctx.count )
+  {
+    *entry = ctx.entries[index];
+    ret = true;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return ret;
+}
+
+uint32_t TaskStats_GetCpuLoad( void )
+{
+  return ctx.cpu_load;
+}
+
+void TaskStats_Print( void )
+{
+  task_stats_entry_t entry;
+
+  printf( "TASK: %-16s %4s %6s %7s %5s\n", "name", "prio", "cpu%", "stack", "blk%" );
+  for ( uint32_t i = 0; TaskStats_Get( i, &entry ); i++ )
+  {
+    printf( "TASK: %-16s %4u %4u.%u %7lu %5u\n", entry.name, entry.priority, entry.cpu_permille / 10,
+            entry.cpu_permille % 10, (unsigned long) entry.stack_free, entry.blocked_percent );
+  }
+  printf( "TASK: load %lu.%lu%%\n", (unsigned long) ctx.cpu_load / 10, (unsigned long) ctx.cpu_load % 10 );
+}
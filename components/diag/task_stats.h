@@ -0,0 +1,37 @@
+#ifndef TASK_STATS_H_
+#define TASK_STATS_H_
+
+#include "app_config.h"
+
+/* Per task CPU share, stack headroom and blocked share. A low priority task
+ * samples the FreeRTOS task list every TASK_STATS_SAMPLE_MS and publishes a
+ * snapshot once per TASK_STATS_WINDOW_MS. FreeRTOS does not count context
+ * switches per task, the share of samples a task was found blocked stands in
+ * for how often it waits. Needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS,
+ * without it the snapshot stays empty. */
+
+#define TASK_STATS_MAX        24    // tasks tracked, further ones are sampled but not reported
+#define TASK_STATS_SAMPLE_MS  100
+#define TASK_STATS_WINDOW_MS  1000
+#define TASK_STATS_NAME_LEN   16
+
+typedef struct
+{
+  char name[TASK_STATS_NAME_LEN];
+  uint32_t number;            // FreeRTOS task number, snapshot is sorted by it
+  uint16_t cpu_permille;      // of all cores during the last window
+  uint8_t blocked_percent;    // samples found in eBlocked
+  uint8_t priority;
+  uint32_t stack_free;        // high water mark in bytes
+} task_stats_entry_t;
+
+/* publish mirrors the snapshot into the PARAM_DIAG_* parameters served by the
+ * parameters API, the remote reads the controller values into the same ones
+ * and keeps its own snapshot local. */
+void TaskStats_Start( bool publish );
+uint32_t TaskStats_GetCount( void );
+bool TaskStats_Get( uint32_t index, task_stats_entry_t* entry );
+uint32_t TaskStats_GetCpuLoad( void );    // permille, all but the idle tasks
+void TaskStats_Print( void );
+
+#endif
@@ -0,0 +1,266 @@
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#define TRACE_DUMP_BATCH 16
+#define TRACE_LINE_BYTES 32
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  uint32_t frozen;    // dumps reading the ring, they may nest
+  uint32_t dropped;
+  uint32_t write_idx;
+  bool dumping;
+  trace_dump_header_t dump;    // of the ranged dump in progress
+  uint8_t* copy;               // its bytes, NULL when it reads the frozen ring
+  trace_record_t ring[CONFIG_TRACE_RECORDS];
+} trace_t;
+
+static trace_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+void Trace_Write( trace_id_t id, uint32_t arg0, uint32_t arg1, uint32_t arg2 )
+{
+  uint32_t timestamp = (uint32_t) esp_timer_get_time();
+
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.frozen > 0 )
+  {
+    ctx.dropped++;
+    portEXIT_CRITICAL( &ctx.lock );
+    return;
+  }
+
+  uint32_t idx = ctx.write_idx++;
+  trace_record_t* record = &ctx.ring[idx % CONFIG_TRACE_RECORDS];
+  record->timestamp_us = timestamp;
+  record->id = id;
+  record->seq = (uint16_t) idx;
+  record->args[0] = arg0;
+  record->args[1] = arg1;
+  record->args[2] = arg2;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+static uint32_t _oldest( void )
+{
+  return ctx.write_idx > CONFIG_TRACE_RECORDS ? ctx.write_idx - CONFIG_TRACE_RECORDS : 0;
+}
+
+uint32_t Trace_Snapshot( trace_record_t* records, uint32_t size )
+{
+  assert( records );
+
+  uint32_t cnt = 0;
+
+  portENTER_CRITICAL( &ctx.lock );
+  for ( uint32_t idx = _oldest(); ( idx != ctx.write_idx ) && ( cnt < size ); idx++ )
+  {
+    records[cnt++] = ctx.ring[idx % CONFIG_TRACE_RECORDS];
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return cnt;
+}
+
+static void _freeze( trace_dump_header_t* header )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.frozen++ == 0 )
+  {
+    ctx.dropped = 0;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  uint32_t idx = _oldest();
+  *header = ( trace_dump_header_t ) {
+    .magic = TRACE_DUMP_MAGIC,
+    .record_size = sizeof( trace_record_t ),
+    .fmt_cnt = TRACE_ID_TOP,
+    .records_cnt = ctx.write_idx - idx,
+    .lost = idx,
+  };
+}
+
+static void _unfreeze( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  if ( ctx.frozen > 0 )
+  {
+    ctx.frozen--;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+/* The ring is frozen while it is written out, records traced meanwhile are
+ * counted as lost instead of tearing the dump */
+void Trace_Dump( void ( *write )( const void* data, uint32_t len, void* arg ), void* arg )
+{
+  assert( write );
+
+  trace_dump_header_t header;
+  _freeze( &header );
+  uint32_t idx = header.lost;
+
+  write( &header, sizeof( header ), arg );
+
+  while ( idx != ctx.write_idx )
+  {
+    uint32_t cnt = ctx.write_idx - idx < TRACE_DUMP_BATCH ? ctx.write_idx - idx : TRACE_DUMP_BATCH;
+    uint32_t pos = idx % CONFIG_TRACE_RECORDS;
+
+    /* Batches never wrap the ring end */
+    if ( pos + cnt > CONFIG_TRACE_RECORDS )
+    {
+      cnt = CONFIG_TRACE_RECORDS - pos;
+    }
+
+    write( &ctx.ring[pos], cnt * sizeof( trace_record_t ), arg );
+    idx += cnt;
+  }
+
+  _unfreeze();
+}
+
+static uint32_t _dump_size( void )
+{
+  return sizeof( ctx.dump ) + ctx.dump.records_cnt * sizeof( trace_record_t );
+}
+
+/* The dump bytes from the frozen ring */
+static uint32_t _read_ring( uint32_t offset, uint8_t* out, uint32_t len )
+{
+  uint32_t done = 0;
+
+  while ( done < len )
+  {
+    uint32_t pos = offset + done;
+    uint32_t chunk;
+
+    if ( pos < sizeof( ctx.dump ) )
+    {
+      chunk = sizeof( ctx.dump ) - pos;
+      chunk = chunk < len - done ? chunk : len - done;
+      memcpy( out + done, (const uint8_t*) &ctx.dump + pos, chunk );
+    }
+    else
+    {
+      pos -= sizeof( ctx.dump );
+      uint32_t record = ( ctx.dump.lost + pos / sizeof( trace_record_t ) ) % CONFIG_TRACE_RECORDS;
+      uint32_t skip = pos % sizeof( trace_record_t );
+
+      /* Up to the ring end */
+      chunk = ( CONFIG_TRACE_RECORDS - record ) * sizeof( trace_record_t ) - skip;
+      chunk = chunk < len - done ? chunk : len - done;
+      memcpy( out + done, (const uint8_t*) &ctx.ring[record] + skip, chunk );
+    }
+    done += chunk;
+  }
+
+  return done;
+}
+
+uint32_t Trace_DumpBegin( uint32_t* tag )
+{
+  _freeze( &ctx.dump );
+  ctx.dumping = true;
+
+  /* The write index restarts at boot, the newest timestamp tells boots apart */
+  uint32_t newest = ctx.write_idx > 0 ? ctx.ring[( ctx.write_idx - 1 ) % CONFIG_TRACE_RECORDS].timestamp_us : 0;
+  *tag = ctx.write_idx ^ newest;
+
+  /* A copy, at most the ring, lets tracing go on while a slow client reads.
+   * Without the memory for it the ring stays frozen until the end. */
+  uint32_t size = _dump_size();
+  ctx.copy = malloc( size );
+  if ( ctx.copy != NULL )
+  {
+    _read_ring( 0, ctx.copy, size );
+    _unfreeze();
+  }
+
+  return size;
+}
+
+uint32_t Trace_DumpRead( uint32_t offset, void* data, uint32_t len )
+{
+  uint32_t size = _dump_size();
+
+  if ( !ctx.dumping || ( offset >= size ) )
+  {
+    return 0;
+  }
+
+  len = size - offset < len ? size - offset : len;
+  if ( ctx.copy != NULL )
+  {
+    memcpy( data, ctx.copy + offset, len );
+    return len;
+  }
+
+  return _read_ring( offset, data, len );
+}
+
+void Trace_DumpEnd( void )
+{
+  if ( !ctx.dumping )
+  {
+    return;
+  }
+
+  if ( ctx.copy != NULL )
+  {
+    free( ctx.copy );
+    ctx.copy = NULL;
+  }
+  else
+  {
+    _unfreeze();
+  }
+  ctx.dumping = false;
+}
+
+static void _console_write( const void* data, uint32_t len, void* arg )
+{
+  const uint8_t* bytes = data;
+  (void) arg;
+
+  for ( uint32_t off = 0; off < len; off += TRACE_LINE_BYTES )
+  {
+    printf( "TRC: " );
+    for ( uint32_t i = off; ( i < len ) && ( i < off + TRACE_LINE_BYTES ); i++ )
+    {
+      printf( "%02x", bytes[i] );
+    }
+    printf( "\n" );
+  }
+}
+
+/* Hex lines framed by TRC: BEGIN/END, tools/trace_tool.py picks them out of a serial log */
+void Trace_DumpConsole( void )
+{
+  printf( "TRC: BEGIN\n" );
+  Trace_Dump( _console_write, NULL );
+  printf( "TRC: END\n" );
+}
+
+uint32_t Trace_GetDropped( void )
+{
+  return ctx.dropped;
+}
+
+void Trace_Clear( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.write_idx = 0;
+  ctx.dropped = 0;
+  portEXIT_CRITICAL( &ctx.lock );
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "app_config.h"
+#include "trace_fmt.h"
+
+/* Binary trace ring for hot paths. TRACE() stores a timestamp, a format id
+ * from trace_fmt.h and up to three arguments, formatting happens offline.
+ * Each module defines TRACE_LVL next to DEBUG_LVL, calls below it and all
+ * calls with CONFIG_TRACE_ENABLE cleared compile to nothing. */
+
+#define TRACE_ARGS_CNT   3
+#define TRACE_DUMP_MAGIC 0x31435254    // "TRC1"
+
+typedef struct
+{
+  uint32_t timestamp_us;
+  uint16_t id;
+  uint16_t seq;
+  uint32_t args[TRACE_ARGS_CNT];
+} trace_record_t;
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t record_size;
+  uint16_t fmt_cnt;
+  uint32_t records_cnt;
+  uint32_t lost;    // records overwritten before the dump
+} trace_dump_header_t;
+
+#define _TRACE_ARGS( _unused, _a0, _a1, _a2, ... ) ( uint32_t )( _a0 ), ( uint32_t )( _a1 ), ( uint32_t )( _a2 )
+
+#define TRACE( _lvl, _id, ... )                                              \
+  do                                                                         \
+  {                                                                          \
+    if ( CONFIG_TRACE_ENABLE && ( ( _lvl ) >= TRACE_LVL ) )                  \
+    {                                                                        \
+      Trace_Write( _id, _TRACE_ARGS( _, ##__VA_ARGS__, 0, 0, 0 ) );          \
+    }                                                                        \
+  } while ( 0 )
+
+void Trace_Write( trace_id_t id, uint32_t arg0, uint32_t arg1, uint32_t arg2 );
+uint32_t Trace_Snapshot( trace_record_t* records, uint32_t size );
+void Trace_Dump( void ( *write )( const void* data, uint32_t len, void* arg ), void* arg );
+void Trace_DumpConsole( void );
+
+/* The dump of Trace_Dump() read by offset from a copy taken at begin, or
+ * from the ring frozen until the end when the copy cannot be allocated.
+ * Returns the dump size and a tag of its content. Freezes nest, a console
+ * dump meanwhile does not thaw the ring under a ranged one. */
+uint32_t Trace_DumpBegin( uint32_t* tag );
+uint32_t Trace_DumpRead( uint32_t offset, void* data, uint32_t len );
+void Trace_DumpEnd( void );
+uint32_t Trace_GetDropped( void );    // traced while the ring was last frozen
+void Trace_Clear( void );
+
+#endif
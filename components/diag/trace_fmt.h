@@ -0,0 +1,50 @@
+#ifndef TRACE_FMT_H_
+#define TRACE_FMT_H_
+
+#include "trace_states.h"
+
+/* TRACE_FMT(id, module, kind, format)
+ * Formats are never expanded on the device, records only carry the id and up
+ * to TRACE_ARGS_CNT 32 bit arguments. tools/trace_tool.py reads this file at
+ * build time and decodes dumps with the generated table.
+ *
+ * kind: EVENT  single point on the module track
+ *       STATE  arg0 -> arg1 transition, the track shows arg1 until the next one
+ *       BEGIN  opens a span keyed by arg0, closed by the next END of the module
+ *       END    with the same arg0
+ * format specifiers: %u %d %x and %{names} for a TRACE_NAMES table.
+ * Append new ids at the end, decoders match dumps by position. */
+
+#define TRACE_FMT_LIST                                                                            \
+  TRACE_FMT( TRACE_ID_MEAS_ADC_RAW, "measure", EVENT, "ADC%u ch %u raw %u" )                       \
+  TRACE_FMT( TRACE_ID_MEAS_ADC_AVG, "measure", EVENT, "ch %u avg %u filtered %u" )                 \
+  TRACE_FMT( TRACE_ID_CTRL_STATE, "srvr_ctrl", STATE, "%{ctrl_state} -> %{ctrl_state}" )           \
+  TRACE_FMT( TRACE_ID_CTRL_VALVE_ON, "srvr_ctrl", EVENT, "valve gpio %u on" )                      \
+  TRACE_FMT( TRACE_ID_CTRL_VALVE_OFF, "srvr_ctrl", EVENT, "valve gpio %u off" )                    \
+  TRACE_FMT( TRACE_ID_BACKEND_STATE, "menu_backend", STATE, "%{backend_state} -> %{backend_state}" ) \
+  TRACE_FMT( TRACE_ID_START_STATE, "start_menu", STATE, "%{start_state} -> %{start_state}" )       \
+  TRACE_FMT( TRACE_ID_HTTP_SET_BEGIN, "http_client", BEGIN, "set param %u = %u" )                  \
+  TRACE_FMT( TRACE_ID_HTTP_SET_END, "http_client", END, "set param %u: %{http_error}" )            \
+  TRACE_FMT( TRACE_ID_HTTP_GET_BEGIN, "http_client", BEGIN, "get param %u" )                       \
+  TRACE_FMT( TRACE_ID_HTTP_GET_END, "http_client", END, "get param %u: %{http_error}" )
+
+/* TRACE_NAMES(name, ...) value names for %{name}, in enum order, or
+ * TRACE_NAMES(name, LIST) for a state list of trace_states.h.
+ * Only read by the decoder, keep the literal ones in sync with the enums
+ * they describe. */
+
+#define TRACE_NAMES_LIST                                  \
+  TRACE_NAMES( ctrl_state, SRVR_CTRL_STATE_LIST )         \
+  TRACE_NAMES( backend_state, MENU_BACKEND_STATE_LIST )   \
+  TRACE_NAMES( start_state, START_MENU_STATE_LIST )       \
+  TRACE_NAMES( http_error, "OK", "FAIL", "TIMEOUT" )
+
+typedef enum
+{
+#define TRACE_FMT( _id, _module, _kind, _format ) _id,
+  TRACE_FMT_LIST
+#undef TRACE_FMT
+  TRACE_ID_TOP,
+} trace_id_t;
+
+#endif
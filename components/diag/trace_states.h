@@ -0,0 +1,39 @@
+#ifndef TRACE_STATES_H_
+#define TRACE_STATES_H_
+
+/* LIST(_S) with one _S(state, "NAME") per state, in enum order. The module
+ * builds its state enum and the STATE_MACHINE_DEFINE() names from the list,
+ * TRACE_NAMES_LIST in trace_fmt.h names the same list for the decoder, so
+ * the trace names never drift from the enum. */
+
+#define SRVR_CTRL_STATE_LIST( _S )                   \
+  _S( STATE_INIT, "INIT" )                           \
+  _S( STATE_IDLE, "IDLE" )                           \
+  _S( STATE_WORKING, "WORKING" )                     \
+  _S( STATE_EMERGENCY_DISABLE, "EMERGENCY_DISABLE" ) \
+  _S( STATE_ERROR, "ERROR" )
+
+#define MENU_BACKEND_STATE_LIST( _S )                          \
+  _S( STATE_INIT, "INIT" )                                     \
+  _S( STATE_IDLE, "IDLE" )                                     \
+  _S( STATE_START, "START" )                                   \
+  _S( STATE_MENU_PARAMETERS, "MENU_PARAMETERS" )               \
+  _S( STATE_ERROR_CHECK, "ERROR_CHECK" )                       \
+  _S( STATE_EMERGENCY_DISABLE, "EMERGENCY_DISABLE" )           \
+  _S( STATE_EMERGENCY_DISABLE_EXIT, "EMERGENCY_DISABLE_EXIT" )
+
+#define START_MENU_STATE_LIST( _S )      \
+  _S( STATE_INIT, "INIT" )               \
+  _S( STATE_CHECK_WIFI, "CHECK_WIFI" )   \
+  _S( STATE_IDLE, "IDLE" )               \
+  _S( STATE_START, "START" )             \
+  _S( STATE_READY, "READY" )             \
+  _S( STATE_POWER_SAVE, "POWER_SAVE" )   \
+  _S( STATE_ERROR, "ERROR" )             \
+  _S( STATE_INFO, "INFO" )               \
+  _S( STATE_STOP, "STOP" )               \
+  _S( STATE_ERROR_CHECK, "ERROR_CHECK" ) \
+  _S( STATE_RECONNECT, "RECONNECT" )     \
+  _S( STATE_WAIT_CONNECT, "WAIT_CONNECT" )
+
+#endif
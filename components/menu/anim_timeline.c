@@ -0,0 +1,55 @@
+#include "anim_timeline.h"
+
+#include "frame_sched.h"
+#include "freertos/task.h"
+
+typedef struct
+{
+  bool running;
+  uint32_t frame;
+  TickType_t next_step;
+} anim_t;
+
+static const uint32_t anim_period_ms[ANIM_TOP] =
+  {
+    [ANIM_BATTERY] = 500,
+    [ANIM_LOW_ACCU] = 500,
+    [ANIM_VALVE] = 200,
+    [ANIM_WAIT_DOTS] = 100,
+};
+
+static anim_t ctx[ANIM_TOP];
+
+uint32_t AnimTimeline_Frame( anim_id_t id )
+{
+  assert( id < ANIM_TOP );
+
+  anim_t* anim = &ctx[id];
+  TickType_t period = MS2ST( anim_period_ms[id] );
+  TickType_t now = xTaskGetTickCount();
+
+  if ( !anim->running )
+  {
+    anim->running = true;
+    anim->next_step = now + period;
+  }
+  else if ( TICK_IS_ELAPSED( now, anim->next_step ) )
+  {
+    /* Catch up on steps missed while the figure was not drawn */
+    TickType_t steps = ( now - anim->next_step ) / period + 1;
+    anim->frame += steps;
+    anim->next_step += steps * period;
+  }
+
+  FrameSched_RequestRedrawAt( anim->next_step );
+
+  return anim->frame;
+}
+
+void AnimTimeline_Restart( anim_id_t id )
+{
+  assert( id < ANIM_TOP );
+
+  ctx[id].running = false;
+  ctx[id].frame = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef ANIM_TIMELINE_H_
+#define ANIM_TIMELINE_H_
+
+#include "app_config.h"
+
+/* One clock for every animated figure. A figure asks for its frame index while
+ * drawing, the timeline steps it on wrap-safe tick deadlines and asks the frame
+ * scheduler for a redraw exactly at the next step. */
+
+typedef enum
+{
+  ANIM_BATTERY,     // charging fill and low voltage blink in the status bar
+  ANIM_LOW_ACCU,    // empty accumulator blink on the low battery screen
+  ANIM_VALVE,       // valve while water is added
+  ANIM_WAIT_DOTS,   // dots after "waiting for connection"
+  ANIM_TOP,
+} anim_id_t;
+
+uint32_t AnimTimeline_Frame( anim_id_t id );
+void AnimTimeline_Restart( anim_id_t id );
+
+#endif
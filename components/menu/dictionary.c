@@ -2,6 +2,7 @@
 
 #include "app_config.h"
 #include "parameters.h"
+#include "text_cache.h"
 
 static dict_language_t dict_language = DICT_LANGUAGE_ENGLISH;
 
@@ -468,6 +469,12 @@ static const char* dictionary_phrases[DICT_TOP][LANGUAGE_CNT_SUPPORT] = {
                              "SN",
                              "SN",
                              "SN" },
+  [DICT_DIAGNOSTICS] =
+    {
+                             "Diagnostics",
+                             "Диагностика",
+                             "Diagnostyka",
+                             "Diagnose" },
 };
 
 void dictionary_init( void )
@@ -480,7 +487,11 @@ bool dictionary_set_language( dict_language_t lang )
   if ( lang < LANGUAGE_CNT_SUPPORT )
   {
     parameters_setValue( PARAM_LANGUAGE, lang );
-    dict_language = lang;
+    if ( dict_language != lang )
+    {
+      dict_language = lang;
+      TextCache_Invalidate();
+    }
     return true;
   }
 
@@ -98,6 +98,7 @@ enum dictionary_phrase
   DICT_PWM_VALVE,
   DICT_TANK_SIZE,
   DICT_SERIAL_NUMBER,
+  DICT_DIAGNOSTICS,
   DICT_TOP
 };
 
@@ -0,0 +1,258 @@
+#include "frame_sched.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define MODULE_NAME "[FRAME] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_MENU_BACKEND
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define FRAME_SCHED_MENU_CNT 8
+
+typedef struct
+{
+  menu_token_t* menu;
+  bool ( *process )( void* arg );
+  bool ( *enter )( void* arg );
+  bool ( *exit )( void* arg );
+} attached_menu_t;
+
+typedef struct
+{
+  attached_menu_t menus[FRAME_SCHED_MENU_CNT];
+  uint8_t menus_cnt;
+
+  SemaphoreHandle_t wake;
+  portMUX_TYPE lock;
+  TickType_t period;
+  TickType_t last_frame;
+  bool redraw_req;
+  bool animation_pending;
+  TickType_t animation_deadline;
+
+  TickType_t fps_window_start;
+  uint32_t fps_window_frames;
+  frame_sched_stats_t stats;
+} frame_sched_t;
+
+static frame_sched_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .period = MS2ST( 1000 / MENU_TARGET_FPS ),
+    .redraw_req = true,
+    .stats = {.target_fps = MENU_TARGET_FPS},
+};
+
+static attached_menu_t* _find( void* arg )
+{
+  for ( uint8_t i = 0; i < ctx.menus_cnt; i++ )
+  {
+    if ( ctx.menus[i].menu == arg )
+    {
+      return &ctx.menus[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Returns 0 when a frame has to be drawn now, otherwise ticks until one is due */
+static TickType_t _ticks_to_redraw( TickType_t now )
+{
+  TickType_t idle_deadline = ctx.last_frame + MS2ST( MENU_IDLE_REFRESH_MS );
+  TickType_t deadline = idle_deadline;
+
+  portENTER_CRITICAL( &ctx.lock );
+  bool redraw_req = ctx.redraw_req;
+  if ( ctx.animation_pending && !TICK_IS_ELAPSED( ctx.animation_deadline, idle_deadline ) )
+  {
+    deadline = ctx.animation_deadline;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( redraw_req || TICK_IS_ELAPSED( now, deadline ) )
+  {
+    return 0;
+  }
+
+  return deadline - now;
+}
+
+static void _wait_frame( void )
+{
+  /* Pace to the target frame rate */
+  TickType_t elapsed = xTaskGetTickCount() - ctx.last_frame;
+  if ( elapsed < ctx.period )
+  {
+    vTaskDelay( ctx.period - elapsed );
+  }
+
+  /* Idle until state changed or an animation tick is due */
+  TickType_t wait_ticks;
+  while ( ( wait_ticks = _ticks_to_redraw( xTaskGetTickCount() ) ) > 0 )
+  {
+    ctx.stats.skipped_frames++;
+    xSemaphoreTake( ctx.wake, wait_ticks < ctx.period ? wait_ticks : ctx.period );
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.redraw_req = false;
+  if ( ctx.animation_pending && TICK_IS_ELAPSED( xTaskGetTickCount(), ctx.animation_deadline ) )
+  {
+    ctx.animation_pending = false;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+static void _frame_done( TickType_t frame_start )
+{
+  TickType_t now = xTaskGetTickCount();
+
+  ctx.stats.frames++;
+  if ( now - frame_start > ctx.period )
+  {
+    ctx.stats.overruns++;
+  }
+
+  ctx.fps_window_frames++;
+  if ( now - ctx.fps_window_start >= MS2ST( 1000 ) )
+  {
+    ctx.stats.achieved_fps = ctx.fps_window_frames;
+    ctx.fps_window_frames = 0;
+    ctx.fps_window_start = now;
+  }
+}
+
+static bool _menu_process( void* arg )
+{
+  attached_menu_t* attached = _find( arg );
+
+  if ( ( attached == NULL ) || ( attached->process == NULL ) )
+  {
+    NULL_ERROR_MSG();
+    return false;
+  }
+
+  _wait_frame();
+
+  ctx.last_frame = xTaskGetTickCount();
+  bool ret = attached->process( arg );
+  _frame_done( ctx.last_frame );
+
+  return ret;
+}
+
+static bool _menu_enter( void* arg )
+{
+  attached_menu_t* attached = _find( arg );
+
+  FrameSched_RequestRedraw();
+
+  if ( ( attached == NULL ) || ( attached->enter == NULL ) )
+  {
+    return true;
+  }
+
+  return attached->enter( arg );
+}
+
+static bool _menu_exit( void* arg )
+{
+  attached_menu_t* attached = _find( arg );
+
+  FrameSched_RequestRedraw();
+
+  if ( ( attached == NULL ) || ( attached->exit == NULL ) )
+  {
+    return true;
+  }
+
+  return attached->exit( arg );
+}
+
+void FrameSched_Attach( menu_token_t* menu )
+{
+  if ( ctx.wake == NULL )
+  {
+    ctx.wake = xSemaphoreCreateBinary();
+    assert( ctx.wake );
+  }
+
+  attached_menu_t* attached = _find( menu );
+
+  if ( attached == NULL )
+  {
+    if ( ctx.menus_cnt == FRAME_SCHED_MENU_CNT )
+    {
+      LOG( PRINT_ERROR, "Too many menus attached" );
+      return;
+    }
+
+    attached = &ctx.menus[ctx.menus_cnt++];
+    attached->menu = menu;
+  }
+  else if ( menu->menu_cb.process == _menu_process )
+  {
+    return;
+  }
+
+  attached->process = menu->menu_cb.process;
+  attached->enter = menu->menu_cb.enter;
+  attached->exit = menu->menu_cb.exit;
+
+  menu->menu_cb.process = _menu_process;
+  menu->menu_cb.enter = _menu_enter;
+  menu->menu_cb.exit = _menu_exit;
+}
+
+void FrameSched_SetTargetFps( uint32_t fps )
+{
+  if ( ( fps == 0 ) || ( fps > configTICK_RATE_HZ ) )
+  {
+    return;
+  }
+
+  ctx.stats.target_fps = fps;
+  ctx.period = MS2ST( 1000 / fps );
+}
+
+void FrameSched_RequestRedraw( void )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.redraw_req = true;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( ctx.wake != NULL )
+  {
+    xSemaphoreGive( ctx.wake );
+  }
+}
+
+void FrameSched_RequestRedrawIn( uint32_t ms )
+{
+  FrameSched_RequestRedrawAt( xTaskGetTickCount() + MS2ST( ms ) );
+}
+
+void FrameSched_RequestRedrawAt( TickType_t deadline )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  if ( !ctx.animation_pending || !TICK_IS_ELAPSED( deadline, ctx.animation_deadline ) )
+  {
+    ctx.animation_deadline = deadline;
+    ctx.animation_pending = true;
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void FrameSched_GetStats( frame_sched_stats_t* stats )
+{
+  assert( stats );
+  *stats = ctx.stats;
+}
@@ -0,0 +1,23 @@
+#ifndef FRAME_SCHED_H_
+#define FRAME_SCHED_H_
+
+#include "app_config.h"
+#include "menu_drv.h"
+
+typedef struct
+{
+  uint32_t target_fps;
+  uint32_t achieved_fps;    // frames drawn during the last full second
+  uint32_t frames;          // process calls since boot
+  uint32_t skipped_frames;  // frame slots idled because nothing needed redraw
+  uint32_t overruns;        // frames which took longer than one frame period
+} frame_sched_stats_t;
+
+void FrameSched_Attach( menu_token_t* menu );
+void FrameSched_SetTargetFps( uint32_t fps );
+void FrameSched_RequestRedraw( void );
+void FrameSched_RequestRedrawIn( uint32_t ms );
+void FrameSched_RequestRedrawAt( TickType_t deadline );
+void FrameSched_GetStats( frame_sched_stats_t* stats );
+
+#endif
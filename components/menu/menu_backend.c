@@ -1,21 +1,36 @@
 #include <stdbool.h>
 
 #include "app_config.h"
+#include "battery.h"
 #include "but.h"
 #include "cmd_client.h"
 #include "dictionary.h"
+#include "energy.h"
+#include "esp_timer.h"
 #include "freertos/semphr.h"
+#include "heap_prof.h"
 #include "http_parameters_client.h"
+#include "latency_trace.h"
+#include "link_stats.h"
 #include "menu_drv.h"
+#include "param_snapshot.h"
+#include "param_store.h"
 #include "parameters.h"
 #include "ssdFigure.h"
+#include "stall_detect.h"
 #include "start_menu.h"
+#include "state_machine.h"
 #include "stdarg.h"
 #include "stdint.h"
+#include "trace.h"
+#include "trace_states.h"
 #include "wifidrv.h"
 
 #define MODULE_NAME "[M BACK] "
 #define DEBUG_LVL   PRINT_INFO
+#define TRACE_LVL   PRINT_INFO
+
+#define PROFILE_SETTINGS_CNT 3
 
 #if CONFIG_DEBUG_MENU_BACKEND
 #define LOG( _lvl, ... ) \
@@ -26,13 +41,7 @@
 
 typedef enum
 {
-  STATE_INIT,
-  STATE_IDLE,
-  STATE_START,
-  STATE_MENU_PARAMETERS,
-  STATE_ERROR_CHECK,
-  STATE_EMERGENCY_DISABLE,
-  STATE_EMERGENCY_DISABLE_EXIT,
+  MENU_BACKEND_STATE_LIST( STATE_MACHINE_ENUM )
   STATE_TOP,
 } state_backend_t;
 
@@ -48,34 +57,122 @@ typedef struct
 
   bool start_menu_is_active;
   bool menu_param_is_active;
+  bool menu_diag_is_active;
   bool emergency_msg_sended;
   bool emergency_exit_msg_sended;
   bool emergency_req;
 
   bool send_all_data;
-  struct menu_data sended_data;
+  param_snapshot_t sended_data;
+
+  bool settings_known[PROFILE_SETTINGS_CNT];
+  uint32_t settings_synced[PROFILE_SETTINGS_CNT];    // as last read from or sent to the controller
 } start_menu_context_t;
 
 static start_menu_context_t ctx;
 
-static char* state_name[] =
-  {
-    [STATE_INIT] = "STATE_INIT",
-    [STATE_IDLE] = "STATE_IDLE",
-    [STATE_START] = "STATE_START",
-    [STATE_MENU_PARAMETERS] = "STATE_MENU_PARAMETERS",
-    [STATE_ERROR_CHECK] = "STATE_ERROR_CHECK",
-    [STATE_EMERGENCY_DISABLE] = "STATE_EMERGENCY_DISABLE",
-    [STATE_EMERGENCY_DISABLE_EXIT] = "STATE_EMERGENCY_DISABLE_EXIT" };
+/* Published by the start menu, valves first */
+PARAM_GROUP_DEFINE( start_data_group, "start_data",
+                    PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE, PARAM_VALVE_4_STATE,
+                    PARAM_VALVE_5_STATE, PARAM_VALVE_6_STATE, PARAM_VALVE_7_STATE, PARAM_WATER_VOL_ADD );
+
+STATE_MACHINE_DEFINE( state_machine, "menu_backend", MENU_BACKEND_STATE_LIST( STATE_MACHINE_NAME ) );
+
+/* Settings which are part of the controller profiles. The controller owns
+ * them: the remote sends one only after it was edited here and reads them
+ * back otherwise, so a profile loaded on the controller stays in place. */
+static const parameter_value_t profile_settings[PROFILE_SETTINGS_CNT] = { PARAM_PULSES_PER_LITER, PARAM_PWM_VALVE, PARAM_TANK_SIZE };
+
+/* Each parameters request may take its full timeout, it checks in as well */
+STALL_WATCH_DEFINE( stall_watch, "menu_back", 6000, &state_machine );
 
 static void change_state( state_backend_t new_state )
 {
-  if ( ctx.state < STATE_TOP )
+  state_backend_t prev = ctx.state;
+
+  if ( StateMachine_Change( &state_machine, new_state ) )
   {
-    if ( ctx.state != new_state )
+    TRACE( PRINT_INFO, TRACE_ID_BACKEND_STATE, prev, new_state );
+    ctx.state = new_state;
+  }
+}
+
+static void _link_record( int rssi, int64_t start_us, error_code_t ret )
+{
+  uint32_t latency_us = (uint32_t) ( esp_timer_get_time() - start_us );
+
+  /* The radio is busy for the whole request, retries included */
+  Energy_AddActive( ENERGY_LOAD_WIFI_TX, latency_us );
+
+  switch ( ret )
+  {
+    case ERROR_CODE_OK:
+      LinkStats_Record( rssi, latency_us, LINK_RESULT_OK );
+      break;
+
+    case ERROR_CODE_TIMEOUT:
+      LinkStats_Record( rssi, latency_us, LINK_RESULT_TIMEOUT );
+      break;
+
+    default:
+      LinkStats_Record( rssi, latency_us, LINK_RESULT_FAIL );
+      break;
+  }
+}
+
+static error_code_t _set_u32( parameter_value_t param, uint32_t value, uint32_t timeout )
+{
+  TRACE( PRINT_INFO, TRACE_ID_HTTP_SET_BEGIN, param, value );
+  StallDetect_Checkin( &stall_watch );
+  int rssi = wifiDrvGetRssi();
+  int64_t start_us = esp_timer_get_time();
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_HTTP_CLIENT );
+  error_code_t ret = HTTPParamClient_SetU32Value( param, value, timeout );
+  HeapProf_ScopeExit( heap_scope );
+  _link_record( rssi, start_us, ret );
+  TRACE( PRINT_INFO, TRACE_ID_HTTP_SET_END, param, ret );
+  return ret;
+}
+
+static error_code_t _get_u32( parameter_value_t param, uint32_t* value, uint32_t timeout )
+{
+  TRACE( PRINT_INFO, TRACE_ID_HTTP_GET_BEGIN, param );
+  StallDetect_Checkin( &stall_watch );
+  int rssi = wifiDrvGetRssi();
+  int64_t start_us = esp_timer_get_time();
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_HTTP_CLIENT );
+  error_code_t ret = HTTPParamClient_GetU32Value( param, value, timeout );
+  HeapProf_ScopeExit( heap_scope );
+  _link_record( rssi, start_us, ret );
+  TRACE( PRINT_INFO, TRACE_ID_HTTP_GET_END, param, ret );
+  return ret;
+}
+
+static bool _settings_edited( uint8_t i )
+{
+  return ctx.settings_known[i] && ( parameters_getValue( profile_settings[i] ) != ctx.settings_synced[i] );
+}
+
+static void _settings_read( void )
+{
+  for ( uint8_t i = 0; i < PROFILE_SETTINGS_CNT; i++ )
+  {
+    if ( !_settings_edited( i ) && ( _get_u32( profile_settings[i], NULL, 2000 ) == ERROR_CODE_OK ) )
+    {
+      ctx.settings_synced[i] = parameters_getValue( profile_settings[i] );
+      ctx.settings_known[i] = true;
+    }
+  }
+}
+
+static void _settings_send( void )
+{
+  for ( uint8_t i = 0; i < PROFILE_SETTINGS_CNT; i++ )
+  {
+    uint32_t value = parameters_getValue( profile_settings[i] );
+    if ( _settings_edited( i ) && ( _set_u32( profile_settings[i], value, 1000 ) == ERROR_CODE_OK ) )
     {
-      LOG( PRINT_INFO, "Backend menu %s", state_name[new_state] );
-      ctx.state = new_state;
+      ctx.settings_synced[i] = value;
     }
   }
 }
@@ -84,7 +181,7 @@ static void _enter_emergency( void )
 {
   if ( ctx.state != STATE_EMERGENCY_DISABLE )
   {
-    LOG( PRINT_INFO, "%s %s", __func__, state_name[ctx.state] );
+    LOG( PRINT_INFO, "%s %s", __func__, StateMachine_GetStateName( &state_machine, ctx.state ) );
     change_state( STATE_EMERGENCY_DISABLE );
     ctx.emergency_msg_sended = false;
     ctx.emergency_exit_msg_sended = false;
@@ -100,14 +197,14 @@ static void _send_emergency_msg( void )
   }
 
   bool ret =
-    ( HTTPParamClient_SetU32Value( PARAM_EMERGENCY_DISABLE, 1, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_1_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_2_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_3_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_4_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_5_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_6_STATE, 0, 2000 ) == ERROR_CODE_OK )
-    && ( HTTPParamClient_SetU32Value( PARAM_VALVE_7_STATE, 0, 2000 ) == ERROR_CODE_OK );
+    ( _set_u32( PARAM_EMERGENCY_DISABLE, 1, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_1_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_2_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_3_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_4_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_5_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_6_STATE, 0, 2000 ) == ERROR_CODE_OK )
+    && ( _set_u32( PARAM_VALVE_7_STATE, 0, 2000 ) == ERROR_CODE_OK );
 
   LOG( PRINT_INFO, "%s %d", __func__, ret );
   if ( ret )
@@ -132,7 +229,7 @@ static void backend_init_state( void )
 
 static void backend_idle( void )
 {
-  if ( ctx.menu_param_is_active )
+  if ( ctx.menu_param_is_active || ctx.menu_diag_is_active )
   {
     change_state( STATE_MENU_PARAMETERS );
     return;
@@ -150,8 +247,8 @@ static void backend_idle( void )
 
 static bool _check_error( void )
 {
-  HTTPParamClient_GetU32Value( PARAM_MACHINE_ERRORS, NULL, 2000 );
-  HTTPParamClient_GetU32Value( PARAM_WATER_FLOW_STATE, NULL, 2000 );
+  _get_u32( PARAM_MACHINE_ERRORS, NULL, 2000 );
+  _get_u32( PARAM_WATER_FLOW_STATE, NULL, 2000 );
   // uint32_t errors = parameters_getValue( PARAM_MACHINE_ERRORS );
 
   // if ( errors > 0 )
@@ -184,16 +281,17 @@ static void backend_start( void )
       menuStartResetError();
       LOG( PRINT_DEBUG, "No error" );
     }
-    HTTPParamClient_GetU32Value( PARAM_VOLTAGE_ACCUM, NULL, 2000 );
-    HTTPParamClient_GetU32Value( PARAM_LOW_LEVEL_SILOS, NULL, 2000 );
-    HTTPParamClient_GetU32Value( PARAM_SILOS_LEVEL, NULL, 2000 );
-    HTTPParamClient_GetU32Value( PARAM_SILOS_SENSOR_IS_CONNECTED, NULL, 2000 );
+    _get_u32( PARAM_VOLTAGE_ACCUM, NULL, 2000 );
+    _get_u32( PARAM_LOW_LEVEL_SILOS, NULL, 2000 );
+    _get_u32( PARAM_SILOS_LEVEL, NULL, 2000 );
+    _get_u32( PARAM_SILOS_SENSOR_IS_CONNECTED, NULL, 2000 );
     HTTPParamClient_GetStrValue( PARAM_STR_CONTROLLER_SN, NULL, 0, 2000 );
+    _settings_read();
   }
 
   ctx.get_data_cnt++;
 
-  if ( ctx.menu_param_is_active )
+  if ( ctx.menu_param_is_active || ctx.menu_diag_is_active )
   {
     change_state( STATE_MENU_PARAMETERS );
     return;
@@ -205,9 +303,14 @@ static void backend_start( void )
     return;
   }
 
-  struct menu_data* data = menuStartGetData();
+  param_snapshot_t data;
 
-  if ( memcmp( &ctx.sended_data, data, sizeof( ctx.sended_data ) ) != 0 )
+  if ( !ParamSnapshot_Read( &start_data_group, &data ) )
+  {
+    data = ctx.sended_data;
+  }
+
+  if ( !ParamSnapshot_Equal( &ctx.sended_data, &data ) )
   {
     ctx.send_all_data = true;
   }
@@ -215,32 +318,36 @@ static void backend_start( void )
   if ( ctx.send_all_data )
   {
     uint8_t pass_counter = 0;
+    uint32_t corr_id = LatencyTrace_TakePending();
+
+    if ( corr_id != 0 )
+    {
+      /* Sent ahead of the valves, so the controller knows the id before the edge */
+      LatencyTrace_End( corr_id, LAT_HOP_BACKEND_SEND );
+      LatencyTrace_Publish( LAT_HOP_BACKEND_SEND );
+      _set_u32( PARAM_LAT_CORR_ID, corr_id, 1000 );
+    }
 
     for ( int i = 0; i < CFG_VALVE_CNT; i++ )
     {
-      if ( HTTPParamClient_SetU32Value( PARAM_VALVE_1_STATE + i, data->valve[i].state, 1000 ) == ERROR_CODE_OK )
+      if ( _set_u32( PARAM_VALVE_1_STATE + i, data.values[i], 1000 ) == ERROR_CODE_OK )
       {
         pass_counter++;
       }
     }
 
-    if ( pass_counter == CFG_VALVE_CNT && ( HTTPParamClient_SetU32Value( PARAM_WATER_VOL_ADD, data->water_volume_l, 1000 ) == ERROR_CODE_OK ) )
+    if ( pass_counter == CFG_VALVE_CNT && ( _set_u32( PARAM_WATER_VOL_ADD, data.values[CFG_VALVE_CNT], 1000 ) == ERROR_CODE_OK ) )
     {
       ctx.send_all_data = false;
-      for ( int i = 0; i < CFG_VALVE_CNT; i++ )
-      {
-        ctx.sended_data.valve[i].state = data->valve[i].state;
-      }
-      ctx.sended_data.water_volume_l = data->water_volume_l;
+      ctx.sended_data = data;
     }
-
-    HTTPParamClient_SetU32Value( PARAM_PULSES_PER_LITER, parameters_getValue( PARAM_PULSES_PER_LITER ), 1000 );
-    HTTPParamClient_SetU32Value( PARAM_PWM_VALVE, parameters_getValue( PARAM_PWM_VALVE ), 1000 );
   }
 
+  _settings_send();
+
   if ( ctx.enable_water_req )
   {
-    if ( HTTPParamClient_SetU32Value( PARAM_ADD_WATER, ctx.on_off_water, 1000 ) == ERROR_CODE_OK )
+    if ( _set_u32( PARAM_ADD_WATER, ctx.on_off_water, 1000 ) == ERROR_CODE_OK )
     {
       ctx.enable_water_req = false;
     }
@@ -248,12 +355,12 @@ static void backend_start( void )
 
   if ( ctx.on_off_water && !ctx.enable_water_req )
   {
-    if ( HTTPParamClient_GetU32Value( PARAM_ADD_WATER, NULL, 2000 ) == ERROR_CODE_OK )
+    if ( _get_u32( PARAM_ADD_WATER, NULL, 2000 ) == ERROR_CODE_OK )
     {
       ctx.on_off_water = parameters_getValue( PARAM_ADD_WATER );
     }
 
-    HTTPParamClient_GetU32Value( PARAM_WATER_VOL_READ, NULL, 1000 );
+    _get_u32( PARAM_WATER_VOL_READ, NULL, 1000 );
   }
 
   osDelay( 10 );
@@ -261,13 +368,18 @@ static void backend_start( void )
 
 static void backend_menu_parameters( void )
 {
-  if ( !ctx.menu_param_is_active )
+  if ( !ctx.menu_param_is_active && !ctx.menu_diag_is_active )
   {
     change_state( STATE_IDLE );
     return;
   }
 
-  HTTPParamClient_GetU32Value( PARAM_VOLTAGE_ACCUM, NULL, 2000 );
+  _get_u32( PARAM_VOLTAGE_ACCUM, NULL, 2000 );
+  if ( ctx.menu_diag_is_active )
+  {
+    _get_u32( PARAM_DIAG_CPU_LOAD, NULL, 2000 );
+    _get_u32( PARAM_DIAG_MIN_STACK, NULL, 2000 );
+  }
   osDelay( 50 );
 }
 
@@ -314,7 +426,7 @@ static void backend_emergency_disable_exit( void )
 {
   if ( !ctx.emergency_exit_msg_sended )
   {
-    error_code_t ret = HTTPParamClient_SetU32Value( PARAM_EMERGENCY_DISABLE, 0, 2000 );
+    error_code_t ret = _set_u32( PARAM_EMERGENCY_DISABLE, 0, 2000 );
     LOG( PRINT_INFO, "%s %d", __func__, ret );
     if ( ret == ERROR_CODE_OK )
     {
@@ -339,6 +451,16 @@ void backendExitparameterseters( void )
   ctx.menu_param_is_active = false;
 }
 
+void backendEnterDiagnostics( void )
+{
+  ctx.menu_diag_is_active = true;
+}
+
+void backendExitDiagnostics( void )
+{
+  ctx.menu_diag_is_active = false;
+}
+
 void backendEnterMenuStart( void )
 {
   ctx.start_menu_is_active = true;
@@ -375,7 +497,15 @@ static void menu_task( void* arg )
 {
   while ( 1 )
   {
+    StallDetect_Checkin( &stall_watch );
     _check_emergency_disable();
+    Energy_SetOn( ENERGY_LOAD_WIFI_RX, wifiDrvIsConnected() );
+    Energy_SetBatteryVoltage( battery_get_voltage() );
+
+    if ( ParamStore_Take( PARAM_LINK_PRINT ) )
+    {
+      LinkStats_Print();
+    }
 
     switch ( ctx.state )
     {
@@ -4,6 +4,8 @@
 void menuBackendInit( void );
 void backendEnterparameterseters( void );
 void backendExitparameterseters( void );
+void backendEnterDiagnostics( void );
+void backendExitDiagnostics( void );
 void backendToggleEmergencyDisable( void );
 void backendEnterMenuStart( void );
 void backendExitMenuStart( void );
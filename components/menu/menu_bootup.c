@@ -1,7 +1,9 @@
+#include "anim_timeline.h"
 #include "app_config.h"
 #include "but.h"
 #include "cmd_client.h"
 #include "dictionary.h"
+#include "frame_sched.h"
 #include "freertos/semphr.h"
 #include "http_parameters_client.h"
 #include "menu_backend.h"
@@ -11,8 +13,11 @@
 #include "parameters.h"
 #include "parse_cmd.h"
 #include "ssdFigure.h"
+#include "stall_detect.h"
+#include "state_machine.h"
 #include "stdarg.h"
 #include "stdint.h"
+#include "text_cache.h"
 #include "wifi_menu.h"
 #include "wifidrv.h"
 
@@ -46,6 +51,7 @@ typedef struct
   const char* error_msg;
   char ap_name[33];
   uint32_t timeout_con;
+  bool wait_for_server;
   bool system_connected;
   bool exit_req;
   char buff[128];
@@ -53,17 +59,18 @@ typedef struct
 
 static context_t ctx;
 
-static char* state_name[] =
-  {
-    [STATE_INIT] = "STATE_INIT",
-    [STATE_WAIT_WIFI_INIT] = "STATE_WAIT_WIFI_INIT",
-    [STATE_CHECK_MEMORY] = "STATE_CHECK_MEMORY",
-    [STATE_CONNECT] = "STATE_CONNECT",
-    [STATE_WAIT_CONNECT] = "STATE_WAIT_CONNECT",
-    [STATE_GET_SERVER_DATA] = "STATE_GET_SERVER_DATA",
-    [STATE_CHECKING_DATA] = "STATE_CHECKING_DATA",
-    [STATE_EXIT] = "STATE_EXIT",
-};
+STATE_MACHINE_DEFINE( state_machine, "bootup",
+                      [STATE_INIT] = "INIT",
+                      [STATE_WAIT_WIFI_INIT] = "WAIT_WIFI_INIT",
+                      [STATE_CHECK_MEMORY] = "CHECK_MEMORY",
+                      [STATE_CONNECT] = "CONNECT",
+                      [STATE_WAIT_CONNECT] = "WAIT_CONNECT",
+                      [STATE_GET_SERVER_DATA] = "GET_SERVER_DATA",
+                      [STATE_CHECKING_DATA] = "CHECKING_DATA",
+                      [STATE_EXIT] = "EXIT" );
+
+/* Armed while waiting for the connection, the wait is polled every frame */
+STALL_WATCH_DEFINE( stall_watch, "bootup", 3000, &state_machine );
 
 extern void mainMenuInit( menu_drv_init_t init_type );
 extern void enterMenuStart( void );
@@ -76,19 +83,12 @@ menu_token_t bootup_menu =
 
 static void change_state( state_bootup_t new_state )
 {
-  if ( ctx.state < STATE_TOP )
+  if ( StateMachine_Change( &state_machine, new_state ) )
   {
-    if ( ctx.state != new_state )
-    {
-      LOG( PRINT_INFO, "Bootup menu %s", state_name[new_state] );
-    }
-
+    StallDetect_Disarm( &stall_watch );
+    FrameSched_RequestRedraw();
     ctx.state = new_state;
   }
-  else
-  {
-    LOG( PRINT_ERROR, "change state %d", new_state );
-  }
 }
 
 static void bootup_init_state( void )
@@ -126,54 +126,50 @@ static void bootup_connect( void )
   wifiDrvGetAPName( ctx.ap_name );
   menuPrintfInfo( "%s %s", dictionary_get_string( DICT_TRY_CONNECT_TO_S ), ctx.ap_name );
   wifiDrvConnect();
+  ctx.timeout_con = MS2ST( 5000 ) + xTaskGetTickCount();
+  ctx.wait_for_server = false;
+  AnimTimeline_Restart( ANIM_WAIT_DOTS );
   change_state( STATE_WAIT_CONNECT );
 }
 
 static void _show_wait_connection( void )
 {
   oled_clearScreen();
-  sprintf( ctx.buff, dictionary_get_string( DICT_WAIT_CONNECTION_S_S_S ), xTaskGetTickCount() % 400 > 100 ? "." : " ",
-           xTaskGetTickCount() % 400 > 200 ? "." : " ", xTaskGetTickCount() % 400 > 300 ? "." : " " );
+  uint32_t dots = AnimTimeline_Frame( ANIM_WAIT_DOTS ) % 4;
+  sprintf( ctx.buff, dictionary_get_string( DICT_WAIT_CONNECTION_S_S_S ), dots > 0 ? "." : " ", dots > 1 ? "." : " ",
+           dots > 2 ? "." : " " );
   oled_printFixed( 2, 2 * MENU_HEIGHT, ctx.buff, OLED_FONT_SIZE_11 );
-  oled_update();
 }
 
 static void bootup_wait_connect( void )
 {
-  /* Wait to connect wifi */
-  ctx.timeout_con = MS2ST( 5000 ) + xTaskGetTickCount();
-  do
+  /* Wait to connect wifi, then to the server. Polled once per frame */
+  StallDetect_Checkin( &stall_watch );
+  if ( TICK_IS_ELAPSED( xTaskGetTickCount(), ctx.timeout_con ) || ctx.exit_req )
   {
-    if ( ctx.timeout_con < xTaskGetTickCount() || ctx.exit_req )
-    {
-      ctx.error_msg = dictionary_get_string( DICT_TIMEOUT_CONNECT );
-      ctx.error_flag = 1;
-      change_state( STATE_EXIT );
-      return;
-    }
-
-    _show_wait_connection();
-    osDelay( 50 );
-  } while ( wifiDrvTryingConnect() );
+    ctx.error_msg = dictionary_get_string( ctx.wait_for_server ? DICT_TIMEOUT_SERVER : DICT_TIMEOUT_CONNECT );
+    ctx.error_flag = 1;
+    change_state( STATE_EXIT );
+    return;
+  }
 
-  ctx.timeout_con = MS2ST( 5000 ) + xTaskGetTickCount();
-  do
+  if ( !ctx.wait_for_server )
   {
-    if ( ctx.timeout_con < xTaskGetTickCount() || ctx.exit_req )
+    if ( !wifiDrvTryingConnect() )
     {
-      ctx.error_msg = dictionary_get_string( DICT_TIMEOUT_SERVER );
-      ctx.error_flag = 1;
-      change_state( STATE_EXIT );
-      return;
+      ctx.timeout_con = MS2ST( 5000 ) + xTaskGetTickCount();
+      ctx.wait_for_server = true;
     }
+  }
+  else if ( backendIsConnected() )
+  {
+    oled_clearScreen();
+    menuPrintfInfo( dictionary_get_string( DICT_CONNECTED_TRY_READ_DATA ) );
+    change_state( STATE_GET_SERVER_DATA );
+    return;
+  }
 
-    _show_wait_connection();
-    osDelay( 50 );
-  } while ( !backendIsConnected() );
-
-  oled_clearScreen();
-  menuPrintfInfo( dictionary_get_string( DICT_CONNECTED_TRY_READ_DATA ) );
-  change_state( STATE_GET_SERVER_DATA );
+  _show_wait_connection();
 }
 
 static void bootup_get_server_data( void )
@@ -226,7 +222,7 @@ static bool menu_process( void* arg )
   }
 
   oled_clearScreen();
-  oled_printFixed( 2, 0, dictionary_get_string( DICT_LOGO_CLIENT_NAME ), OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 0, dictionary_get_string( DICT_LOGO_CLIENT_NAME ), OLED_FONT_SIZE_16 );
   oled_setGLCDFont( OLED_FONT_SIZE_11 );
 
   switch ( ctx.state )
@@ -264,7 +260,7 @@ static bool menu_process( void* arg )
       break;
 
     default:
-      ctx.state = STATE_CONNECT;
+      change_state( STATE_CONNECT );
       break;
   }
 
@@ -310,6 +306,7 @@ static void menu_button_exit_callback( void* arg )
   }
 
   ctx.exit_req = true;
+  FrameSched_RequestRedraw();
 }
 
 static bool menu_button_init_cb( void* arg )
@@ -336,6 +333,7 @@ void menuInitBootUpMenu( void )
   bootup_menu.menu_cb.button_init_cb = menu_button_init_cb;
   bootup_menu.menu_cb.exit = menu_exit_cb;
   bootup_menu.menu_cb.process = menu_process;
+  FrameSched_Attach( &bootup_menu );
 
   menuEnter( &bootup_menu );
 }
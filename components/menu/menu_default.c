@@ -1,9 +1,11 @@
 #include "app_config.h"
 #include "menu_drv.h"
 #include "dictionary.h"
+#include "frame_sched.h"
 #include "menu_default.h"
 #include "oled.h"
 #include "ssdFigure.h"
+#include "text_cache.h"
 
 #define MODULE_NAME "[DEFAULT] "
 #define DEBUG_LVL   PRINT_INFO
@@ -30,6 +32,8 @@ static void menu_button_up_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   menu->last_button = LAST_BUTTON_UP;
   if ( menu->position > 0 )
   {
@@ -47,6 +51,8 @@ static void menu_button_down_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   menu->last_button = LAST_BUTTON_DOWN;
   if ( menu->position < menuDrvElementsCnt( menu ) - 1 )
   {
@@ -142,7 +148,7 @@ static bool menu_process( void* arg )
   }
 
   oled_clearScreen();
-  oled_printFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
   oled_setGLCDFont( OLED_FONT_SIZE_11 );
 
   if ( menu->line.end - menu->line.start != MAX_LINE - 1 )
@@ -172,11 +178,11 @@ static bool menu_process( void* arg )
     if ( line + menu->line.start == menu->position )
     {
       ssdFigureFillLine( MENU_HEIGHT + LINE_HEIGHT * line, LINE_HEIGHT );
-      oled_printFixedBlack( 2, MENU_HEIGHT + LINE_HEIGHT * line, dictionary_get_string( menu->menu_list[line + menu->line.start]->name_dict ), OLED_FONT_SIZE_11 );
+      TextCache_PrintFixedBlack( 2, MENU_HEIGHT + LINE_HEIGHT * line, dictionary_get_string( menu->menu_list[line + menu->line.start]->name_dict ), OLED_FONT_SIZE_11 );
     }
     else
     {
-      oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT * line, dictionary_get_string( menu->menu_list[line + menu->line.start]->name_dict ), OLED_FONT_SIZE_11 );
+      TextCache_PrintFixed( 2, MENU_HEIGHT + LINE_HEIGHT * line, dictionary_get_string( menu->menu_list[line + menu->line.start]->name_dict ), OLED_FONT_SIZE_11 );
     }
 
     line++;
@@ -0,0 +1,301 @@
+#include "menu_diag.h"
+
+#include "app_config.h"
+#include "dictionary.h"
+#include "frame_sched.h"
+#include "menu_backend.h"
+#include "menu_drv.h"
+#include "menu_fmt.h"
+#include "parameters.h"
+#include "ssd1306.h"
+#include "ssdFigure.h"
+#include "state_machine.h"
+#include "task_stats.h"
+#include "text_cache.h"
+
+#define MODULE_NAME "[DIAG] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_MENU_BACKEND
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+/* Summary rows, the local tasks follow them */
+typedef enum
+{
+  ROW_CTRL_CPU,
+  ROW_CTRL_STACK,
+  ROW_REMOTE_CPU,
+  ROW_TOP,
+} diag_row_t;
+
+static scrollBar_t scrollBar = {
+  .line_max = MAX_LINE,
+  .y_start = MENU_HEIGHT };
+
+/* After the tasks every state machine gets a header row with its current
+ * state followed by one row per state */
+static uint32_t _sm_rows_cnt( void )
+{
+  uint32_t rows = 0;
+  for ( state_machine_t* sm = StateMachine_GetFirst(); sm != NULL; sm = sm->next )
+  {
+    rows += 1 + sm->states_cnt;
+  }
+
+  return rows;
+}
+
+static uint32_t _rows_cnt( void )
+{
+  return ROW_TOP + TaskStats_GetCount() + _sm_rows_cnt();
+}
+
+static void _format_sm_row( menu_fmt_t* fmt, uint32_t row )
+{
+  sm_state_stats_t stats;
+
+  for ( state_machine_t* sm = StateMachine_GetFirst(); sm != NULL; sm = sm->next )
+  {
+    if ( row == 0 )
+    {
+      MenuFmt_Str( fmt, sm->name );
+      MenuFmt_Str( fmt, ": " );
+      MenuFmt_Str( fmt, StateMachine_GetStateName( sm, sm->state ) );
+      return;
+    }
+
+    if ( row <= sm->states_cnt )
+    {
+      StateMachine_GetStats( sm, row - 1, &stats );
+      MenuFmt_Char( fmt, ' ' );
+      MenuFmt_Str( fmt, StateMachine_GetStateName( sm, row - 1 ) );
+      MenuFmt_Char( fmt, ' ' );
+      MenuFmt_U32( fmt, stats.entries );
+      MenuFmt_Str( fmt, "x " );
+      MenuFmt_U32( fmt, stats.total_ms / 1000 );
+      MenuFmt_Char( fmt, '/' );
+      MenuFmt_U32( fmt, stats.longest_ms / 1000 );
+      MenuFmt_Char( fmt, 's' );
+      return;
+    }
+
+    row -= 1 + sm->states_cnt;
+  }
+}
+
+static void _format_permille( menu_fmt_t* fmt, uint32_t permille )
+{
+  MenuFmt_Fixed( fmt, permille, 1 );
+  MenuFmt_Str( fmt, "%" );
+}
+
+static void _format_row( menu_fmt_t* fmt, uint32_t row )
+{
+  task_stats_entry_t entry;
+
+  switch ( row )
+  {
+    case ROW_CTRL_CPU:
+      MenuFmt_Str( fmt, "Ctrl CPU: " );
+      _format_permille( fmt, parameters_getValue( PARAM_DIAG_CPU_LOAD ) );
+      break;
+
+    case ROW_CTRL_STACK:
+      MenuFmt_Str( fmt, "Ctrl stack: " );
+      MenuFmt_U32( fmt, parameters_getValue( PARAM_DIAG_MIN_STACK ) );
+      MenuFmt_Str( fmt, " B" );
+      break;
+
+    case ROW_REMOTE_CPU:
+      MenuFmt_Str( fmt, "CPU: " );
+      _format_permille( fmt, TaskStats_GetCpuLoad() );
+      break;
+
+    default:
+      if ( row - ROW_TOP >= TaskStats_GetCount() )
+      {
+        _format_sm_row( fmt, row - ROW_TOP - TaskStats_GetCount() );
+      }
+      else if ( TaskStats_Get( row - ROW_TOP, &entry ) )
+      {
+        MenuFmt_Str( fmt, entry.name );
+        MenuFmt_Char( fmt, ' ' );
+        _format_permille( fmt, entry.cpu_permille );
+        MenuFmt_Char( fmt, ' ' );
+        MenuFmt_U32( fmt, entry.stack_free );
+        MenuFmt_Str( fmt, " b" );
+        MenuFmt_U32( fmt, entry.blocked_percent );
+      }
+      break;
+  }
+}
+
+static void menu_button_up_callback( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return;
+  }
+
+  FrameSched_RequestRedraw();
+
+  menu->last_button = LAST_BUTTON_UP;
+  if ( menu->position > 0 )
+  {
+    menu->position--;
+  }
+}
+
+static void menu_button_down_callback( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return;
+  }
+
+  FrameSched_RequestRedraw();
+
+  menu->last_button = LAST_BUTTON_DOWN;
+  if ( menu->position < _rows_cnt() - 1 )
+  {
+    menu->position++;
+  }
+}
+
+static void menu_button_exit_callback( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return;
+  }
+  menuDrv_Exit( menu );
+}
+
+static bool menu_button_init_cb( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return false;
+  }
+  menu->button.down.fall_callback = menu_button_down_callback;
+  menu->button.up.fall_callback = menu_button_up_callback;
+  menu->button.exit.fall_callback = menu_button_exit_callback;
+  menu->button.enter.fall_callback = menu_button_exit_callback;
+
+  return true;
+}
+
+static bool menu_enter_cb( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return false;
+  }
+  menu->position = 0;
+  backendEnterDiagnostics();
+  return true;
+}
+
+static bool menu_exit_cb( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return false;
+  }
+  backendExitDiagnostics();
+  return true;
+}
+
+static bool menu_process( void* arg )
+{
+  static char buff[64];
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return false;
+  }
+
+  uint32_t rows = _rows_cnt();
+  if ( menu->position >= rows )
+  {
+    menu->position = rows - 1;
+  }
+
+  oled_clearScreen();
+  oled_setGLCDFont( OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
+  oled_setGLCDFont( OLED_FONT_SIZE_11 );
+
+  if ( menu->line.end - menu->line.start != MAX_LINE - 1 )
+  {
+    menu->line.start = menu->position;
+    menu->line.end = menu->line.start + MAX_LINE - 1;
+  }
+
+  if ( menu->position < menu->line.start || menu->position > menu->line.end )
+  {
+    if ( menu->last_button == LAST_BUTTON_UP )
+    {
+      menu->line.start = menu->position;
+      menu->line.end = menu->line.start + MAX_LINE - 1;
+    }
+    else
+    {
+      menu->line.end = menu->position;
+      menu->line.start = menu->line.end - MAX_LINE + 1;
+    }
+  }
+
+  menu_fmt_t fmt;
+  for ( int line = 0; ( line < MAX_LINE ) && ( line + menu->line.start < rows ); line++ )
+  {
+    uint32_t row = line + menu->line.start;
+
+    MenuFmt_Init( &fmt, buff, sizeof( buff ) );
+    _format_row( &fmt, row );
+
+    if ( row == menu->position )
+    {
+      ssdFigureFillLine( MENU_HEIGHT + LINE_HEIGHT * line, LINE_HEIGHT );
+      oled_printFixedBlack( 2, MENU_HEIGHT + LINE_HEIGHT * line, buff, OLED_FONT_SIZE_11 );
+    }
+    else
+    {
+      oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT * line, buff, OLED_FONT_SIZE_11 );
+    }
+  }
+
+  scrollBar.actual_line = menu->position;
+  scrollBar.all_line = rows - 1;
+  ssdFigureDrawScrollBar( &scrollBar );
+
+  /* Numbers change without input, follow the collector window */
+  FrameSched_RequestRedrawIn( TASK_STATS_WINDOW_MS );
+
+  return true;
+}
+
+void menuInitDiagnosticsMenu( menu_token_t* menu )
+{
+  menu->menu_cb.enter = menu_enter_cb;
+  menu->menu_cb.button_init_cb = menu_button_init_cb;
+  menu->menu_cb.exit = menu_exit_cb;
+  menu->menu_cb.process = menu_process;
+}
@@ -0,0 +1,8 @@
+#ifndef _MENU_DIAG_H_
+#define _MENU_DIAG_H_
+#include "menu_drv.h"
+
+/* Hidden screen, hold up on the parameters screen to open it */
+void menuInitDiagnosticsMenu( menu_token_t* menu );
+void menuEnterDiagnostics( void );
+#endif
@@ -0,0 +1,99 @@
+#include "menu_fmt.h"
+
+void MenuFmt_Init( menu_fmt_t* fmt, char* buff, uint32_t size )
+{
+  assert( fmt );
+  assert( buff );
+  assert( size > 0 );
+
+  fmt->buff = buff;
+  fmt->size = size;
+  fmt->len = 0;
+  buff[0] = '\0';
+}
+
+void MenuFmt_Char( menu_fmt_t* fmt, char c )
+{
+  if ( fmt->len + 1 < fmt->size )
+  {
+    fmt->buff[fmt->len++] = c;
+    fmt->buff[fmt->len] = '\0';
+  }
+}
+
+void MenuFmt_Str( menu_fmt_t* fmt, const char* str )
+{
+  if ( str == NULL )
+  {
+    return;
+  }
+
+  while ( ( *str != '\0' ) && ( fmt->len + 1 < fmt->size ) )
+  {
+    fmt->buff[fmt->len++] = *str++;
+  }
+
+  fmt->buff[fmt->len] = '\0';
+}
+
+/* Writes at least min_digits digits, zero padded */
+static void _put_u32( menu_fmt_t* fmt, uint32_t value, uint8_t min_digits )
+{
+  char digits[10];
+  uint8_t cnt = 0;
+
+  do
+  {
+    digits[cnt++] = '0' + value % 10;
+    value /= 10;
+  } while ( value > 0 || cnt < min_digits );
+
+  while ( ( cnt > 0 ) && ( fmt->len + 1 < fmt->size ) )
+  {
+    fmt->buff[fmt->len++] = digits[--cnt];
+  }
+
+  fmt->buff[fmt->len] = '\0';
+}
+
+void MenuFmt_U32( menu_fmt_t* fmt, uint32_t value )
+{
+  _put_u32( fmt, value, 1 );
+}
+
+void MenuFmt_I32( menu_fmt_t* fmt, int32_t value )
+{
+  if ( value < 0 )
+  {
+    MenuFmt_Char( fmt, '-' );
+    _put_u32( fmt, -(uint32_t) value, 1 );
+    return;
+  }
+
+  _put_u32( fmt, value, 1 );
+}
+
+void MenuFmt_Fixed( menu_fmt_t* fmt, int32_t value, uint8_t decimals )
+{
+  static const uint32_t scale[] = { 1, 10, 100, 1000, 10000, 100000 };
+
+  if ( decimals >= sizeof( scale ) / sizeof( scale[0] ) )
+  {
+    decimals = sizeof( scale ) / sizeof( scale[0] ) - 1;
+  }
+
+  uint32_t abs_value = value < 0 ? -(uint32_t) value : (uint32_t) value;
+
+  if ( value < 0 )
+  {
+    MenuFmt_Char( fmt, '-' );
+  }
+
+  _put_u32( fmt, abs_value / scale[decimals], 1 );
+
+  if ( decimals > 0 )
+  {
+    MenuFmt_Char( fmt, '.' );
+    _put_u32( fmt, abs_value % scale[decimals], decimals );
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef MENU_FMT_H_
+#define MENU_FMT_H_
+
+#include "app_config.h"
+
+/* Integer and fixed-point text builder for render loops, replaces sprintf.
+ * Output is always NUL terminated and silently truncated to the buffer. */
+
+typedef struct
+{
+  char* buff;
+  uint32_t size;
+  uint32_t len;
+} menu_fmt_t;
+
+void MenuFmt_Init( menu_fmt_t* fmt, char* buff, uint32_t size );
+void MenuFmt_Str( menu_fmt_t* fmt, const char* str );
+void MenuFmt_Char( menu_fmt_t* fmt, char c );
+void MenuFmt_U32( menu_fmt_t* fmt, uint32_t value );
+void MenuFmt_I32( menu_fmt_t* fmt, int32_t value );
+void MenuFmt_Fixed( menu_fmt_t* fmt, int32_t value, uint8_t decimals );
+
+#endif
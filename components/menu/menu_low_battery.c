@@ -5,6 +5,7 @@
 #include "power_on.h"
 #include "ssd1306.h"
 #include "ssdFigure.h"
+#include "text_cache.h"
 
 #define MODULE_NAME "[M_LOW_BAT] "
 #define DEBUG_LVL   PRINT_INFO
@@ -66,8 +67,8 @@ static bool menu_process( void* arg )
   }
 
   oled_clearScreen();
-  oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_LOW_BATTERY ), OLED_FONT_SIZE_16 );
-  oled_printFixed( 2, 2 * MENU_HEIGHT + 5, dictionary_get_string( DICT_CONNECT_CHARGER ), OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_LOW_BATTERY ), OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 2 * MENU_HEIGHT + 5, dictionary_get_string( DICT_CONNECT_CHARGER ), OLED_FONT_SIZE_11 );
   oled_update();
 
   return true;
@@ -1,6 +1,8 @@
 #include "app_config.h"
 
+#include "frame_sched.h"
 #include "menu_default.h"
+#include "menu_diag.h"
 #include "menu_drv.h"
 #include "menu_low_battery.h"
 #include "menu_settings.h"
@@ -43,6 +45,11 @@ static menu_token_t parameters_menu =
     .name_dict = DICT_PARAMETES,
 };
 
+static menu_token_t diag_menu =
+  {
+    .name_dict = DICT_DIAGNOSTICS,
+};
+
 static menu_token_t low_battery_menu =
   {
     .arg_type = T_ARG_TYPE_MENU,
@@ -66,11 +73,19 @@ void mainMenuInit( menu_drv_init_t init_type )
     menuInitWifiMenu( &wifi_menu );
     menuInitStartMenu( &start_menu );
     menuInitParametersMenu( &parameters_menu );
+    menuInitDiagnosticsMenu( &diag_menu );
+    FrameSched_Attach( &main_menu );
+    FrameSched_Attach( &setings );
+    FrameSched_Attach( &wifi_menu );
+    FrameSched_Attach( &start_menu );
+    FrameSched_Attach( &parameters_menu );
+    FrameSched_Attach( &diag_menu );
     menuSetMain( &main_menu );
   }
   else
   {
     menuInitLowBatteryLvl( &low_battery_menu );
+    FrameSched_Attach( &low_battery_menu );
     menuSetMain( &low_battery_menu );
   }
 }
@@ -84,3 +99,8 @@ void menuDrv_EnterToParameters( void )
 {
   menuEnter( &parameters_menu );
 }
+
+void menuEnterDiagnostics( void )
+{
+  menuEnter( &diag_menu );
+}
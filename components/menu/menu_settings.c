@@ -4,14 +4,18 @@
 #include "cmd_client.h"
 #include "dictionary.h"
 #include "fast_add.h"
+#include "frame_sched.h"
 #include "http_parameters_client.h"
 #include "led.h"
 #include "menu_backend.h"
 #include "menu_default.h"
 #include "menu_drv.h"
+#include "menu_fmt.h"
+#include "param_persist.h"
 #include "parameters.h"
 #include "ssd1306.h"
 #include "ssdFigure.h"
+#include "text_cache.h"
 #include "wifidrv.h"
 
 #define MODULE_NAME "[SETTING] "
@@ -214,6 +218,7 @@ static void get_min_pulses_per_liter( uint32_t* value )
 static void set_pulses_per_liter( uint32_t value )
 {
   parameters_setValue( PARAM_PULSES_PER_LITER, value );
+  ParamPersist_Mark( PARAM_PULSES_PER_LITER );
 }
 
 static void get_pwm_valve( uint32_t* value )
@@ -234,6 +239,7 @@ static void get_min_pwm_valve( uint32_t* value )
 static void set_pwm_valve( uint32_t value )
 {
   parameters_setValue( PARAM_PWM_VALVE, value );
+  ParamPersist_Mark( PARAM_PWM_VALVE );
 }
 
 static void get_tank_size( uint32_t* value )
@@ -254,6 +260,7 @@ static void get_min_tank_size( uint32_t* value )
 static void set_tank_size( uint32_t value )
 {
   parameters_setValue( PARAM_TANK_SIZE, value );
+  ParamPersist_Mark( PARAM_TANK_SIZE );
 }
 
 static void get_power_on_min( uint32_t* value )
@@ -275,6 +282,7 @@ static void get_min_power_on_min( uint32_t* value )
 static void set_power_on_min( uint32_t value )
 {
   parameters_setValue( PARAM_POWER_ON_MIN, value );
+  ParamPersist_Mark( PARAM_POWER_ON_MIN );
 }
 
 static void get_language( uint32_t* value )
@@ -290,6 +298,7 @@ static void get_max_language( uint32_t* value )
 static void set_language( uint32_t value )
 {
   dictionary_set_language( value );
+  ParamPersist_Mark( PARAM_LANGUAGE );
 }
 
 static void get_bootup( uint32_t* value )
@@ -315,11 +324,13 @@ static void get_max_buzzer( uint32_t* value )
 static void set_bootup( uint32_t value )
 {
   parameters_setValue( PARAM_BOOT_UP_SYSTEM, value );
+  ParamPersist_Mark( PARAM_BOOT_UP_SYSTEM );
 }
 
 static void set_buzzer( uint32_t value )
 {
   parameters_setValue( PARAM_BUZZER, value );
+  ParamPersist_Mark( PARAM_BUZZER );
 }
 
 static void get_brightness( uint32_t* value )
@@ -330,6 +341,7 @@ static void get_brightness( uint32_t* value )
 static void set_brightness( uint32_t value )
 {
   parameters_setValue( PARAM_BRIGHTNESS, value );
+  ParamPersist_Mark( PARAM_BRIGHTNESS );
   MOTOR_LED_SET_RED( 1 );
   SERVO_VIBRO_LED_SET_GREEN( 1 );
 }
@@ -418,6 +430,8 @@ static void menu_button_up_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   _set_and_exit( menu );
 
   menu->last_button = LAST_BUTTON_UP;
@@ -439,6 +453,8 @@ static void menu_button_down_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   _set_and_exit( menu );
 
   menu->last_button = LAST_BUTTON_DOWN;
@@ -461,6 +477,8 @@ static void menu_button_plus_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( menu->position >= SETTINGS_TOP )
   {
     return;
@@ -479,6 +497,7 @@ static void menu_button_plus_callback( void* arg )
 static void _fast_add_cb( uint32_t value )
 {
   (void) value;
+  FrameSched_RequestRedraw();
 }
 
 static void menu_button_plus_time_cb( void* arg )
@@ -535,6 +554,8 @@ static void menu_button_minus_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( menu->position >= SETTINGS_TOP )
   {
     return;
@@ -560,6 +581,8 @@ static void menu_button_enter_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( menu->position >= SETTINGS_TOP )
   {
     LOG( PRINT_INFO, "Error settings: menu->position >= SETTINGS_TOP" );
@@ -596,7 +619,8 @@ static void menu_button_exit_callback( void* arg )
     return;
   }
 
-  parameters_save();
+  FrameSched_RequestRedraw();
+
   if ( _state == MENU_EDIT_PARAMETERS )
   {
     _set_and_exit( menu );
@@ -689,7 +713,7 @@ static bool menu_process( void* arg )
     case MENU_LIST_PARAMETERS:
       {
         oled_setGLCDFont( OLED_FONT_SIZE_16 );
-        oled_printFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
+        TextCache_PrintFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
         oled_setGLCDFont( OLED_FONT_SIZE_11 );
 
         if ( menu->line.end - menu->line.start != MAX_LINE - 1 )
@@ -719,15 +743,15 @@ static bool menu_process( void* arg )
         do
         {
           int pos = line + menu->line.start;
-          sprintf( buff, "%s", dictionary_get_string( parameters_list[pos].name_dict ) );
+          const char* name = dictionary_get_string( parameters_list[pos].name_dict );
           if ( line + menu->line.start == menu->position )
           {
             ssdFigureFillLine( MENU_HEIGHT + LINE_HEIGHT * line, LINE_HEIGHT );
-            oled_printFixedBlack( 2, MENU_HEIGHT + LINE_HEIGHT * line, buff, OLED_FONT_SIZE_11 );
+            TextCache_PrintFixedBlack( 2, MENU_HEIGHT + LINE_HEIGHT * line, name, OLED_FONT_SIZE_11 );
           }
           else
           {
-            oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT * line, buff, OLED_FONT_SIZE_11 );
+            TextCache_PrintFixed( 2, MENU_HEIGHT + LINE_HEIGHT * line, name, OLED_FONT_SIZE_11 );
           }
 
           line++;
@@ -740,32 +764,34 @@ static bool menu_process( void* arg )
       break;
 
     case MENU_EDIT_PARAMETERS:
-      oled_printFixed( 2, 0, dictionary_get_string( parameters_list[menu->position].name_dict ), OLED_FONT_SIZE_16 );
+      TextCache_PrintFixed( 2, 0, dictionary_get_string( parameters_list[menu->position].name_dict ), OLED_FONT_SIZE_16 );
       switch ( parameters_list[menu->position].unit_type )
       {
         case UNIT_INT:
-          sprintf( buff, "%ld %s", parameters_list[menu->position].value, parameters_list[menu->position].unit_name != NULL ? parameters_list[menu->position].unit_name : "" );
+        {
+          menu_fmt_t fmt;
+          MenuFmt_Init( &fmt, buff, sizeof( buff ) );
+          MenuFmt_U32( &fmt, parameters_list[menu->position].value );
+          MenuFmt_Char( &fmt, ' ' );
+          MenuFmt_Str( &fmt, parameters_list[menu->position].unit_name != NULL ? parameters_list[menu->position].unit_name : "" );
           oled_printFixed( 30, MENU_HEIGHT + 15, buff, OLED_FONT_SIZE_16 );
+        }
           break;
 
         case UNIT_ON_OFF:
-          sprintf( buff, "%s", parameters_list[menu->position].value ? dictionary_get_string( DICT_ON ) : dictionary_get_string( DICT_OFF ) );
-          oled_printFixed( 20, MENU_HEIGHT + 15, buff, OLED_FONT_SIZE_16 );
+          TextCache_PrintFixed( 20, MENU_HEIGHT + 15, parameters_list[menu->position].value ? dictionary_get_string( DICT_ON ) : dictionary_get_string( DICT_OFF ), OLED_FONT_SIZE_16 );
           break;
 
         case UNIT_BOOL:
-          sprintf( buff, "%s", parameters_list[menu->position].value ? "1" : "0" );
-          oled_printFixed( 30, MENU_HEIGHT + 15, buff, OLED_FONT_SIZE_16 );
+          TextCache_PrintFixed( 30, MENU_HEIGHT + 15, parameters_list[menu->position].value ? "1" : "0", OLED_FONT_SIZE_16 );
           break;
 
         case UNIT_LANGUAGE:
-          sprintf( buff, "%s", language[parameters_list[menu->position].value] );
-          oled_printFixed( 30, MENU_HEIGHT + 15, buff, OLED_FONT_SIZE_16 );
+          TextCache_PrintFixed( 30, MENU_HEIGHT + 15, language[parameters_list[menu->position].value], OLED_FONT_SIZE_16 );
           break;
 
         case UNIT_STR:
-          sprintf( buff, "%s", parameters_list[menu->position].str_value );
-          oled_printFixed( 30, MENU_HEIGHT + 15, buff, OLED_FONT_SIZE_16 );
+          oled_printFixed( 30, MENU_HEIGHT + 15, parameters_list[menu->position].str_value, OLED_FONT_SIZE_16 );
           break;
 
         default:
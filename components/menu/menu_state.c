@@ -4,12 +4,17 @@
 #include "cmd_client.h"
 #include "menu_backend.h"
 #include "menu_default.h"
+#include "menu_diag.h"
 #include "menu_drv.h"
+#include "menu_fmt.h"
 #include "parameters.h"
 #include "ssd1306.h"
 #include "ssdFigure.h"
+#include "text_cache.h"
 #include "wifidrv.h"
 #include "dictionary.h"
+#include "frame_sched.h"
+#include "link_stats.h"
 
 #define MODULE_NAME "[SETTING] "
 #define DEBUG_LVL   PRINT_INFO
@@ -28,6 +33,11 @@ typedef enum
   PARAM_CONNECTION,
   PARAM_SIGNAL,
   PARAM_SN,
+  PARAM_LINK_EXCELLENT,
+  PARAM_LINK_GOOD,
+  PARAM_LINK_FAIR,
+  PARAM_LINK_WEAK,
+  PARAM_LINK_BAD,
   PARAM_TOP
 
 } parameters_type_t;
@@ -39,6 +49,7 @@ typedef enum
   UNIT_ON_OFF,
   UNIT_BOOL,
   UNIT_STR,
+  UNIT_LINK,
 } unit_type_t;
 
 typedef struct
@@ -50,6 +61,7 @@ typedef struct
   unit_type_t unit_type;
   void ( *get_value )( uint32_t* value );
   void ( *get_str )( char** value );
+  link_band_t link_band;
 } parameters_t;
 
 static void get_current( uint32_t* value );
@@ -65,6 +77,11 @@ static parameters_t parameters_list[] =
     [PARAM_SIGNAL] = { .name_dict = DICT_SIGNAL,        .unit = "",  .unit_type = UNIT_INT,    .get_value = get_signal    },
     [PARAM_CONNECTION] = { .name_dict = DICT_CONNECT,       .unit = "",  .unit_type = UNIT_BOOL,   .get_value = get_connection},
     [PARAM_SN] = { .name_dict = DICT_SERIAL_NUMBER, .unit = "",  .unit_type = UNIT_STR,    .get_str = get_sn          },
+    [PARAM_LINK_EXCELLENT] = { .unit_type = UNIT_LINK, .link_band = LINK_BAND_EXCELLENT },
+    [PARAM_LINK_GOOD] = { .unit_type = UNIT_LINK, .link_band = LINK_BAND_GOOD },
+    [PARAM_LINK_FAIR] = { .unit_type = UNIT_LINK, .link_band = LINK_BAND_FAIR },
+    [PARAM_LINK_WEAK] = { .unit_type = UNIT_LINK, .link_band = LINK_BAND_WEAK },
+    [PARAM_LINK_BAD] = { .unit_type = UNIT_LINK, .link_band = LINK_BAND_BAD },
 };
 
 static scrollBar_t scrollBar = {
@@ -98,6 +115,23 @@ static void get_sn( char** value )
   *value = serial_number;
 }
 
+/* <band> p50/p90 ms timeouts/requests */
+static void _format_link( menu_fmt_t* fmt, link_band_t band )
+{
+  link_band_stats_t stats;
+
+  LinkStats_GetBand( band, &stats );
+  MenuFmt_Str( fmt, LinkStats_GetBandName( band ) );
+  MenuFmt_Char( fmt, ' ' );
+  MenuFmt_U32( fmt, LatencyTrace_Percentile( &stats.hist, 50 ) / 1000 );
+  MenuFmt_Char( fmt, '/' );
+  MenuFmt_U32( fmt, LatencyTrace_Percentile( &stats.hist, 90 ) / 1000 );
+  MenuFmt_Str( fmt, "ms " );
+  MenuFmt_U32( fmt, stats.timeouts );
+  MenuFmt_Char( fmt, '/' );
+  MenuFmt_U32( fmt, stats.hist.count + stats.timeouts + stats.fails );
+}
+
 static void menu_button_up_callback( void* arg )
 {
   menu_token_t* menu = arg;
@@ -107,6 +141,8 @@ static void menu_button_up_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   menu->last_button = LAST_BUTTON_UP;
   if ( menu->position > 0 )
   {
@@ -123,6 +159,8 @@ static void menu_button_down_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   menu->last_button = LAST_BUTTON_DOWN;
   if ( menu->position < PARAM_TOP - 1 )
   {
@@ -130,6 +168,17 @@ static void menu_button_down_callback( void* arg )
   }
 }
 
+static void menu_button_diag_callback( void* arg )
+{
+  menu_token_t* menu = arg;
+  if ( menu == NULL )
+  {
+    NULL_ERROR_MSG();
+    return;
+  }
+  menuEnterDiagnostics();
+}
+
 static void menu_button_exit_callback( void* arg )
 {
   menu_token_t* menu = arg;
@@ -151,6 +200,7 @@ static bool menu_button_init_cb( void* arg )
   }
   menu->button.down.fall_callback = menu_button_down_callback;
   menu->button.up.fall_callback = menu_button_up_callback;
+  menu->button.up.timer_callback = menu_button_diag_callback;
 
   menu->button.enter.fall_callback = menu_button_exit_callback;
   menu->button.exit.fall_callback = menu_button_exit_callback;
@@ -231,21 +281,37 @@ static bool _connected_process( menu_token_t* menu )
   }
 
   int line = 0;
+  menu_fmt_t fmt;
   do
   {
     int pos = line + menu->line.start;
 
-    if ( parameters_list[pos].unit_type == UNIT_DOUBLE )
-    {
-      sprintf( buff, "%s:      %.2f %s", dictionary_get_string( parameters_list[pos].name_dict ), (float) parameters_list[pos].value / 100.0, parameters_list[pos].unit );
-    }
-    else if ( parameters_list[pos].unit_type == UNIT_STR && parameters_list[pos].value_str != NULL )
+    MenuFmt_Init( &fmt, buff, sizeof( buff ) );
+    if ( parameters_list[pos].unit_type == UNIT_LINK )
     {
-      sprintf( buff, "%s:      %s", dictionary_get_string( parameters_list[pos].name_dict ), parameters_list[pos].value_str );
+      _format_link( &fmt, parameters_list[pos].link_band );
     }
     else
     {
-      sprintf( buff, "%s:      %ld %s", dictionary_get_string( parameters_list[pos].name_dict ), parameters_list[pos].value, parameters_list[pos].unit );
+      MenuFmt_Str( &fmt, dictionary_get_string( parameters_list[pos].name_dict ) );
+      MenuFmt_Str( &fmt, ":      " );
+
+      if ( parameters_list[pos].unit_type == UNIT_DOUBLE )
+      {
+        MenuFmt_Fixed( &fmt, parameters_list[pos].value, 2 );
+        MenuFmt_Char( &fmt, ' ' );
+        MenuFmt_Str( &fmt, parameters_list[pos].unit );
+      }
+      else if ( parameters_list[pos].unit_type == UNIT_STR && parameters_list[pos].value_str != NULL )
+      {
+        MenuFmt_Str( &fmt, parameters_list[pos].value_str );
+      }
+      else
+      {
+        MenuFmt_I32( &fmt, parameters_list[pos].value );
+        MenuFmt_Char( &fmt, ' ' );
+        MenuFmt_Str( &fmt, parameters_list[pos].unit );
+      }
     }
 
     if ( line + menu->line.start == menu->position )
@@ -281,7 +347,7 @@ static bool menu_process( void* arg )
 
   oled_clearScreen();
   oled_setGLCDFont( OLED_FONT_SIZE_16 );
-  oled_printFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
   oled_setGLCDFont( OLED_FONT_SIZE_11 );
 
   if ( backendIsConnected() )
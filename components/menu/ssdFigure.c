@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 
+#include "anim_timeline.h"
 #include "math.h"
 #include "oled.h"
 #include "ssd1306.h"
@@ -694,22 +695,6 @@ typedef enum
 
 } acc_state_t;
 
-#define ANIMATION_TIMEOUT 500
-
-static uint32_t animation_timer;
-static uint32_t animation_cnt;
-
-static void animation_counter_process( void )
-{
-  uint32_t time_now = xTaskGetTickCount();
-
-  if ( animation_timer < time_now )
-  {
-    animation_timer = time_now + MS2ST( ANIMATION_TIMEOUT );
-    animation_cnt++;
-  }
-}
-
 static void _drawBattery( uint8_t x, uint8_t y, uint8_t chrg )
 {
   for ( int j = 0; j < 8; j++ )
@@ -731,7 +716,6 @@ static void _drawBattery( uint8_t x, uint8_t y, uint8_t chrg )
 
 void drawBattery( uint8_t x, uint8_t y, float accum_voltage, bool is_charging )
 {
-  animation_counter_process();
   uint8_t x_charge = 0;
 
   if ( accum_voltage < 3.2 )
@@ -767,15 +751,14 @@ void drawBattery( uint8_t x, uint8_t y, float accum_voltage, bool is_charging )
       break;
 
     case BATTERY_CHARGING:
-      _drawBattery( x, y, x_charge + animation_cnt % ( 8 - x_charge ) );
+      _drawBattery( x, y, x_charge + AnimTimeline_Frame( ANIM_BATTERY ) % ( 8 - x_charge ) );
       break;
 
     case BATTERY_LOW_VOLTAGE:
-      if ( animation_cnt % 2 )
+      if ( AnimTimeline_Frame( ANIM_BATTERY ) % 2 )
       {
         _drawBattery( x, y, x_charge );
       }
-
       break;
 
     default:
@@ -856,7 +839,6 @@ static void _draw_low_accu4( uint8_t x, uint8_t y )
 
 void ssdFigure_DrawLowAccu( uint8_t x, uint8_t y, float acc_voltage, float acc_current )
 {
-  animation_counter_process();
   acc_state_t state = 0;
   int ds = 10;
   acc_current = acc_current * ds;
@@ -910,7 +892,7 @@ void ssdFigure_DrawLowAccu( uint8_t x, uint8_t y, float acc_voltage, float acc_c
 
     case ACC_0_blink:
       {
-        if ( animation_cnt % 2 )
+        if ( AnimTimeline_Frame( ANIM_LOW_ACCU ) % 2 )
         {
           _draw_low_accu0( x, y );
         }
@@ -1,25 +1,36 @@
 #include "start_menu.h"
 
+#include "anim_timeline.h"
 #include "app_config.h"
 #include "battery.h"
 #include "buzzer.h"
 #include "cmd_client.h"
 #include "dictionary.h"
 #include "fast_add.h"
+#include "frame_sched.h"
 #include "freertos/timers.h"
 #include "http_parameters_client.h"
+#include "latency_trace.h"
 #include "menu_backend.h"
 #include "menu_default.h"
 #include "menu_drv.h"
+#include "menu_fmt.h"
 #include "oled.h"
+#include "param_snapshot.h"
 #include "parameters.h"
 #include "ssd1306.h"
 #include "ssdFigure.h"
+#include "stall_detect.h"
+#include "state_machine.h"
 #include "string.h"
+#include "text_cache.h"
+#include "trace.h"
+#include "trace_states.h"
 #include "wifidrv.h"
 
 #define MODULE_NAME "[START] "
 #define DEBUG_LVL   PRINT_INFO
+#define TRACE_LVL   PRINT_INFO
 
 #if CONFIG_DEBUG_MENU_BACKEND
 #define LOG( _lvl, ... ) \
@@ -33,21 +44,12 @@
 #define POWER_SAVE_TIMEOUT_MS    30 * 1000
 #define CHANGE_VALUE_DISP_OFFSET 40
 #define PARAM_START_OFFSET       42
+#define VALVE_LINE_CNT           5
+#define VALVE_LINE_FIRST_COL     11
 
 typedef enum
 {
-  STATE_INIT,
-  STATE_CHECK_WIFI,
-  STATE_IDLE,
-  STATE_START,
-  STATE_READY,
-  STATE_POWER_SAVE,
-  STATE_ERROR,
-  STATE_INFO,
-  STATE_STOP,
-  STATE_ERROR_CHECK,
-  STATE_RECONNECT,
-  STATE_WAIT_CONNECT,
+  START_MENU_STATE_LIST( STATE_MACHINE_ENUM )
   STATE_TOP,
 } state_start_menu_t;
 
@@ -73,12 +75,11 @@ typedef struct
   char buff[128];
   char ap_name[64];
   uint32_t timeout_con;
+  bool wait_for_server;
   uint32_t low_silos_ckeck_timeout;
   error_type_t error_dev;
 
   struct menu_data data;
-  TickType_t animation_timeout;
-  uint8_t animation_cnt;
   TickType_t go_to_power_save_timeout;
   TickType_t low_silos_timeout;
 } context_t;
@@ -101,35 +102,27 @@ loadBar_t servo_bar =
     .height = 10,
 };
 
-static char* state_name[] =
-  {
-    [STATE_INIT] = "STATE_INIT",
-    [STATE_IDLE] = "STATE_IDLE",
-    [STATE_CHECK_WIFI] = "STATE_CHECK_WIFI",
-    [STATE_START] = "STATE_START",
-    [STATE_READY] = "STATE_READY",
-    [STATE_POWER_SAVE] = "STATE_POWER_SAVE",
-    [STATE_ERROR] = "STATE_ERROR",
-    [STATE_INFO] = "STATE_INFO",
-    [STATE_STOP] = "STATE_STOP",
-    [STATE_ERROR_CHECK] = "STATE_ERROR_CHECK",
-    [STATE_RECONNECT] = "STATE_RECONNECT",
-    [STATE_WAIT_CONNECT] = "STATE_WAIT_CONNECT" };
+STATE_MACHINE_DEFINE( state_machine, "start_menu", START_MENU_STATE_LIST( STATE_MACHINE_NAME ) );
+
+/* What _publish_data() writes, the backend reads the same fields as one
+ * group */
+PARAM_GROUP_DEFINE( publish_group, "start_data",
+                    PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE, PARAM_VALVE_4_STATE,
+                    PARAM_VALVE_5_STATE, PARAM_VALVE_6_STATE, PARAM_VALVE_7_STATE, PARAM_WATER_VOL_ADD );
+
+/* Armed while waiting for the connection, the wait is polled every frame */
+STALL_WATCH_DEFINE( stall_watch, "start_menu", 3000, &state_machine );
 
 static void change_state( state_start_menu_t new_state )
 {
-  if ( ctx.state < STATE_TOP )
-  {
-    if ( ctx.state != new_state )
-    {
-      LOG( PRINT_INFO, "Start menu %s", state_name[new_state] );
-    }
+  state_start_menu_t prev = ctx.state;
 
-    ctx.state = new_state;
-  }
-  else
+  if ( StateMachine_Change( &state_machine, new_state ) )
   {
-    LOG( PRINT_INFO, "change state %ld", new_state );
+    StallDetect_Disarm( &stall_watch );
+    TRACE( PRINT_INFO, TRACE_ID_START_STATE, prev, new_state );
+    FrameSched_RequestRedraw();
+    ctx.state = new_state;
   }
 }
 
@@ -186,6 +179,7 @@ static bool default_button_process( void* arg )
     return false;
   }
 
+  FrameSched_RequestRedraw();
   _reset_error();
   _reset_power_save_timer();
 
@@ -203,8 +197,23 @@ static bool default_button_process( void* arg )
   return true;
 }
 
+/* The backend sends the edits from a snapshot of these parameters, all
+ * fields change in one step */
+static void _publish_data( void )
+{
+  ParamSnapshot_WriteBegin( &publish_group );
+  for ( int i = 0; i < CFG_VALVE_CNT; i++ )
+  {
+    parameters_setValue( PARAM_VALVE_1_STATE + i, ctx.data.valve[i].state );
+  }
+  parameters_setValue( PARAM_WATER_VOL_ADD, ctx.data.water_volume_l );
+  ParamSnapshot_WriteEnd( &publish_group );
+}
+
 static void fast_add_callback( uint32_t value )
 {
+  _publish_data();
+  FrameSched_RequestRedraw();
 }
 
 static void menu_button_up_callback( void* arg )
@@ -219,6 +228,7 @@ static void menu_button_up_callback( void* arg )
     if ( ctx.data.water_volume_l < parameters_getValue( PARAM_TANK_SIZE ) )
     {
       ctx.data.water_volume_l += 10;
+      _publish_data();
     }
   }
 }
@@ -262,6 +272,7 @@ static void menu_button_down_callback( void* arg )
     if ( ctx.data.water_volume_l >= 10 )
     {
       ctx.data.water_volume_l -= 10;
+      _publish_data();
     }
   }
 }
@@ -292,6 +303,7 @@ static void menu_button_exit_callback( void* arg )
     NULL_ERROR_MSG();
     return;
   }
+  FrameSched_RequestRedraw();
   _reset_error();
   if ( ctx.substate == SUBSTATE_MAIN )
   {
@@ -306,6 +318,13 @@ static void menu_button_exit_callback( void* arg )
   ctx.exit_wait_flag = true;
 }
 
+static void _toggle_valve( uint8_t valve )
+{
+  ctx.data.valve[valve].state = !ctx.data.valve[valve].state;
+  _publish_data();
+  LatencyTrace_Begin();
+}
+
 static void menu_button_valve_5_cb( void* arg )
 {
   if ( !default_button_process( arg ) )
@@ -313,7 +332,7 @@ static void menu_button_valve_5_cb( void* arg )
     return;
   }
 
-  ctx.data.valve[4].state = ctx.data.valve[4].state ? false : true;
+  _toggle_valve( 4 );
 }
 
 static void menu_button_add_water_cb( void* arg )
@@ -355,7 +374,7 @@ static void menu_button_valve_2_push_cb( void* arg )
     return;
   }
 
-  ctx.data.valve[1].state = ctx.data.valve[1].state ? false : true;
+  _toggle_valve( 1 );
 }
 
 static void menu_button_valve_2_time_cb( void* arg )
@@ -373,7 +392,7 @@ static void menu_button_valve_1_push_cb( void* arg )
     return;
   }
 
-  ctx.data.valve[0].state = ctx.data.valve[0].state ? false : true;
+  _toggle_valve( 0 );
 }
 
 static void menu_button_valve_1_time_cb( void* arg )
@@ -403,7 +422,7 @@ static void menu_button_valve_4_push_cb( void* arg )
     return;
   }
 
-  ctx.data.valve[3].state = ctx.data.valve[3].state ? false : true;
+  _toggle_valve( 3 );
 }
 
 static void menu_button_valve_4_time_cb( void* arg )
@@ -421,7 +440,7 @@ static void menu_button_valve_3_push_cb( void* arg )
     return;
   }
 
-  ctx.data.valve[2].state = ctx.data.valve[2].state ? false : true;
+  _toggle_valve( 2 );
 }
 
 static void menu_button_valve_3_time_cb( void* arg )
@@ -452,6 +471,7 @@ static void menu_button_on_off( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
   _reset_error();
 }
 
@@ -524,6 +544,8 @@ static bool menu_enter_cb( void* arg )
 
 static bool menu_exit_cb( void* arg )
 {
+  /* The wait for the connection is not polled once the menu is left */
+  StallDetect_Disarm( &stall_watch );
   backendExitMenuStart();
 
   menu_token_t* menu = arg;
@@ -550,7 +572,7 @@ static void menu_set_error_msg( const char* msg )
 
 static void start_menu_init( void )
 {
-  oled_printFixed( 2, 2 * LINE_HEIGHT, dictionary_get_string( DICT_CHECK_CONNECTION ), OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, 2 * LINE_HEIGHT, dictionary_get_string( DICT_CHECK_CONNECTION ), OLED_FONT_SIZE_11 );
   change_state( STATE_CHECK_WIFI );
 }
 
@@ -568,6 +590,7 @@ static void menu_check_connection( void )
   {
     ctx.data.valve[i].state = parameters_getValue( PARAM_VALVE_1_STATE + i );
   }
+  _publish_data();
 
   for ( uint8_t i = 0; i < 3; i++ )
   {
@@ -616,24 +639,15 @@ static void start_menu_start( void )
 
 static void _substate_main( void )
 {
-  static char buff_on[64];
-  static char buff_off[64];
+  static char buff_on[32] = "Valve on:  _ _ _ _ _";
+  static char buff_off[32] = "Valve off: _ _ _ _ _";
 
-  for ( int i = 0; i < CFG_VALVE_CNT; i++ )
+  /* Both lines share the layout, only the valve digits at fixed columns change */
+  for ( int i = 0; i < VALVE_LINE_CNT; i++ )
   {
-    sprintf( buff_on, "Valve on:  %s %s %s %s %s",
-             ctx.data.valve[0].state ? "1" : "_",
-             ctx.data.valve[1].state ? "2" : "_",
-             ctx.data.valve[2].state ? "3" : "_",
-             ctx.data.valve[3].state ? "4" : "_",
-             ctx.data.valve[4].state ? "5" : "_" );
-
-    sprintf( buff_off, "Valve off: %s %s %s %s %s",
-             !ctx.data.valve[0].state ? "1" : "_",
-             !ctx.data.valve[1].state ? "2" : "_",
-             !ctx.data.valve[2].state ? "3" : "_",
-             !ctx.data.valve[3].state ? "4" : "_",
-             !ctx.data.valve[4].state ? "5" : "_" );
+    char digit = '1' + i;
+    buff_on[VALVE_LINE_FIRST_COL + 2 * i] = ctx.data.valve[i].state ? digit : '_';
+    buff_off[VALVE_LINE_FIRST_COL + 2 * i] = !ctx.data.valve[i].state ? digit : '_';
   }
 
   oled_printFixed( 2, MENU_HEIGHT, buff_on, OLED_FONT_SIZE_11 );
@@ -671,13 +685,16 @@ static void _get_liters_coordinate_and_size( uint32_t value, uint8_t* x, uint8_t
 
 static void _substate_add_water( void )
 {
-  static char buff_water[64];
+  static char buff_water[16];
   ssdFigure_DrawArrow( 2, 10, true );
   ssdFigure_DrawArrow( 2, 38, false );
   ssdFigure_DrawValve( 105, 15, false );
   ssdFigure_DrawTank( 90, 40, ctx.data.water_volume_l * 100 / parameters_getValue( PARAM_TANK_SIZE ) );
-  oled_printFixed( 20, 2, "ADD WATER:", OLED_FONT_SIZE_11 );
-  sprintf( buff_water, "%ld [l]", ctx.data.water_volume_l );
+  TextCache_PrintFixed( 20, 2, "ADD WATER:", OLED_FONT_SIZE_11 );
+  menu_fmt_t fmt;
+  MenuFmt_Init( &fmt, buff_water, sizeof( buff_water ) );
+  MenuFmt_U32( &fmt, ctx.data.water_volume_l );
+  MenuFmt_Str( &fmt, " [l]" );
 
   uint8_t x_liters;
   uint8_t y_liters;
@@ -688,37 +705,40 @@ static void _substate_add_water( void )
 
 static void _substate_apply_water( void )
 {
-  oled_printFixed( 2, 2, "Add water?", OLED_FONT_SIZE_11 );
-  oled_printFixed( 11, 14, "Yes", OLED_FONT_SIZE_11 );
-  oled_printFixed( 98, 14, "No", OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, 2, "Add water?", OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 11, 14, "Yes", OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 98, 14, "No", OLED_FONT_SIZE_11 );
   ssdFigure_DrawAcceptButton( 2, 26 );
   ssdFigure_DrawDeclineButton( 88, 26 );
 }
 
 static void _substate_wait_water_add( void )
 {
-  static char buff_water[64];
+  static char buff_water[16];
   uint32_t water_added = parameters_getValue( PARAM_WATER_VOL_READ );
   uint16_t water_flow_state = parameters_getValue( PARAM_WATER_FLOW_STATE );
 
   if ( water_flow_state == 0 )
   {
-    oled_printFixed( 2, 2, "Water added:", OLED_FONT_SIZE_11 );
-    ssdFigure_DrawValveAnimation( 105, 15, ctx.animation_cnt );
+    TextCache_PrintFixed( 2, 2, "Water added:", OLED_FONT_SIZE_11 );
+    ssdFigure_DrawValveAnimation( 105, 15, AnimTimeline_Frame( ANIM_VALVE ) );
   }
   else if ( water_flow_state == 1 )
   {
-    oled_printFixed( 2, 2, "No water flow", OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, 2, "No water flow", OLED_FONT_SIZE_11 );
     ssdFigure_DrawValve( 105, 15, false );
   }
   else
   {
-    oled_printFixed( 2, 2, "Error water flow", OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, 2, "Error water flow", OLED_FONT_SIZE_11 );
     ssdFigure_DrawValve( 105, 15, true );
   }
 
   ssdFigure_DrawTank( 90, 40, water_added * 100 / parameters_getValue( PARAM_TANK_SIZE ) );
-  sprintf( buff_water, "%ld [l]", water_added );
+  menu_fmt_t fmt;
+  MenuFmt_Init( &fmt, buff_water, sizeof( buff_water ) );
+  MenuFmt_U32( &fmt, water_added );
+  MenuFmt_Str( &fmt, " [l]" );
 
   uint8_t x_liters;
   uint8_t y_liters;
@@ -734,11 +754,6 @@ static void _substate_wait_water_add( void )
       backendSetWater( false );
     }
   }
-  if ( ctx.animation_timeout < xTaskGetTickCount() )
-  {
-    ctx.animation_cnt++;
-    ctx.animation_timeout = xTaskGetTickCount() + MS2ST( 200 );
-  }
 }
 
 static void start_menu_ready( void )
@@ -751,7 +766,7 @@ static void start_menu_ready( void )
 
 /* Enter power save. Not used */
 #if 0
-    if (ctx.go_to_power_save_timeout < xTaskGetTickCount())
+    if (TICK_IS_ELAPSED(xTaskGetTickCount(), ctx.go_to_power_save_timeout))
     {
         _enter_power_save();
         change_state(STATE_POWER_SAVE);
@@ -866,6 +881,10 @@ static void menu_reconnect( void )
   if ( strlen( ctx.ap_name ) > 5 )
   {
     wifiDrvConnect();
+    ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
+    ctx.wait_for_server = false;
+    ctx.exit_wait_flag = false;
+    AnimTimeline_Restart( ANIM_WAIT_DOTS );
     change_state( STATE_WAIT_CONNECT );
   }
 }
@@ -873,45 +892,39 @@ static void menu_reconnect( void )
 static void _show_wait_connection( void )
 {
   oled_clearScreen();
-  sprintf( ctx.buff, dictionary_get_string( DICT_WAIT_CONNECTION_S_S_S ), xTaskGetTickCount() % 400 > 100 ? "." : " ",
-           xTaskGetTickCount() % 400 > 200 ? "." : " ", xTaskGetTickCount() % 400 > 300 ? "." : " " );
+  uint32_t dots = AnimTimeline_Frame( ANIM_WAIT_DOTS ) % 4;
+  sprintf( ctx.buff, dictionary_get_string( DICT_WAIT_CONNECTION_S_S_S ), dots > 0 ? "." : " ", dots > 1 ? "." : " ",
+           dots > 2 ? "." : " " );
   oled_printFixed( 2, 2 * LINE_HEIGHT, ctx.buff, OLED_FONT_SIZE_11 );
-  oled_update();
 }
 
 static void menu_wait_connect( void )
 {
-  /* Wait to connect wifi */
-  ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
-  ctx.exit_wait_flag = false;
-  do
+  /* Wait to connect wifi, then to the server. Polled once per frame */
+  StallDetect_Checkin( &stall_watch );
+  if ( TICK_IS_ELAPSED( xTaskGetTickCount(), ctx.timeout_con ) || ctx.exit_wait_flag )
   {
-    if ( ( ctx.timeout_con < xTaskGetTickCount() ) || ctx.exit_wait_flag )
-    {
-      menu_set_error_msg( dictionary_get_string( DICT_TIMEOUT_CONNECT ) );
-      return;
-    }
-
-    _show_wait_connection();
-    osDelay( 50 );
-  } while ( wifiDrvTryingConnect() );
+    menu_set_error_msg( dictionary_get_string( ctx.wait_for_server ? DICT_TIMEOUT_SERVER : DICT_TIMEOUT_CONNECT ) );
+    return;
+  }
 
-  ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
-  do
+  if ( !ctx.wait_for_server )
   {
-    if ( ( ctx.timeout_con < xTaskGetTickCount() ) || ctx.exit_wait_flag )
+    if ( !wifiDrvTryingConnect() )
     {
-      menu_set_error_msg( dictionary_get_string( DICT_TIMEOUT_SERVER ) );
-      return;
+      ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
+      ctx.wait_for_server = true;
     }
+  }
+  else if ( backendIsConnected() )
+  {
+    oled_clearScreen();
+    menuPrintfInfo( dictionary_get_string( DICT_CONNECTED_TRY_READ_DATA ) );
+    change_state( STATE_CHECK_WIFI );
+    return;
+  }
 
-    _show_wait_connection();
-    osDelay( 50 );
-  } while ( !backendIsConnected() );
-
-  oled_clearScreen();
-  menuPrintfInfo( dictionary_get_string( DICT_CONNECTED_TRY_READ_DATA ) );
-  change_state( STATE_CHECK_WIFI );
+  _show_wait_connection();
 }
 
 static bool menu_process( void* arg )
@@ -1001,6 +1014,7 @@ void menuStartReset( void )
   {
     ctx.data.valve[i].state = false;
   }
+  _publish_data();
 }
 
 void menuInitStartMenu( menu_token_t* menu )
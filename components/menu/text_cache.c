@@ -0,0 +1,249 @@
+#include "text_cache.h"
+
+#include <string.h>
+
+#include "oled.h"
+#include "ssd1306.h"
+
+#define TEXT_CACHE_ENTRIES   32
+#define TEXT_CACHE_POOL_SIZE 3072
+#define REGION_ROW_BYTES     ( SSD1306_WIDTH / 8 )
+
+typedef struct
+{
+  const char* str;
+  uint8_t font;
+  bool black;
+  uint8_t width;
+  uint8_t height;
+  uint16_t offset;
+} text_cache_entry_t;
+
+typedef struct
+{
+  text_cache_entry_t entries[TEXT_CACHE_ENTRIES];
+  uint8_t entries_cnt;
+  uint16_t pool_used;
+  uint8_t pool[TEXT_CACHE_POOL_SIZE];
+  uint32_t generation;
+} text_cache_t;
+
+static text_cache_t cache;
+static volatile uint32_t invalidate_generation;
+
+/* Framebuffer contents under the string while it is rendered on a blank
+ * area, afterwards the rendered glyphs */
+static uint8_t region[SSD1306_HEIGHT][REGION_ROW_BYTES];
+
+static void _reset( void )
+{
+  cache.entries_cnt = 0;
+  cache.pool_used = 0;
+  cache.generation = invalidate_generation;
+}
+
+static text_cache_entry_t* _find( const char* str, enum oledFontSize font, bool black )
+{
+  for ( uint8_t i = 0; i < cache.entries_cnt; i++ )
+  {
+    text_cache_entry_t* entry = &cache.entries[i];
+    if ( ( entry->str == str ) && ( entry->font == (uint8_t) font ) && ( entry->black == black ) )
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void _blit( uint8_t x, uint8_t y, const text_cache_entry_t* entry )
+{
+  const uint8_t* bits = &cache.pool[entry->offset];
+  uint32_t bit = 0;
+
+  for ( uint8_t j = 0; j < entry->height; j++ )
+  {
+    for ( uint8_t i = 0; i < entry->width; i++, bit++ )
+    {
+      if ( bits[bit / 8] & ( 1 << ( bit % 8 ) ) )
+      {
+        if ( entry->black )
+        {
+          oled_clearPixel( x + i, y + j );
+        }
+        else
+        {
+          oled_putPixel( x + i, y + j );
+        }
+      }
+    }
+  }
+}
+
+static bool _region_bit( uint8_t col, uint8_t row )
+{
+  return ( region[row][col / 8] & ( 1 << ( col % 8 ) ) ) != 0;
+}
+
+static void _pixel( uint8_t x, uint8_t y, bool on )
+{
+  if ( on )
+  {
+    oled_putPixel( x, y );
+  }
+  else
+  {
+    oled_clearPixel( x, y );
+  }
+}
+
+/* Saves the area right of and below x,y and fills it with the text
+ * background, lit for black text */
+static void _blank( uint8_t x, uint8_t y, bool black )
+{
+  memset( region, 0, sizeof( region ) );
+  for ( uint8_t row = 0; row < SSD1306_HEIGHT - y; row++ )
+  {
+    for ( uint8_t col = 0; col < SSD1306_WIDTH - x; col++ )
+    {
+      if ( oled_getPixel( x + col, y + row ) )
+      {
+        region[row][col / 8] |= 1 << ( col % 8 );
+      }
+      _pixel( x + col, y + row, black );
+    }
+  }
+}
+
+/* Swaps the rendered glyphs into the region and puts the saved pixels back,
+ * so whatever was under the string does not end up in the entry */
+static void _capture( uint8_t x, uint8_t y, bool black, uint8_t* width, uint8_t* height )
+{
+  *width = 0;
+  *height = 0;
+
+  for ( uint8_t row = 0; row < SSD1306_HEIGHT - y; row++ )
+  {
+    for ( uint8_t col = 0; col < SSD1306_WIDTH - x; col++ )
+    {
+      bool ink = oled_getPixel( x + col, y + row ) != black;
+
+      _pixel( x + col, y + row, _region_bit( col, row ) );
+      if ( ink )
+      {
+        region[row][col / 8] |= 1 << ( col % 8 );
+        *width = col + 1 > *width ? col + 1 : *width;
+        *height = row + 1;
+      }
+      else
+      {
+        region[row][col / 8] &= ~( 1 << ( col % 8 ) );
+      }
+    }
+  }
+}
+
+static text_cache_entry_t* _store( const char* str, enum oledFontSize font, bool black, uint8_t width, uint8_t height )
+{
+  uint16_t size = ( width * height + 7 ) / 8;
+
+  if ( ( cache.entries_cnt == TEXT_CACHE_ENTRIES ) || ( cache.pool_used + size > TEXT_CACHE_POOL_SIZE ) )
+  {
+    /* Labels change only with the screen, so starting over is cheaper than LRU bookkeeping */
+    _reset();
+    if ( size > TEXT_CACHE_POOL_SIZE )
+    {
+      return NULL;
+    }
+  }
+
+  text_cache_entry_t* entry = &cache.entries[cache.entries_cnt++];
+  entry->str = str;
+  entry->font = (uint8_t) font;
+  entry->black = black;
+  entry->width = width;
+  entry->height = height;
+  entry->offset = cache.pool_used;
+
+  uint8_t* bits = &cache.pool[entry->offset];
+  memset( bits, 0, size );
+  uint32_t bit = 0;
+
+  for ( uint8_t row = 0; row < height; row++ )
+  {
+    for ( uint8_t col = 0; col < width; col++, bit++ )
+    {
+      if ( _region_bit( col, row ) )
+      {
+        bits[bit / 8] |= 1 << ( bit % 8 );
+      }
+    }
+  }
+
+  cache.pool_used += size;
+  return entry;
+}
+
+static void _render( uint8_t x, uint8_t y, const char* str, enum oledFontSize font, bool black )
+{
+  if ( black )
+  {
+    oled_printFixedBlack( x, y, str, font );
+  }
+  else
+  {
+    oled_printFixed( x, y, str, font );
+  }
+}
+
+static void _print( uint8_t x, uint8_t y, const char* str, enum oledFontSize font, bool black )
+{
+  uint8_t width;
+  uint8_t height;
+
+  if ( ( str == NULL ) || ( x >= SSD1306_WIDTH ) || ( y >= SSD1306_HEIGHT ) )
+  {
+    return;
+  }
+
+  if ( cache.generation != invalidate_generation )
+  {
+    _reset();
+  }
+
+  text_cache_entry_t* entry = _find( str, font, black );
+
+  if ( entry == NULL )
+  {
+    /* Rendered on a blank area, a diff against the background would lose
+     * the glyph pixels that were already set */
+    _blank( x, y, black );
+    _render( x, y, str, font, black );
+    _capture( x, y, black, &width, &height );
+    entry = _store( str, font, black, width, height );
+  }
+
+  if ( entry != NULL )
+  {
+    _blit( x, y, entry );
+  }
+  else
+  {
+    _render( x, y, str, font, black );
+  }
+}
+
+void TextCache_PrintFixed( uint8_t x, uint8_t y, const char* str, enum oledFontSize font )
+{
+  _print( x, y, str, font, false );
+}
+
+void TextCache_PrintFixedBlack( uint8_t x, uint8_t y, const char* str, enum oledFontSize font )
+{
+  _print( x, y, str, font, true );
+}
+
+void TextCache_Invalidate( void )
+{
+  invalidate_generation++;
+}
@@ -0,0 +1,15 @@
+#ifndef TEXT_CACHE_H_
+#define TEXT_CACHE_H_
+
+#include "app_config.h"
+#include "oled.h"
+
+/* Glyph-run cache for static menu labels.
+ * Strings are keyed by pointer, so only pass strings with static storage
+ * (literals, dictionary phrases). Formatted buffers must use oled_printFixed. */
+
+void TextCache_PrintFixed( uint8_t x, uint8_t y, const char* str, enum oledFontSize font );
+void TextCache_PrintFixedBlack( uint8_t x, uint8_t y, const char* str, enum oledFontSize font );
+void TextCache_Invalidate( void );
+
+#endif
@@ -1,12 +1,16 @@
 #include "app_config.h"
 #include "cmd_client.h"
 #include "dictionary.h"
+#include "frame_sched.h"
 #include "menu_backend.h"
 #include "menu_default.h"
 #include "menu_drv.h"
 #include "oled.h"
 #include "ssd1306.h"
 #include "ssdFigure.h"
+#include "stall_detect.h"
+#include "state_machine.h"
+#include "text_cache.h"
 #include "wifidrv.h"
 
 #define MODULE_NAME "[SETTING] "
@@ -53,18 +57,20 @@ typedef struct
 static wifi_menu_t ctx;
 static uint8_t dev_type;
 
-static char* state_name[] =
-  {
-    [ST_WIFI_INIT] = "ST_WIFI_INIT",
-    [ST_WIFI_IDLE] = "ST_WIFI_IDLE",
-    [ST_WIFI_FIND_DEVICE] = "ST_WIFI_FIND_DEVICE",
-    [ST_WIFI_DEVICE_LIST] = "ST_WIFI_DEVICE_LIST",
-    [ST_WIFI_DEVICE_TRY_CONNECT] = "ST_WIFI_DEVICE_TRY_CONNECT",
-    [ST_WIFI_DEVICE_WAIT_CONNECT] = "ST_WIFI_DEVICE_WAIT_CONNECT",
-    [ST_WIFI_DEVICE_WAIT_CMD_CLIENT] = "ST_WIFI_DEVICE_WAIT_CMD_CLIENT",
-    [ST_WIFI_CONNECTED] = "ST_WIFI_CONNECTED",
-    [ST_WIFI_ERROR_CHECK] = "ST_WIFI_ERROR_CHECK",
-    [ST_WIFI_STOP] = "ST_WIFI_STOP" };
+STATE_MACHINE_DEFINE( state_machine, "wifi_menu",
+                      [ST_WIFI_INIT] = "INIT",
+                      [ST_WIFI_IDLE] = "IDLE",
+                      [ST_WIFI_FIND_DEVICE] = "FIND_DEVICE",
+                      [ST_WIFI_DEVICE_LIST] = "DEVICE_LIST",
+                      [ST_WIFI_DEVICE_TRY_CONNECT] = "DEVICE_TRY_CONNECT",
+                      [ST_WIFI_DEVICE_WAIT_CONNECT] = "DEVICE_WAIT_CONNECT",
+                      [ST_WIFI_DEVICE_WAIT_CMD_CLIENT] = "DEVICE_WAIT_CMD_CLIENT",
+                      [ST_WIFI_CONNECTED] = "CONNECTED",
+                      [ST_WIFI_ERROR_CHECK] = "ERROR_CHECK",
+                      [ST_WIFI_STOP] = "STOP" );
+
+/* Armed inside the connection waits which block the menu task */
+STALL_WATCH_DEFINE( stall_watch, "wifi_menu", 3000, &state_machine );
 
 static scrollBar_t scrollBar =
   {
@@ -73,8 +79,10 @@ static scrollBar_t scrollBar =
 
 static void change_state( stateWifiMenu_t new_state )
 {
+  StallDetect_Disarm( &stall_watch );
+  StateMachine_Change( &state_machine, new_state );
   ctx.state = new_state;
-  LOG( PRINT_INFO, "WiFi menu %s", state_name[new_state] );
+  FrameSched_RequestRedraw();
 }
 
 static void menu_button_up_callback( void* arg )
@@ -87,6 +95,8 @@ static void menu_button_up_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( ctx.state != ST_WIFI_DEVICE_LIST )
   {
     return;
@@ -109,6 +119,8 @@ static void menu_button_down_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( ctx.state != ST_WIFI_DEVICE_LIST )
   {
     return;
@@ -131,6 +143,8 @@ static void menu_button_enter_callback( void* arg )
     return;
   }
 
+  FrameSched_RequestRedraw();
+
   if ( ( ctx.state == ST_WIFI_IDLE ) || ( ctx.state == ST_WIFI_ERROR_CHECK ) )
   {
     ctx.scan_req = true;
@@ -249,7 +263,7 @@ static bool connectToDevice( char* dev )
     uint32_t wait_to_ready = MS2ST( 1000 ) + xTaskGetTickCount();
     do
     {
-      if ( wait_to_ready < xTaskGetTickCount() )
+      if ( TICK_IS_ELAPSED( xTaskGetTickCount(), wait_to_ready ) )
       {
         ctx.error_msg = "Wifi drv not ready";
         return false;
@@ -282,19 +296,19 @@ static void menu_wifi_init( void )
     change_state( ST_WIFI_IDLE );
   }
 
-  oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WAIT_TO_WIFI_INIT ), OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WAIT_TO_WIFI_INIT ), OLED_FONT_SIZE_11 );
 }
 
 static void menu_wifi_idle( void )
 {
   if ( ctx.scan_req )
   {
-    oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_SCANNING_DEVICES ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_SCANNING_DEVICES ), OLED_FONT_SIZE_11 );
     change_state( ST_WIFI_FIND_DEVICE );
     return;
   }
 
-  oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_CLICK_ENTER_TO_SCANNING ), OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_CLICK_ENTER_TO_SCANNING ), OLED_FONT_SIZE_11 );
 }
 
 static void menu_wifi_find_devices( void )
@@ -345,12 +359,12 @@ static void menu_wifi_show_list( menu_token_t* menu )
   {
     if ( ctx.scan_req )
     {
-      oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_FIND_DEVICES ), OLED_FONT_SIZE_11 );
+      TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_FIND_DEVICES ), OLED_FONT_SIZE_11 );
       change_state( ST_WIFI_FIND_DEVICE );
       return;
     }
 
-    oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_DEVICE_NOT_FOUND ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_DEVICE_NOT_FOUND ), OLED_FONT_SIZE_11 );
     return;
   }
 
@@ -410,7 +424,7 @@ static void menu_wifi_connect( menu_token_t* menu )
 {
   if ( connectToDevice( ctx.devices_list[menu->position] ) )
   {
-    oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WAIT_TO_CONNECT ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WAIT_TO_CONNECT ), OLED_FONT_SIZE_11 );
     oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT, ctx.devices_list[menu->position], OLED_FONT_SIZE_11 );
     change_state( ST_WIFI_DEVICE_WAIT_CONNECT );
   }
@@ -428,7 +442,8 @@ static void menu_wifi_wait_connect( void )
   ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
   do
   {
-    if ( ctx.timeout_con < xTaskGetTickCount() )
+    StallDetect_Checkin( &stall_watch );
+    if ( TICK_IS_ELAPSED( xTaskGetTickCount(), ctx.timeout_con ) )
     {
       ctx.error_msg = dictionary_get_string( DICT_TIMEOUT_CONNECT );
       ctx.error_flag = 1;
@@ -443,8 +458,8 @@ static void menu_wifi_wait_connect( void )
 
   if ( wifiDrvIsConnected() )
   {
-    oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WIFI_CONNECTED ), OLED_FONT_SIZE_11 );
-    oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT, dictionary_get_string( DICT_WAIT_TO_SERVER ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_WIFI_CONNECTED ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT + LINE_HEIGHT, dictionary_get_string( DICT_WAIT_TO_SERVER ), OLED_FONT_SIZE_11 );
     change_state( ST_WIFI_DEVICE_WAIT_CMD_CLIENT );
   }
   else
@@ -461,7 +476,8 @@ static void menu_wifi_wait_cmd_client( void )
   ctx.timeout_con = MS2ST( 10000 ) + xTaskGetTickCount();
   do
   {
-    if ( ctx.timeout_con < xTaskGetTickCount() )
+    StallDetect_Checkin( &stall_watch );
+    if ( TICK_IS_ELAPSED( xTaskGetTickCount(), ctx.timeout_con ) )
     {
       ctx.error_msg = dictionary_get_string( DICT_TIMEOUT_SERVER );
       ctx.error_flag = 1;
@@ -481,7 +497,7 @@ static void menu_wifi_error_check( void )
 
   if ( ctx.error_flag )
   {
-    oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_ERROR_CONNECT ), OLED_FONT_SIZE_11 );
+    TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_ERROR_CONNECT ), OLED_FONT_SIZE_11 );
     if ( ctx.error_msg != NULL )
     {
       sprintf( error_buff, "%s:%d", ctx.error_msg, ctx.error_code );
@@ -510,7 +526,7 @@ static void menu_wifi_error_check( void )
 
 static void menu_wifi_connected( menu_token_t* menu )
 {
-  oled_printFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_CONNECTED_TO ), OLED_FONT_SIZE_11 );
+  TextCache_PrintFixed( 2, MENU_HEIGHT, dictionary_get_string( DICT_CONNECTED_TO ), OLED_FONT_SIZE_11 );
   oled_printFixed( 2, MENU_HEIGHT + LINE_HEIGHT, ctx.devices_list[menu->position], OLED_FONT_SIZE_11 );
 
   if ( ctx.scan_req )
@@ -542,7 +558,7 @@ static bool menu_process( void* arg )
   }
 
   oled_clearScreen();
-  oled_printFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
+  TextCache_PrintFixed( 2, 0, dictionary_get_string( menu->name_dict ), OLED_FONT_SIZE_16 );
 
   switch ( ctx.state )
   {
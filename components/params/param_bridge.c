@@ -0,0 +1,105 @@
+#include "param_bridge.h"
+
+#include <string.h>
+
+#include "param_persist.h"
+#include "param_store.h"
+
+bool __real_parameters_setValue( parameter_value_t val, uint32_t value );
+uint32_t __real_parameters_getValue( parameter_value_t val );
+bool __real_parameters_setString( parameter_string_t val, const char* str );
+uint32_t __real_ParamStore_Take( parameter_value_t param );
+
+/* A changed config value goes to flash whoever wrote it, the menu as well
+ * as the HTTP server of hq */
+bool __wrap_parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  uint32_t old;
+  bool ret;
+
+  if ( ParamStore_GetDef( val ) != NULL )
+  {
+    old = ParamStore_Get( val );
+    ret = ParamStore_Set( val, value ) && __real_parameters_setValue( val, value );
+  }
+  else
+  {
+    param_store_write_begin( val );
+    old = __real_parameters_getValue( val );
+    ret = __real_parameters_setValue( val, value );
+    param_store_write_end( val );
+
+    if ( ret )
+    {
+      param_store_changed( val, old, value );
+    }
+  }
+
+  if ( ret && ( old != value ) && ParamStore_IsConfig( val ) )
+  {
+    ParamPersist_Mark( val );
+  }
+
+  return ret;
+}
+
+/* The trigger is cleared in hq too, inside the same write so no snapshot
+ * sees the store and hq disagree */
+uint32_t __wrap_ParamStore_Take( parameter_value_t param )
+{
+  uint32_t value;
+
+  param_store_write_begin( param );
+  if ( ParamStore_GetDef( param ) != NULL )
+  {
+    value = __real_ParamStore_Take( param );
+  }
+  else
+  {
+    value = __real_parameters_getValue( param );
+  }
+
+  if ( value != 0 )
+  {
+    __real_parameters_setValue( param, 0 );
+  }
+  param_store_write_end( param );
+
+  return value;
+}
+
+uint32_t __wrap_parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_GetDef( val ) != NULL ? ParamStore_Get( val ) : __real_parameters_getValue( val );
+}
+
+/* Strings go to flash with the parameter image */
+bool __wrap_parameters_setString( parameter_string_t val, const char* str )
+{
+  char old[PARAM_PERSIST_STR_SIZE];
+
+  if ( !parameters_getString( val, old, sizeof( old ) ) )
+  {
+    old[0] = '\0';
+  }
+
+  bool ret = __real_parameters_setString( val, str );
+  if ( ret && ( strncmp( old, str, sizeof( old ) - 1 ) != 0 ) )
+  {
+    ParamPersist_MarkString( val );
+  }
+
+  return ret;
+}
+
+void ParamBridge_Sync( void )
+{
+  ParamStore_Init();
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( ParamStore_GetDef( i ) != NULL )
+    {
+      ParamStore_Set( i, __real_parameters_getValue( i ) );
+    }
+  }
+}
@@ -0,0 +1,20 @@
+#ifndef PARAM_BRIDGE_H_
+#define PARAM_BRIDGE_H_
+
+#include "app_config.h"
+
+/* parameters_setValue() and parameters_getValue() of the hq parameters
+ * module are linked with --wrap (see CMakeLists.txt) so that every writer,
+ * the HTTP API included, goes through the store: parameters of
+ * PARAM_STORE_LIST are read from and written to their store slots, the hq
+ * copy follows for its own save and API. Writes of the shared parameters
+ * stay in hq but still count as store writes and notify subscribers.
+ * parameters_setString() is wrapped too, and ParamStore_Take() so a taken
+ * trigger is cleared in hq as well. A changed config value or string
+ * is marked for param_persist, so edits over HTTP reach flash like the
+ * ones from the menu. */
+
+/* The store slots from the values parameters_init() loaded */
+void ParamBridge_Sync( void );
+
+#endif
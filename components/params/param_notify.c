@@ -0,0 +1,117 @@
+#include "param_notify.h"
+
+#include "param_store.h"
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  param_subscriber_t* first;
+} param_notify_t;
+
+static param_notify_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void _register( param_subscriber_t* sub )
+{
+  /* Not only store slots, shared parameters are notified too */
+  for ( uint8_t i = 0; i < sub->params_cnt; i++ )
+  {
+    sub->last[i] = parameters_getValue( sub->params[i] );
+  }
+
+  /* Linked fully set up, the dispatch walks the list without the lock */
+  portENTER_CRITICAL( &ctx.lock );
+  sub->next = ctx.first;
+  ctx.first = sub;
+  for ( uint8_t i = 0; i < sub->params_cnt; i++ )
+  {
+    atomic_fetch_or( &param_store_watched[sub->params[i] / 32], 1u << ( sub->params[i] % 32 ) );
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void ParamNotify_Subscribe( param_subscriber_t* sub, param_notify_cb_t cb, void* arg )
+{
+  assert( sub );
+  assert( cb );
+
+  sub->cb = cb;
+  sub->arg = arg;
+  _register( sub );
+}
+
+void ParamNotify_SubscribeQueue( param_subscriber_t* sub, QueueHandle_t queue )
+{
+  assert( sub );
+  assert( queue );
+
+  sub->queue = queue;
+  _register( sub );
+}
+
+static bool _pass( param_subscriber_t* sub, uint8_t i, uint32_t old, uint32_t value )
+{
+  switch ( sub->filter )
+  {
+    case PARAM_FILTER_DEADBAND:
+      return ( value > sub->last[i] ? value - sub->last[i] : sub->last[i] - value ) > sub->level;
+
+    case PARAM_FILTER_THRESHOLD:
+      return ( old >= sub->level ) != ( value >= sub->level );
+
+    default:
+      return true;
+  }
+}
+
+void ParamNotify_Dispatch( parameter_value_t param, uint32_t old, uint32_t value )
+{
+  for ( param_subscriber_t* sub = ctx.first; sub != NULL; sub = sub->next )
+  {
+    for ( uint8_t i = 0; i < sub->params_cnt; i++ )
+    {
+      if ( sub->params[i] != param )
+      {
+        continue;
+      }
+
+      /* Writers of a parameter may run in several tasks */
+      portENTER_CRITICAL( &ctx.lock );
+      bool pass = _pass( sub, i, old, value );
+      if ( pass )
+      {
+        sub->last[i] = value;
+        sub->events++;
+      }
+      portEXIT_CRITICAL( &ctx.lock );
+
+      if ( !pass )
+      {
+        break;
+      }
+
+      if ( sub->cb != NULL )
+      {
+        sub->cb( param, value, sub->arg );
+      }
+      else
+      {
+        param_event_t event = { .param = param, .value = value };
+        if ( xQueueSend( sub->queue, &event, 0 ) != pdTRUE )
+        {
+          portENTER_CRITICAL( &ctx.lock );
+          sub->dropped++;
+          portEXIT_CRITICAL( &ctx.lock );
+        }
+      }
+      break;
+    }
+  }
+}
+
+param_subscriber_t* ParamNotify_GetFirst( void )
+{
+  return ctx.first;
+}
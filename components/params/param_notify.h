@@ -0,0 +1,74 @@
+#ifndef PARAM_NOTIFY_H_
+#define PARAM_NOTIFY_H_
+
+#include "app_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "parameters.h"
+
+/* Change notification for the parameter store. A subscriber names a set of
+ * parameters and a filter and gets a callback or a queue event when one of
+ * them changes. Dispatch runs in the writer's task right after the store
+ * update, walks the subscriber list without a lock and never allocates;
+ * the filter state of a subscriber is updated under a short critical
+ * section, callbacks run outside it. A queue which is full drops the event
+ * and counts it. Callbacks must not block, a task waiting for changes
+ * should use a queue. */
+
+typedef enum
+{
+  PARAM_FILTER_CHANGE,       // every change
+  PARAM_FILTER_DEADBAND,     // moved more than level from the last notified value
+  PARAM_FILTER_THRESHOLD,    // crossed level in either direction
+} param_filter_t;
+
+typedef struct
+{
+  parameter_value_t param;
+  uint32_t value;
+} param_event_t;
+
+typedef void ( *param_notify_cb_t )( parameter_value_t param, uint32_t value, void* arg );
+
+typedef struct param_subscriber
+{
+  const char* name;
+  const parameter_value_t* params;
+  uint32_t* last;    // last notified value per parameter
+  uint8_t params_cnt;
+  param_filter_t filter;
+  uint32_t level;
+  param_notify_cb_t cb;
+  void* arg;
+  QueueHandle_t queue;
+  uint32_t events;
+  uint32_t dropped;
+  struct param_subscriber* next;
+} param_subscriber_t;
+
+/* PARAM_SUBSCRIBER_DEFINE(sub, "controller", PARAM_FILTER_CHANGE, 0,
+ *                         PARAM_START_SYSTEM, PARAM_ADD_WATER) */
+#define PARAM_SUBSCRIBER_DEFINE( _var, _name, _filter, _level, ... )                    \
+  static const parameter_value_t _var##_params[] = { __VA_ARGS__ };                     \
+  static uint32_t _var##_last[sizeof( _var##_params ) / sizeof( _var##_params[0] )];   \
+  static param_subscriber_t _var =                                                      \
+    {                                                                                   \
+      .name = _name,                                                                    \
+      .params = _var##_params,                                                          \
+      .last = _var##_last,                                                              \
+      .params_cnt = sizeof( _var##_params ) / sizeof( _var##_params[0] ),               \
+      .filter = _filter,                                                                \
+      .level = _level,                                                                  \
+  }
+
+/* Subscribers are registered once and never removed */
+void ParamNotify_Subscribe( param_subscriber_t* sub, param_notify_cb_t cb, void* arg );
+/* The queue holds param_event_t items */
+void ParamNotify_SubscribeQueue( param_subscriber_t* sub, QueueHandle_t queue );
+
+/* Called by the store writers, old differs from value */
+void ParamNotify_Dispatch( parameter_value_t param, uint32_t old, uint32_t value );
+
+param_subscriber_t* ParamNotify_GetFirst( void );
+
+#endif
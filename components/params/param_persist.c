@@ -0,0 +1,512 @@
+#include "param_persist.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "param_store.h"
+
+#define MODULE_NAME "[PERSIST] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_PARAM_PERSIST
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define PARAM_PERSIST_NAMESPACE   "params"
+#define PARAM_PERSIST_VERSION_KEY "cfg_ver"
+#define PARAM_PERSIST_IMAGE_KEY   "image"
+#define PARAM_IMAGE_MAGIC         0x324D4950    // "PIM2"
+#define DIRTY_WORDS             ( ( PARAM_VALUE_TOP + 31 ) / 32 )
+
+/* All stored config values and the strings in one blob, the values by
+ * their position among the config parameters. The config version pins the
+ * positions. */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t crc;    // of the bytes after it
+  uint32_t version;
+  uint32_t cnt;
+  uint32_t stored[DIRTY_WORDS];
+  char strings[PARAM_STR_TOP][PARAM_PERSIST_STR_SIZE];
+  uint32_t values[PARAM_VALUE_TOP];
+} param_image_t;
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  SemaphoreHandle_t flush_lock;
+  uint32_t dirty[DIRTY_WORDS];
+  uint32_t stored[DIRTY_WORDS];    // shadow holds the value in flash
+  uint32_t shadow[PARAM_VALUE_TOP];
+  uint32_t version;    // config version in flash
+  bool pending;
+  bool strings_dirty;
+  bool committed;
+  bool loading;    // the values being set come from flash, no marks
+  TickType_t first_mark;
+  TickType_t last_mark;
+  TickType_t last_commit;
+  param_image_t image;
+  param_persist_stats_t stats;
+} param_persist_t;
+
+static param_persist_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* NVS keys are limited to 15 characters, the key is a hash of the name so
+ * it survives reordering of the parameters list */
+static void _key( parameter_value_t param, char* key, size_t size )
+{
+  uint32_t hash = 2166136261u;
+
+  for ( const char* c = parameters_getName( param ); *c != '\0'; c++ )
+  {
+    hash = ( hash ^ (uint8_t) *c ) * 16777619u;
+  }
+
+  snprintf( key, size, "p%08lx", (unsigned long) hash );
+}
+
+static bool _bit( const uint32_t* bits, uint32_t i )
+{
+  return ( bits[i / 32] >> ( i % 32 ) ) & 1;
+}
+
+static void _set_bit( uint32_t* bits, uint32_t i )
+{
+  bits[i / 32] |= 1u << ( i % 32 );
+}
+
+static uint32_t _image_size( uint32_t cnt )
+{
+  return offsetof( param_image_t, values ) + cnt * sizeof( uint32_t );
+}
+
+static uint32_t _image_crc( uint32_t cnt )
+{
+  const uint8_t* start = (const uint8_t*) &ctx.image + offsetof( param_image_t, version );
+  return esp_rom_crc32_le( 0, start, _image_size( cnt ) - offsetof( param_image_t, version ) );
+}
+
+/* From the shadow, what is in flash once committed */
+static bool _image_write( nvs_handle_t handle )
+{
+  uint32_t cnt = 0;
+
+  memset( &ctx.image, 0, sizeof( ctx.image ) );
+  for ( uint32_t i = 0; i < PARAM_STR_TOP; i++ )
+  {
+    parameters_getString( i, ctx.image.strings[i], PARAM_PERSIST_STR_SIZE );
+  }
+
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( !ParamStore_IsConfig( i ) )
+    {
+      continue;
+    }
+
+    if ( _bit( ctx.stored, i ) )
+    {
+      _set_bit( ctx.image.stored, cnt );
+      ctx.image.values[cnt] = ctx.shadow[i];
+    }
+    cnt++;
+  }
+
+  ctx.image.magic = PARAM_IMAGE_MAGIC;
+  ctx.image.version = ParamStore_GetConfigVersion();
+  ctx.image.cnt = cnt;
+  ctx.image.crc = _image_crc( cnt );
+
+  return nvs_set_blob( handle, PARAM_PERSIST_IMAGE_KEY, &ctx.image, _image_size( cnt ) ) == ESP_OK;
+}
+
+/* One read for all values, false sends the boot to the keys */
+static bool _image_read( nvs_handle_t handle )
+{
+  size_t size = sizeof( ctx.image );
+
+  if ( nvs_get_blob( handle, PARAM_PERSIST_IMAGE_KEY, &ctx.image, &size ) != ESP_OK )
+  {
+    return false;
+  }
+
+  if ( ( ctx.image.magic != PARAM_IMAGE_MAGIC ) || ( ctx.image.cnt > PARAM_VALUE_TOP )
+       || ( size != _image_size( ctx.image.cnt ) ) || ( ctx.image.crc != _image_crc( ctx.image.cnt ) ) )
+  {
+    LOG( PRINT_WARNING, "image damaged" );
+    return false;
+  }
+
+  if ( ctx.image.version != ParamStore_GetConfigVersion() )
+  {
+    LOG( PRINT_INFO, "image of config version %08lx", ctx.image.version );
+    return false;
+  }
+
+  return true;
+}
+
+bool ParamPersist_LoadImage( void )
+{
+  nvs_handle_t handle;
+  uint32_t loaded = 0;
+
+  if ( nvs_open( PARAM_PERSIST_NAMESPACE, NVS_READONLY, &handle ) != ESP_OK )
+  {
+    return false;
+  }
+
+  bool ret = _image_read( handle );
+  nvs_close( handle );
+  if ( !ret )
+  {
+    return false;
+  }
+
+  /* Everything parameters_init() would set: the stored values, the
+   * defaults for the rest and the strings */
+  uint32_t pos = 0;
+  ctx.loading = true;
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    bool stored = ParamStore_IsConfig( i ) && _bit( ctx.image.stored, pos );
+    uint32_t value = stored ? ctx.image.values[pos] : parameters_getDefaultValue( i );
+
+    if ( parameters_setValue( i, value ) && stored )
+    {
+      ctx.shadow[i] = value;
+      _set_bit( ctx.stored, i );
+      loaded++;
+    }
+    pos += ParamStore_IsConfig( i ) ? 1 : 0;
+  }
+
+  for ( uint32_t i = 0; i < PARAM_STR_TOP; i++ )
+  {
+    ctx.image.strings[i][PARAM_PERSIST_STR_SIZE - 1] = '\0';
+    parameters_setString( i, ctx.image.strings[i] );
+  }
+  ctx.loading = false;
+
+  ctx.version = ctx.image.version;
+  ctx.stats.image_loads++;
+  LOG( PRINT_INFO, "%lu parameters loaded from the image", loaded );
+  return true;
+}
+
+static uint32_t _keys_load( nvs_handle_t handle )
+{
+  char key[16];
+  uint32_t value;
+  uint32_t loaded = 0;
+
+  if ( ( nvs_get_u32( handle, PARAM_PERSIST_VERSION_KEY, &ctx.version ) == ESP_OK )
+       && ( ctx.version != ParamStore_GetConfigVersion() ) )
+  {
+    LOG( PRINT_WARNING, "config version %08lx, now %08lx", ctx.version, ParamStore_GetConfigVersion() );
+  }
+
+  ctx.loading = true;
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( !ParamStore_IsConfig( i ) )
+    {
+      continue;
+    }
+
+    _key( i, key, sizeof( key ) );
+    if ( ( nvs_get_u32( handle, key, &value ) == ESP_OK ) && parameters_setValue( i, value ) )
+    {
+      ctx.shadow[i] = value;
+      _set_bit( ctx.stored, i );
+      loaded++;
+    }
+  }
+  ctx.loading = false;
+
+  return loaded;
+}
+
+void ParamPersist_Load( void )
+{
+  nvs_handle_t handle;
+  uint32_t loaded = 0;
+
+  if ( nvs_open( PARAM_PERSIST_NAMESPACE, NVS_READONLY, &handle ) == ESP_OK )
+  {
+    loaded = _keys_load( handle );
+    nvs_close( handle );
+  }
+
+  /* What parameters_init() and the keys gave is what the next boot takes
+   * from the image, the keys stay the fallback */
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( ParamStore_IsConfig( i ) && !_bit( ctx.stored, i ) )
+    {
+      ctx.shadow[i] = parameters_getValue( i );
+      _set_bit( ctx.stored, i );
+    }
+  }
+
+  bool ret = nvs_open( PARAM_PERSIST_NAMESPACE, NVS_READWRITE, &handle ) == ESP_OK;
+  if ( ret )
+  {
+    ret = _image_write( handle ) && ( nvs_commit( handle ) == ESP_OK );
+    nvs_close( handle );
+  }
+  ctx.stats.image_writes += ret ? 1 : 0;
+  ctx.stats.errors += ret ? 0 : 1;
+
+  LOG( PRINT_INFO, "%lu parameters loaded from the keys", loaded );
+}
+
+void ParamPersist_Mark( parameter_value_t param )
+{
+  assert( param < PARAM_VALUE_TOP );
+
+  TickType_t now = xTaskGetTickCount();
+
+  if ( ctx.loading )
+  {
+    return;
+  }
+
+  if ( !ParamStore_IsConfig( param ) )
+  {
+    portENTER_CRITICAL( &ctx.lock );
+    ctx.stats.runtime_marks++;
+    portEXIT_CRITICAL( &ctx.lock );
+    return;
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  _set_bit( ctx.dirty, param );
+  if ( !ctx.pending )
+  {
+    ctx.pending = true;
+    ctx.first_mark = now;
+  }
+  ctx.last_mark = now;
+  ctx.stats.marks++;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+void ParamPersist_MarkString( parameter_string_t param )
+{
+  assert( param < PARAM_STR_TOP );
+
+  TickType_t now = xTaskGetTickCount();
+
+  if ( ctx.loading )
+  {
+    return;
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.strings_dirty = true;
+  if ( !ctx.pending )
+  {
+    ctx.pending = true;
+    ctx.first_mark = now;
+  }
+  ctx.last_mark = now;
+  ctx.stats.marks++;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+bool ParamPersist_IsPending( void )
+{
+  return ctx.pending;
+}
+
+static void _remark( const uint32_t* dirty, bool strings )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  for ( uint32_t w = 0; w < DIRTY_WORDS; w++ )
+  {
+    ctx.dirty[w] |= dirty[w];
+  }
+  ctx.strings_dirty |= strings;
+  if ( !ctx.pending )
+  {
+    ctx.pending = true;
+    ctx.first_mark = xTaskGetTickCount();
+  }
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+static bool _flush( void )
+{
+  uint32_t dirty[DIRTY_WORDS];
+  uint32_t written = 0;
+  uint32_t unchanged = 0;
+  nvs_handle_t handle;
+  char key[16];
+  bool ret = true;
+
+  portENTER_CRITICAL( &ctx.lock );
+  memcpy( dirty, ctx.dirty, sizeof( dirty ) );
+  memset( ctx.dirty, 0, sizeof( ctx.dirty ) );
+  bool strings = ctx.strings_dirty;
+  ctx.strings_dirty = false;
+  ctx.pending = false;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( nvs_open( PARAM_PERSIST_NAMESPACE, NVS_READWRITE, &handle ) != ESP_OK )
+  {
+    LOG( PRINT_ERROR, "nvs open failed" );
+    _remark( dirty, strings );
+    ctx.stats.errors++;
+    return false;
+  }
+
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( !_bit( dirty, i ) )
+    {
+      continue;
+    }
+
+    uint32_t value = parameters_getValue( i );
+    if ( _bit( ctx.stored, i ) && ( ctx.shadow[i] == value ) )
+    {
+      unchanged++;
+      continue;
+    }
+
+    _key( i, key, sizeof( key ) );
+    if ( nvs_set_u32( handle, key, value ) != ESP_OK )
+    {
+      ret = false;
+      break;
+    }
+
+    ctx.shadow[i] = value;
+    _set_bit( ctx.stored, i );
+    written++;
+  }
+
+  uint32_t version = ParamStore_GetConfigVersion();
+  if ( ret && ( written > 0 ) && ( version != ctx.version ) )
+  {
+    ret = nvs_set_u32( handle, PARAM_PERSIST_VERSION_KEY, version ) == ESP_OK;
+  }
+
+  /* A string only lives in the image */
+  bool commit = ( written > 0 ) || strings;
+  if ( ret && commit )
+  {
+    ret = _image_write( handle );
+    ctx.stats.image_writes += ret ? 1 : 0;
+  }
+
+  if ( ret && commit && ( nvs_commit( handle ) != ESP_OK ) )
+  {
+    ret = false;
+  }
+  nvs_close( handle );
+
+  if ( !ret )
+  {
+    /* The shadow of these may be ahead of flash now, write them again. The
+     * others stay stored, the next image keeps them. */
+    LOG( PRINT_ERROR, "nvs write failed" );
+    for ( uint32_t w = 0; w < DIRTY_WORDS; w++ )
+    {
+      ctx.stored[w] &= ~dirty[w];
+    }
+    _remark( dirty, strings );
+    ctx.stats.errors++;
+    return false;
+  }
+
+  ctx.stats.keys_written += written;
+  ctx.stats.keys_unchanged += unchanged;
+  if ( commit )
+  {
+    ctx.stats.commits++;
+    ctx.committed = true;
+    ctx.version = version;
+    ctx.last_commit = xTaskGetTickCount();
+    LOG( PRINT_INFO, "%lu written, %lu unchanged", written, unchanged );
+  }
+
+  return true;
+}
+
+bool ParamPersist_Flush( void )
+{
+  if ( ctx.flush_lock != NULL )
+  {
+    xSemaphoreTake( ctx.flush_lock, portMAX_DELAY );
+  }
+
+  bool ret = !ctx.pending || _flush();
+
+  if ( ctx.flush_lock != NULL )
+  {
+    xSemaphoreGive( ctx.flush_lock );
+  }
+
+  return ret;
+}
+
+void ParamPersist_Process( void )
+{
+  TickType_t now = xTaskGetTickCount();
+
+  portENTER_CRITICAL( &ctx.lock );
+  bool settled = ctx.pending
+                 && ( ( ST2MS( now - ctx.last_mark ) >= PARAM_PERSIST_QUIET_MS )
+                      || ( ST2MS( now - ctx.first_mark ) >= PARAM_PERSIST_MAX_DELAY_MS ) );
+  portEXIT_CRITICAL( &ctx.lock );
+
+  if ( settled && ( !ctx.committed || ( ST2MS( now - ctx.last_commit ) >= PARAM_PERSIST_MIN_INTERVAL_MS ) ) )
+  {
+    ParamPersist_Flush();
+  }
+}
+
+void ParamPersist_GetStats( param_persist_stats_t* stats )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.stats;
+  portEXIT_CRITICAL( &ctx.lock );
+}
+
+static void _task( void* arg )
+{
+  while ( 1 )
+  {
+    vTaskDelay( MS2ST( PARAM_PERSIST_CHECK_MS ) );
+    ParamPersist_Process();
+  }
+}
+
+static void _shutdown( void )
+{
+  ParamPersist_Flush();
+}
+
+void ParamPersist_Start( void )
+{
+  ctx.flush_lock = xSemaphoreCreateMutex();
+  esp_register_shutdown_handler( _shutdown );
+  xTaskCreate( _task, "param_persist", 3072, NULL, 3, NULL );
+}
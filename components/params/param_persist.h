@@ -0,0 +1,62 @@
+#ifndef PARAM_PERSIST_H_
+#define PARAM_PERSIST_H_
+
+#include "app_config.h"
+#include "parameters.h"
+
+/* Deferred NVS persistence of the PARAM_CONFIG parameters, runtime values
+ * never reach flash. Writers mark a parameter dirty after changing it, on
+ * the target param_bridge.c does that for every parameters_setValue(). The
+ * service coalesces marks until no new one came for
+ * PARAM_PERSIST_QUIET_MS and commits at most once per
+ * PARAM_PERSIST_MIN_INTERVAL_MS. Only keys whose value differs from the one
+ * in flash are written, all of them in a single commit. Restarts flush what
+ * is pending, call ParamPersist_Flush() before cutting the supply.
+ * Each commit also writes all stored values and the strings as one CRC
+ * checked image. Boot applies it after parameters_init() with a single read
+ * and only falls back to the keys when it is missing, damaged or of another
+ * config version:
+ *   parameters_init(); ...; if ( !ParamPersist_LoadImage() ) { ParamPersist_Load(); } */
+
+#define PARAM_PERSIST_CHECK_MS        500
+#define PARAM_PERSIST_QUIET_MS        2000
+#define PARAM_PERSIST_MAX_DELAY_MS    10000    // a stream of marks is written anyway after this
+#define PARAM_PERSIST_MIN_INTERVAL_MS 30000
+#define PARAM_PERSIST_STR_SIZE        32    // longer strings are cut in the image
+
+typedef struct
+{
+  uint32_t marks;
+  uint32_t commits;
+  uint32_t keys_written;
+  uint32_t keys_unchanged;
+  uint32_t errors;
+  uint32_t runtime_marks;    // ignored, runtime parameters are not persisted
+  uint32_t image_loads;
+  uint32_t image_writes;
+} param_persist_stats_t;
+
+/* Starts the service and the flush at restart */
+void ParamPersist_Start( void );
+
+/* Sets every parameter and string from the image, false when there is no
+ * usable image and nothing was set */
+bool ParamPersist_LoadImage( void );
+/* After parameters_init(): applies the keys and writes the image from the
+ * values in place. Values stored under another config version are applied
+ * as long as they are in range. */
+void ParamPersist_Load( void );
+void ParamPersist_Mark( parameter_value_t param );
+/* Strings are kept in the image only */
+void ParamPersist_MarkString( parameter_string_t param );
+
+/* One service step, flushes when the coalescing and rate limits allow */
+void ParamPersist_Process( void );
+
+/* Writes pending parameters now, false when NVS failed */
+bool ParamPersist_Flush( void );
+
+bool ParamPersist_IsPending( void );
+void ParamPersist_GetStats( param_persist_stats_t* stats );
+
+#endif
@@ -0,0 +1,377 @@
+#include "param_profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_rom_crc.h"
+#include "esp_spiffs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "param_persist.h"
+#include "param_snapshot.h"
+#include "param_store.h"
+
+#define MODULE_NAME "[PROFILE] "
+#define DEBUG_LVL   PRINT_INFO
+
+#if CONFIG_DEBUG_PARAM_PROFILE
+#define LOG( _lvl, ... ) \
+  debug_printf( DEBUG_LVL, _lvl, MODULE_NAME __VA_ARGS__ )
+#else
+#define LOG( PRINT_INFO, ... )
+#endif
+
+#define PROFILE_MAGIC     0x31465250    // "PRF1"
+#define PROFILE_PATH_SIZE 48
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t count;
+  char name[PARAM_PROFILE_NAME_MAX];
+} profile_header_t;
+
+typedef struct
+{
+  uint32_t key;    // hash of the parameter name
+  uint32_t value;
+} profile_entry_t;
+
+typedef struct
+{
+  profile_header_t header;
+  profile_entry_t entries[PARAM_SNAPSHOT_MAX];
+} profile_file_t;
+
+typedef struct
+{
+  SemaphoreHandle_t lock;
+  bool mounted;
+} param_profile_t;
+
+static param_profile_t ctx;
+
+PARAM_GROUP_DEFINE( profile_group, "profile",
+                    PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE, PARAM_VALVE_4_STATE,
+                    PARAM_VALVE_5_STATE, PARAM_VALVE_6_STATE, PARAM_VALVE_7_STATE,
+                    PARAM_WATER_VOL_ADD, PARAM_PWM_VALVE, PARAM_PULSES_PER_LITER, PARAM_TANK_SIZE );
+
+static uint32_t _key( parameter_value_t param )
+{
+  uint32_t hash = 2166136261u;
+
+  for ( const char* c = parameters_getName( param ); *c != '\0'; c++ )
+  {
+    hash = ( hash ^ (uint8_t) *c ) * 16777619u;
+  }
+
+  return hash;
+}
+
+static void _path( uint8_t slot, const char* ext, char* path )
+{
+  snprintf( path, PROFILE_PATH_SIZE, PARAM_PROFILE_BASE_PATH "/prof%u.%s", slot, ext );
+}
+
+static size_t _size( const profile_file_t* file )
+{
+  return sizeof( file->header ) + file->header.count * sizeof( file->entries[0] );
+}
+
+static bool _read_path( const char* path, profile_file_t* file )
+{
+  FILE* f = fopen( path, "rb" );
+  uint32_t crc;
+  bool ret = false;
+
+  if ( f == NULL )
+  {
+    return false;
+  }
+
+  if ( ( fread( &file->header, sizeof( file->header ), 1, f ) == 1 ) && ( file->header.magic == PROFILE_MAGIC )
+       && ( file->header.count <= PARAM_SNAPSHOT_MAX )
+       && ( fread( file->entries, sizeof( file->entries[0] ), file->header.count, f ) == file->header.count )
+       && ( fread( &crc, sizeof( crc ), 1, f ) == 1 ) )
+  {
+    ret = esp_rom_crc32_le( 0, (const uint8_t*) file, _size( file ) ) == crc;
+  }
+  fclose( f );
+
+  file->header.name[PARAM_PROFILE_NAME_MAX - 1] = '\0';
+  return ret;
+}
+
+/* A save interrupted after removing the old file leaves only the new one
+ * under the temporary name */
+static bool _read( uint8_t slot, profile_file_t* file )
+{
+  char path[PROFILE_PATH_SIZE];
+
+  _path( slot, "bin", path );
+  if ( _read_path( path, file ) )
+  {
+    return true;
+  }
+
+  _path( slot, "tmp", path );
+  return _read_path( path, file );
+}
+
+static bool _write( uint8_t slot, const profile_file_t* file )
+{
+  char path[PROFILE_PATH_SIZE];
+  char tmp_path[PROFILE_PATH_SIZE];
+  uint32_t crc = esp_rom_crc32_le( 0, (const uint8_t*) file, _size( file ) );
+
+  _path( slot, "bin", path );
+  _path( slot, "tmp", tmp_path );
+
+  FILE* f = fopen( tmp_path, "wb" );
+  if ( f == NULL )
+  {
+    return false;
+  }
+
+  bool ret = ( fwrite( file, _size( file ), 1, f ) == 1 ) && ( fwrite( &crc, sizeof( crc ), 1, f ) == 1 );
+  ret = ( fclose( f ) == 0 ) && ret;
+
+  /* SPIFFS does not rename over an existing file */
+  if ( ret )
+  {
+    remove( path );
+    ret = rename( tmp_path, path ) == 0;
+  }
+
+  if ( !ret )
+  {
+    remove( tmp_path );
+  }
+
+  return ret;
+}
+
+static bool _valid_slot( uint8_t slot )
+{
+  return ( slot >= 1 ) && ( slot <= CFG_PROFILE_CNT );
+}
+
+static void _lock( void )
+{
+  if ( ctx.lock != NULL )
+  {
+    xSemaphoreTake( ctx.lock, portMAX_DELAY );
+  }
+}
+
+static void _unlock( void )
+{
+  if ( ctx.lock != NULL )
+  {
+    xSemaphoreGive( ctx.lock );
+  }
+}
+
+bool ParamProfile_Init( void )
+{
+  esp_vfs_spiffs_conf_t conf =
+    {
+      .base_path = PARAM_PROFILE_BASE_PATH,
+      .partition_label = PARAM_PROFILE_PARTITION,
+      .max_files = 2,
+      .format_if_mount_failed = true,
+    };
+
+  ctx.lock = xSemaphoreCreateMutex();
+  ctx.mounted = esp_vfs_spiffs_register( &conf ) == ESP_OK;
+  if ( !ctx.mounted )
+  {
+    LOG( PRINT_ERROR, "storage mount failed" );
+  }
+
+  return ctx.mounted;
+}
+
+bool ParamProfile_Save( uint8_t slot, const char* name )
+{
+  profile_file_t file = { 0 };
+  param_snapshot_t snapshot;
+
+  if ( !ctx.mounted || !_valid_slot( slot ) || !ParamSnapshot_Read( &profile_group, &snapshot ) )
+  {
+    return false;
+  }
+
+  file.header.magic = PROFILE_MAGIC;
+  file.header.count = profile_group.params_cnt;
+  if ( name != NULL )
+  {
+    strncpy( file.header.name, name, sizeof( file.header.name ) - 1 );
+  }
+  else
+  {
+    snprintf( file.header.name, sizeof( file.header.name ), "profile %u", slot );
+  }
+
+  for ( uint8_t i = 0; i < profile_group.params_cnt; i++ )
+  {
+    file.entries[i].key = _key( profile_group.params[i] );
+    file.entries[i].value = snapshot.values[i];
+  }
+
+  _lock();
+  bool ret = _write( slot, &file );
+  _unlock();
+
+  LOG( ret ? PRINT_INFO : PRINT_ERROR, "save %u \"%s\" %s", slot, file.header.name, ret ? "ok" : "failed" );
+  return ret;
+}
+
+static int _find_entry( const profile_file_t* file, parameter_value_t param )
+{
+  uint32_t key = _key( param );
+
+  for ( uint32_t i = 0; i < file->header.count; i++ )
+  {
+    if ( file->entries[i].key == key )
+    {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+bool ParamProfile_Load( uint8_t slot )
+{
+  profile_file_t file;
+  param_snapshot_t snapshot;
+
+  if ( !ctx.mounted || !_valid_slot( slot ) )
+  {
+    return false;
+  }
+
+  _lock();
+  bool ret = _read( slot, &file );
+  _unlock();
+
+  if ( !ret || !ParamSnapshot_Read( &profile_group, &snapshot ) )
+  {
+    LOG( PRINT_ERROR, "load %u failed", slot );
+    return false;
+  }
+
+  /* Parameters the file does not know keep their value, one value out of
+   * range rejects the whole profile */
+  for ( uint8_t i = 0; i < profile_group.params_cnt; i++ )
+  {
+    parameter_value_t param = profile_group.params[i];
+    int entry = _find_entry( &file, param );
+
+    if ( entry < 0 )
+    {
+      continue;
+    }
+
+    uint32_t value = file.entries[entry].value;
+    if ( ( value < parameters_getMinValue( param ) ) || ( value > parameters_getMaxValue( param ) ) )
+    {
+      LOG( PRINT_ERROR, "load %u: %s out of range", slot, parameters_getName( param ) );
+      return false;
+    }
+    snapshot.values[i] = value;
+  }
+
+  ParamSnapshot_Seal( &snapshot );
+  if ( !ParamSnapshot_Restore( &snapshot ) )
+  {
+    return false;
+  }
+
+  for ( uint8_t i = 0; i < profile_group.params_cnt; i++ )
+  {
+    ParamPersist_Mark( profile_group.params[i] );
+  }
+  parameters_setValue( PARAM_PROFILE_ACTIVE, slot );
+
+  LOG( PRINT_INFO, "loaded %u \"%s\"", slot, file.header.name );
+  return true;
+}
+
+bool ParamProfile_Delete( uint8_t slot )
+{
+  char path[PROFILE_PATH_SIZE];
+
+  if ( !ctx.mounted || !_valid_slot( slot ) )
+  {
+    return false;
+  }
+
+  _lock();
+  _path( slot, "tmp", path );
+  remove( path );
+  _path( slot, "bin", path );
+  bool ret = remove( path ) == 0;
+  _unlock();
+
+  if ( ret && ( parameters_getValue( PARAM_PROFILE_ACTIVE ) == slot ) )
+  {
+    parameters_setValue( PARAM_PROFILE_ACTIVE, 0 );
+  }
+
+  return ret;
+}
+
+bool ParamProfile_GetName( uint8_t slot, char* name, size_t size )
+{
+  profile_file_t file;
+
+  if ( !ctx.mounted || !_valid_slot( slot ) )
+  {
+    return false;
+  }
+
+  _lock();
+  bool ret = _read( slot, &file );
+  _unlock();
+
+  if ( ret )
+  {
+    snprintf( name, size, "%s", file.header.name );
+  }
+
+  return ret;
+}
+
+bool ParamProfile_Find( const char* name, uint8_t* slot )
+{
+  char slot_name[PARAM_PROFILE_NAME_MAX];
+
+  for ( uint8_t i = 1; i <= CFG_PROFILE_CNT; i++ )
+  {
+    if ( ParamProfile_GetName( i, slot_name, sizeof( slot_name ) ) && ( strcmp( slot_name, name ) == 0 ) )
+    {
+      *slot = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ParamProfile_Process( void )
+{
+  /* Taken in one step, a command written meanwhile is never cleared unseen */
+  uint32_t slot = ParamStore_Take( PARAM_PROFILE_SAVE );
+  if ( slot != 0 )
+  {
+    ParamProfile_Save( slot, NULL );
+  }
+
+  slot = ParamStore_Take( PARAM_PROFILE_LOAD );
+  if ( slot != 0 )
+  {
+    ParamProfile_Load( slot );
+  }
+}
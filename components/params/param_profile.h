@@ -0,0 +1,38 @@
+#ifndef PARAM_PROFILE_H_
+#define PARAM_PROFILE_H_
+
+#include <stddef.h>
+
+#include "app_config.h"
+#include "parameters.h"
+
+/* Named configuration profiles (recipes) in the SPIFFS storage partition:
+ * valve set, water volume, valve PWM, pulses per liter and tank size.
+ * Slots are 1..CFG_PROFILE_CNT, one file each, written to a temporary file
+ * first and renamed. Entries are keyed by a hash of the parameter name and
+ * the file carries a CRC, so a damaged file or one from a firmware without
+ * some of the parameters never applies garbage. Loading validates the whole
+ * profile and writes it as one snapshot update.
+ * Remote commands are the trigger parameters profile_load and profile_save
+ * with the slot number, profile_active shows the last loaded slot. */
+
+#ifndef PARAM_PROFILE_BASE_PATH
+#define PARAM_PROFILE_BASE_PATH "/storage"
+#endif
+#define PARAM_PROFILE_PARTITION "storage"
+#define PARAM_PROFILE_NAME_MAX  16
+
+bool ParamProfile_Init( void );
+
+/* Current values to the slot, name may be NULL for "profile <slot>" */
+bool ParamProfile_Save( uint8_t slot, const char* name );
+bool ParamProfile_Load( uint8_t slot );
+bool ParamProfile_Delete( uint8_t slot );
+
+bool ParamProfile_GetName( uint8_t slot, char* name, size_t size );
+bool ParamProfile_Find( const char* name, uint8_t* slot );
+
+/* Handles the trigger parameters, called from the controller task */
+void ParamProfile_Process( void );
+
+#endif
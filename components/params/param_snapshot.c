@@ -0,0 +1,161 @@
+#include "param_snapshot.h"
+
+#include <string.h>
+
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "param_store.h"
+
+typedef struct
+{
+  portMUX_TYPE lock;
+  param_snapshot_stats_t stats;
+} param_snapshot_ctx_t;
+
+static param_snapshot_ctx_t ctx =
+  {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t _crc( const param_group_t* group, const uint32_t* values )
+{
+  uint32_t crc = esp_rom_crc32_le( 0, (const uint8_t*) group->params, group->params_cnt * sizeof( group->params[0] ) );
+  return esp_rom_crc32_le( crc, (const uint8_t*) values, group->params_cnt * sizeof( values[0] ) );
+}
+
+/* One seqlock pass over the counters of the group's slots, writes of other
+ * parameters do not disturb it. The values go through the parameters module
+ * which is backed by the store. */
+static bool _try_read( const param_group_t* group, uint32_t* values )
+{
+  uint32_t begun[PARAM_SNAPSHOT_MAX];
+
+  for ( uint8_t i = 0; i < group->params_cnt; i++ )
+  {
+    uint32_t ended = atomic_load( &param_store_writes_ended[group->params[i]] );
+    begun[i] = atomic_load( &param_store_writes_begun[group->params[i]] );
+
+    if ( begun[i] != ended )
+    {
+      return false;
+    }
+  }
+
+  for ( uint8_t i = 0; i < group->params_cnt; i++ )
+  {
+    values[i] = parameters_getValue( group->params[i] );
+  }
+
+  atomic_thread_fence( memory_order_acquire );
+  for ( uint8_t i = 0; i < group->params_cnt; i++ )
+  {
+    if ( atomic_load( &param_store_writes_begun[group->params[i]] ) != begun[i] )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ParamSnapshot_Read( const param_group_t* group, param_snapshot_t* snapshot )
+{
+  assert( group );
+  assert( snapshot );
+
+  uint32_t values[PARAM_SNAPSHOT_MAX];
+  uint32_t tries;
+  bool ret = false;
+
+  for ( tries = 0; tries < PARAM_SNAPSHOT_TRIES; tries++ )
+  {
+    if ( tries >= PARAM_SNAPSHOT_SPINS )
+    {
+      vTaskDelay( 1 );
+    }
+
+    if ( _try_read( group, values ) )
+    {
+      ret = true;
+      break;
+    }
+  }
+
+  if ( ret )
+  {
+    snapshot->group = group;
+    memcpy( snapshot->values, values, group->params_cnt * sizeof( values[0] ) );
+    snapshot->crc = _crc( group, snapshot->values );
+  }
+
+  portENTER_CRITICAL( &ctx.lock );
+  ctx.stats.reads++;
+  ctx.stats.retries += ret ? tries : tries - 1;
+  ctx.stats.failed += ret ? 0 : 1;
+  portEXIT_CRITICAL( &ctx.lock );
+
+  return ret;
+}
+
+void ParamSnapshot_Seal( param_snapshot_t* snapshot )
+{
+  assert( snapshot->group );
+  snapshot->crc = _crc( snapshot->group, snapshot->values );
+}
+
+bool ParamSnapshot_IsValid( const param_snapshot_t* snapshot )
+{
+  return ( snapshot->group != NULL ) && ( snapshot->group->params_cnt <= PARAM_SNAPSHOT_MAX )
+         && ( _crc( snapshot->group, snapshot->values ) == snapshot->crc );
+}
+
+bool ParamSnapshot_Equal( const param_snapshot_t* a, const param_snapshot_t* b )
+{
+  return ( a->group == b->group ) && ( a->crc == b->crc );
+}
+
+bool ParamSnapshot_Restore( const param_snapshot_t* snapshot )
+{
+  bool ret = true;
+
+  if ( !ParamSnapshot_IsValid( snapshot ) )
+  {
+    return false;
+  }
+
+  ParamSnapshot_WriteBegin( snapshot->group );
+  for ( uint8_t i = 0; i < snapshot->group->params_cnt; i++ )
+  {
+    if ( !parameters_setValue( snapshot->group->params[i], snapshot->values[i] ) )
+    {
+      ret = false;
+    }
+  }
+  ParamSnapshot_WriteEnd( snapshot->group );
+
+  return ret;
+}
+
+void ParamSnapshot_WriteBegin( const param_group_t* group )
+{
+  for ( uint8_t i = 0; i < group->params_cnt; i++ )
+  {
+    param_store_write_begin( group->params[i] );
+  }
+}
+
+void ParamSnapshot_WriteEnd( const param_group_t* group )
+{
+  for ( uint8_t i = 0; i < group->params_cnt; i++ )
+  {
+    param_store_write_end( group->params[i] );
+  }
+}
+
+void ParamSnapshot_GetStats( param_snapshot_stats_t* stats )
+{
+  portENTER_CRITICAL( &ctx.lock );
+  *stats = ctx.stats;
+  portEXIT_CRITICAL( &ctx.lock );
+}
@@ -0,0 +1,72 @@
+#ifndef PARAM_SNAPSHOT_H_
+#define PARAM_SNAPSHOT_H_
+
+#include "app_config.h"
+#include "parameters.h"
+
+/* Consistent copies of a group of parameters. Reading is a seqlock on the
+ * per slot write counters of the parameter store: the values are copied and
+ * the copy is retried when a write of one of the group's parameters started
+ * or was in progress meanwhile, so readers never block writers and writes
+ * of other parameters never fail a read. Code changing several fields wraps
+ * the writes in ParamSnapshot_WriteBegin()/End() of the group they belong
+ * to, brackets nest, and readers of any group sharing a parameter with it
+ * never see half of them. A snapshot carries a CRC over the group and the values,
+ * two snapshots of a group are equal when their CRCs are. */
+
+#define PARAM_SNAPSHOT_MAX   12
+#define PARAM_SNAPSHOT_SPINS 4     // retries before yielding to the writer
+#define PARAM_SNAPSHOT_TRIES 16
+
+typedef struct
+{
+  const char* name;
+  const parameter_value_t* params;
+  uint8_t params_cnt;
+} param_group_t;
+
+typedef struct
+{
+  const param_group_t* group;
+  uint32_t crc;
+  uint32_t values[PARAM_SNAPSHOT_MAX];    // in the order of the group
+} param_snapshot_t;
+
+typedef struct
+{
+  uint32_t reads;
+  uint32_t retries;
+  uint32_t failed;
+} param_snapshot_stats_t;
+
+/* PARAM_GROUP_DEFINE(valves, "valves", PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE) */
+#define PARAM_GROUP_DEFINE( _var, _name, ... )                                                   \
+  static const parameter_value_t _var##_params[] = { __VA_ARGS__ };                              \
+  _Static_assert( sizeof( _var##_params ) / sizeof( _var##_params[0] ) <= PARAM_SNAPSHOT_MAX,   \
+                  "group " _name " larger than PARAM_SNAPSHOT_MAX" );                            \
+  static const param_group_t _var =                                                              \
+    {                                                                                            \
+      .name = _name,                                                                             \
+      .params = _var##_params,                                                                   \
+      .params_cnt = sizeof( _var##_params ) / sizeof( _var##_params[0] ),                        \
+  }
+
+/* False when writers kept the group busy for all PARAM_SNAPSHOT_TRIES,
+ * the snapshot is left untouched then */
+bool ParamSnapshot_Read( const param_group_t* group, param_snapshot_t* snapshot );
+
+/* Writes the values back as one update, false when the CRC does not match
+ * or a value was rejected */
+bool ParamSnapshot_Restore( const param_snapshot_t* snapshot );
+
+/* Recomputes the CRC after the values were edited */
+void ParamSnapshot_Seal( param_snapshot_t* snapshot );
+bool ParamSnapshot_IsValid( const param_snapshot_t* snapshot );
+bool ParamSnapshot_Equal( const param_snapshot_t* a, const param_snapshot_t* b );
+
+void ParamSnapshot_WriteBegin( const param_group_t* group );
+void ParamSnapshot_WriteEnd( const param_group_t* group );
+
+void ParamSnapshot_GetStats( param_snapshot_stats_t* stats );
+
+#endif
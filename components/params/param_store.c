@@ -0,0 +1,125 @@
+#include "param_store.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define PARAM( _param, _min, _max, _default, _name ) \
+  _Static_assert( ( _min ) <= ( _default ) && ( _default ) <= ( _max ), _name " default out of range" );
+PARAM_STORE_LIST
+#undef PARAM
+
+_Atomic uint32_t param_store_slots[PARAM_VALUE_TOP];
+_Atomic uint32_t param_store_watched[PARAM_STORE_WORDS];
+_Atomic uint32_t param_store_writes_begun[PARAM_VALUE_TOP];
+_Atomic uint32_t param_store_writes_ended[PARAM_VALUE_TOP];
+
+static const param_store_def_t param_defs[PARAM_VALUE_TOP] =
+  {
+#define PARAM( _param, _min, _max, _default, _name ) [_param] = { _min, _max, _default, _name },
+    PARAM_STORE_LIST
+#undef PARAM
+};
+
+#define PARAM_CLASS_ENTRY( _param, _min, _max, _default, _name, _class ) [_param] = _class,
+#define PARAM_SHARED_CLASS_ENTRY( _param, _class )                         [_param] = _class,
+static const uint8_t param_classes[PARAM_VALUE_TOP] =
+  {
+    PARAMETERS_U32_TABLE( PARAM_CLASS_ENTRY )
+    PARAMETERS_SHARED_CLASS_LIST( PARAM_SHARED_CLASS_ENTRY )
+};
+#undef PARAM_CLASS_ENTRY
+#undef PARAM_SHARED_CLASS_ENTRY
+
+void ParamStore_Init( void )
+{
+  for ( int i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    param_store_write_begin( i );
+    atomic_store_explicit( &param_store_slots[i], param_defs[i].def, memory_order_relaxed );
+    param_store_write_end( i );
+  }
+}
+
+bool ParamStore_Set( parameter_value_t param, uint32_t value )
+{
+  assert( param < PARAM_VALUE_TOP );
+
+  if ( ( param_defs[param].name == NULL ) || ( value < param_defs[param].min ) || ( value > param_defs[param].max ) )
+  {
+    return false;
+  }
+
+  param_store_write_begin( param );
+  uint32_t old = atomic_exchange_explicit( &param_store_slots[param], value, memory_order_relaxed );
+  param_store_write_end( param );
+  param_store_changed( param, old, value );
+  return true;
+}
+
+uint32_t ParamStore_Take( parameter_value_t param )
+{
+  assert( param < PARAM_VALUE_TOP );
+
+  param_store_write_begin( param );
+  uint32_t value = atomic_exchange_explicit( &param_store_slots[param], 0, memory_order_relaxed );
+  param_store_write_end( param );
+  return value;
+}
+
+const param_store_def_t* ParamStore_GetDef( parameter_value_t param )
+{
+  if ( ( param >= PARAM_VALUE_TOP ) || ( param_defs[param].name == NULL ) )
+  {
+    return NULL;
+  }
+
+  return &param_defs[param];
+}
+
+param_class_t ParamStore_GetClass( parameter_value_t param )
+{
+  return param < PARAM_VALUE_TOP ? param_classes[param] : PARAM_RUNTIME;
+}
+
+static uint32_t _fnv( uint32_t hash, const void* data, size_t len )
+{
+  const uint8_t* bytes = data;
+
+  for ( size_t i = 0; i < len; i++ )
+  {
+    hash = ( hash ^ bytes[i] ) * 16777619u;
+  }
+
+  return hash;
+}
+
+uint32_t ParamStore_GetConfigVersion( void )
+{
+  uint32_t hash = 2166136261u;
+
+  for ( int i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( ( param_defs[i].name != NULL ) && ( param_classes[i] == PARAM_CONFIG ) )
+    {
+      hash = _fnv( hash, param_defs[i].name, strlen( param_defs[i].name ) );
+      hash = _fnv( hash, &param_defs[i].min, sizeof( param_defs[i].min ) );
+      hash = _fnv( hash, &param_defs[i].max, sizeof( param_defs[i].max ) );
+    }
+  }
+
+  return hash;
+}
+
+bool ParamStore_Find( const char* name, parameter_value_t* param )
+{
+  for ( int i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    if ( ( param_defs[i].name != NULL ) && ( strcmp( param_defs[i].name, name ) == 0 ) )
+    {
+      *param = i;
+      return true;
+    }
+  }
+
+  return false;
+}
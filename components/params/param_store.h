@@ -0,0 +1,103 @@
+#ifndef PARAM_STORE_H_
+#define PARAM_STORE_H_
+
+#include <stdatomic.h>
+
+#include "app_config.h"
+#include "parameters.h"
+
+/* Parameter values in 32-bit atomic slots generated from the PARAM() list.
+ * Slots are indexed by parameter_value_t, readers and writers never lock.
+ * Every parameter gets an inline getter, e.g.
+ * ParamStore_Get_PARAM_SILOS_HEIGHT(). Writes go through
+ * parameters_setValue(), which on the target keeps the hq copy in step;
+ * ParamStore_Set() is what it calls for the store slot and rejects out of
+ * range values like it. The storage class comes from
+ * PARAMETERS_U32_TABLE and PARAMETERS_SHARED_CLASS_LIST, ids in neither
+ * are runtime values. */
+
+#ifndef PARAM_STORE_LIST
+#define PARAM_STORE_LIST PARAMETERS_U32_LIST
+#endif
+
+typedef struct
+{
+  uint32_t min;
+  uint32_t max;
+  uint32_t def;
+  const char* name;    // NULL for ids not in PARAM_STORE_LIST
+} param_store_def_t;
+
+#define PARAM_STORE_WORDS ( ( PARAM_VALUE_TOP + 31 ) / 32 )
+
+extern _Atomic uint32_t param_store_slots[PARAM_VALUE_TOP];
+/* Parameters with change subscribers, see param_notify.h */
+extern _Atomic uint32_t param_store_watched[PARAM_STORE_WORDS];
+
+/* Writes started and finished per slot, equal when no write of the
+ * parameter is in progress. Snapshot readers retry when the ones of their
+ * group change, see param_snapshot.h */
+extern _Atomic uint32_t param_store_writes_begun[PARAM_VALUE_TOP];
+extern _Atomic uint32_t param_store_writes_ended[PARAM_VALUE_TOP];
+
+static inline void param_store_write_begin( parameter_value_t param )
+{
+  atomic_fetch_add( &param_store_writes_begun[param], 1 );
+  atomic_thread_fence( memory_order_release );
+}
+
+static inline void param_store_write_end( parameter_value_t param )
+{
+  atomic_fetch_add( &param_store_writes_ended[param], 1 );
+}
+
+void ParamNotify_Dispatch( parameter_value_t param, uint32_t old, uint32_t value );
+
+static inline void param_store_changed( parameter_value_t param, uint32_t old, uint32_t value )
+{
+  if ( ( old != value ) && ( atomic_load_explicit( &param_store_watched[param / 32], memory_order_relaxed ) & ( 1u << ( param % 32 ) ) ) )
+  {
+    ParamNotify_Dispatch( param, old, value );
+  }
+}
+
+#define PARAM( _param, _min, _max, _default, _name )                                  \
+  static inline uint32_t ParamStore_Get_##_param( void )                              \
+  {                                                                                   \
+    return atomic_load_explicit( &param_store_slots[_param], memory_order_relaxed );  \
+  }
+PARAM_STORE_LIST
+#undef PARAM
+
+/* All slots to their defaults */
+void ParamStore_Init( void );
+
+static inline uint32_t ParamStore_Get( parameter_value_t param )
+{
+  return atomic_load_explicit( &param_store_slots[param], memory_order_relaxed );
+}
+
+bool ParamStore_Set( parameter_value_t param, uint32_t value );
+
+/* Returns the value and clears the slot in one step, for trigger parameters
+ * which are set remotely and consumed by a task. Clearing does not notify.
+ * On the target the call is wrapped by param_bridge.c, which clears the hq
+ * copy within the same write. */
+uint32_t ParamStore_Take( parameter_value_t param );
+
+const param_store_def_t* ParamStore_GetDef( parameter_value_t param );
+param_class_t ParamStore_GetClass( parameter_value_t param );
+
+/* Only config values go to flash and to a full synchronization */
+static inline bool ParamStore_IsConfig( parameter_value_t param )
+{
+  return ParamStore_GetClass( param ) == PARAM_CONFIG;
+}
+
+/* Hash of the names and limits of the config parameters, changes with the
+ * layout of what is persisted */
+uint32_t ParamStore_GetConfigVersion( void );
+
+bool ParamStore_Find( const char* name, parameter_value_t* param );
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "parameters.h"
 #include "server_controller.h"
+#include "state_machine.h"
 
 #define MODULE_NAME "[Error] "
 #define DEBUG_LVL   PRINT_INFO
@@ -36,23 +37,16 @@ struct error_siewnik_ctx
 
 static struct error_siewnik_ctx ctx;
 
-static char* state_name[] =
-  {
-    [STATE_INIT] = "STATE_INIT",
-    [STATE_IDLE] = "STATE_IDLE",
-    [STATE_WORKING] = "STATE_WORKING",
-    [STATE_WAIT_RESET_ERROR] = "STATE_WAIT_RESET_ERROR",
-};
+STATE_MACHINE_DEFINE( state_machine, "error",
+                      [STATE_INIT] = "INIT",
+                      [STATE_IDLE] = "IDLE",
+                      [STATE_WORKING] = "WORKING",
+                      [STATE_WAIT_RESET_ERROR] = "WAIT_RESET_ERROR" );
 
 static void _change_state( state_t new_state )
 {
-  if ( ctx.state < STATE_TOP )
+  if ( StateMachine_Change( &state_machine, new_state ) )
   {
-    if ( ctx.state != new_state )
-    {
-      LOG( PRINT_INFO, "state %s", state_name[new_state] );
-    }
-
     ctx.state = new_state;
   }
 }
@@ -11,10 +11,12 @@
 #include "measure.h"
 #include "parameters.h"
 #include "parse_cmd.h"
+#include "trace.h"
 #include "ultrasonar.h"
 
 #define MODULE_NAME "[Meas] "
 #define DEBUG_LVL   PRINT_WARNING
+#define TRACE_LVL   PRINT_INFO
 
 #if CONFIG_DEBUG_MEASURE
 #define LOG( _lvl, ... ) \
@@ -62,18 +64,6 @@ static meas_data_t meas_data[MEAS_CH_LAST] =
 static uint32_t table_size;
 static uint32_t table_iter;
 
-static uint32_t filtered_value( uint32_t* tab, uint8_t size )
-{
-  uint16_t ret_val = *tab;
-
-  for ( uint8_t i = 1; i < size; i++ )
-  {
-    ret_val = ( ret_val + tab[i] ) / 2;
-  }
-
-  return ret_val;
-}
-
 void init_measure( void )
 {
 }
@@ -88,13 +78,14 @@ static void _read_adc_values( adc_oneshot_unit_handle_t adc1_handle, adc_oneshot
     {
       int adc_reading = 0;
       ESP_ERROR_CHECK( adc_oneshot_read( meas_data[ch].unit == ADC_UNIT_1 ? adc1_handle : adc2_handle, meas_data[ch].channel, &adc_reading ) );
-      LOG( PRINT_DEBUG, "ADC%d Channel[%d] Raw Data: %d", meas_data[ch].unit + 1, meas_data[ch].channel, adc_reading );
+      TRACE( PRINT_DEBUG, TRACE_ID_MEAS_ADC_RAW, meas_data[ch].unit + 1, meas_data[ch].channel, adc_reading );
       meas_data[ch].adc += adc_reading;
     }
 
     meas_data[ch].adc /= NO_OF_SAMPLES;
     meas_data[ch].filter_table[table_iter % FILTER_TABLE_SIZE] = meas_data[ch].adc;
-    meas_data[ch].filtered_adc = filtered_value( &meas_data[ch].adc, table_size );
+    meas_data[ch].filtered_adc = measure_filter( &meas_data[ch].adc, table_size );
+    TRACE( PRINT_DEBUG, TRACE_ID_MEAS_ADC_AVG, ch, meas_data[ch].adc, meas_data[ch].filtered_adc );
   }
 
   table_iter++;
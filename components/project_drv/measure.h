@@ -32,6 +32,19 @@ typedef enum
   MEAS_CH_LAST
 } enum_meas_ch;
 
+/* Running average step of the ADC filter, inline for the benchmarks */
+static inline uint32_t measure_filter( const uint32_t* tab, uint8_t size )
+{
+  uint16_t ret_val = *tab;
+
+  for ( uint8_t i = 1; i < size; i++ )
+  {
+    ret_val = ( ret_val + tab[i] ) / 2;
+  }
+
+  return ret_val;
+}
+
 void init_measure( void );
 void measure_start( void );
 void measure_meas_calibration_value( void );
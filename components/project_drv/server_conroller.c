@@ -2,15 +2,27 @@
 
 #include "cmd_server.h"
 #include "error_valve.h"
+#include "field_log.h"
+#include "freertos/semphr.h"
 #include "http_server.h"
+#include "latency_trace.h"
 #include "measure.h"
+#include "param_notify.h"
+#include "param_profile.h"
+#include "param_snapshot.h"
+#include "param_store.h"
 #include "parameters.h"
 #include "pwm_drv.h"
 #include "server_controller.h"
+#include "stall_detect.h"
+#include "state_machine.h"
+#include "trace.h"
+#include "trace_states.h"
 #include "water_flow_sensor.h"
 
 #define MODULE_NAME "[Srvr Ctrl] "
 #define DEBUG_LVL   PRINT_INFO
+#define TRACE_LVL   PRINT_INFO
 
 #if CONFIG_DEBUG_SERVER_CONTROLLER
 #define LOG( _lvl, ... ) \
@@ -23,11 +35,7 @@
 
 typedef enum
 {
-  STATE_INIT,
-  STATE_IDLE,
-  STATE_WORKING,
-  STATE_EMERGENCY_DISABLE,
-  STATE_ERROR,
+  SRVR_CTRL_STATE_LIST( STATE_MACHINE_ENUM )
   STATE_LAST,
 } state_t;
 
@@ -48,14 +56,17 @@ typedef struct
   bool errors;
 
   bool water_on;
+  bool water_logged_on;
   uint32_t water_volume_l;
   uint32_t water_read_cl;    // value in centi liter: 1 l = 100 cl
   struct valve_data valves[CFG_VALVE_CNT];
 
   bool working_state_req;
+  uint32_t lat_corr_id;
 
   water_flow_sensor_t water_flow_sensor;
   pwm_drv_t valve_pwm;
+  SemaphoreHandle_t wake;
 } server_controller_ctx;
 
 static server_controller_ctx ctx =
@@ -81,24 +92,38 @@ static server_controller_ctx ctx =
       } }
 };
 
-static char* state_name[] =
-  {
-    [STATE_INIT] = "STATE_INIT",
-    [STATE_IDLE] = "STATE_IDLE",
-    [STATE_WORKING] = "STATE_WORKING",
-    [STATE_EMERGENCY_DISABLE] = "STATE_EMERGENCY_DISABLE",
-    [STATE_ERROR] = "STATE_ERROR" };
+STATE_MACHINE_DEFINE( state_machine, "srvr_ctrl", SRVR_CTRL_STATE_LIST( STATE_MACHINE_NAME ) );
+
+STALL_WATCH_DEFINE( stall_watch, "srvr_ctrl", 5000, &state_machine );
+
+PARAM_SUBSCRIBER_DEFINE( subscriber, "srvr_ctrl", PARAM_FILTER_CHANGE, 0,
+                         PARAM_START_SYSTEM, PARAM_EMERGENCY_DISABLE, PARAM_MACHINE_ERRORS,
+                         PARAM_ADD_WATER, PARAM_WATER_VOL_ADD,
+                         PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE,
+                         PARAM_VALVE_4_STATE, PARAM_VALVE_5_STATE, PARAM_VALVE_7_STATE,
+                         PARAM_PROFILE_LOAD, PARAM_PROFILE_SAVE );
+
+PARAM_GROUP_DEFINE( valves_group, "valves",
+                    PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE, PARAM_VALVE_4_STATE,
+                    PARAM_VALVE_5_STATE, PARAM_VALVE_6_STATE, PARAM_VALVE_7_STATE );
+
+PARAM_GROUP_DEFINE( dosing_group, "dosing",
+                    PARAM_ADD_WATER, PARAM_WATER_VOL_ADD, PARAM_PULSES_PER_LITER );
+
+enum
+{
+  DOSING_ADD_WATER,
+  DOSING_WATER_VOL_ADD,
+  DOSING_PULSES_PER_LITER,
+};
 
 static void change_state( state_t state )
 {
-  if ( state >= STATE_LAST )
-  {
-    return;
-  }
+  state_t prev = ctx.state;
 
-  if ( state != ctx.state )
+  if ( StateMachine_Change( &state_machine, state ) )
   {
-    LOG( PRINT_INFO, "Change state -> %s", state_name[state] );
+    TRACE( PRINT_INFO, TRACE_ID_CTRL_STATE, prev, state );
     ctx.state = state;
   }
 }
@@ -107,23 +132,48 @@ static void count_working_data( void )
 {
 }
 
+static void _on_param_change( parameter_value_t param, uint32_t value, void* arg )
+{
+  xSemaphoreGive( ctx.wake );
+}
+
+/* Poll period, a change of a subscribed parameter ends it early */
+static void _wait_change( uint32_t ms )
+{
+  xSemaphoreTake( ctx.wake, MS2ST( ms ) );
+}
+
+static void _valve_edge_traced( void )
+{
+  if ( ctx.lat_corr_id != 0 )
+  {
+    LatencyTrace_End( ctx.lat_corr_id, LAT_HOP_GPIO_SET );
+    LatencyTrace_Publish( LAT_HOP_GPIO_SET );
+    ctx.lat_corr_id = 0;
+  }
+}
+
 static void _on_valve( struct valve_data* valve )
 {
-  printf( "[VALVE] %d ON\n\r", valve->gpio );
+  TRACE( PRINT_INFO, TRACE_ID_CTRL_VALVE_ON, valve->gpio );
   PWMDrv_SetDuty( &ctx.valve_pwm, (float) parameters_getValue( PARAM_PWM_VALVE ) );
   gpio_set_level( valve->gpio, 1 );
+  _valve_edge_traced();
   osDelay( 20 );
   PWMDrv_SetDuty( &ctx.valve_pwm, 100 );
   osDelay( 80 );
   PWMDrv_SetDuty( &ctx.valve_pwm, (float) parameters_getValue( PARAM_PWM_VALVE ) );
   valve->state = 1;
+  FieldLog_Record( FIELD_LOG_VALVE, valve - ctx.valves, 1 );
 }
 
 static void _off_valve( struct valve_data* valve )
 {
-  printf( "[VALVE] %d OFF\n\r", valve->gpio );
+  TRACE( PRINT_INFO, TRACE_ID_CTRL_VALVE_OFF, valve->gpio );
   gpio_set_level( valve->gpio, 0 );
+  _valve_edge_traced();
   valve->state = 0;
+  FieldLog_Record( FIELD_LOG_VALVE, valve - ctx.valves, 0 );
 }
 
 static void set_working_data( void )
@@ -153,6 +203,21 @@ static void set_working_data( void )
   }
 }
 
+/* One record per add water cycle, however it ended. Called wherever
+ * water_on can drop; leaving for idle keeps the cycle, the valve and the
+ * measurement stay as they are until the controller is back. */
+static void _log_dose( void )
+{
+  if ( ctx.water_on != ctx.water_logged_on )
+  {
+    if ( !ctx.water_on )
+    {
+      FieldLog_Record( FIELD_LOG_DOSE, 0, ctx.water_read_cl );
+    }
+    ctx.water_logged_on = ctx.water_on;
+  }
+}
+
 static void water_flow_event_callback( water_flow_sensor_event_t event, uint32_t value )
 {
   switch ( event )
@@ -170,8 +235,10 @@ static void water_flow_event_callback( water_flow_sensor_event_t event, uint32_t
       break;
 
     default:
-      break;
+      return;
   }
+
+  FieldLog_Record( FIELD_LOG_FLOW, 0, parameters_getValue( PARAM_WATER_FLOW_STATE ) );
 }
 
 static void state_init( void )
@@ -191,6 +258,9 @@ static void state_init( void )
   WaterFlowSensor_Init( &ctx.water_flow_sensor, "valve1", parameters_getValue( PARAM_PULSES_PER_LITER ), water_flow_event_callback, 34 );
   PWMDrv_Init( &ctx.valve_pwm, "valve_pwm", PWM_DRV_DUTY_MODE_LOW, 1000, 0, CFG_VALVE_CURRENT_REGULATION_PIN );
 
+  /* Snapshot readers see the reset as one update */
+  ParamSnapshot_WriteBegin( &valves_group );
+  ParamSnapshot_WriteBegin( &dosing_group );
   parameters_setValue( PARAM_VALVE_1_STATE, 0 );
   parameters_setValue( PARAM_VALVE_2_STATE, 0 );
   parameters_setValue( PARAM_VALVE_3_STATE, 0 );
@@ -204,6 +274,8 @@ static void state_init( void )
   parameters_setValue( PARAM_MACHINE_ERRORS, 0 );
   parameters_setValue( PARAM_START_SYSTEM, 0 );
   parameters_setValue( PARAM_WATER_FLOW_STATE, 0 );
+  ParamSnapshot_WriteEnd( &dosing_group );
+  ParamSnapshot_WriteEnd( &valves_group );
 
   change_state( STATE_IDLE );
 }
@@ -229,7 +301,7 @@ static void state_idle( void )
     return;
   }
 
-  osDelay( 100 );
+  _wait_change( 100 );
 }
 
 static void state_working( void )
@@ -251,21 +323,40 @@ static void state_working( void )
     return;
   }
 
+  uint32_t corr_id = parameters_getValue( PARAM_LAT_CORR_ID );
+  if ( corr_id != ctx.lat_corr_id )
+  {
+    ctx.lat_corr_id = corr_id;
+    LatencyTrace_Mark( corr_id, LAT_HOP_CONTROLLER_READ );
+  }
+
+  /* Valves and dosing are taken as a whole, never half of a remote update */
+  param_snapshot_t valves;
+  param_snapshot_t dosing;
+
+  if ( !ParamSnapshot_Read( &valves_group, &valves ) || !ParamSnapshot_Read( &dosing_group, &dosing ) )
+  {
+    _wait_change( 100 );
+    return;
+  }
+
   for ( int i = 0; i < CFG_VALVE_CNT; i++ )
   {
-    ctx.valves[i].valve_on = parameters_getValue( ctx.valves[i].menu_value );
+    ctx.valves[i].valve_on = valves.values[ctx.valves[i].menu_value - PARAM_VALVE_1_STATE];
   }
 
-  ctx.water_volume_l = parameters_getValue( PARAM_WATER_VOL_ADD );
+  ctx.water_volume_l = dosing.values[DOSING_WATER_VOL_ADD];
 
-  if ( !ctx.water_on && parameters_getValue( PARAM_ADD_WATER ) )
+  if ( !ctx.water_on && dosing.values[DOSING_ADD_WATER] )
   {
     WaterFlowSensor_StartMeasure( &ctx.water_flow_sensor );
     ctx.water_read_cl = 0;
   }
 
-  ctx.water_on = parameters_getValue( PARAM_ADD_WATER );
+  ctx.water_on = dosing.values[DOSING_ADD_WATER];
 
+  ParamSnapshot_WriteBegin( &valves_group );
+  ParamSnapshot_WriteBegin( &dosing_group );
   if ( ctx.water_read_cl >= WATER_FLOW_CONVERT_L_TO_CL( ctx.water_volume_l ) )
   {
     WaterFlowSensor_StopMeasure( &ctx.water_flow_sensor );
@@ -275,11 +366,14 @@ static void state_working( void )
 
   parameters_setValue( PARAM_VALVE_6_STATE, ctx.water_on );
   parameters_setValue( PARAM_WATER_VOL_READ, ctx.water_read_cl );
+  ParamSnapshot_WriteEnd( &dosing_group );
+  ParamSnapshot_WriteEnd( &valves_group );
 
   ctx.water_read_cl = WaterFlowSensor_GetValue( &ctx.water_flow_sensor );
-  WaterFlowSensor_SetPulsesPerLiter( &ctx.water_flow_sensor, parameters_getValue( PARAM_PULSES_PER_LITER ) );
+  WaterFlowSensor_SetPulsesPerLiter( &ctx.water_flow_sensor, dosing.values[DOSING_PULSES_PER_LITER] );
+  _log_dose();
 
-  osDelay( 100 );
+  _wait_change( 100 );
 }
 
 static void state_emergency_disable( void )
@@ -294,6 +388,7 @@ static void state_emergency_disable( void )
   }
 
   ctx.water_on = false;
+  _log_dose();
 
   if ( !ctx.emergency_disable )
   {
@@ -301,7 +396,7 @@ static void state_emergency_disable( void )
     return;
   }
 
-  osDelay( 100 );
+  _wait_change( 100 );
 }
 
 static void state_error( void )
@@ -312,6 +407,7 @@ static void state_error( void )
   }
 
   ctx.water_on = false;
+  _log_dose();
 
   ctx.errors = (bool) parameters_getValue( PARAM_MACHINE_ERRORS );
 
@@ -322,7 +418,7 @@ static void state_error( void )
     return;
   }
 
-  osDelay( 100 );
+  _wait_change( 100 );
 }
 
 static void _task( void* arg )
@@ -330,6 +426,8 @@ static void _task( void* arg )
   parameters_setString( PARAM_STR_CONTROLLER_SN, DevConfig_GetSerialNumber() );
   while ( 1 )
   {
+    StallDetect_Checkin( &stall_watch );
+
     switch ( ctx.state )
     {
       case STATE_INIT:
@@ -359,6 +457,8 @@ static void _task( void* arg )
 
     count_working_data();
     set_working_data();
+
+    ParamProfile_Process();
   }
 }
 
@@ -374,6 +474,8 @@ bool srvrControllGetEmergencyDisable( void )
 
 void srvrControllStart( void )
 {
+  ctx.wake = xSemaphoreCreateBinary();
+  ParamNotify_Subscribe( &subscriber, _on_param_change, NULL );
   xTaskCreate( _task, "srvrController", 4096, NULL, 10, NULL );
 }
 
@@ -34,6 +34,10 @@
 
 #define CFG_VALVE_CNT                    7
 #define CFG_VALVE_CURRENT_REGULATION_PIN 27
+#define CFG_PROFILE_CNT                  8
+
+#define MENU_TARGET_FPS      20
+#define MENU_IDLE_REFRESH_MS 250
 
 #ifndef NULL
 #define NULL 0
@@ -73,6 +77,22 @@
 #define CONFIG_DEBUG_SERVER_CONTROLLER TRUE
 #define CONFIG_DEBUG_MENU_BACKEND      TRUE
 #define CONFIG_DEBUG_SLEEP             TRUE
+#define CONFIG_DEBUG_TASK_STATS        TRUE
+#define CONFIG_DEBUG_HEAP_PROF         TRUE
+#define CONFIG_DEBUG_STATE_MACHINE     TRUE
+#define CONFIG_DEBUG_STALL_DETECT      TRUE
+#define CONFIG_DEBUG_PARAM_PERSIST     TRUE
+#define CONFIG_DEBUG_PARAM_PROFILE     TRUE
+#define CONFIG_DEBUG_FIELD_LOG         TRUE
+#define CONFIG_DEBUG_LOG_STREAM        TRUE
+#define CONFIG_DEBUG_BOOT_TIME         TRUE
+
+// Binary trace ring, see components/diag/trace.h
+#define CONFIG_TRACE_ENABLE  TRUE
+#define CONFIG_TRACE_RECORDS 512
+
+// Live allocations tracked per module, see components/diag/heap_prof.h
+#define CONFIG_HEAP_PROF_SLOTS 512
 
 /////////////////////  CONFIG PERIPHERALS  ////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -99,6 +119,10 @@
 #define MS2ST( ms )   pdMS_TO_TICKS( ms )
 #define ST2MS( tick ) ( ( tick ) * portTICK_PERIOD_MS )
 
+/* Tick deadline check that survives the tick counter wrapping around,
+ * valid while now and deadline are less than half the tick range apart */
+#define TICK_IS_ELAPSED( now, deadline ) ( (int32_t) ( ( now ) - ( deadline ) ) >= 0 )
+
 #define osDelay( ms )       vTaskDelay( MS2ST( ms ) )
 #define debug_printf( ... ) DevConfig_Printf( __VA_ARGS__ )
 
@@ -2,6 +2,7 @@
 
 #include "app_config.h"
 #include "battery.h"
+#include "boot_time.h"
 #include "but.h"
 #include "buzzer.h"
 #include "cmd_client.h"
@@ -13,35 +14,49 @@
 #include "error_valve.h"
 #include "esp_attr.h"
 #include "esp_sleep.h"
+#include "energy.h"
 #include "esp_system.h"
 #include "fast_add.h"
+#include "field_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "heap_prof.h"
+#include "init_graph.h"
 #include "http_parameters_client.h"
 #include "http_server.h"
 #include "intf/i2c/ssd1306_i2c.h"
 #include "keepalive.h"
+#include "log_stream.h"
 #include "measure.h"
 #include "menu_backend.h"
 #include "menu_drv.h"
 #include "nvs_flash.h"
 #include "oled.h"
 #include "ota_drv.h"
+#include "param_bridge.h"
+#include "param_persist.h"
+#include "param_profile.h"
+#include "param_store.h"
 #include "parameters.h"
 #include "parameters_api.h"
 #include "pcf8574.h"
 #include "power_on.h"
 #include "server_controller.h"
 #include "sleep_e.h"
+#include "stall_detect.h"
 #include "ssd1306.h"
+#include "task_stats.h"
 #include "wifidrv.h"
 
+#define INIT_TASK_STACK 4096
+
 extern void ultrasonar_start( void );
 
 static gpio_config_t io_conf;
 static uint32_t blink_pin = GPIO_NUM_23;
 portMUX_TYPE portMux = portMUX_INITIALIZER_UNLOCKED;
 static uint8_t wifi_type;
+static bool battery_ok;
 
 static bool check_i2c_communication( void )
 {
@@ -86,9 +101,15 @@ static void checkDevType( void )
 
 void app_init( void )
 {
+  BootTime_Mark( "app_main" );
   nvs_flash_init();
+  BootTime_Mark( "nvs" );
   DevConfig_Init();
+
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_OTA );
   OTA_Init();
+  HeapProf_ScopeExit( heap_scope );
+  BootTime_Mark( "ota" );
 }
 
 static void _toggle_emergency_disable( void )
@@ -96,57 +117,178 @@ static void _toggle_emergency_disable( void )
   backendToggleEmergencyDisable();
 }
 
-static void _init_remote_controller( void )
+/* Remote controller: the display and the backend come up while the battery
+ * is measured, Wi-Fi with the menu once the battery is known to be good.
+ * The display and the pcf8574 share the I2C bus, the LEDs wait for the
+ * display. */
+typedef enum
+{
+  REMOTE_PERSIST,
+  REMOTE_DISPLAY,
+  REMOTE_BACKEND,
+  REMOTE_BATTERY,
+  REMOTE_IO,
+  REMOTE_POWER,
+  REMOTE_MENU,
+  REMOTE_WIFI,
+  REMOTE_HTTP_CLIENT,
+  REMOTE_KEEP_ALIVE,
+  REMOTE_DICTIONARY,
+  REMOTE_TASKS,
+  REMOTE_STEPS,
+} remote_step_t;
+
+/* Values from flash before anything uses them, flushed again at restart */
+static void _persist( void )
+{
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_PARAMETERS );
+  ParamPersist_Start();
+  HeapProf_ScopeExit( heap_scope );
+}
+
+static void _remote_battery( void )
 {
-  graphic_init();
-  menuBackendInit();
   battery_init();
+}
+
+static void _remote_io( void )
+{
   init_leds();
   osDelay( 10 );
 
   buzzer_init();
   power_on_init();
+}
 
+static void _remote_power( void )
+{
   /* Wait to measure voltage */
   while ( !battery_is_measured() )
   {
     osDelay( 10 );
   }
 
-  float voltage = battery_get_voltage();
+  battery_ok = battery_get_voltage() > 3.2;
   power_on_enable_system();
   init_buttons();
+}
 
-  if ( voltage > 3.2 )
+static void _remote_menu( void )
+{
+  menuDrvInit( battery_ok ? MENU_DRV_NORMAL_INIT : MENU_DRV_LOW_BATTERY_INIT, _toggle_emergency_disable );
+}
+
+static void _remote_wifi( void )
+{
+  if ( battery_ok )
   {
-    menuDrvInit( MENU_DRV_NORMAL_INIT, _toggle_emergency_disable );
+    heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_WIFIDRV );
     wifiDrvInit();
+    HeapProf_ScopeExit( heap_scope );
+  }
+}
+
+static void _remote_http_client( void )
+{
+  if ( battery_ok )
+  {
+    heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_HTTP_CLIENT );
     HTTPParamClient_Init();
+    HeapProf_ScopeExit( heap_scope );
+  }
+}
+
+static void _remote_keep_alive( void )
+{
+  if ( battery_ok )
+  {
     keepAliveStartTask();
+  }
+}
+
+static void _remote_dictionary( void )
+{
+  if ( battery_ok )
+  {
     dictionary_init();
-    fastProcessStartTask();
-    power_on_start_task();
-    // init_sleep();
   }
-  else
+}
+
+static void _remote_tasks( void )
+{
+  if ( !battery_ok )
   {
-    menuDrvInit( MENU_DRV_LOW_BATTERY_INIT, _toggle_emergency_disable );
+    ParamPersist_Flush();
     power_on_disable_system();
+    return;
   }
+
+  fastProcessStartTask();
+  power_on_start_task();
+  TaskStats_Start( false );
+  StallDetect_Start();
+  Energy_Start();
+  Energy_SetOn( ENERGY_LOAD_DISPLAY, true );
+  // init_sleep();
 }
 
-static void _init_server_controller( void )
+static void _init_remote_controller( void )
 {
-  wifiDrvInit();
+  init_step_t steps[REMOTE_STEPS] =
+    {
+      [REMOTE_PERSIST] = { "persist", _persist, 0, INIT_TASK_STACK },
+      [REMOTE_DISPLAY] = { "display", graphic_init, 0, INIT_TASK_STACK },
+      [REMOTE_BACKEND] = { "backend", menuBackendInit, INIT_AFTER( REMOTE_PERSIST ), INIT_TASK_STACK },
+      [REMOTE_BATTERY] = { "battery", _remote_battery, 0, 0 },
+      [REMOTE_IO] = { "io", _remote_io, INIT_AFTER( REMOTE_DISPLAY ), 0 },
+      [REMOTE_POWER] = { "power", _remote_power, INIT_AFTER( REMOTE_BATTERY ) | INIT_AFTER( REMOTE_IO ), 0 },
+      [REMOTE_MENU] = { "menu", _remote_menu, INIT_AFTER( REMOTE_DISPLAY ) | INIT_AFTER( REMOTE_BACKEND ) | INIT_AFTER( REMOTE_POWER ), 0 },
+      [REMOTE_WIFI] = { "wifi", _remote_wifi, INIT_AFTER( REMOTE_POWER ), INIT_TASK_STACK },
+      [REMOTE_HTTP_CLIENT] = { "http_client", _remote_http_client, INIT_AFTER( REMOTE_WIFI ), 0 },
+      [REMOTE_KEEP_ALIVE] = { "keep_alive", _remote_keep_alive, INIT_AFTER( REMOTE_HTTP_CLIENT ), 0 },
+      [REMOTE_DICTIONARY] = { "dictionary", _remote_dictionary, INIT_AFTER( REMOTE_MENU ), 0 },
+      [REMOTE_TASKS] = { "tasks", _remote_tasks, INIT_AFTER( REMOTE_KEEP_ALIVE ) | INIT_AFTER( REMOTE_DICTIONARY ), 0 },
+    };
 
-  keepAliveStartTask();
-  measure_start();
-  srvrControllStart();
-  ultrasonar_start();
-  //WYLACZONE
+  InitGraph_Run( steps, REMOTE_STEPS );
+}
+
+/* Server controller: the persisted values first, then Wi-Fi and the
+ * storage partition side by side, the controller starts on the profiles
+ * and the servers on both */
+typedef enum
+{
+  SERVER_PERSIST,
+  SERVER_WIFI,
+  SERVER_STORAGE,
+  SERVER_MEASURE,
+  SERVER_CONTROLLER,
+  SERVER_SONAR,
+  SERVER_ERRORS,
+  SERVER_LED,
+  SERVER_KEEP_ALIVE,
+  SERVER_HTTP_SERVER,
+  SERVER_DIAG,
+  SERVER_STEPS,
+} server_step_t;
 
-  errorStart();
+static void _server_wifi( void )
+{
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_WIFIDRV );
+  wifiDrvInit();
+  HeapProf_ScopeExit( heap_scope );
+}
 
+static void _server_storage( void )
+{
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_PARAMETERS );
+  ParamProfile_Init();
+  HeapProf_ScopeExit( heap_scope );
+  FieldLog_Start();
+}
+
+static void _server_led( void )
+{
   //LED on
   io_conf.intr_type = GPIO_INTR_DISABLE;
   io_conf.mode = GPIO_MODE_OUTPUT;
@@ -155,15 +297,67 @@ static void _init_server_controller( void )
   io_conf.pull_up_en = 0;
   gpio_config( &io_conf );
   gpio_set_level( blink_pin, 1 );
+}
+
+static void _server_http_server( void )
+{
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_HTTP_SERVER );
   HTTPServer_Init();
   ParametersAPI_Init();
+  LogStream_StartServer();
+  HeapProf_ScopeExit( heap_scope );
+}
+
+static void _server_keep_alive( void )
+{
+  keepAliveStartTask();
+}
+
+static void _server_diag( void )
+{
+  TaskStats_Start( true );
+  StallDetect_Start();
+}
+
+static void _init_server_controller( void )
+{
+  init_step_t steps[SERVER_STEPS] =
+    {
+      [SERVER_PERSIST] = { "persist", _persist, 0, INIT_TASK_STACK },
+      [SERVER_WIFI] = { "wifi", _server_wifi, INIT_AFTER( SERVER_PERSIST ), INIT_TASK_STACK },
+      [SERVER_STORAGE] = { "storage", _server_storage, INIT_AFTER( SERVER_PERSIST ), INIT_TASK_STACK },
+      [SERVER_MEASURE] = { "measure", measure_start, 0, 0 },
+      [SERVER_CONTROLLER] = { "controller", srvrControllStart, INIT_AFTER( SERVER_PERSIST ) | INIT_AFTER( SERVER_STORAGE ) | INIT_AFTER( SERVER_MEASURE ), 0 },
+      [SERVER_SONAR] = { "sonar", ultrasonar_start, 0, 0 },    //WYLACZONE
+      [SERVER_ERRORS] = { "errors", errorStart, INIT_AFTER( SERVER_CONTROLLER ), 0 },
+      [SERVER_LED] = { "led", _server_led, 0, 0 },
+      [SERVER_KEEP_ALIVE] = { "keep_alive", _server_keep_alive, INIT_AFTER( SERVER_WIFI ), 0 },
+      [SERVER_HTTP_SERVER] = { "http_server", _server_http_server, INIT_AFTER( SERVER_WIFI ) | INIT_AFTER( SERVER_STORAGE ), 0 },
+      [SERVER_DIAG] = { "diag", _server_diag, INIT_AFTER( SERVER_ERRORS ) | INIT_AFTER( SERVER_SONAR ) | INIT_AFTER( SERVER_LED ) | INIT_AFTER( SERVER_KEEP_ALIVE ) | INIT_AFTER( SERVER_HTTP_SERVER ), 0 },
+    };
+
+  InitGraph_Run( steps, SERVER_STEPS );
 }
 
 void MainApp_Start( void )
 {
   app_init();
   checkDevType();
+  BootTime_Mark( "dev_type" );
+
+  /* parameters_init() sets up hq every boot, the persisted values come on
+   * top of it from one read of the image, from the per parameter keys only
+   * when the image is missing or stale */
+  heap_mod_t heap_scope = HeapProf_ScopeEnter( HEAP_MOD_PARAMETERS );
   parameters_init();
+  ParamBridge_Sync();
+  bool image = ParamPersist_LoadImage();
+  if ( !image )
+  {
+    ParamPersist_Load();
+  }
+  HeapProf_ScopeExit( heap_scope );
+  BootTime_Mark( image ? "parameters image" : "parameters keys" );
 
   if ( wifi_type != T_WIFI_TYPE_SERVER )
   {
@@ -173,6 +367,7 @@ void MainApp_Start( void )
   {
     _init_server_controller();
   }
+  BootTime_Ready( wifi_type == T_WIFI_TYPE_SERVER ? "server" : "remote" );
 
   DevConfig_Printf( PRINT_DEBUG, PRINT_DEBUG, "[MENU] ------------START SYSTEM-------------" );
   DevConfig_Printf( PRINT_DEBUG, PRINT_DEBUG, "[MENU] SN %s", DevConfig_GetSerialNumber() );
@@ -18,32 +18,92 @@
 
 /* Public types --------------------------------------------------------------*/
 
-/* PARAM(param, min_value, max_value, default_value, name) */
-
-#define PARAMETERS_U32_LIST                                                      \
-  PARAM( PARAM_VALVE_1_STATE, 0, 1, 0, "v1" )                                    \
-  PARAM( PARAM_VALVE_2_STATE, 0, 1, 0, "v2" )                                    \
-  PARAM( PARAM_VALVE_3_STATE, 0, 1, 0, "v3" )                                    \
-  PARAM( PARAM_VALVE_4_STATE, 0, 1, 0, "v4" )                                    \
-  PARAM( PARAM_VALVE_5_STATE, 0, 1, 0, "v5" )                                    \
-  PARAM( PARAM_VALVE_6_STATE, 0, 1, 0, "v6" )                                    \
-  PARAM( PARAM_VALVE_7_STATE, 0, 1, 0, "v7" )                                    \
-  PARAM( PARAM_ADD_WATER, 0, 1, 0, "add_water" )                                 \
-  PARAM( PARAM_WATER_VOL_ADD, 0, UINT16_MAX, 100, "water_volume_add" )           \
-  PARAM( PARAM_WATER_VOL_READ, 0, 10000, 0, "water_volume_read" )                \
-  PARAM( PARAM_VOLTAGE_ACCUM, 0, UINT32_MAX, 0, "voltage_accum" )                \
-  PARAM( PARAM_START_SYSTEM, 0, 1, 0, "start_system" )                           \
-  PARAM( PARAM_SILOS_LEVEL, 0, 100, 0, "silos_lvl" )                             \
-  PARAM( PARAM_SILOS_SENSOR_IS_CONNECTED, 0, 1, 0, "silos_sensor_is_connected" ) \
-  PARAM( PARAM_SILOS_HEIGHT, 0, 300, 60, "silos_height" )                        \
-  PARAM( PARAM_LOW_LEVEL_SILOS, 0, 1, 0, "low_level_silos" )                     \
-  PARAM( PARAM_LANGUAGE, 0, 3, 0, "language" )                                   \
-  PARAM( PARAM_PULSES_PER_LITER, 10, 10000, 100, "pulses_per_liter" )            \
-  PARAM( PARAM_PWM_VALVE, 30, 100, 50, "pwm_valve" )                             \
-  PARAM( PARAM_TANK_SIZE, 100, 8000, 150, "tank_size" )                          \
-                                                                                 \
-  /* ERRORS */                                                                   \
-  PARAM( PARAM_MACHINE_ERRORS, 0, UINT32_MAX, 0, "machine_errors" )              \
-  PARAM( PARAM_WATER_FLOW_STATE, 0, 10, 0, "water_flow_state" )
+typedef enum
+{
+  PARAM_RUNTIME,
+  PARAM_CONFIG,
+} param_class_t;
+
+/* PARAM(param, min_value, max_value, default_value, name)
+ *
+ * PARAMETERS_U32_TABLE entries carry the storage class as well,
+ * _P(param, min_value, max_value, default_value, name, class):
+ * PARAM_CONFIG values are persisted, versioned and synchronized,
+ * PARAM_RUNTIME values (telemetry, commands, triggers) only live in RAM.
+ * PARAMETERS_U32_LIST is the same table with PARAM() entries. */
+
+#define PARAMETERS_U32_TABLE( _P )                                                           \
+  _P( PARAM_VALVE_1_STATE, 0, 1, 0, "v1", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_2_STATE, 0, 1, 0, "v2", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_3_STATE, 0, 1, 0, "v3", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_4_STATE, 0, 1, 0, "v4", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_5_STATE, 0, 1, 0, "v5", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_6_STATE, 0, 1, 0, "v6", PARAM_RUNTIME )                                    \
+  _P( PARAM_VALVE_7_STATE, 0, 1, 0, "v7", PARAM_RUNTIME )                                    \
+  _P( PARAM_ADD_WATER, 0, 1, 0, "add_water", PARAM_RUNTIME )                                 \
+  _P( PARAM_WATER_VOL_ADD, 0, UINT16_MAX, 100, "water_volume_add", PARAM_RUNTIME )           \
+  _P( PARAM_WATER_VOL_READ, 0, 10000, 0, "water_volume_read", PARAM_RUNTIME )                \
+  _P( PARAM_VOLTAGE_ACCUM, 0, UINT32_MAX, 0, "voltage_accum", PARAM_RUNTIME )                \
+  _P( PARAM_START_SYSTEM, 0, 1, 0, "start_system", PARAM_RUNTIME )                           \
+  _P( PARAM_SILOS_LEVEL, 0, 100, 0, "silos_lvl", PARAM_RUNTIME )                             \
+  _P( PARAM_SILOS_SENSOR_IS_CONNECTED, 0, 1, 0, "silos_sensor_is_connected", PARAM_RUNTIME ) \
+  _P( PARAM_SILOS_HEIGHT, 0, 300, 60, "silos_height", PARAM_CONFIG )                         \
+  _P( PARAM_LOW_LEVEL_SILOS, 0, 1, 0, "low_level_silos", PARAM_RUNTIME )                     \
+  _P( PARAM_LANGUAGE, 0, 3, 0, "language", PARAM_CONFIG )                                    \
+  _P( PARAM_PULSES_PER_LITER, 10, 10000, 100, "pulses_per_liter", PARAM_CONFIG )             \
+  _P( PARAM_PWM_VALVE, 30, 100, 50, "pwm_valve", PARAM_CONFIG )                              \
+  _P( PARAM_TANK_SIZE, 100, 8000, 150, "tank_size", PARAM_CONFIG )                           \
+  _P( PARAM_PROFILE_LOAD, 0, CFG_PROFILE_CNT, 0, "profile_load", PARAM_RUNTIME )             \
+  _P( PARAM_PROFILE_SAVE, 0, CFG_PROFILE_CNT, 0, "profile_save", PARAM_RUNTIME )             \
+  _P( PARAM_PROFILE_ACTIVE, 0, CFG_PROFILE_CNT, 0, "profile_active", PARAM_RUNTIME )         \
+                                                                                             \
+  /* LATENCY */                                                                              \
+  _P( PARAM_LAT_CORR_ID, 0, UINT32_MAX, 0, "lat_corr_id", PARAM_RUNTIME )                    \
+  _P( PARAM_LAT_COUNT, 0, UINT32_MAX, 0, "lat_count", PARAM_RUNTIME )                        \
+  _P( PARAM_LAT_P50_US, 0, UINT32_MAX, 0, "lat_p50_us", PARAM_RUNTIME )                      \
+  _P( PARAM_LAT_P99_US, 0, UINT32_MAX, 0, "lat_p99_us", PARAM_RUNTIME )                      \
+  _P( PARAM_LAT_MAX_US, 0, UINT32_MAX, 0, "lat_max_us", PARAM_RUNTIME )                      \
+  _P( PARAM_TRACE_DUMP, 0, 1, 0, "trace_dump", PARAM_RUNTIME )                               \
+                                                                                             \
+  /* TASK STATS */                                                                           \
+  _P( PARAM_DIAG_CPU_LOAD, 0, 1000, 0, "diag_cpu_load", PARAM_RUNTIME )                      \
+  _P( PARAM_DIAG_MIN_STACK, 0, UINT32_MAX, 0, "diag_min_stack", PARAM_RUNTIME )              \
+  _P( PARAM_DIAG_TASK_CNT, 0, UINT32_MAX, 0, "diag_task_cnt", PARAM_RUNTIME )                \
+  _P( PARAM_DIAG_TASK_SEL, 0, UINT32_MAX, 0, "diag_task_sel", PARAM_RUNTIME )                \
+  _P( PARAM_DIAG_TASK_TAG, 0, UINT32_MAX, 0, "diag_task_tag", PARAM_RUNTIME )                \
+  _P( PARAM_DIAG_TASK_CPU, 0, 1000, 0, "diag_task_cpu", PARAM_RUNTIME )                      \
+  _P( PARAM_DIAG_TASK_STACK, 0, UINT32_MAX, 0, "diag_task_stack", PARAM_RUNTIME )            \
+  _P( PARAM_DIAG_TASK_BLOCKED, 0, 100, 0, "diag_task_blocked", PARAM_RUNTIME )               \
+  _P( PARAM_DIAG_PRINT, 0, 1, 0, "diag_print", PARAM_RUNTIME )                               \
+  _P( PARAM_HEAP_FREE, 0, UINT32_MAX, 0, "heap_free", PARAM_RUNTIME )                        \
+  _P( PARAM_HEAP_MIN_FREE, 0, UINT32_MAX, 0, "heap_min_free", PARAM_RUNTIME )                \
+  _P( PARAM_HEAP_LARGEST, 0, UINT32_MAX, 0, "heap_largest", PARAM_RUNTIME )                  \
+  _P( PARAM_HEAP_WATERMARK, 0, UINT32_MAX, 30000, "heap_watermark", PARAM_CONFIG )           \
+  _P( PARAM_HEAP_PRINT, 0, 1, 0, "heap_print", PARAM_RUNTIME )                               \
+  _P( PARAM_LINK_PRINT, 0, 1, 0, "link_print", PARAM_RUNTIME )                               \
+  _P( PARAM_STALL_COUNT, 0, UINT32_MAX, 0, "stall_count", PARAM_RUNTIME )                    \
+  _P( PARAM_STALL_PRINT, 0, 1, 0, "stall_print", PARAM_RUNTIME )                             \
+  _P( PARAM_STALL_CLEAR, 0, 1, 0, "stall_clear", PARAM_RUNTIME )                             \
+  _P( PARAM_BATTERY_CAPACITY, 100, 10000, 2000, "battery_mah", PARAM_CONFIG )                \
+  _P( PARAM_ENERGY_USED_MAH, 0, UINT32_MAX, 0, "energy_used_mah", PARAM_RUNTIME )            \
+  _P( PARAM_ENERGY_AVG_UA, 0, UINT32_MAX, 0, "energy_avg_ua", PARAM_RUNTIME )                \
+  _P( PARAM_ENERGY_REMAINING_MIN, 0, UINT32_MAX, 0, "energy_remaining_min", PARAM_RUNTIME )  \
+  _P( PARAM_ENERGY_PRINT, 0, 1, 0, "energy_print", PARAM_RUNTIME )                           \
+  _P( PARAM_BOOT_READY_MS, 0, UINT32_MAX, 0, "boot_ready_ms", PARAM_RUNTIME )                \
+                                                                                             \
+  /* ERRORS */                                                                               \
+  _P( PARAM_MACHINE_ERRORS, 0, UINT32_MAX, 0, "machine_errors", PARAM_RUNTIME )              \
+  _P( PARAM_WATER_FLOW_STATE, 0, 10, 0, "water_flow_state", PARAM_RUNTIME )
+
+/* Storage class of the parameters owned by the shared drivers */
+#define PARAMETERS_SHARED_CLASS_LIST( _C )         \
+  _C( PARAM_EMERGENCY_DISABLE, PARAM_RUNTIME ) \
+  _C( PARAM_BRIGHTNESS, PARAM_CONFIG )         \
+  _C( PARAM_BUZZER, PARAM_CONFIG )             \
+  _C( PARAM_BOOT_UP_SYSTEM, PARAM_CONFIG )     \
+  _C( PARAM_POWER_ON_MIN, PARAM_CONFIG )
+
+#define PARAM_DROP_CLASS( _param, _min, _max, _default, _name, _class ) PARAM( _param, _min, _max, _default, _name )
+#define PARAMETERS_U32_LIST PARAMETERS_U32_TABLE( PARAM_DROP_CLASS )
 
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*
+ * Host run of the micro benchmarks in components/bench, the target runs the
+ * same cases from the unit test app.
+ *
+ * usage: bench [-o out.json] [-n iterations] [case]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "dictionary.h"
+#include "parameters.h"
+
+#define DEFAULT_ITERATIONS 100000
+
+static void _write_line( const char* line, void* arg )
+{
+  fprintf( arg, "%s\n", line );
+}
+
+int main( int argc, char** argv )
+{
+  uint32_t iterations = DEFAULT_ITERATIONS;
+  const char* out_path = NULL;
+  FILE* out = stdout;
+  int opt;
+
+  while ( ( opt = getopt( argc, argv, "o:n:" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'o':
+        out_path = optarg;
+        break;
+
+      case 'n':
+        iterations = strtoul( optarg, NULL, 0 );
+        break;
+
+      default:
+        fprintf( stderr, "usage: %s [-o out.json] [-n iterations] [case]\n", argv[0] );
+        return 2;
+    }
+  }
+
+  if ( out_path != NULL )
+  {
+    out = fopen( out_path, "w" );
+    if ( out == NULL )
+    {
+      fprintf( stderr, "cannot write '%s'\n", out_path );
+      return 2;
+    }
+  }
+
+  parameters_init();
+  dictionary_init();
+
+  uint32_t count;
+  const bench_case_t* cases = Bench_GetCases( &count );
+  bool ret = Bench_Run( cases, count, optind < argc ? argv[optind] : NULL, iterations, _write_line, out );
+
+  if ( out != stdout )
+  {
+    fclose( out );
+  }
+
+  if ( !ret )
+  {
+    fprintf( stderr, "no benchmark ran\n" );
+    return 1;
+  }
+
+  return 0;
+}
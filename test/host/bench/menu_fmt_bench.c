@@ -0,0 +1,188 @@
+/*
+ * Compares MenuFmt against snprintf for the patterns used by the menu render
+ * loops. Every value is checked for identical output before timing.
+ *
+ * usage: menu_fmt_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "menu_fmt.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+static volatile char sink;
+static uint32_t truncated;    // snprintf() calls which did not fit
+
+typedef enum
+{
+  PATTERN_LITERS,
+  PATTERN_FIXED,
+  PATTERN_SIGNED,
+  PATTERN_TOP,
+} pattern_t;
+
+static const char* pattern_name[] =
+  {
+    [PATTERN_LITERS] = "\"%lu [l]\"",
+    [PATTERN_FIXED] = "\"%s:      %.2f %s\"",
+    [PATTERN_SIGNED] = "\"%s:      %ld %s\"",
+};
+
+static uint64_t _now_ns( void )
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void _with_snprintf( pattern_t pattern, int32_t value, char* buff, uint32_t size )
+{
+  int len = 0;
+
+  switch ( pattern )
+  {
+    case PATTERN_LITERS:
+      len = snprintf( buff, size, "%lu [l]", (unsigned long) (uint32_t) value );
+      break;
+
+    case PATTERN_FIXED:
+      len = snprintf( buff, size, "%s:      %.2f %s", "Voltage", (double) value / 100.0, "V" );
+      break;
+
+    case PATTERN_SIGNED:
+      len = snprintf( buff, size, "%s:      %ld %s", "Signal", (long) value, "dBm" );
+      break;
+
+    default:
+      break;
+  }
+
+  truncated += len >= (int) size;
+}
+
+static void _with_menu_fmt( pattern_t pattern, int32_t value, char* buff, uint32_t size )
+{
+  menu_fmt_t fmt;
+  MenuFmt_Init( &fmt, buff, size );
+
+  switch ( pattern )
+  {
+    case PATTERN_LITERS:
+      MenuFmt_U32( &fmt, value );
+      MenuFmt_Str( &fmt, " [l]" );
+      break;
+
+    case PATTERN_FIXED:
+      MenuFmt_Str( &fmt, "Voltage" );
+      MenuFmt_Str( &fmt, ":      " );
+      MenuFmt_Fixed( &fmt, value, 2 );
+      MenuFmt_Char( &fmt, ' ' );
+      MenuFmt_Str( &fmt, "V" );
+      break;
+
+    case PATTERN_SIGNED:
+      MenuFmt_Str( &fmt, "Signal" );
+      MenuFmt_Str( &fmt, ":      " );
+      MenuFmt_I32( &fmt, value );
+      MenuFmt_Char( &fmt, ' ' );
+      MenuFmt_Str( &fmt, "dBm" );
+      break;
+
+    default:
+      break;
+  }
+}
+
+static int32_t _value( pattern_t pattern, uint32_t i )
+{
+  switch ( pattern )
+  {
+    case PATTERN_LITERS:
+      return i % 100000;
+
+    case PATTERN_FIXED:
+      /* stays exact in binary so %.2f has no rounding to disagree on */
+      return ( i % 2000 ) * 25 - 10000;
+
+    default:
+      return (int32_t) ( i * 2654435761u );
+  }
+}
+
+static bool _check( pattern_t pattern, uint32_t iterations )
+{
+  char expected[64];
+  char actual[64];
+
+  for ( uint32_t i = 0; i < iterations; i++ )
+  {
+    int32_t value = _value( pattern, i );
+    _with_snprintf( pattern, value, expected, sizeof( expected ) );
+    _with_menu_fmt( pattern, value, actual, sizeof( actual ) );
+
+    if ( strcmp( expected, actual ) != 0 )
+    {
+      fprintf( stderr, "%s: value %d expected '%s' got '%s'\n", pattern_name[pattern], value, expected, actual );
+      return false;
+    }
+  }
+
+  /* truncation keeps the prefix and the terminator, like snprintf */
+  uint32_t was_truncated = truncated;
+  _with_snprintf( pattern, _value( pattern, 12345 ), expected, 6 );
+  _with_menu_fmt( pattern, _value( pattern, 12345 ), actual, 6 );
+  if ( ( truncated == was_truncated ) || ( strcmp( expected, actual ) != 0 ) )
+  {
+    fprintf( stderr, "%s: truncated expected '%s' got '%s'\n", pattern_name[pattern], expected, actual );
+    return false;
+  }
+
+  return true;
+}
+
+static uint64_t _time( void ( *format )( pattern_t, int32_t, char*, uint32_t ), pattern_t pattern, uint32_t iterations )
+{
+  char buff[64];
+  uint64_t start = _now_ns();
+
+  for ( uint32_t i = 0; i < iterations; i++ )
+  {
+    format( pattern, _value( pattern, i ), buff, sizeof( buff ) );
+    sink = buff[0];
+  }
+
+  return _now_ns() - start;
+}
+
+int main( int argc, char** argv )
+{
+  uint32_t iterations = argc > 1 ? strtoul( argv[1], NULL, 0 ) : DEFAULT_ITERATIONS;
+
+  if ( iterations == 0 )
+  {
+    fprintf( stderr, "usage: %s [iterations]\n", argv[0] );
+    return 2;
+  }
+
+  printf( "%-24s %14s %14s %8s\n", "pattern", "snprintf [ns]", "menu_fmt [ns]", "speedup" );
+
+  for ( int i = 0; i < PATTERN_TOP; i++ )
+  {
+    if ( !_check( i, iterations ) )
+    {
+      return 1;
+    }
+
+    uint64_t libc_ns = _time( _with_snprintf, i, iterations );
+    uint64_t fmt_ns = _time( _with_menu_fmt, i, iterations );
+
+    printf( "%-24s %14.1f %14.1f %7.1fx\n", pattern_name[i], (double) libc_ns / iterations,
+            (double) fmt_ns / iterations, fmt_ns > 0 ? (double) libc_ns / fmt_ns : 0.0 );
+  }
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Replays a simulated activity trace through the energy model in
+ * components/diag/energy.c on virtual time.
+ *
+ * usage: energy_replay <trace>
+ *
+ * Trace commands, one per line, '#' starts a comment:
+ *   wait <ms>                      advance virtual time
+ *   on <load> / off <load>         switch a load
+ *   active <load> <ms>             add a burst, e.g. a radio transmit
+ *   voltage <mV>                   battery voltage for the next sample
+ *   sample                         Energy_Sample()
+ *   repeat <n> ... end             repeat the enclosed lines, not nested
+ *   print                          Energy_Print()
+ *   expect <param> <min> <max>     published parameter within range
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "energy.h"
+#include "parameters.h"
+#include "sim.h"
+
+#define TRACE_LINE_MAX   256
+#define TRACE_REPEAT_MAX 64
+
+static struct
+{
+  const char* path;
+  int line_no;
+  int errors;
+} ctx;
+
+static void _error( const char* fmt, ... )
+{
+  va_list args;
+
+  va_start( args, fmt );
+  fprintf( stderr, "%s:%d: ", ctx.path, ctx.line_no );
+  vfprintf( stderr, fmt, args );
+  fprintf( stderr, "\n" );
+  va_end( args );
+  ctx.errors++;
+}
+
+static bool _load( const char* name, energy_load_t* load )
+{
+  for ( int i = 0; i < ENERGY_LOAD_TOP; i++ )
+  {
+    if ( strcmp( name, Energy_GetLoadName( i ) ) == 0 )
+    {
+      *load = i;
+      return true;
+    }
+  }
+
+  _error( "unknown load '%s'", name );
+  return false;
+}
+
+static void _expect( const char* name, uint32_t min, uint32_t max )
+{
+  parameter_value_t param;
+
+  if ( !Sim_ParametersFind( name, &param ) )
+  {
+    _error( "unknown parameter '%s'", name );
+    return;
+  }
+
+  uint32_t value = parameters_getValue( param );
+  if ( ( value < min ) || ( value > max ) )
+  {
+    _error( "%s = %lu, expected %lu..%lu", name, (unsigned long) value, (unsigned long) min, (unsigned long) max );
+  }
+}
+
+static void _run( char* line )
+{
+  char* cmd = strtok( line, " \t\r\n" );
+  char* arg1 = strtok( NULL, " \t\r\n" );
+  char* arg2 = strtok( NULL, " \t\r\n" );
+  char* arg3 = strtok( NULL, " \t\r\n" );
+  energy_load_t load;
+
+  if ( ( cmd == NULL ) || ( cmd[0] == '#' ) )
+  {
+    return;
+  }
+
+  if ( ( strcmp( cmd, "wait" ) == 0 ) && arg1 )
+  {
+    Sim_AdvanceMs( strtoul( arg1, NULL, 0 ) );
+  }
+  else if ( ( ( strcmp( cmd, "on" ) == 0 ) || ( strcmp( cmd, "off" ) == 0 ) ) && arg1 )
+  {
+    if ( _load( arg1, &load ) )
+    {
+      Energy_SetOn( load, strcmp( cmd, "on" ) == 0 );
+    }
+  }
+  else if ( ( strcmp( cmd, "active" ) == 0 ) && arg2 )
+  {
+    if ( _load( arg1, &load ) )
+    {
+      Energy_AddActive( load, strtoul( arg2, NULL, 0 ) * 1000 );
+    }
+  }
+  else if ( ( strcmp( cmd, "voltage" ) == 0 ) && arg1 )
+  {
+    Energy_SetBatteryVoltage( strtoul( arg1, NULL, 0 ) / 1000.0f );
+  }
+  else if ( strcmp( cmd, "sample" ) == 0 )
+  {
+    Energy_Sample();
+  }
+  else if ( strcmp( cmd, "print" ) == 0 )
+  {
+    Energy_Print();
+  }
+  else if ( ( strcmp( cmd, "expect" ) == 0 ) && arg3 )
+  {
+    _expect( arg1, strtoul( arg2, NULL, 0 ), strtoul( arg3, NULL, 0 ) );
+  }
+  else
+  {
+    _error( "bad command '%s'", cmd );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  char line[TRACE_LINE_MAX];
+  char repeat[TRACE_REPEAT_MAX][TRACE_LINE_MAX];
+  int repeat_lines = 0;
+  long repeat_cnt = -1;
+
+  if ( argc != 2 )
+  {
+    fprintf( stderr, "usage: %s <trace>\n", argv[0] );
+    return 2;
+  }
+
+  ctx.path = argv[1];
+  FILE* file = fopen( ctx.path, "r" );
+  if ( file == NULL )
+  {
+    fprintf( stderr, "cannot read '%s'\n", ctx.path );
+    return 2;
+  }
+
+  parameters_init();
+  Energy_Start();
+
+  while ( fgets( line, sizeof( line ), file ) != NULL )
+  {
+    ctx.line_no++;
+
+    if ( strncmp( line, "repeat ", 7 ) == 0 )
+    {
+      repeat_cnt = strtol( line + 7, NULL, 0 );
+      repeat_lines = 0;
+    }
+    else if ( ( repeat_cnt >= 0 ) && ( strncmp( line, "end", 3 ) == 0 ) )
+    {
+      for ( long i = 0; i < repeat_cnt; i++ )
+      {
+        for ( int j = 0; j < repeat_lines; j++ )
+        {
+          strcpy( line, repeat[j] );
+          _run( line );
+        }
+      }
+      repeat_cnt = -1;
+    }
+    else if ( repeat_cnt >= 0 )
+    {
+      if ( repeat_lines == TRACE_REPEAT_MAX )
+      {
+        _error( "repeat block too long" );
+        break;
+      }
+      strcpy( repeat[repeat_lines++], line );
+    }
+    else
+    {
+      _run( line );
+    }
+  }
+  fclose( file );
+
+  if ( repeat_cnt >= 0 )
+  {
+    _error( "missing end" );
+  }
+
+  return ctx.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Host test of components/diag/field_log.c on a directory standing in for
+ * the storage partition: block rotation, reboots, torn appends and the
+ * record stream the download endpoint serves.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "field_log.h"
+#include "param_store.h"
+#include "sim.h"
+
+#define RECORDS_PER_BLOCK ( FIELD_LOG_BLOCK_SIZE / sizeof( field_log_record_t ) )
+#define STREAM_MAX        ( FIELD_LOG_BLOCKS * RECORDS_PER_BLOCK )
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+typedef struct
+{
+  uint32_t records;
+  uint32_t blocks;
+  uint32_t boots;
+  uint32_t last_boot;
+  uint32_t first_seq;
+  uint32_t last_seq;
+  bool seq_gap;
+  bool boot_back;    // a boot count below the one before it
+  bool bad_check;
+} stream_t;
+
+static field_log_record_t stream_records[STREAM_MAX];
+static uint32_t errors;
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+static void _remove_blocks( void )
+{
+  char path[256];
+
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    snprintf( path, sizeof( path ), FIELD_LOG_BASE_PATH "/flog%u.bin", i );
+    remove( path );
+  }
+}
+
+/* What a downloader does with the served bytes */
+static void _download( stream_t* stream )
+{
+  uint32_t size = FieldLog_GetSize();
+  uint32_t offset = 0;
+  uint32_t len;
+
+  CHECK( size % sizeof( field_log_record_t ) == 0 );
+  CHECK( size <= sizeof( stream_records ) );
+
+  /* Odd chunk sizes, a record may span two reads */
+  while ( ( len = FieldLog_Read( offset, (uint8_t*) stream_records + offset, 1000 ) ) > 0 )
+  {
+    offset += len;
+  }
+  CHECK( offset == size );
+
+  *stream = ( stream_t ) { 0 };
+  stream->records = size / sizeof( field_log_record_t );
+  for ( uint32_t i = 0; i < stream->records; i++ )
+  {
+    const field_log_record_t* record = &stream_records[i];
+
+    stream->bad_check |= !FieldLog_CheckRecord( record );
+    if ( record->type == FIELD_LOG_BLOCK )
+    {
+      if ( stream->blocks++ == 0 )
+      {
+        stream->first_seq = record->value;
+      }
+      else
+      {
+        stream->seq_gap |= record->value != stream->last_seq + 1;
+      }
+      stream->last_seq = record->value;
+      /* Each block goes on with the boot count */
+      CHECK( ( i + 1 < stream->records ) && ( stream_records[i + 1].type == FIELD_LOG_BOOT ) );
+    }
+    if ( record->type == FIELD_LOG_BOOT )
+    {
+      stream->boot_back |= record->value < stream->last_boot;
+      stream->last_boot = record->value;
+      stream->boots += record->arg;
+    }
+  }
+
+  CHECK( ( stream->records == 0 ) || ( stream_records[0].type == FIELD_LOG_BLOCK ) );
+}
+
+static void _fill( uint32_t cnt )
+{
+  for ( uint32_t i = 0; i < cnt; i++ )
+  {
+    FieldLog_Record( FIELD_LOG_SILO, 0, i );
+    if ( ( i % FIELD_LOG_QUEUE ) == FIELD_LOG_QUEUE - 1 )
+    {
+      CHECK( FieldLog_Flush() );
+    }
+  }
+  CHECK( FieldLog_Flush() );
+}
+
+int main( void )
+{
+  field_log_stats_t stats;
+  stream_t stream;
+
+  ParamStore_Init();
+  _remove_blocks();
+  FieldLog_Init();
+
+  /* Events in order after the block record of the boot */
+  FieldLog_Record( FIELD_LOG_VALVE, 2, 1 );
+  Sim_AdvanceMs( 1500 );
+  FieldLog_Record( FIELD_LOG_VALVE, 2, 0 );
+  FieldLog_Record( FIELD_LOG_DOSE, 0, 12345 );
+  FieldLog_Record( FIELD_LOG_FLOW, 0, 1 );
+  CHECK( FieldLog_Flush() );
+  _download( &stream );
+  CHECK( stream.records == 7 );
+  CHECK( ( stream.blocks == 1 ) && ( stream.boots == 1 ) && ( stream.first_seq == 1 ) && ( stream.last_boot == 1 ) );
+  /* The host clock is set */
+  CHECK( ( stream_records[2].type == FIELD_LOG_CLOCK ) && ( stream_records[2].value + 10 >= (uint32_t) time( NULL ) ) );
+  CHECK( ( stream_records[3].type == FIELD_LOG_VALVE ) && ( stream_records[3].arg == 2 ) && ( stream_records[3].value == 1 ) );
+  CHECK( stream_records[4].time_ms - stream_records[3].time_ms == 1500 );
+  CHECK( ( stream_records[5].type == FIELD_LOG_DOSE ) && ( stream_records[5].value == 12345 ) );
+  CHECK( !stream.bad_check );
+
+  /* Samples only when out of their band */
+  ParamStore_Set( PARAM_SILOS_LEVEL, 50 );
+  ParamStore_Set( PARAM_VOLTAGE_ACCUM, 125000 );
+  FieldLog_Sample();
+  ParamStore_Set( PARAM_SILOS_LEVEL, 49 );
+  ParamStore_Set( PARAM_VOLTAGE_ACCUM, 125500 );
+  FieldLog_Sample();
+  ParamStore_Set( PARAM_SILOS_LEVEL, 47 );
+  ParamStore_Set( PARAM_VOLTAGE_ACCUM, 124000 );
+  FieldLog_Sample();
+  FieldLog_GetStats( &stats );
+  CHECK( stats.records == 4 + 4 );
+  CHECK( FieldLog_Flush() );
+
+  /* A full queue drops and counts */
+  for ( uint32_t i = 0; i < FIELD_LOG_QUEUE + 6; i++ )
+  {
+    FieldLog_Record( FIELD_LOG_VALVE, 0, i & 1 );
+  }
+  FieldLog_GetStats( &stats );
+  CHECK( stats.lost == 6 );
+  CHECK( FieldLog_Flush() );
+
+  /* Rotation keeps the newest blocks in sequence */
+  _fill( 3 * STREAM_MAX );
+  _download( &stream );
+  CHECK( stream.blocks == FIELD_LOG_BLOCKS );
+  CHECK( stream.last_seq - stream.first_seq == FIELD_LOG_BLOCKS - 1 );
+  CHECK( !stream.seq_gap && !stream.bad_check );
+  CHECK( stream.boots == 0 );    // the first block of the boot was dropped
+  CHECK( stream_records[stream.records - 1].value == 3 * STREAM_MAX - 1 );
+
+  /* Reboots go on in the newest block with the next boot counts */
+  uint32_t last_seq = stream.last_seq;
+  uint32_t last_boot = stream.last_boot;
+  for ( uint32_t i = 0; i < 20; i++ )
+  {
+    FieldLog_Init();
+  }
+  FieldLog_Record( FIELD_LOG_FLOW, 0, 2 );
+  CHECK( FieldLog_Flush() );
+  _download( &stream );
+  CHECK( stream.last_seq - last_seq <= 1 );    // unless the block filled up
+  CHECK( ( stream.boots == 20 ) && ( stream.last_boot == last_boot + 20 ) && !stream.boot_back );
+  CHECK( ( stream_records[stream.records - 3].type == FIELD_LOG_BOOT ) && ( stream_records[stream.records - 3].arg == 1 ) );
+  CHECK( stream_records[stream.records - 1].type == FIELD_LOG_FLOW );
+  last_seq = stream.last_seq;
+  last_boot = stream.last_boot;
+
+  /* A torn append ends its block at the last whole record */
+  uint32_t size = FieldLog_GetSize();
+  char path[256];
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    snprintf( path, sizeof( path ), FIELD_LOG_BASE_PATH "/flog%u.bin", i );
+    FILE* f = fopen( path, "rb" );
+    if ( f != NULL )
+    {
+      field_log_record_t record;
+      bool newest = ( fread( &record, sizeof( record ), 1, f ) == 1 ) && ( record.value == last_seq );
+      fclose( f );
+      if ( newest )
+      {
+        f = fopen( path, "ab" );
+        fwrite( "\x11\x22\x33\x44\x55\x66\x77", 7, 1, f );
+        fclose( f );
+      }
+    }
+  }
+  /* and the boot after it opens a new one */
+  FieldLog_Init();
+  _download( &stream );
+  CHECK( !stream.bad_check );
+  CHECK( stream.last_seq == last_seq + 1 );
+  CHECK( ( stream.last_boot == last_boot + 1 ) && !stream.boot_back );
+  CHECK( ( stream_records[stream.records - 3].type == FIELD_LOG_BLOCK ) && ( stream_records[stream.records - 3].arg == 1 ) );
+  CHECK( FieldLog_GetSize() <= size + 3 * sizeof( field_log_record_t ) );
+
+  FieldLog_GetStats( &stats );
+  printf( "%u records in %u blocks, seq %u..%u, boot %u, %u write errors, %u failed checks\n", stream.records, stream.blocks,
+          stream.first_seq, stream.last_seq, stream.last_boot, stats.write_errors, errors );
+
+  return errors > 0 ? 1 : 0;
+}
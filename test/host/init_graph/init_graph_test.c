@@ -0,0 +1,323 @@
+/*
+ * Test of components/diag/init_graph.c with threads standing in for the
+ * FreeRTOS tasks: dependency order, steps overlapping, the caller's task
+ * taking over when no task can be created, and graphs that never finish.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "boot_time.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "init_graph.h"
+#include "parameters.h"
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+/* As the remote controller: display and battery measurement side by side,
+ * the LEDs on the display's I2C bus after it, Wi-Fi once the battery is
+ * known */
+typedef enum
+{
+  STEP_PERSIST,
+  STEP_DISPLAY,
+  STEP_BACKEND,
+  STEP_BATTERY,
+  STEP_IO,
+  STEP_POWER,
+  STEP_MENU,
+  STEP_WIFI,
+  STEP_HTTP_CLIENT,
+  STEP_DICTIONARY,
+  STEP_TASKS,
+  STEP_TOP,
+} step_t;
+
+struct sim_queue
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint8_t* items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+};
+
+static const uint32_t step_ms[STEP_TOP] = { 5, 40, 20, 5, 15, 20, 10, 50, 20, 15, 5 };
+static uint32_t errors;
+static bool fail_create;
+static uint32_t tasks_created;
+static _Atomic uint32_t runs[STEP_TOP];
+
+/* FreeRTOS on threads --------------------------------------------------------*/
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  (void) val;
+  (void) value;
+  return true;
+}
+
+int64_t esp_timer_get_time( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void vTaskDelay( TickType_t ticks )
+{
+  usleep( ticks * portTICK_PERIOD_MS * 1000 );
+}
+
+BaseType_t xTaskCreate( TaskFunction_t task, const char* name, uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle )
+{
+  pthread_t thread;
+
+  (void) name;
+  (void) stack;
+  (void) prio;
+  (void) handle;
+
+  if ( fail_create || ( pthread_create( &thread, NULL, (void* ( * )( void* )) task, arg ) != 0 ) )
+  {
+    return pdFAIL;
+  }
+
+  pthread_detach( thread );
+  tasks_created++;
+  return pdPASS;
+}
+
+void vTaskDelete( TaskHandle_t task )
+{
+  assert( task == NULL );
+  pthread_exit( NULL );
+}
+
+QueueHandle_t xQueueCreate( UBaseType_t length, UBaseType_t item_size )
+{
+  QueueHandle_t queue = calloc( 1, sizeof( struct sim_queue ) );
+  assert( queue );
+  queue->items = calloc( length, item_size );
+  assert( queue->items );
+  queue->length = length;
+  queue->item_size = item_size;
+  pthread_mutex_init( &queue->lock, NULL );
+  pthread_cond_init( &queue->cond, NULL );
+  return queue;
+}
+
+void vQueueDelete( QueueHandle_t queue )
+{
+  pthread_mutex_destroy( &queue->lock );
+  pthread_cond_destroy( &queue->cond );
+  free( queue->items );
+  free( queue );
+}
+
+BaseType_t xQueueSend( QueueHandle_t queue, const void* item, TickType_t ticks )
+{
+  (void) ticks;
+
+  pthread_mutex_lock( &queue->lock );
+  assert( queue->count < queue->length );
+  memcpy( &queue->items[( ( queue->head + queue->count ) % queue->length ) * queue->item_size], item, queue->item_size );
+  queue->count++;
+  pthread_cond_signal( &queue->cond );
+  pthread_mutex_unlock( &queue->lock );
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive( QueueHandle_t queue, void* item, TickType_t ticks )
+{
+  assert( ticks == portMAX_DELAY );
+
+  pthread_mutex_lock( &queue->lock );
+  while ( queue->count == 0 )
+  {
+    pthread_cond_wait( &queue->cond, &queue->lock );
+  }
+  memcpy( item, &queue->items[queue->head * queue->item_size], queue->item_size );
+  queue->head = ( queue->head + 1 ) % queue->length;
+  queue->count--;
+  pthread_mutex_unlock( &queue->lock );
+  return pdTRUE;
+}
+
+/* Steps ----------------------------------------------------------------------*/
+
+#define STEP_FN( _step )                 \
+  static void _run_##_step( void )       \
+  {                                      \
+    runs[_step]++;                       \
+    usleep( step_ms[_step] * 1000 );     \
+  }
+
+STEP_FN( STEP_PERSIST )
+STEP_FN( STEP_DISPLAY )
+STEP_FN( STEP_BACKEND )
+STEP_FN( STEP_BATTERY )
+STEP_FN( STEP_IO )
+STEP_FN( STEP_POWER )
+STEP_FN( STEP_MENU )
+STEP_FN( STEP_WIFI )
+STEP_FN( STEP_HTTP_CLIENT )
+STEP_FN( STEP_DICTIONARY )
+STEP_FN( STEP_TASKS )
+
+static void _graph( init_step_t* steps )
+{
+  const init_step_t graph[STEP_TOP] =
+    {
+      [STEP_PERSIST] = { "persist", _run_STEP_PERSIST, 0, 0 },
+      [STEP_DISPLAY] = { "display", _run_STEP_DISPLAY, 0, 4096 },
+      [STEP_BACKEND] = { "backend", _run_STEP_BACKEND, INIT_AFTER( STEP_PERSIST ), 4096 },
+      [STEP_BATTERY] = { "battery", _run_STEP_BATTERY, 0, 0 },
+      [STEP_IO] = { "io", _run_STEP_IO, INIT_AFTER( STEP_DISPLAY ), 0 },
+      [STEP_POWER] = { "power", _run_STEP_POWER, INIT_AFTER( STEP_BATTERY ) | INIT_AFTER( STEP_IO ), 0 },
+      [STEP_MENU] = { "menu", _run_STEP_MENU, INIT_AFTER( STEP_DISPLAY ) | INIT_AFTER( STEP_BACKEND ) | INIT_AFTER( STEP_POWER ), 4096 },
+      [STEP_WIFI] = { "wifi", _run_STEP_WIFI, INIT_AFTER( STEP_POWER ), 4096 },
+      [STEP_HTTP_CLIENT] = { "http_client", _run_STEP_HTTP_CLIENT, INIT_AFTER( STEP_WIFI ), 4096 },
+      [STEP_DICTIONARY] = { "dictionary", _run_STEP_DICTIONARY, INIT_AFTER( STEP_POWER ), 4096 },
+      [STEP_TASKS] = { "tasks", _run_STEP_TASKS, INIT_AFTER( STEP_MENU ) | INIT_AFTER( STEP_HTTP_CLIENT ) | INIT_AFTER( STEP_DICTIONARY ), 0 },
+    };
+
+  memcpy( steps, graph, sizeof( graph ) );
+  memset( (void*) runs, 0, sizeof( runs ) );
+}
+
+static void _check_order( const init_step_t* steps )
+{
+  for ( uint32_t i = 0; i < STEP_TOP; i++ )
+  {
+    CHECK( runs[i] == 1 );
+    CHECK( steps[i].end_us >= steps[i].start_us + step_ms[i] * 1000 );
+    for ( uint32_t dep = 0; dep < STEP_TOP; dep++ )
+    {
+      if ( steps[i].after & INIT_AFTER( dep ) )
+      {
+        CHECK( steps[i].start_us >= steps[dep].end_us );
+      }
+    }
+  }
+}
+
+static bool _overlap( const init_step_t* a, const init_step_t* b )
+{
+  return ( a->start_us < b->end_us ) && ( b->start_us < a->end_us );
+}
+
+static uint32_t _sum_ms( void )
+{
+  uint32_t sum = 0;
+
+  for ( uint32_t i = 0; i < STEP_TOP; i++ )
+  {
+    sum += step_ms[i];
+  }
+
+  return sum;
+}
+
+/* Longest chain of dependencies, the steps are declared after the ones they need */
+static uint32_t _critical_ms( const init_step_t* steps )
+{
+  uint32_t end_ms[STEP_TOP];
+  uint32_t longest = 0;
+
+  for ( uint32_t i = 0; i < STEP_TOP; i++ )
+  {
+    uint32_t start_ms = 0;
+    for ( uint32_t dep = 0; dep < i; dep++ )
+    {
+      if ( ( steps[i].after & INIT_AFTER( dep ) ) && ( end_ms[dep] > start_ms ) )
+      {
+        start_ms = end_ms[dep];
+      }
+    }
+    end_ms[i] = start_ms + step_ms[i];
+    longest = end_ms[i] > longest ? end_ms[i] : longest;
+  }
+
+  return longest;
+}
+
+int main( void )
+{
+  init_step_t steps[STEP_TOP];
+  boot_time_mark_t marks[BOOT_TIME_MARKS];
+
+  /* Side by side */
+  _graph( steps );
+  int64_t start = esp_timer_get_time();
+  CHECK( InitGraph_Run( steps, STEP_TOP ) );
+  uint32_t parallel_ms = ( esp_timer_get_time() - start ) / 1000;
+  _check_order( steps );
+  CHECK( tasks_created == 6 );
+  CHECK( _overlap( &steps[STEP_DISPLAY], &steps[STEP_BATTERY] ) );
+  CHECK( steps[STEP_IO].start_us >= steps[STEP_DISPLAY].end_us );    // one I2C bus
+  CHECK( _overlap( &steps[STEP_WIFI], &steps[STEP_MENU] ) );
+  CHECK( parallel_ms < ( _critical_ms( steps ) + _sum_ms() ) / 2 );
+  CHECK( BootTime_Get( marks, BOOT_TIME_MARKS ) == STEP_TOP );
+
+  /* No task to be had, the caller runs them all in order */
+  _graph( steps );
+  fail_create = true;
+  start = esp_timer_get_time();
+  CHECK( InitGraph_Run( steps, STEP_TOP ) );
+  uint32_t serial_ms = ( esp_timer_get_time() - start ) / 1000;
+  fail_create = false;
+  _check_order( steps );
+  CHECK( serial_ms >= _sum_ms() );
+  CHECK( BootTime_Get( marks, BOOT_TIME_MARKS ) == 2 * STEP_TOP );
+
+  /* A cycle or a missing step starts nothing */
+  _graph( steps );
+  steps[STEP_PERSIST].after = INIT_AFTER( STEP_TASKS );
+  CHECK( !InitGraph_Run( steps, STEP_TOP ) );
+  _graph( steps );
+  steps[STEP_WIFI].after |= INIT_AFTER( STEP_TOP );
+  CHECK( !InitGraph_Run( steps, STEP_TOP ) );
+  uint32_t started = 0;
+  for ( uint32_t i = 0; i < STEP_TOP; i++ )
+  {
+    started += runs[i];
+  }
+  CHECK( started == 0 );
+
+  BootTime_Ready( "test" );
+  printf( "%u steps of %u ms in %u ms side by side (longest chain %u ms), %u ms one by one, %u failed checks\n", STEP_TOP,
+          _sum_ms(), parallel_ms, _critical_ms( steps ), serial_ms, errors );
+
+  return errors > 0 ? 1 : 0;
+}
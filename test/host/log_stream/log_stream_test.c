@@ -0,0 +1,518 @@
+/*
+ * Host test of components/diag/log_stream.c with a client standing in for
+ * the HTTP side: range parsing, downloads cut off and resumed, stale resumes
+ * and the throughput of a large log served chunk by chunk.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "field_log.h"
+#include "log_stream.h"
+#include "param_store.h"
+#include "sim.h"
+#include "trace.h"
+
+#define BIG_SIZE     ( 3 * 1024 * 1024 + 77 )
+#define BENCH_ROUNDS 8
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+typedef struct
+{
+  uint16_t status;
+  char etag[LOG_STREAM_TAG_SIZE];
+  char content_range[48];
+  bool accept_ranges;
+  bool complete;
+  uint8_t* body;
+  uint32_t body_len;
+  uint32_t body_max;
+  uint32_t drop_at;    // connection lost once the body reaches it, 0 never
+  void ( *on_send )( void );
+} client_t;
+
+static uint32_t errors;
+
+/* A big log made up on the fly, nothing of it is held in RAM */
+static uint32_t big_tag = 0x1234;
+static uint32_t big_reads;
+static uint32_t big_max_read;
+static bool big_open;
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+static uint8_t _big_byte( uint32_t offset )
+{
+  return ( offset * 2654435761u ) >> 24;
+}
+
+static uint32_t _big_open( uint32_t* tag )
+{
+  big_open = true;
+  *tag = big_tag;
+  return BIG_SIZE;
+}
+
+static uint32_t _big_read( uint32_t offset, void* data, uint32_t len )
+{
+  uint8_t* out = data;
+
+  big_reads++;
+  big_max_read = len > big_max_read ? len : big_max_read;
+  for ( uint32_t i = 0; i < len; i++ )
+  {
+    out[i] = _big_byte( offset + i );
+  }
+
+  return len;
+}
+
+static void _big_close( void )
+{
+  big_open = false;
+}
+
+static const log_stream_source_t big_source =
+  {
+    .name = "big",
+    .open = _big_open,
+    .read = _big_read,
+    .close = _big_close,
+};
+
+static void _status( void* arg, uint16_t code )
+{
+  client_t* client = arg;
+  client->status = code;
+}
+
+static void _header( void* arg, const char* field, const char* value )
+{
+  client_t* client = arg;
+
+  if ( strcmp( field, "ETag" ) == 0 )
+  {
+    snprintf( client->etag, sizeof( client->etag ), "%s", value );
+  }
+  else if ( strcmp( field, "Content-Range" ) == 0 )
+  {
+    snprintf( client->content_range, sizeof( client->content_range ), "%s", value );
+  }
+  else if ( strcmp( field, "Accept-Ranges" ) == 0 )
+  {
+    client->accept_ranges = strcmp( value, "bytes" ) == 0;
+  }
+}
+
+/* The socket takes what fits before the drop, like a TCP connection does */
+static bool _send( void* arg, const void* data, uint32_t len )
+{
+  client_t* client = arg;
+
+  if ( len == 0 )
+  {
+    client->complete = true;
+    return true;
+  }
+
+  uint32_t room = client->body_max - client->body_len;
+  if ( ( client->drop_at > 0 ) && ( client->drop_at - client->body_len < room ) )
+  {
+    room = client->drop_at - client->body_len;
+  }
+
+  memcpy( client->body + client->body_len, data, len < room ? len : room );
+  client->body_len += len < room ? len : room;
+  if ( client->on_send != NULL )
+  {
+    client->on_send();
+  }
+
+  return len <= room;
+}
+
+static bool _get( client_t* client, const log_stream_source_t* source, const char* range, const char* if_range )
+{
+  const log_stream_io_t io =
+    {
+      .status = _status,
+      .header = _header,
+      .send = _send,
+      .arg = client,
+    };
+
+  client->status = 0;
+  client->content_range[0] = '\0';
+  client->accept_ranges = false;
+  client->complete = false;
+
+  return LogStream_Serve( source, range, if_range, &io );
+}
+
+/* What a downloader does: resume from what it has while the tag holds,
+ * start over on a full response. Returns the number of requests. */
+static uint32_t _download( client_t* client, const log_stream_source_t* source, uint32_t drop_every )
+{
+  char range[32];
+  char etag[LOG_STREAM_TAG_SIZE];
+  uint32_t requests = 0;
+
+  client->body_len = 0;
+  client->drop_at = drop_every;
+  _get( client, source, NULL, NULL );
+  requests++;
+
+  while ( !client->complete && ( requests < 1000 ) )
+  {
+    snprintf( range, sizeof( range ), "bytes=%u-", client->body_len );
+    snprintf( etag, sizeof( etag ), "%s", client->etag );
+    client->drop_at = drop_every > 0 ? client->body_len + drop_every : 0;
+
+    uint32_t had = client->body_len;
+    _get( client, source, range, etag );
+    requests++;
+
+    if ( client->status == 200 )
+    {
+      /* The body restarted at offset 0 behind what was kept */
+      memmove( client->body, client->body + had, client->body_len - had );
+      client->body_len -= had;
+      client->drop_at = drop_every;
+    }
+    else
+    {
+      CHECK( client->status == 206 );
+    }
+  }
+
+  return requests;
+}
+
+static bool _is_big( const client_t* client, uint32_t first, uint32_t len )
+{
+  for ( uint32_t i = 0; i < len; i++ )
+  {
+    if ( client->body[i] != _big_byte( first + i ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void _test_parse( void )
+{
+  static const struct
+  {
+    const char* range;
+    log_range_t ret;
+    uint32_t first;
+    uint32_t last;
+  } cases[] =
+    {
+      { "bytes=0-99", LOG_RANGE_OK, 0, 99 },
+      { "bytes=900-", LOG_RANGE_OK, 900, 999 },
+      { "bytes=-100", LOG_RANGE_OK, 900, 999 },
+      { "bytes=-5000", LOG_RANGE_OK, 0, 999 },
+      { "bytes=500-99999999999", LOG_RANGE_OK, 500, 999 },
+      { "bytes=999-999", LOG_RANGE_OK, 999, 999 },
+      { "bytes=1000-", LOG_RANGE_UNSATISFIABLE },
+      { "bytes=-0", LOG_RANGE_UNSATISFIABLE },
+      { "bytes=5-1", LOG_RANGE_NONE },
+      { "bytes=0-1,5-6", LOG_RANGE_NONE },
+      { "bytes=-", LOG_RANGE_NONE },
+      { "bytes=abc", LOG_RANGE_NONE },
+      { "items=0-1", LOG_RANGE_NONE },
+      { NULL, LOG_RANGE_NONE },
+    };
+  uint32_t first;
+  uint32_t last;
+
+  for ( uint32_t i = 0; i < sizeof( cases ) / sizeof( cases[0] ); i++ )
+  {
+    log_range_t ret = LogStream_ParseRange( cases[i].range, 1000, &first, &last );
+    CHECK( ret == cases[i].ret );
+    if ( ( ret == cases[i].ret ) && ( ret == LOG_RANGE_OK ) )
+    {
+      CHECK( ( first == cases[i].first ) && ( last == cases[i].last ) );
+    }
+  }
+
+  CHECK( LogStream_ParseRange( "bytes=-10", 0, &first, &last ) == LOG_RANGE_UNSATISFIABLE );
+}
+
+static double _now_s( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _test_big( client_t* client )
+{
+  log_stream_stats_t stats;
+  char content_range[48];
+
+  /* One chunk at a time */
+  big_reads = 0;
+  CHECK( _get( client, &big_source, NULL, NULL ) );
+  CHECK( client->complete && ( client->status == 200 ) && client->accept_ranges );
+  CHECK( ( client->body_len == BIG_SIZE ) && _is_big( client, 0, BIG_SIZE ) );
+  CHECK( big_reads == ( BIG_SIZE + LOG_STREAM_CHUNK - 1 ) / LOG_STREAM_CHUNK );
+  CHECK( big_max_read <= LOG_STREAM_CHUNK );
+  CHECK( !big_open );
+
+  double start = _now_s();
+  for ( uint32_t i = 0; i < BENCH_ROUNDS; i++ )
+  {
+    client->body_len = 0;
+    _get( client, &big_source, NULL, NULL );
+  }
+  double mb_s = BENCH_ROUNDS * ( BIG_SIZE / 1e6 ) / ( _now_s() - start );
+  printf( "served %u x %u bytes at %.0f MB/s in %u byte chunks\n", BENCH_ROUNDS, BIG_SIZE, mb_s, LOG_STREAM_CHUNK );
+  CHECK( mb_s > 5.0 );
+
+  /* Cut off, then resumed where it ended */
+  LogStream_GetStats( &stats );
+  client->body_len = 0;
+  client->drop_at = 1000000;
+  CHECK( !_get( client, &big_source, NULL, NULL ) );
+  CHECK( !client->complete && ( client->body_len == 1000000 ) && !big_open );
+
+  char etag[LOG_STREAM_TAG_SIZE];
+  snprintf( etag, sizeof( etag ), "%s", client->etag );
+  client->body_len = 0;
+  client->drop_at = 0;
+  CHECK( _get( client, &big_source, "bytes=1000000-", etag ) );
+  CHECK( client->complete && ( client->status == 206 ) );
+  snprintf( content_range, sizeof( content_range ), "bytes 1000000-%u/%u", BIG_SIZE - 1, BIG_SIZE );
+  CHECK( strcmp( client->content_range, content_range ) == 0 );
+  CHECK( ( client->body_len == BIG_SIZE - 1000000 ) && _is_big( client, 1000000, client->body_len ) );
+
+  log_stream_stats_t after;
+  LogStream_GetStats( &after );
+  CHECK( after.aborted == stats.aborted + 1 );
+  CHECK( after.resumed == stats.resumed + 1 );
+
+  /* Many drops, the pieces add up */
+  uint32_t requests = _download( client, &big_source, 300001 );
+  CHECK( requests == BIG_SIZE / 300001 + 1 );
+  CHECK( ( client->body_len == BIG_SIZE ) && _is_big( client, 0, BIG_SIZE ) );
+
+  /* The log changed since, the resume gets all of it */
+  client->body_len = 0;
+  big_tag++;
+  CHECK( _get( client, &big_source, "bytes=1000000-", etag ) );
+  CHECK( ( client->status == 200 ) && ( client->body_len == BIG_SIZE ) );
+
+  /* A plain Range without If-Range is taken as is */
+  client->body_len = 0;
+  CHECK( _get( client, &big_source, "bytes=-10", NULL ) );
+  CHECK( ( client->status == 206 ) && ( client->body_len == 10 ) && _is_big( client, BIG_SIZE - 10, 10 ) );
+
+  /* Past the end */
+  client->body_len = 0;
+  snprintf( content_range, sizeof( content_range ), "bytes */%u", BIG_SIZE );
+  CHECK( _get( client, &big_source, "bytes=99999999-", NULL ) );
+  CHECK( ( client->status == 416 ) && client->complete && ( client->body_len == 0 ) );
+  CHECK( strcmp( client->content_range, content_range ) == 0 );
+}
+
+static void _rotate( void )
+{
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS * FIELD_LOG_BLOCK_SIZE / sizeof( field_log_record_t ); i++ )
+  {
+    FieldLog_Record( FIELD_LOG_SILO, 0, i );
+    if ( ( i % FIELD_LOG_QUEUE ) == FIELD_LOG_QUEUE - 1 )
+    {
+      FieldLog_Flush();
+    }
+  }
+  FieldLog_Flush();
+}
+
+static void _test_field_log( client_t* client )
+{
+  const log_stream_source_t* source = LogStream_Find( "field" );
+  static uint8_t direct[FIELD_LOG_BLOCKS * FIELD_LOG_BLOCK_SIZE];
+  char path[256];
+
+  CHECK( source != NULL );
+  for ( uint32_t i = 0; i < FIELD_LOG_BLOCKS; i++ )
+  {
+    snprintf( path, sizeof( path ), FIELD_LOG_BASE_PATH "/flog%u.bin", i );
+    remove( path );
+  }
+  FieldLog_Init();
+  for ( uint32_t i = 0; i < 1000; i++ )
+  {
+    FieldLog_Record( FIELD_LOG_VALVE, i % 8, i & 1 );
+    if ( ( i % FIELD_LOG_QUEUE ) == FIELD_LOG_QUEUE - 1 )
+    {
+      FieldLog_Flush();
+    }
+  }
+
+  /* Queued records are flushed by the download */
+  uint32_t requests = _download( client, source, 2500 );
+  uint32_t size = FieldLog_GetSize();
+  CHECK( FieldLog_Read( 0, direct, sizeof( direct ) ) == size );
+  CHECK( size == ( 1000 + 3 * 3 ) * sizeof( field_log_record_t ) );    // block, boot and clock records heading 3 blocks
+  CHECK( requests == size / 2500 + 1 );
+  CHECK( ( client->body_len == size ) && ( memcmp( client->body, direct, size ) == 0 ) );
+
+  /* Appends keep the resume valid */
+  char etag[LOG_STREAM_TAG_SIZE];
+  snprintf( etag, sizeof( etag ), "%s", client->etag );
+  client->drop_at = 0;
+  FieldLog_Record( FIELD_LOG_FLOW, 0, 1 );
+  client->body_len = 0;
+  CHECK( _get( client, source, "bytes=1200-", etag ) );
+  CHECK( ( client->status == 206 ) && ( client->body_len == size + sizeof( field_log_record_t ) - 1200 ) );
+
+  /* Rotation does not */
+  _rotate();
+  client->body_len = 0;
+  CHECK( _get( client, source, "bytes=1200-", etag ) );
+  CHECK( ( client->status == 200 ) && ( client->body_len == FieldLog_GetSize() ) );
+
+  /* Nor when it happens under a transfer, the client sees it cut short */
+  client->body_len = 0;
+  client->on_send = _rotate;
+  CHECK( !_get( client, source, NULL, NULL ) );
+  CHECK( !client->complete && ( client->body_len == LOG_STREAM_CHUNK ) );
+  client->on_send = NULL;
+}
+
+static void _trace_during_dump( void )
+{
+  Trace_Write( TRACE_ID_MEAS_ADC_AVG, 0, 0, 0 );
+}
+
+static uint32_t console_writes;
+
+/* A ranged dump opened and closed under a console dump */
+static void _console_write( const void* data, uint32_t len, void* arg )
+{
+  uint32_t tag;
+
+  (void) data;
+  (void) len;
+  (void) arg;
+  if ( console_writes++ == 1 )
+  {
+    Trace_DumpBegin( &tag );
+    Trace_DumpEnd();
+  }
+  Trace_Write( TRACE_ID_MEAS_ADC_AVG, 0, 0, 0 );
+}
+
+static void _test_trace( client_t* client )
+{
+  const log_stream_source_t* source = LogStream_Find( "trace" );
+  trace_dump_header_t header;
+
+  CHECK( source != NULL );
+  Trace_Clear();
+  for ( uint32_t i = 0; i < CONFIG_TRACE_RECORDS + 100; i++ )
+  {
+    Sim_AdvanceMs( 1 );
+    Trace_Write( TRACE_ID_MEAS_ADC_AVG, i, i + 1, i + 2 );
+  }
+
+  /* Same bytes as the console dump, the ring wrapped; resumed while
+   * nothing is traced */
+  uint32_t size = sizeof( header ) + CONFIG_TRACE_RECORDS * sizeof( trace_record_t );
+  CHECK( _download( client, source, 1000 ) == size / 1000 + 1 );
+  CHECK( client->body_len == size );
+
+  /* Traced meanwhile, the transfer still sends the ring as it was at the start */
+  client->on_send = _trace_during_dump;
+  CHECK( _download( client, source, 0 ) == 1 );
+  client->on_send = NULL;
+  CHECK( client->body_len == size );
+  memcpy( &header, client->body, sizeof( header ) );
+  CHECK( ( header.magic == TRACE_DUMP_MAGIC ) && ( header.records_cnt == CONFIG_TRACE_RECORDS ) && ( header.lost == 100 ) );
+
+  bool in_order = true;
+  for ( uint32_t i = 0; i < CONFIG_TRACE_RECORDS; i++ )
+  {
+    trace_record_t record;
+    memcpy( &record, client->body + sizeof( header ) + i * sizeof( record ), sizeof( record ) );
+    in_order &= ( record.args[0] == 100 + i ) && ( record.seq == (uint16_t) ( 100 + i ) );
+  }
+  CHECK( in_order );
+
+  /* Served from a copy, traces written during the transfer are kept */
+  static trace_record_t ring[CONFIG_TRACE_RECORDS];
+  uint32_t cnt = Trace_Snapshot( ring, CONFIG_TRACE_RECORDS );
+  CHECK( Trace_GetDropped() == 0 );
+  CHECK( ( cnt == CONFIG_TRACE_RECORDS ) && ( ring[cnt - 1].args[1] == 0 ) );
+  CHECK( Trace_DumpRead( 0, &header, sizeof( header ) ) == 0 );
+
+  /* Freezes nest, the ranged dump does not thaw the ring under the console one */
+  Trace_Dump( _console_write, NULL );
+  CHECK( ( console_writes > 2 ) && ( Trace_GetDropped() == console_writes ) );
+
+  /* A new trace makes an old resume start over */
+  char etag[LOG_STREAM_TAG_SIZE];
+  snprintf( etag, sizeof( etag ), "%s", client->etag );
+  client->drop_at = 0;
+  Sim_AdvanceMs( 1 );
+  Trace_Write( TRACE_ID_MEAS_ADC_AVG, 1, 2, 3 );
+  client->body_len = 0;
+  CHECK( _get( client, source, "bytes=100-", etag ) );
+  CHECK( ( client->status == 200 ) && ( client->body_len == size ) );
+}
+
+int main( void )
+{
+  client_t client =
+    {
+      .body_max = BIG_SIZE,
+      .body = malloc( BIG_SIZE ),
+    };
+  log_stream_stats_t stats;
+
+  ParamStore_Init();
+  _test_parse();
+  _test_big( &client );
+  _test_field_log( &client );
+  _test_trace( &client );
+
+  LogStream_GetStats( &stats );
+  printf( "%u transfers, %u resumed, %u aborted, %u bytes, %u failed checks\n", stats.transfers, stats.resumed,
+          stats.aborted, stats.bytes, errors );
+  free( client.body );
+
+  return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,361 @@
+/*
+ * Host test of components/params/param_bridge.c in the target layout: only
+ * the project parameters are in the store, the shared ones stay with a
+ * stand-in for the hq parameters module. param_persist.c keeps the values in
+ * an in-memory NVS namespace which outlives a simulated reboot.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "param_bridge.h"
+#include "param_notify.h"
+#include "param_persist.h"
+#include "param_snapshot.h"
+#include "param_store.h"
+
+#define NVS_KEYS_MAX 16
+#define NVS_BLOB_MAX 1024
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+typedef struct
+{
+  uint32_t min;
+  uint32_t max;
+  uint32_t def;
+  const char* name;
+} hq_limits_t;
+
+static struct
+{
+  char keys[NVS_KEYS_MAX][16];
+  uint32_t values[NVS_KEYS_MAX];
+  uint32_t count;
+  uint8_t blob[NVS_BLOB_MAX];
+  size_t blob_len;
+} nvs;
+
+static uint32_t errors;
+static uint32_t hq_values[PARAM_VALUE_TOP];
+static uint32_t hq_writes;
+static uint32_t calls;
+static bool read_in_write;
+static bool read_ok;
+static char hq_strings[PARAM_STR_TOP][64];
+
+static const hq_limits_t hq_limits[PARAM_VALUE_TOP] =
+  {
+#define PARAM( _param, _min, _max, _default, _name ) [_param] = { _min, _max, _default, _name },
+    PARAMETERS_SIM_U32_LIST
+#undef PARAM
+};
+
+PARAM_SUBSCRIBER_DEFINE( subscriber, "bridge", PARAM_FILTER_CHANGE, 0, PARAM_EMERGENCY_DISABLE, PARAM_ADD_WATER );
+PARAM_GROUP_DEFINE( group, "mixed", PARAM_EMERGENCY_DISABLE, PARAM_START_SYSTEM );
+
+bool __wrap_parameters_setValue( parameter_value_t val, uint32_t value );
+uint32_t __wrap_parameters_getValue( parameter_value_t val );
+bool __wrap_parameters_setString( parameter_string_t val, const char* str );
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+/* hq parameters module */
+bool __real_parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  if ( ( value < hq_limits[val].min ) || ( value > hq_limits[val].max ) )
+  {
+    return false;
+  }
+
+  /* A reader in the middle of an hq write must not get a snapshot */
+  if ( read_in_write )
+  {
+    param_snapshot_t snapshot;
+    read_ok = ParamSnapshot_Read( &group, &snapshot );
+  }
+
+  hq_values[val] = value;
+  hq_writes++;
+  return true;
+}
+
+uint32_t __real_parameters_getValue( parameter_value_t val )
+{
+  return hq_values[val];
+}
+
+bool __real_parameters_setString( parameter_string_t val, const char* str )
+{
+  snprintf( hq_strings[val], sizeof( hq_strings[val] ), "%s", str );
+  return true;
+}
+
+bool parameters_getString( parameter_string_t val, char* str, uint32_t str_len )
+{
+  snprintf( str, str_len, "%s", hq_strings[val] );
+  return true;
+}
+
+const char* parameters_getName( parameter_value_t val )
+{
+  return hq_limits[val].name;
+}
+
+uint32_t parameters_getDefaultValue( parameter_value_t val )
+{
+  return hq_limits[val].def;
+}
+
+/* NVS ------------------------------------------------------------------------*/
+
+esp_err_t nvs_open( const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle )
+{
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_u32( nvs_handle_t handle, const char* key, uint32_t* out_value )
+{
+  for ( uint32_t i = 0; i < nvs.count; i++ )
+  {
+    if ( strcmp( nvs.keys[i], key ) == 0 )
+    {
+      *out_value = nvs.values[i];
+      return ESP_OK;
+    }
+  }
+
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_set_u32( nvs_handle_t handle, const char* key, uint32_t value )
+{
+  uint32_t i;
+
+  for ( i = 0; ( i < nvs.count ) && ( strcmp( nvs.keys[i], key ) != 0 ); i++ )
+    ;
+
+  if ( i == NVS_KEYS_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  if ( i == nvs.count )
+  {
+    snprintf( nvs.keys[nvs.count++], sizeof( nvs.keys[0] ), "%s", key );
+  }
+
+  nvs.values[i] = value;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char* key, void* out_value, size_t* length )
+{
+  if ( ( nvs.blob_len == 0 ) || ( nvs.blob_len > *length ) )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( out_value, nvs.blob, nvs.blob_len );
+  *length = nvs.blob_len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char* key, const void* value, size_t length )
+{
+  if ( length > NVS_BLOB_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( nvs.blob, value, length );
+  nvs.blob_len = length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+  return ESP_OK;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+}
+
+esp_err_t esp_register_shutdown_handler( shutdown_handler_t handler )
+{
+  return ESP_OK;
+}
+
+/* What the project modules link against on the target */
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return __wrap_parameters_getValue( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  return __wrap_parameters_setValue( val, value );
+}
+
+bool parameters_setString( parameter_string_t val, const char* str )
+{
+  return __wrap_parameters_setString( val, str );
+}
+
+/* hq parameters_init(): the defaults, the strings cleared */
+static void _hq_init( void )
+{
+  for ( uint32_t i = 0; i < PARAM_VALUE_TOP; i++ )
+  {
+    hq_values[i] = hq_limits[i].def;
+  }
+  memset( hq_strings, 0, sizeof( hq_strings ) );
+}
+
+/* As MainApp_Start() */
+static bool _boot( void )
+{
+  _hq_init();
+  bool image = ParamPersist_LoadImage();
+  if ( !image )
+  {
+    ParamPersist_Load();
+  }
+  ParamBridge_Sync();
+  return image;
+}
+
+static void _count( parameter_value_t param, uint32_t value, void* arg )
+{
+  calls++;
+}
+
+int main( void )
+{
+  param_persist_stats_t stats;
+
+  /* Only the project list is in the store */
+  CHECK( ParamStore_GetDef( PARAM_EMERGENCY_DISABLE ) == NULL );
+  CHECK( ParamStore_GetDef( PARAM_TANK_SIZE ) != NULL );
+
+  /* The store starts from what parameters_init() loaded */
+  hq_values[PARAM_TANK_SIZE] = 1234;
+  hq_values[PARAM_EMERGENCY_DISABLE] = 1;
+  ParamBridge_Sync();
+  CHECK( ParamStore_Get( PARAM_TANK_SIZE ) == 1234 );
+  CHECK( __wrap_parameters_getValue( PARAM_TANK_SIZE ) == 1234 );
+  CHECK( __wrap_parameters_getValue( PARAM_EMERGENCY_DISABLE ) == 1 );
+
+  /* Shared parameters are seeded from hq, not from an unused slot */
+  ParamNotify_Subscribe( &subscriber, _count, NULL );
+  CHECK( subscriber.last[0] == 1 );
+
+  /* Store parameters: the slot and the hq copy, limits of the store */
+  uint32_t begun = param_store_writes_begun[PARAM_TANK_SIZE];
+  CHECK( __wrap_parameters_setValue( PARAM_TANK_SIZE, 2000 ) );
+  CHECK( ParamStore_Get( PARAM_TANK_SIZE ) == 2000 );
+  CHECK( hq_values[PARAM_TANK_SIZE] == 2000 );
+  CHECK( param_store_writes_begun[PARAM_TANK_SIZE] == begun + 1 );
+  CHECK( !__wrap_parameters_setValue( PARAM_ADD_WATER, 2 ) );
+  CHECK( hq_values[PARAM_ADD_WATER] == 0 );
+  CHECK( __wrap_parameters_setValue( PARAM_ADD_WATER, 1 ) );
+  CHECK( calls == 1 );
+
+  /* Shared parameters stay in hq but count as writes and notify */
+  begun = param_store_writes_begun[PARAM_EMERGENCY_DISABLE];
+  uint32_t writes = hq_writes;
+  CHECK( __wrap_parameters_setValue( PARAM_EMERGENCY_DISABLE, 0 ) );
+  CHECK( hq_values[PARAM_EMERGENCY_DISABLE] == 0 );
+  CHECK( hq_writes == writes + 1 );
+  CHECK( param_store_writes_begun[PARAM_EMERGENCY_DISABLE] == begun + 1 );
+  CHECK( param_store_writes_ended[PARAM_EMERGENCY_DISABLE] == param_store_writes_begun[PARAM_EMERGENCY_DISABLE] );
+  CHECK( calls == 2 );
+  CHECK( !__wrap_parameters_setValue( PARAM_EMERGENCY_DISABLE, 2 ) );
+  CHECK( __wrap_parameters_setValue( PARAM_EMERGENCY_DISABLE, 0 ) );
+  CHECK( calls == 2 );
+
+  /* A taken trigger is cleared in hq too, as one write */
+  CHECK( __wrap_parameters_setValue( PARAM_TRACE_DUMP, 1 ) );
+  CHECK( hq_values[PARAM_TRACE_DUMP] == 1 );
+  begun = param_store_writes_begun[PARAM_TRACE_DUMP];
+  CHECK( ParamStore_Take( PARAM_TRACE_DUMP ) == 1 );
+  CHECK( ParamStore_Get( PARAM_TRACE_DUMP ) == 0 );
+  CHECK( hq_values[PARAM_TRACE_DUMP] == 0 );
+  CHECK( param_store_writes_ended[PARAM_TRACE_DUMP] == param_store_writes_begun[PARAM_TRACE_DUMP] );
+  CHECK( param_store_writes_begun[PARAM_TRACE_DUMP] > begun );
+  CHECK( ParamStore_Take( PARAM_TRACE_DUMP ) == 0 );
+
+  /* Snapshots of shared parameters see the hq writes as store writes */
+  param_snapshot_t snapshot;
+  read_in_write = true;
+  read_ok = true;
+  CHECK( __wrap_parameters_setValue( PARAM_EMERGENCY_DISABLE, 1 ) );
+  read_in_write = false;
+  CHECK( !read_ok );
+  CHECK( ParamSnapshot_Read( &group, &snapshot ) );
+  CHECK( snapshot.values[0] == 1 );
+
+  /* Only a changed string goes to flash */
+  ParamPersist_GetStats( &stats );
+  uint32_t marks = stats.marks;
+  CHECK( __wrap_parameters_setString( PARAM_STR_CONTROLLER_SN, "SN-0001" ) );
+  ParamPersist_GetStats( &stats );
+  CHECK( stats.marks == marks + 1 );
+  CHECK( __wrap_parameters_setString( PARAM_STR_CONTROLLER_SN, "SN-0001" ) );
+  ParamPersist_GetStats( &stats );
+  CHECK( stats.marks == marks + 1 );
+  CHECK( strcmp( hq_strings[PARAM_STR_CONTROLLER_SN], "SN-0001" ) == 0 );
+  CHECK( ParamPersist_Flush() );
+
+  /* The string went with an image, loading it marks nothing */
+  CHECK( _boot() );
+  CHECK( strcmp( hq_strings[PARAM_STR_CONTROLLER_SN], "SN-0001" ) == 0 );
+  CHECK( !ParamPersist_IsPending() );
+
+  /* A config value set over HTTP goes to flash without any explicit mark,
+   * a runtime value does not */
+  ParamPersist_GetStats( &stats );
+  marks = stats.marks;
+  CHECK( __wrap_parameters_setValue( PARAM_TANK_SIZE, 1500 ) );
+  CHECK( __wrap_parameters_setValue( PARAM_VOLTAGE_ACCUM, 41000 ) );
+  CHECK( ParamPersist_IsPending() );
+  ParamPersist_GetStats( &stats );
+  CHECK( stats.marks == marks + 1 );
+  CHECK( __wrap_parameters_setValue( PARAM_TANK_SIZE, 1500 ) );
+  ParamPersist_GetStats( &stats );
+  CHECK( stats.marks == marks + 1 );
+  CHECK( ParamPersist_Flush() );
+
+  /* After a reboot the image holds it, the runtime value is gone */
+  CHECK( _boot() );
+  CHECK( !ParamPersist_IsPending() );
+  CHECK( __wrap_parameters_getValue( PARAM_TANK_SIZE ) == 1500 );
+  CHECK( hq_values[PARAM_TANK_SIZE] == 1500 );
+  CHECK( __wrap_parameters_getValue( PARAM_VOLTAGE_ACCUM ) == hq_limits[PARAM_VOLTAGE_ACCUM].def );
+
+  printf( "%u failed checks\n", errors );
+
+  return errors > 0 ? 1 : 0;
+}
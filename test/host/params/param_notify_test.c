@@ -0,0 +1,167 @@
+/*
+ * Host test of components/params/param_notify.c: filters, queue delivery
+ * and writes made from inside a callback.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "param_notify.h"
+#include "param_store.h"
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+typedef struct
+{
+  uint32_t calls;
+  parameter_value_t param;
+  uint32_t value;
+} probe_t;
+
+static uint32_t errors;
+
+PARAM_SUBSCRIBER_DEFINE( on_change, "change", PARAM_FILTER_CHANGE, 0, PARAM_ADD_WATER, PARAM_WATER_VOL_ADD );
+PARAM_SUBSCRIBER_DEFINE( on_deadband, "deadband", PARAM_FILTER_DEADBAND, 10, PARAM_SILOS_LEVEL );
+PARAM_SUBSCRIBER_DEFINE( on_threshold, "threshold", PARAM_FILTER_THRESHOLD, 1000, PARAM_TANK_SIZE );
+PARAM_SUBSCRIBER_DEFINE( on_queue, "queue", PARAM_FILTER_CHANGE, 0, PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE );
+PARAM_SUBSCRIBER_DEFINE( on_chain, "chain", PARAM_FILTER_CHANGE, 0, PARAM_START_SYSTEM );
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+static void _probe( parameter_value_t param, uint32_t value, void* arg )
+{
+  probe_t* probe = arg;
+
+  probe->calls++;
+  probe->param = param;
+  probe->value = value;
+}
+
+/* Writing another watched parameter from a callback notifies its subscribers */
+static void _chain( parameter_value_t param, uint32_t value, void* arg )
+{
+  ParamStore_Set( PARAM_ADD_WATER, value );
+}
+
+int main( void )
+{
+  probe_t change = { 0 };
+  probe_t deadband = { 0 };
+  probe_t threshold = { 0 };
+  param_event_t event;
+
+  ParamStore_Init();
+
+  /* Nothing is dispatched before anyone subscribes */
+  CHECK( ParamStore_Set( PARAM_ADD_WATER, 1 ) );
+  CHECK( on_change.events == 0 );
+  ParamStore_Set( PARAM_ADD_WATER, 0 );
+
+  ParamNotify_Subscribe( &on_change, _probe, &change );
+  ParamNotify_Subscribe( &on_deadband, _probe, &deadband );
+  ParamNotify_Subscribe( &on_threshold, _probe, &threshold );
+  ParamNotify_Subscribe( &on_chain, _chain, NULL );
+
+  QueueHandle_t queue = xQueueCreate( 2, sizeof( param_event_t ) );
+  ParamNotify_SubscribeQueue( &on_queue, queue );
+
+  /* Change: every new value, writing the same value is not a change */
+  ParamStore_Set( PARAM_ADD_WATER, 1 );
+  CHECK( change.calls == 1 );
+  CHECK( change.param == PARAM_ADD_WATER );
+  CHECK( change.value == 1 );
+  ParamStore_Set( PARAM_ADD_WATER, 1 );
+  CHECK( change.calls == 1 );
+  ParamStore_Set( PARAM_WATER_VOL_ADD, 250 );
+  CHECK( change.calls == 2 );
+  CHECK( change.param == PARAM_WATER_VOL_ADD );
+  CHECK( change.value == 250 );
+
+  /* Rejected values do not notify */
+  CHECK( !ParamStore_Set( PARAM_ADD_WATER, 2 ) );
+  CHECK( change.calls == 2 );
+
+  /* Deadband: small steps add up against the last notified value */
+  for ( uint32_t level = 1; level <= 10; level++ )
+  {
+    ParamStore_Set( PARAM_SILOS_LEVEL, level );
+  }
+  CHECK( deadband.calls == 0 );
+  ParamStore_Set( PARAM_SILOS_LEVEL, 11 );
+  CHECK( deadband.calls == 1 );
+  ParamStore_Set( PARAM_SILOS_LEVEL, 15 );
+  CHECK( deadband.calls == 1 );
+  ParamStore_Set( PARAM_SILOS_LEVEL, 0 );
+  CHECK( deadband.calls == 2 );
+  CHECK( deadband.value == 0 );
+
+  /* Threshold: only crossings in either direction */
+  ParamStore_Set( PARAM_TANK_SIZE, 500 );
+  ParamStore_Set( PARAM_TANK_SIZE, 999 );
+  CHECK( threshold.calls == 0 );
+  ParamStore_Set( PARAM_TANK_SIZE, 1000 );
+  CHECK( threshold.calls == 1 );
+  ParamStore_Set( PARAM_TANK_SIZE, 4000 );
+  CHECK( threshold.calls == 1 );
+  ParamStore_Set( PARAM_TANK_SIZE, 200 );
+  CHECK( threshold.calls == 2 );
+
+  /* Queue: events in order, a full queue drops and counts */
+  ParamStore_Set( PARAM_VALVE_1_STATE, 1 );
+  ParamStore_Set( PARAM_VALVE_2_STATE, 1 );
+  ParamStore_Set( PARAM_VALVE_1_STATE, 0 );
+  CHECK( uxQueueMessagesWaiting( queue ) == 2 );
+  CHECK( on_queue.dropped == 1 );
+  CHECK( xQueueReceive( queue, &event, 0 ) == pdTRUE );
+  CHECK( ( event.param == PARAM_VALVE_1_STATE ) && ( event.value == 1 ) );
+  CHECK( xQueueReceive( queue, &event, 0 ) == pdTRUE );
+  CHECK( ( event.param == PARAM_VALVE_2_STATE ) && ( event.value == 1 ) );
+  CHECK( xQueueReceive( queue, &event, 0 ) == pdFALSE );
+
+  /* Unwatched parameters reach nobody */
+  uint32_t events = on_change.events + on_deadband.events + on_threshold.events + on_queue.events;
+  ParamStore_Set( PARAM_LAT_COUNT, 1234 );
+  CHECK( on_change.events + on_deadband.events + on_threshold.events + on_queue.events == events );
+
+  /* Nested dispatch from a callback */
+  ParamStore_Set( PARAM_ADD_WATER, 0 );
+  change.calls = 0;
+  ParamStore_Set( PARAM_START_SYSTEM, 1 );
+  CHECK( on_chain.events == 1 );
+  CHECK( change.calls == 1 );
+  CHECK( ParamStore_Get( PARAM_ADD_WATER ) == 1 );
+
+  uint32_t subscribers = 0;
+  for ( param_subscriber_t* sub = ParamNotify_GetFirst(); sub != NULL; sub = sub->next )
+  {
+    printf( "%-10s %u events, %u dropped\n", sub->name, sub->events, sub->dropped );
+    subscribers++;
+  }
+  CHECK( subscribers == 5 );
+  printf( "%u failed checks\n", errors );
+
+  return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * Host test of components/params/param_persist.c on virtual time against an
+ * in-memory NVS namespace, the parameters module is the generated store.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "param_persist.h"
+#include "param_store.h"
+#include "sim.h"
+
+#define NVS_KEYS_MAX 32
+#define NVS_BLOB_MAX 1024
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+static struct
+{
+  char keys[NVS_KEYS_MAX][16];
+  uint32_t values[NVS_KEYS_MAX];
+  uint32_t count;
+  uint32_t sets;
+  uint32_t gets;
+  uint32_t commits;
+  bool fail_commit;
+  uint8_t blob[NVS_BLOB_MAX];    // the image, the only blob of the namespace
+  size_t blob_len;
+  uint32_t blob_sets;
+  uint32_t blob_gets;
+} nvs;
+
+static uint32_t errors;
+static char serial[PARAM_STR_TOP][64];
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+/* NVS ------------------------------------------------------------------------*/
+
+esp_err_t nvs_open( const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle )
+{
+  (void) name;
+  (void) open_mode;
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_u32( nvs_handle_t handle, const char* key, uint32_t* out_value )
+{
+  (void) handle;
+  nvs.gets++;
+  for ( uint32_t i = 0; i < nvs.count; i++ )
+  {
+    if ( strcmp( nvs.keys[i], key ) == 0 )
+    {
+      *out_value = nvs.values[i];
+      return ESP_OK;
+    }
+  }
+
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_set_u32( nvs_handle_t handle, const char* key, uint32_t value )
+{
+  (void) handle;
+  uint32_t i;
+
+  for ( i = 0; ( i < nvs.count ) && ( strcmp( nvs.keys[i], key ) != 0 ); i++ )
+    ;
+
+  if ( i == NVS_KEYS_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  if ( i == nvs.count )
+  {
+    snprintf( nvs.keys[nvs.count++], sizeof( nvs.keys[0] ), "%s", key );
+  }
+
+  nvs.values[i] = value;
+  nvs.sets++;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char* key, void* out_value, size_t* length )
+{
+  (void) handle;
+  (void) key;
+  nvs.blob_gets++;
+  if ( ( nvs.blob_len == 0 ) || ( nvs.blob_len > *length ) )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( out_value, nvs.blob, nvs.blob_len );
+  *length = nvs.blob_len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char* key, const void* value, size_t length )
+{
+  (void) handle;
+  (void) key;
+  if ( length > NVS_BLOB_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( nvs.blob, value, length );
+  nvs.blob_len = length;
+  nvs.blob_sets++;
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+  (void) handle;
+  if ( nvs.fail_commit )
+  {
+    return ESP_FAIL;
+  }
+
+  nvs.commits++;
+  return ESP_OK;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+  (void) handle;
+}
+
+esp_err_t esp_register_shutdown_handler( shutdown_handler_t handler )
+{
+  (void) handler;
+  return ESP_OK;
+}
+
+/* Parameters -----------------------------------------------------------------*/
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  return ParamStore_Set( val, value );
+}
+
+const char* parameters_getName( parameter_value_t val )
+{
+  const param_store_def_t* def = ParamStore_GetDef( val );
+  return def != NULL ? def->name : "";
+}
+
+uint32_t parameters_getDefaultValue( parameter_value_t val )
+{
+  return ParamStore_GetDef( val )->def;
+}
+
+bool parameters_getString( parameter_string_t val, char* str, uint32_t str_len )
+{
+  snprintf( str, str_len, "%s", serial[val] );
+  return true;
+}
+
+bool parameters_setString( parameter_string_t val, const char* str )
+{
+  snprintf( serial[val], sizeof( serial[val] ), "%s", str );
+  return true;
+}
+
+/* Steps the service like its task does */
+static void _run_ms( uint32_t ms )
+{
+  for ( uint32_t t = 0; t < ms; t += PARAM_PERSIST_CHECK_MS )
+  {
+    Sim_AdvanceMs( PARAM_PERSIST_CHECK_MS );
+    ParamPersist_Process();
+  }
+}
+
+static void _set( parameter_value_t param, uint32_t value )
+{
+  CHECK( parameters_setValue( param, value ) );
+  ParamPersist_Mark( param );
+}
+
+/* As MainApp_Start(), ParamStore_Init() stands in for parameters_init() */
+static bool _load( void )
+{
+  ParamStore_Init();
+  memset( serial, 0, sizeof( serial ) );
+  if ( ParamPersist_LoadImage() )
+  {
+    return true;
+  }
+
+  ParamPersist_Load();
+  return false;
+}
+
+static void _boot( void )
+{
+  _load();
+  CHECK( parameters_getValue( PARAM_TANK_SIZE ) == 500 );
+  CHECK( parameters_getValue( PARAM_BRIGHTNESS ) == 10 );
+  CHECK( parameters_getValue( PARAM_PULSES_PER_LITER ) == 110 );
+  CHECK( parameters_getValue( PARAM_BUZZER ) == 0 );
+  CHECK( parameters_getValue( PARAM_VOLTAGE_ACCUM ) == 0 );
+}
+
+int main( void )
+{
+  param_persist_stats_t stats;
+
+  /* The first boot finds no image and writes one */
+  CHECK( !_load() );
+  CHECK( ( nvs.blob_len > 0 ) && ( nvs.commits == 1 ) );
+  nvs.commits = 0;
+  ParamPersist_Start();
+
+  /* A single edit waits for the quiet time */
+  _set( PARAM_TANK_SIZE, 500 );
+  _run_ms( PARAM_PERSIST_QUIET_MS - PARAM_PERSIST_CHECK_MS );
+  CHECK( nvs.commits == 0 );
+  _run_ms( PARAM_PERSIST_CHECK_MS );
+  CHECK( nvs.commits == 1 );
+  CHECK( nvs.sets == 2 );
+
+  /* A burst of edits is coalesced and held back by the commit rate limit */
+  for ( uint32_t i = 1; i <= 10; i++ )
+  {
+    _set( PARAM_BRIGHTNESS, i );
+    _set( PARAM_PULSES_PER_LITER, 100 + i );
+    _run_ms( 300 );
+  }
+  _run_ms( PARAM_PERSIST_QUIET_MS );
+  CHECK( nvs.commits == 1 );
+  _run_ms( PARAM_PERSIST_MIN_INTERVAL_MS );
+  CHECK( nvs.commits == 2 );
+  CHECK( nvs.sets == 4 );    // the config version went with the first commit
+  CHECK( !ParamPersist_IsPending() );
+
+  /* Runtime values never reach flash */
+  _set( PARAM_VOLTAGE_ACCUM, 41000 );
+  _set( PARAM_SILOS_LEVEL, 50 );
+  CHECK( !ParamPersist_IsPending() );
+  _run_ms( PARAM_PERSIST_MIN_INTERVAL_MS );
+  CHECK( nvs.commits == 2 );
+
+  /* Values equal to the flash copy are not written */
+  _set( PARAM_TANK_SIZE, 500 );
+  CHECK( ParamPersist_Flush() );
+  CHECK( nvs.commits == 2 );
+
+  /* Power off writes right away, a failed commit stays pending */
+  _set( PARAM_BUZZER, 0 );
+  nvs.fail_commit = true;
+  CHECK( !ParamPersist_Flush() );
+  CHECK( ParamPersist_IsPending() );
+  nvs.fail_commit = false;
+  CHECK( ParamPersist_Flush() );
+  CHECK( nvs.commits == 3 );
+
+  /* Boot applies the flash copy with one read of the image */
+  CHECK( nvs.blob_sets >= nvs.commits );    // with each commit, also the failed one
+  nvs.gets = 0;
+  nvs.blob_gets = 0;
+  _boot();
+  CHECK( ( nvs.blob_gets == 1 ) && ( nvs.gets == 0 ) );
+
+  /* A damaged image falls back to the keys and is written again */
+  nvs.blob[nvs.blob_len / 2] ^= 0x40;
+  uint32_t blob_sets = nvs.blob_sets;
+  _boot();
+  uint32_t key_reads = nvs.gets;
+  CHECK( key_reads > 0 );
+  CHECK( nvs.blob_sets == blob_sets + 1 );
+  nvs.gets = 0;
+  _boot();
+  CHECK( nvs.gets == 0 );
+
+  /* So does a flash written before there was an image */
+  nvs.blob_len = 0;
+  _boot();
+  CHECK( ( nvs.gets > 0 ) && ( nvs.blob_len > 0 ) );
+
+  /* A failed commit keeps the others in the next image */
+  _set( PARAM_TANK_SIZE, 700 );
+  nvs.fail_commit = true;
+  CHECK( !ParamPersist_Flush() );
+  nvs.fail_commit = false;
+  CHECK( ParamPersist_Flush() );
+  nvs.gets = 0;
+  CHECK( _load() );
+  CHECK( nvs.gets == 0 );
+  CHECK( parameters_getValue( PARAM_TANK_SIZE ) == 700 );
+  CHECK( parameters_getValue( PARAM_BRIGHTNESS ) == 10 );
+
+  /* Strings live in the image, a new one is written without any key */
+  uint32_t sets = nvs.sets;
+  uint32_t commits = nvs.commits;
+  parameters_setString( PARAM_STR_CONTROLLER_SN, "SN-0042" );
+  ParamPersist_MarkString( PARAM_STR_CONTROLLER_SN );
+  CHECK( ParamPersist_Flush() );
+  CHECK( ( nvs.sets == sets ) && ( nvs.commits == commits + 1 ) );
+  CHECK( _load() );
+  CHECK( strcmp( serial[PARAM_STR_CONTROLLER_SN], "SN-0042" ) == 0 );
+  CHECK( parameters_getValue( PARAM_TANK_SIZE ) == 700 );
+
+  ParamPersist_GetStats( &stats );
+  CHECK( stats.image_loads == 4 );
+  CHECK( stats.runtime_marks == 2 );
+  printf( "boot reads: 1 blob from the image, 1 blob and %u keys without\n", key_reads );
+  printf( "%u marks, %u commits, %u keys written, %u unchanged, %u errors, %u failed checks\n", stats.marks, stats.commits,
+          stats.keys_written, stats.keys_unchanged, stats.errors, errors );
+
+  return errors > 0 ? 1 : 0;
+}
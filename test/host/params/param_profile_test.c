@@ -0,0 +1,327 @@
+/*
+ * Host test of components/params/param_profile.c on a directory standing in
+ * for the storage partition.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_spiffs.h"
+#include "nvs.h"
+#include "param_persist.h"
+#include "param_profile.h"
+#include "param_snapshot.h"
+#include "param_store.h"
+
+#define NVS_KEYS_MAX 32
+#define NVS_BLOB_MAX 1024
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+static struct
+{
+  char keys[NVS_KEYS_MAX][16];
+  uint32_t values[NVS_KEYS_MAX];
+  uint32_t count;
+  uint8_t blob[NVS_BLOB_MAX];
+  size_t blob_len;
+} nvs;
+
+static uint32_t errors;
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+esp_err_t esp_vfs_spiffs_register( const esp_vfs_spiffs_conf_t* conf )
+{
+  (void) conf;
+  return ESP_OK;
+}
+
+esp_err_t esp_register_shutdown_handler( shutdown_handler_t handler )
+{
+  (void) handler;
+  return ESP_OK;
+}
+
+/* NVS, one namespace with the persisted keys and the image ------------------*/
+
+esp_err_t nvs_open( const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle )
+{
+  (void) name;
+  (void) open_mode;
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_u32( nvs_handle_t handle, const char* key, uint32_t* out_value )
+{
+  (void) handle;
+  for ( uint32_t i = 0; i < nvs.count; i++ )
+  {
+    if ( strcmp( nvs.keys[i], key ) == 0 )
+    {
+      *out_value = nvs.values[i];
+      return ESP_OK;
+    }
+  }
+
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_set_u32( nvs_handle_t handle, const char* key, uint32_t value )
+{
+  (void) handle;
+  uint32_t i;
+
+  for ( i = 0; ( i < nvs.count ) && ( strcmp( nvs.keys[i], key ) != 0 ); i++ )
+    ;
+
+  if ( i == NVS_KEYS_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  if ( i == nvs.count )
+  {
+    snprintf( nvs.keys[nvs.count++], sizeof( nvs.keys[0] ), "%s", key );
+  }
+
+  nvs.values[i] = value;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char* key, void* out_value, size_t* length )
+{
+  (void) handle;
+  (void) key;
+  if ( ( nvs.blob_len == 0 ) || ( nvs.blob_len > *length ) )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( out_value, nvs.blob, nvs.blob_len );
+  *length = nvs.blob_len;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char* key, const void* value, size_t length )
+{
+  (void) handle;
+  (void) key;
+  if ( length > NVS_BLOB_MAX )
+  {
+    return ESP_FAIL;
+  }
+
+  memcpy( nvs.blob, value, length );
+  nvs.blob_len = length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+  (void) handle;
+  return ESP_OK;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+  (void) handle;
+}
+
+/* Parameters -----------------------------------------------------------------*/
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  return ParamStore_Set( val, value );
+}
+
+uint32_t parameters_getMinValue( parameter_value_t val )
+{
+  return ParamStore_GetDef( val )->min;
+}
+
+uint32_t parameters_getMaxValue( parameter_value_t val )
+{
+  return ParamStore_GetDef( val )->max;
+}
+
+uint32_t parameters_getDefaultValue( parameter_value_t val )
+{
+  return ParamStore_GetDef( val )->def;
+}
+
+const char* parameters_getName( parameter_value_t val )
+{
+  const param_store_def_t* def = ParamStore_GetDef( val );
+  return def != NULL ? def->name : "";
+}
+
+bool parameters_getString( parameter_string_t val, char* str, uint32_t str_len )
+{
+  (void) val;
+  snprintf( str, str_len, "%s", "" );
+  return true;
+}
+
+bool parameters_setString( parameter_string_t val, const char* str )
+{
+  (void) val;
+  (void) str;
+  return true;
+}
+
+static uint32_t _marks( void )
+{
+  param_persist_stats_t stats;
+
+  ParamPersist_GetStats( &stats );
+  return stats.marks;
+}
+
+static void _set_recipe( uint32_t valves, uint32_t volume, uint32_t pwm, uint32_t pulses, uint32_t tank )
+{
+  for ( uint32_t v = 0; v < CFG_VALVE_CNT; v++ )
+  {
+    ParamStore_Set( PARAM_VALVE_1_STATE + v, ( valves >> v ) & 1 );
+  }
+  ParamStore_Set( PARAM_WATER_VOL_ADD, volume );
+  ParamStore_Set( PARAM_PWM_VALVE, pwm );
+  ParamStore_Set( PARAM_PULSES_PER_LITER, pulses );
+  ParamStore_Set( PARAM_TANK_SIZE, tank );
+}
+
+static bool _is_recipe( uint32_t valves, uint32_t volume, uint32_t pwm, uint32_t pulses, uint32_t tank )
+{
+  for ( uint32_t v = 0; v < CFG_VALVE_CNT; v++ )
+  {
+    if ( ParamStore_Get( PARAM_VALVE_1_STATE + v ) != ( ( valves >> v ) & 1 ) )
+    {
+      return false;
+    }
+  }
+
+  return ( ParamStore_Get( PARAM_WATER_VOL_ADD ) == volume ) && ( ParamStore_Get( PARAM_PWM_VALVE ) == pwm )
+         && ( ParamStore_Get( PARAM_PULSES_PER_LITER ) == pulses ) && ( ParamStore_Get( PARAM_TANK_SIZE ) == tank );
+}
+
+static void _corrupt( uint8_t slot, long offset )
+{
+  char path[64];
+
+  snprintf( path, sizeof( path ), PARAM_PROFILE_BASE_PATH "/prof%u.bin", slot );
+  FILE* f = fopen( path, "r+b" );
+  if ( f != NULL )
+  {
+    fseek( f, offset, SEEK_SET );
+    int c = fgetc( f );
+    fseek( f, offset, SEEK_SET );
+    fputc( c ^ 0x5A, f );
+    fclose( f );
+  }
+}
+
+int main( void )
+{
+  char name[PARAM_PROFILE_NAME_MAX];
+  uint8_t slot;
+
+  /* As the server controller boots, see MainApp_Start() */
+  ParamStore_Init();
+  if ( !ParamPersist_LoadImage() )
+  {
+    ParamPersist_Load();
+  }
+  ParamPersist_Start();
+  CHECK( !ParamProfile_Save( 1, "wheat" ) );    // not mounted yet
+  CHECK( ParamProfile_Init() );
+
+  /* Left over from an earlier run */
+  for ( uint8_t i = 1; i <= CFG_PROFILE_CNT; i++ )
+  {
+    ParamProfile_Delete( i );
+  }
+
+  /* Two recipes saved and switched between */
+  _set_recipe( 0x05, 300, 60, 450, 1000 );
+  CHECK( ParamProfile_Save( 1, "wheat" ) );
+  _set_recipe( 0x7A, 1200, 80, 900, 2000 );
+  CHECK( ParamProfile_Save( 2, "rapeseed" ) );
+
+  uint32_t marks = _marks();
+  CHECK( ParamProfile_Load( 1 ) );
+  CHECK( _is_recipe( 0x05, 300, 60, 450, 1000 ) );
+  CHECK( ParamStore_Get( PARAM_PROFILE_ACTIVE ) == 1 );
+  CHECK( _marks() == marks + 3 );    // the config values of the profile
+  CHECK( ParamProfile_Load( 2 ) );
+  CHECK( _is_recipe( 0x7A, 1200, 80, 900, 2000 ) );
+
+  /* The loaded profile survives a reboot, the valves and the volume are
+   * runtime values and start from their defaults */
+  CHECK( ParamPersist_Flush() );
+  ParamStore_Init();
+  CHECK( ParamPersist_LoadImage() );
+  CHECK( _is_recipe( 0x00, 100, 80, 900, 2000 ) );
+
+  /* Names */
+  CHECK( ParamProfile_GetName( 2, name, sizeof( name ) ) && ( strcmp( name, "rapeseed" ) == 0 ) );
+  CHECK( ParamProfile_Find( "wheat", &slot ) && ( slot == 1 ) );
+  CHECK( !ParamProfile_Find( "barley", &slot ) );
+  CHECK( !ParamProfile_Load( 3 ) );
+  CHECK( !ParamProfile_Load( 0 ) );
+  CHECK( !ParamProfile_Save( CFG_PROFILE_CNT + 1, NULL ) );
+
+  /* Commands through the trigger parameters */
+  ParamStore_Set( PARAM_PROFILE_SAVE, 3 );
+  ParamProfile_Process();
+  CHECK( ParamStore_Get( PARAM_PROFILE_SAVE ) == 0 );
+  CHECK( ParamProfile_GetName( 3, name, sizeof( name ) ) && ( strcmp( name, "profile 3" ) == 0 ) );
+  ParamStore_Set( PARAM_PROFILE_LOAD, 1 );
+  ParamProfile_Process();
+  CHECK( ParamStore_Get( PARAM_PROFILE_LOAD ) == 0 );
+  CHECK( _is_recipe( 0x05, 300, 60, 450, 1000 ) );
+  ParamProfile_Process();
+  CHECK( ParamStore_Get( PARAM_PROFILE_ACTIVE ) == 1 );
+
+  /* A damaged file changes nothing */
+  _corrupt( 2, 40 );
+  CHECK( !ParamProfile_Load( 2 ) );
+  CHECK( _is_recipe( 0x05, 300, 60, 450, 1000 ) );
+  CHECK( ParamStore_Get( PARAM_PROFILE_ACTIVE ) == 1 );
+
+  /* Overwriting keeps one file, deleting clears the active slot */
+  _set_recipe( 0x01, 100, 50, 100, 150 );
+  CHECK( ParamProfile_Save( 1, "wheat late" ) );
+  CHECK( ParamProfile_Load( 1 ) );
+  CHECK( _is_recipe( 0x01, 100, 50, 100, 150 ) );
+  CHECK( ParamProfile_Delete( 1 ) );
+  CHECK( ParamStore_Get( PARAM_PROFILE_ACTIVE ) == 0 );
+  CHECK( !ParamProfile_Load( 1 ) );
+
+  printf( "%u failed checks\n", errors );
+  return errors > 0 ? 1 : 0;
+}
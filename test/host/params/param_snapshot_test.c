@@ -0,0 +1,153 @@
+/*
+ * Test of components/params/param_snapshot.c: a writer thread changes a
+ * group as one update while the main thread takes snapshots of it, then
+ * restore and the CRC checks.
+ *
+ * usage: param_snapshot_test [iterations]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "param_snapshot.h"
+#include "param_store.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+PARAM_GROUP_DEFINE( start_data, "start_data",
+                    PARAM_VALVE_1_STATE, PARAM_VALVE_2_STATE, PARAM_VALVE_3_STATE, PARAM_VALVE_4_STATE,
+                    PARAM_VALVE_5_STATE, PARAM_VALVE_6_STATE, PARAM_VALVE_7_STATE, PARAM_WATER_VOL_ADD );
+
+PARAM_GROUP_DEFINE( dosing, "dosing", PARAM_ADD_WATER, PARAM_WATER_VOL_ADD, PARAM_PULSES_PER_LITER );
+
+static uint32_t errors;
+static uint32_t iterations = DEFAULT_ITERATIONS;
+static _Atomic bool writer_done;
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  return ParamStore_Set( val, value );
+}
+
+/* Every update sets all valves to the lowest bit of the volume */
+static void* _writer( void* arg )
+{
+  for ( uint32_t i = 1; i <= iterations; i++ )
+  {
+    ParamSnapshot_WriteBegin( &start_data );
+    for ( uint32_t v = 0; v < CFG_VALVE_CNT; v++ )
+    {
+      ParamStore_Set( PARAM_VALVE_1_STATE + v, i & 1 );
+    }
+    ParamStore_Set( PARAM_WATER_VOL_ADD, i & 0xFFFF );
+    ParamSnapshot_WriteEnd( &start_data );
+
+    if ( ( i % 64 ) == 0 )
+    {
+      sched_yield();
+    }
+  }
+
+  writer_done = true;
+  return NULL;
+}
+
+static bool _consistent( const param_snapshot_t* snapshot )
+{
+  for ( uint32_t v = 0; v < CFG_VALVE_CNT; v++ )
+  {
+    if ( snapshot->values[v] != ( snapshot->values[CFG_VALVE_CNT] & 1 ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main( int argc, char** argv )
+{
+  param_snapshot_t snapshot;
+  param_snapshot_t copy;
+  param_snapshot_stats_t stats;
+  pthread_t writer;
+  uint32_t taken = 0;
+  uint32_t torn = 0;
+
+  if ( argc > 1 )
+  {
+    iterations = strtoul( argv[1], NULL, 0 );
+  }
+
+  ParamStore_Init();
+  ParamStore_Set( PARAM_WATER_VOL_ADD, 0 );
+
+  /* Concurrent updates are seen whole or not at all */
+  pthread_create( &writer, NULL, _writer, NULL );
+  while ( !writer_done )
+  {
+    if ( ParamSnapshot_Read( &start_data, &snapshot ) )
+    {
+      taken++;
+      torn += _consistent( &snapshot ) ? 0 : 1;
+    }
+  }
+  pthread_join( writer, NULL );
+
+  CHECK( torn == 0 );
+  CHECK( taken > 0 );
+
+  /* Snapshots compare by CRC, restore writes the values back */
+  CHECK( ParamSnapshot_Read( &dosing, &snapshot ) );
+  CHECK( ParamSnapshot_IsValid( &snapshot ) );
+  ParamStore_Set( PARAM_PULSES_PER_LITER, 1234 );
+  CHECK( ParamSnapshot_Read( &dosing, &copy ) );
+  CHECK( !ParamSnapshot_Equal( &snapshot, &copy ) );
+  CHECK( ParamSnapshot_Restore( &snapshot ) );
+  CHECK( ParamStore_Get( PARAM_PULSES_PER_LITER ) == snapshot.values[2] );
+  CHECK( ParamSnapshot_Read( &dosing, &copy ) );
+  CHECK( ParamSnapshot_Equal( &snapshot, &copy ) );
+
+  /* A damaged snapshot is refused */
+  copy.values[1] ^= 1;
+  CHECK( !ParamSnapshot_IsValid( &copy ) );
+  CHECK( !ParamSnapshot_Restore( &copy ) );
+  CHECK( ParamStore_Get( PARAM_WATER_VOL_ADD ) == snapshot.values[1] );
+
+  /* A write in progress only holds off the groups of its parameters */
+  ParamSnapshot_WriteBegin( &dosing );
+  CHECK( !ParamSnapshot_Read( &dosing, &copy ) );
+  CHECK( !ParamSnapshot_Read( &start_data, &copy ) );    // shares the water volume
+  ParamSnapshot_WriteEnd( &dosing );
+  param_store_write_begin( PARAM_TANK_SIZE );
+  CHECK( ParamSnapshot_Read( &dosing, &copy ) );
+  CHECK( ParamSnapshot_Read( &start_data, &copy ) );
+  param_store_write_end( PARAM_TANK_SIZE );
+
+  /* Same values in another group are not equal */
+  CHECK( ParamSnapshot_Read( &start_data, &copy ) );
+  CHECK( !ParamSnapshot_Equal( &snapshot, &copy ) );
+
+  ParamSnapshot_GetStats( &stats );
+  printf( "%u snapshots during writes, %u reads, %u retries, %u failed, %u torn, %u failed checks\n", taken, stats.reads,
+          stats.retries, stats.failed, torn, errors );
+
+  return errors > 0 ? 1 : 0;
+}
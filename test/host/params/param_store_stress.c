@@ -0,0 +1,180 @@
+/*
+ * Stress test of components/params/param_store.c: writers, readers and
+ * trigger consumers on the same slots from many threads.
+ *
+ * usage: param_store_stress [iterations]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "param_store.h"
+
+#define WRITERS            4
+#define READERS            4
+#define TAKERS             4
+#define DEFAULT_ITERATIONS 200000
+
+typedef struct
+{
+  uint32_t id;
+  uint32_t iterations;
+  uint32_t errors;
+  uint32_t hops;
+} worker_t;
+
+static _Atomic uint32_t token_holders;
+static _Atomic bool writers_done;
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+/* Each writer stores its id and a rising sequence number, the setter gets
+ * values from both sides of the limits and rejects the ones outside */
+static void* _writer( void* arg )
+{
+  worker_t* worker = arg;
+
+  for ( uint32_t i = 1; i <= worker->iterations; i++ )
+  {
+    ParamStore_Set( PARAM_LAT_COUNT, ( worker->id << 24 ) | ( i & 0xFFFFFF ) );
+    ParamStore_Set( PARAM_PULSES_PER_LITER, ( i * 7919 ) % 20000 );
+    ParamStore_Set( PARAM_SILOS_HEIGHT, i );
+  }
+
+  return NULL;
+}
+
+/* Limits always hold and the sequence of every writer never goes back */
+static void* _reader( void* arg )
+{
+  worker_t* worker = arg;
+  uint32_t last_seq[WRITERS] = { 0 };
+
+  while ( !atomic_load( &writers_done ) )
+  {
+    uint32_t value = ParamStore_Get_PARAM_LAT_COUNT();
+    uint32_t writer = value >> 24;
+    uint32_t seq = value & 0xFFFFFF;
+
+    if ( value != 0 )
+    {
+      if ( ( writer >= WRITERS ) || ( seq < last_seq[writer] ) )
+      {
+        worker->errors++;
+      }
+      else
+      {
+        last_seq[writer] = seq;
+      }
+    }
+
+    uint32_t pulses = ParamStore_Get( PARAM_PULSES_PER_LITER );
+    if ( ( pulses < 10 ) || ( pulses > 10000 ) )
+    {
+      worker->errors++;
+    }
+
+    if ( ParamStore_Get_PARAM_SILOS_HEIGHT() > 300 )
+    {
+      worker->errors++;
+    }
+  }
+
+  return NULL;
+}
+
+/* A single trigger value passed around with take, it must never be held by
+ * two threads at once */
+static void* _taker( void* arg )
+{
+  worker_t* worker = arg;
+
+  for ( uint32_t i = 0; i < worker->iterations; i++ )
+  {
+    if ( ParamStore_Take( PARAM_TRACE_DUMP ) == 0 )
+    {
+      continue;
+    }
+
+    if ( atomic_fetch_add( &token_holders, 1 ) != 0 )
+    {
+      worker->errors++;
+    }
+    worker->hops++;
+    atomic_fetch_sub( &token_holders, 1 );
+
+    ParamStore_Set( PARAM_TRACE_DUMP, 1 );
+  }
+
+  return NULL;
+}
+
+int main( int argc, char** argv )
+{
+  uint32_t iterations = argc > 1 ? strtoul( argv[1], NULL, 0 ) : DEFAULT_ITERATIONS;
+  pthread_t threads[WRITERS + READERS + TAKERS];
+  worker_t workers[WRITERS + READERS + TAKERS] = { 0 };
+  uint32_t errors = 0;
+  uint32_t hops = 0;
+
+  ParamStore_Init();
+  ParamStore_Set( PARAM_TRACE_DUMP, 1 );
+
+  for ( uint32_t i = 0; i < WRITERS + READERS + TAKERS; i++ )
+  {
+    workers[i].iterations = iterations;
+  }
+
+  for ( uint32_t i = 0; i < READERS; i++ )
+  {
+    pthread_create( &threads[WRITERS + i], NULL, _reader, &workers[WRITERS + i] );
+  }
+
+  for ( uint32_t i = 0; i < TAKERS; i++ )
+  {
+    pthread_create( &threads[WRITERS + READERS + i], NULL, _taker, &workers[WRITERS + READERS + i] );
+  }
+
+  for ( uint32_t i = 0; i < WRITERS; i++ )
+  {
+    workers[i].id = i;
+    pthread_create( &threads[i], NULL, _writer, &workers[i] );
+  }
+
+  for ( uint32_t i = 0; i < WRITERS; i++ )
+  {
+    pthread_join( threads[i], NULL );
+  }
+  atomic_store( &writers_done, true );
+
+  for ( uint32_t i = WRITERS; i < WRITERS + READERS + TAKERS; i++ )
+  {
+    pthread_join( threads[i], NULL );
+  }
+
+  for ( uint32_t i = 0; i < WRITERS + READERS + TAKERS; i++ )
+  {
+    errors += workers[i].errors;
+    hops += workers[i].hops;
+  }
+
+  if ( ParamStore_Get( PARAM_TRACE_DUMP ) != 1 )
+  {
+    printf( "trigger lost\n" );
+    errors++;
+  }
+
+  if ( ParamStore_Set( PARAM_SILOS_HEIGHT, 301 ) || ( ParamStore_Get_PARAM_SILOS_HEIGHT() != 300 ) )
+  {
+    printf( "generic set took an out of range value\n" );
+    errors++;
+  }
+
+  printf( "%u threads, %u iterations, %u trigger hops, %u errors\n", WRITERS + READERS + TAKERS, iterations, hops, errors );
+
+  return errors > 0 ? 1 : 0;
+}
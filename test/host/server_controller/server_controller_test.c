@@ -0,0 +1,272 @@
+/*
+ * Host test of components/project_drv/server_conroller.c, its task loop run
+ * a given number of passes at a time against a simulated flow sensor: the
+ * field log gets one dose record per add water cycle, however it ends.
+ */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "error_valve.h"
+#include "field_log.h"
+#include "http_server.h"
+#include "measure.h"
+#include "param_profile.h"
+#include "param_store.h"
+#include "parameters.h"
+#include "pwm_drv.h"
+#include "server_controller.h"
+#include "stall_detect.h"
+#include "water_flow_sensor.h"
+
+#define FLOW_CL_PER_PASS 40
+
+#define CHECK( _cond )                                                   \
+  do                                                                     \
+  {                                                                      \
+    if ( !( _cond ) )                                                    \
+    {                                                                    \
+      printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond ); \
+      errors++;                                                          \
+    }                                                                    \
+  } while ( 0 )
+
+typedef struct
+{
+  bool measuring;
+  uint32_t cl;
+} flow_t;
+
+static uint32_t errors;
+static TaskFunction_t controller_task;
+static jmp_buf stop;
+static uint32_t passes;
+static uint32_t stop_pass;
+static flow_t flow;
+static uint32_t doses;
+static uint32_t last_dose_cl;
+
+/* Platform --------------------------------------------------------------------*/
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  va_list args;
+
+  (void) module_lvl;
+  (void) msg_lvl;
+  va_start( args, format );
+  vprintf( format, args );
+  printf( "\n" );
+  va_end( args );
+}
+
+const char* DevConfig_GetSerialNumber( void )
+{
+  return "SIM0001";
+}
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  return ParamStore_Get( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  return ParamStore_Set( val, value );
+}
+
+bool parameters_setString( parameter_string_t val, const char* str )
+{
+  (void) val;
+  (void) str;
+  return true;
+}
+
+int gpio_config( const gpio_config_t* config )
+{
+  (void) config;
+  return 0;
+}
+
+int gpio_set_level( gpio_num_t gpio, uint32_t level )
+{
+  (void) gpio;
+  (void) level;
+  return 0;
+}
+
+void PWMDrv_Init( pwm_drv_t* dev, const char* name, pwm_drv_duty_mode_t mode, uint32_t freq, int channel, int gpio )
+{
+  (void) mode;
+  (void) freq;
+  (void) channel;
+  (void) gpio;
+  dev->name = name;
+}
+
+void PWMDrv_SetDuty( pwm_drv_t* dev, float duty )
+{
+  dev->duty = duty;
+}
+
+bool HTTPServer_IsClientConnected( void )
+{
+  return true;
+}
+
+void measure_meas_calibration_value( void )
+{
+}
+
+void errorReset( void )
+{
+}
+
+void ParamProfile_Process( void )
+{
+}
+
+/* Flow sensor, each read while measuring sees one more pass of water */
+
+void WaterFlowSensor_Init( water_flow_sensor_t* dev, const char* name, uint32_t pulses_per_liter, water_flow_sensor_cb_t callback, int gpio )
+{
+  (void) gpio;
+  dev->name = name;
+  dev->pulses_per_liter = pulses_per_liter;
+  dev->callback = callback;
+}
+
+void WaterFlowSensor_StartMeasure( water_flow_sensor_t* dev )
+{
+  (void) dev;
+  flow.measuring = true;
+  flow.cl = 0;
+}
+
+void WaterFlowSensor_StopMeasure( water_flow_sensor_t* dev )
+{
+  (void) dev;
+  flow.measuring = false;
+}
+
+uint32_t WaterFlowSensor_GetValue( water_flow_sensor_t* dev )
+{
+  (void) dev;
+  if ( flow.measuring )
+  {
+    flow.cl += FLOW_CL_PER_PASS;
+  }
+
+  return flow.cl;
+}
+
+void WaterFlowSensor_SetPulsesPerLiter( water_flow_sensor_t* dev, uint32_t pulses_per_liter )
+{
+  dev->pulses_per_liter = pulses_per_liter;
+}
+
+void FieldLog_Record( field_log_type_t type, uint8_t arg, uint32_t value )
+{
+  (void) arg;
+  if ( type == FIELD_LOG_DOSE )
+  {
+    doses++;
+    last_dose_cl = value;
+  }
+}
+
+/* The controller task, one check in per pass of its loop ---------------------*/
+
+BaseType_t __wrap_xTaskCreate( TaskFunction_t task, const char* name, uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle )
+{
+  (void) name;
+  (void) stack;
+  (void) arg;
+  (void) prio;
+  (void) handle;
+  controller_task = task;
+  return pdPASS;
+}
+
+void StallDetect_Checkin( stall_watch_t* watch )
+{
+  (void) watch;
+  if ( passes++ == stop_pass )
+  {
+    longjmp( stop, 1 );
+  }
+}
+
+static void _run( uint32_t cnt )
+{
+  stop_pass = passes + cnt;
+  if ( setjmp( stop ) == 0 )
+  {
+    controller_task( NULL );
+  }
+}
+
+int main( void )
+{
+  ParamStore_Init();
+  srvrControllStart();
+  CHECK( controller_task != NULL );
+
+  _run( 1 );
+  parameters_setValue( PARAM_START_SYSTEM, 1 );
+  _run( 2 );
+  CHECK( srvrControllIsWorking() );
+
+  /* A cycle dosing its volume */
+  parameters_setValue( PARAM_WATER_VOL_ADD, 2 );
+  parameters_setValue( PARAM_ADD_WATER, 1 );
+  _run( 3 );
+  CHECK( doses == 0 );
+  CHECK( parameters_getValue( PARAM_VALVE_6_STATE ) == 1 );
+  _run( 20 );
+  CHECK( doses == 1 );
+  CHECK( last_dose_cl >= WATER_FLOW_CONVERT_L_TO_CL( 2 ) );
+  CHECK( parameters_getValue( PARAM_ADD_WATER ) == 0 );
+  CHECK( parameters_getValue( PARAM_VALVE_6_STATE ) == 0 );
+  _run( 20 );
+  CHECK( doses == 1 );
+
+  /* Stopped from the remote */
+  parameters_setValue( PARAM_WATER_VOL_ADD, 10 );
+  parameters_setValue( PARAM_ADD_WATER, 1 );
+  _run( 3 );
+  parameters_setValue( PARAM_ADD_WATER, 0 );
+  _run( 3 );
+  CHECK( doses == 2 );
+  CHECK( ( last_dose_cl > 0 ) && ( last_dose_cl < WATER_FLOW_CONVERT_L_TO_CL( 10 ) ) );
+
+  /* Cut by the emergency stop */
+  parameters_setValue( PARAM_ADD_WATER, 1 );
+  _run( 3 );
+  parameters_setValue( PARAM_EMERGENCY_DISABLE, 1 );
+  _run( 3 );
+  CHECK( !srvrControllIsWorking() );
+  CHECK( doses == 3 );
+  parameters_setValue( PARAM_ADD_WATER, 0 );
+  parameters_setValue( PARAM_EMERGENCY_DISABLE, 0 );
+  _run( 5 );
+  CHECK( srvrControllIsWorking() );
+  CHECK( doses == 3 );
+
+  /* Idle in the middle keeps the cycle, one record at its end */
+  parameters_setValue( PARAM_ADD_WATER, 1 );
+  _run( 2 );
+  parameters_setValue( PARAM_START_SYSTEM, 0 );
+  _run( 3 );
+  CHECK( !srvrControllIsWorking() );
+  CHECK( doses == 3 );
+  parameters_setValue( PARAM_START_SYSTEM, 1 );
+  _run( 30 );
+  CHECK( doses == 4 );
+  CHECK( last_dose_cl >= WATER_FLOW_CONVERT_L_TO_CL( 10 ) );
+
+  printf( "%u doses in %u passes, %u failed checks\n", doses, passes, errors );
+
+  return errors > 0 ? 1 : 0;
+}
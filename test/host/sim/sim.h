@@ -0,0 +1,81 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "menu_drv.h"
+#include "parameters.h"
+
+#define SIM_FB_ROW_BYTES ( SSD1306_WIDTH / 8 )
+#define SIM_FB_SIZE      ( SIM_FB_ROW_BYTES * SSD1306_HEIGHT )
+
+typedef enum
+{
+  SIM_BUTTON_UP,
+  SIM_BUTTON_DOWN,
+  SIM_BUTTON_ENTER,
+  SIM_BUTTON_EXIT,
+  SIM_BUTTON_UP_MINUS,
+  SIM_BUTTON_UP_PLUS,
+  SIM_BUTTON_DOWN_MINUS,
+  SIM_BUTTON_DOWN_PLUS,
+  SIM_BUTTON_MOTOR_ON,
+  SIM_BUTTON_ON_OFF,
+  SIM_BUTTON_TOP,
+} sim_button_t;
+
+typedef enum
+{
+  SIM_BUTTON_PRESS,
+  SIM_BUTTON_RELEASE,
+  SIM_BUTTON_HOLD,
+} sim_button_event_t;
+
+typedef struct
+{
+  bool link;             // access point in range, connect() succeeds
+  bool connected;
+  uint32_t connect_ms;   // virtual time a connect attempt takes
+  int rssi;
+  char ap_name[33];
+  char scan_list[8][33];
+  uint16_t scan_cnt;
+} sim_wifi_t;
+
+typedef struct
+{
+  float accum_voltage;
+  bool is_charging;
+} sim_battery_t;
+
+/* Virtual clock, only moved by delays, semaphore timeouts and the script */
+uint32_t Sim_GetTimeMs( void );
+void Sim_AdvanceMs( uint32_t ms );
+
+/* In-memory framebuffer, rows packed MSB first, set bit = lit pixel */
+const uint8_t* Sim_GetFramebuffer( void );
+uint32_t Sim_FramebufferCrc( void );
+uint32_t Sim_GetUpdateCnt( void );
+void Sim_SetUpdateHook( void ( *hook )( void ) );
+bool Sim_DumpPbm( const char* path );
+bool Sim_DumpPng( const char* path, uint32_t scale );
+uint32_t Sim_Crc32( uint32_t crc, const uint8_t* data, uint32_t len );
+
+/* Menu driver */
+void Sim_MenuDrvStep( void );
+menu_token_t* Sim_MenuDrvGetActive( void );
+void Sim_MenuDrvButton( sim_button_t button, sim_button_event_t event );
+void Sim_FastAddStep( void );
+
+/* Peripherals state, owned by the script */
+sim_wifi_t* Sim_Wifi( void );
+sim_battery_t* Sim_Battery( void );
+bool Sim_ParametersFind( const char* name, parameter_value_t* param );
+
+/* Per screen draw cost */
+void Sim_BenchRecord( menu_token_t* menu, uint64_t ns );
+void Sim_BenchReport( void );
+
+#endif
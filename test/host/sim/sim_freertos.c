@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sim.h"
+
+struct sim_semaphore
+{
+  bool given;
+  bool mutex;
+};
+
+struct sim_queue
+{
+  uint8_t* items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+};
+
+static uint32_t time_ms;
+
+uint32_t Sim_GetTimeMs( void )
+{
+  return time_ms;
+}
+
+void Sim_AdvanceMs( uint32_t ms )
+{
+  time_ms += ms;
+}
+
+int64_t esp_timer_get_time( void )
+{
+  return (int64_t) time_ms * 1000;
+}
+
+TickType_t xTaskGetTickCount( void )
+{
+  return pdMS_TO_TICKS( time_ms );
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+  /* Everything runs in the script loop */
+  return NULL;
+}
+
+char* pcTaskGetName( TaskHandle_t task )
+{
+  (void) task;
+  return "sim";
+}
+
+BaseType_t xTaskGetSchedulerState( void )
+{
+  return taskSCHEDULER_RUNNING;
+}
+
+void vTaskDelay( TickType_t ticks )
+{
+  Sim_AdvanceMs( ticks * portTICK_PERIOD_MS );
+}
+
+BaseType_t xTaskCreate( TaskFunction_t task, const char* name, uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle )
+{
+  /* Background tasks are not run, the script drives the peripherals state directly */
+  (void) task;
+  (void) name;
+  (void) stack;
+  (void) arg;
+  (void) prio;
+
+  if ( handle != NULL )
+  {
+    *handle = NULL;
+  }
+
+  return pdPASS;
+}
+
+void vTaskDelete( TaskHandle_t task )
+{
+  (void) task;
+}
+
+/* The one task of the script loop, which is never deleted */
+static void* tls[CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS];
+
+void* pvTaskGetThreadLocalStoragePointer( TaskHandle_t task, BaseType_t index )
+{
+  (void) task;
+  return tls[index];
+}
+
+void vTaskSetThreadLocalStoragePointerAndDelCallback( TaskHandle_t task, BaseType_t index, void* value,
+                                                      TlsDeleteCallbackFunction_t del )
+{
+  (void) task;
+  (void) del;
+  tls[index] = value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void )
+{
+  return calloc( 1, sizeof( struct sim_semaphore ) );
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex( void )
+{
+  SemaphoreHandle_t sem = calloc( 1, sizeof( struct sim_semaphore ) );
+  assert( sem );
+  sem->mutex = true;
+  sem->given = true;
+  return sem;
+}
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t sem, TickType_t ticks )
+{
+  assert( sem );
+
+  if ( sem->given )
+  {
+    sem->given = false;
+    return pdTRUE;
+  }
+
+  /* Nothing else runs, so nobody can give it while blocked */
+  if ( ticks != portMAX_DELAY )
+  {
+    vTaskDelay( ticks );
+  }
+
+  return pdFALSE;
+}
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t sem )
+{
+  assert( sem );
+
+  if ( sem->given && !sem->mutex )
+  {
+    return pdFALSE;
+  }
+
+  sem->given = true;
+  return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate( UBaseType_t length, UBaseType_t item_size )
+{
+  QueueHandle_t queue = calloc( 1, sizeof( struct sim_queue ) );
+  assert( queue );
+  queue->items = calloc( length, item_size );
+  assert( queue->items );
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+void vQueueDelete( QueueHandle_t queue )
+{
+  assert( queue );
+  free( queue->items );
+  free( queue );
+}
+
+/* Nothing else runs, a full or empty queue stays so while blocked */
+BaseType_t xQueueSend( QueueHandle_t queue, const void* item, TickType_t ticks )
+{
+  assert( queue );
+  (void) ticks;
+
+  if ( queue->count == queue->length )
+  {
+    return pdFALSE;
+  }
+
+  memcpy( &queue->items[( ( queue->head + queue->count ) % queue->length ) * queue->item_size], item, queue->item_size );
+  queue->count++;
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive( QueueHandle_t queue, void* item, TickType_t ticks )
+{
+  assert( queue );
+
+  if ( queue->count == 0 )
+  {
+    if ( ticks != portMAX_DELAY )
+    {
+      vTaskDelay( ticks );
+    }
+    return pdFALSE;
+  }
+
+  memcpy( item, &queue->items[queue->head * queue->item_size], queue->item_size );
+  queue->head = ( queue->head + 1 ) % queue->length;
+  queue->count--;
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting( QueueHandle_t queue )
+{
+  assert( queue );
+  return queue->count;
+}
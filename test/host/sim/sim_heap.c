@@ -0,0 +1,83 @@
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
+#include "heap_prof.h"
+#include "sim.h"
+
+/* The menu_sim link wraps malloc and friends (-Wl,--wrap), allocations made
+ * by the simulated firmware and the simulator itself go through the same
+ * heap profiler as the device heap hooks. Allocations inside libc are not
+ * seen. Free heap is what is left of SIM_HEAP_SIZE after the tracked bytes. */
+
+#define SIM_HEAP_SIZE ( 160 * 1024 )
+
+void* __real_malloc( size_t size );
+void* __real_calloc( size_t nmemb, size_t size );
+void* __real_realloc( void* ptr, size_t size );
+void __real_free( void* ptr );
+
+static uint32_t min_free = SIM_HEAP_SIZE;
+
+static void _update_min_free( void )
+{
+  uint32_t free = heap_caps_get_free_size( MALLOC_CAP_8BIT );
+
+  if ( free < min_free )
+  {
+    min_free = free;
+  }
+}
+
+void* __wrap_malloc( size_t size )
+{
+  void* ptr = __real_malloc( size );
+  HeapProf_OnAlloc( ptr, size );
+  _update_min_free();
+  return ptr;
+}
+
+void* __wrap_calloc( size_t nmemb, size_t size )
+{
+  void* ptr = __real_calloc( nmemb, size );
+  HeapProf_OnAlloc( ptr, nmemb * size );
+  _update_min_free();
+  return ptr;
+}
+
+void* __wrap_realloc( void* ptr, size_t size )
+{
+  void* new_ptr = __real_realloc( ptr, size );
+
+  if ( ( new_ptr != NULL ) || ( size == 0 ) )
+  {
+    HeapProf_OnFree( ptr );
+    HeapProf_OnAlloc( new_ptr, size );
+    _update_min_free();
+  }
+
+  return new_ptr;
+}
+
+void __wrap_free( void* ptr )
+{
+  HeapProf_OnFree( ptr );
+  __real_free( ptr );
+}
+
+size_t heap_caps_get_free_size( uint32_t caps )
+{
+  (void) caps;
+  uint32_t used = HeapProf_GetCurrent();
+  return used < SIM_HEAP_SIZE ? SIM_HEAP_SIZE - used : 0;
+}
+
+size_t heap_caps_get_minimum_free_size( uint32_t caps )
+{
+  (void) caps;
+  return min_free;
+}
+
+size_t heap_caps_get_largest_free_block( uint32_t caps )
+{
+  return heap_caps_get_free_size( caps );
+}
@@ -0,0 +1,497 @@
+/*
+ * Host build of the remote menus driven by a button script.
+ *
+ * usage: menu_sim [-o out_dir] [-b] [-r] script
+ *   -o  directory for dump files (default: current directory)
+ *   -b  print per screen draw cost at exit
+ *   -r  record every frame as out_dir/frame_NNNNN.pbm
+ *
+ * Script commands, one per line, '#' starts a comment:
+ *   init normal|low_battery     start the menu driver like main.c does
+ *   frames <n>                  run n frames
+ *   wait <ms>                   run frames until ms of virtual time passed
+ *   press|release|hold <button> fall, rise or timer callback of a button
+ *   click <button>              press and release
+ *   param <name> <value>        set a parameter by its list name
+ *   set <key> <value>           wifi_link, rssi, battery_mv, charging, connect_ms
+ *   scan <ap name>              add an access point to the scan result
+ *   dump <name>                 write <name>.pbm and <name>.png
+ *   trace_dump <name>           write the trace ring to <name>.bin
+ *   link <rssi> <ms> ok|timeout|fail
+ *                               record a parameters client request
+ *   link_dump <name>            write the link latency table to <name>.csv
+ *   heap mark|check|sample      remember the tracked heap, fail if it differs
+ *                               from the mark, run the periodic heap sample
+ *   expect_crc <hex>            compare the framebuffer crc32
+ *   expect_screen <text>        compare the active menu name
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dictionary.h"
+#include "freertos/task.h"
+#include "heap_prof.h"
+#include "link_stats.h"
+#include "menu_backend.h"
+#include "oled.h"
+#include "sim.h"
+#include "trace.h"
+
+#define SCRIPT_LINE_SIZE 256
+#define PNG_SCALE        4
+
+typedef struct
+{
+  const char* out_dir;
+  bool record;
+  uint32_t recorded;
+  uint32_t errors;
+  const char* script;
+  uint32_t line;
+} sim_main_t;
+
+static sim_main_t ctx = { .out_dir = "." };
+
+static uint32_t heap_mark;
+
+static const char* button_name[] =
+  {
+    [SIM_BUTTON_UP] = "up",
+    [SIM_BUTTON_DOWN] = "down",
+    [SIM_BUTTON_ENTER] = "enter",
+    [SIM_BUTTON_EXIT] = "exit",
+    [SIM_BUTTON_UP_MINUS] = "up_minus",
+    [SIM_BUTTON_UP_PLUS] = "up_plus",
+    [SIM_BUTTON_DOWN_MINUS] = "down_minus",
+    [SIM_BUTTON_DOWN_PLUS] = "down_plus",
+    [SIM_BUTTON_MOTOR_ON] = "motor_on",
+    [SIM_BUTTON_ON_OFF] = "on_off",
+};
+
+static void _error( const char* format, const char* arg )
+{
+  fprintf( stderr, "%s:%u: ", ctx.script, ctx.line );
+  fprintf( stderr, format, arg );
+  fprintf( stderr, "\n" );
+  ctx.errors++;
+}
+
+static void _record_frame( void )
+{
+  char path[512];
+
+  snprintf( path, sizeof( path ), "%s/frame_%05u.pbm", ctx.out_dir, ctx.recorded++ );
+  Sim_DumpPbm( path );
+}
+
+static bool _find_button( const char* name, sim_button_t* button )
+{
+  for ( int i = 0; i < SIM_BUTTON_TOP; i++ )
+  {
+    if ( strcmp( button_name[i], name ) == 0 )
+    {
+      *button = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void _run_frames( uint32_t cnt )
+{
+  while ( cnt-- > 0 )
+  {
+    Sim_MenuDrvStep();
+  }
+}
+
+static void _wait( uint32_t ms )
+{
+  uint32_t start = Sim_GetTimeMs();
+
+  while ( Sim_GetTimeMs() - start < ms )
+  {
+    Sim_MenuDrvStep();
+  }
+}
+
+static void _init( const char* arg )
+{
+  parameters_init();
+  oled_init();
+  dictionary_init();
+  menuBackendInit();
+
+  if ( strcmp( arg, "low_battery" ) == 0 )
+  {
+    menuDrvInit( MENU_DRV_LOW_BATTERY_INIT, backendToggleEmergencyDisable );
+  }
+  else
+  {
+    menuDrvInit( MENU_DRV_NORMAL_INIT, backendToggleEmergencyDisable );
+  }
+}
+
+static void _set( const char* key, const char* value )
+{
+  long num = strtol( value, NULL, 0 );
+
+  if ( strcmp( key, "wifi_link" ) == 0 )
+  {
+    Sim_Wifi()->link = num != 0;
+    if ( !Sim_Wifi()->link )
+    {
+      Sim_Wifi()->connected = false;
+    }
+  }
+  else if ( strcmp( key, "rssi" ) == 0 )
+  {
+    Sim_Wifi()->rssi = num;
+  }
+  else if ( strcmp( key, "connect_ms" ) == 0 )
+  {
+    Sim_Wifi()->connect_ms = num;
+  }
+  else if ( strcmp( key, "battery_mv" ) == 0 )
+  {
+    Sim_Battery()->accum_voltage = num / 1000.0f;
+  }
+  else if ( strcmp( key, "charging" ) == 0 )
+  {
+    Sim_Battery()->is_charging = num != 0;
+  }
+  else
+  {
+    _error( "unknown key '%s'", key );
+  }
+}
+
+static void _dump( const char* name )
+{
+  char path[512];
+
+  snprintf( path, sizeof( path ), "%s/%s.pbm", ctx.out_dir, name );
+  if ( !Sim_DumpPbm( path ) )
+  {
+    _error( "cannot write '%s'", path );
+  }
+
+  snprintf( path, sizeof( path ), "%s/%s.png", ctx.out_dir, name );
+  if ( !Sim_DumpPng( path, PNG_SCALE ) )
+  {
+    _error( "cannot write '%s'", path );
+  }
+}
+
+static void _trace_write( const void* data, uint32_t len, void* arg )
+{
+  if ( fwrite( data, 1, len, arg ) != len )
+  {
+    _error( "%s", "trace dump write failed" );
+  }
+}
+
+static void _trace_dump( const char* name )
+{
+  char path[512];
+
+  snprintf( path, sizeof( path ), "%s/%s.bin", ctx.out_dir, name );
+  FILE* file = fopen( path, "wb" );
+  if ( file == NULL )
+  {
+    _error( "cannot write '%s'", path );
+    return;
+  }
+
+  Trace_Dump( _trace_write, file );
+  fclose( file );
+}
+
+static void _link_write( const char* line, void* arg )
+{
+  fprintf( arg, "%s\n", line );
+}
+
+static void _link( char* arg )
+{
+  static const char* result_name[] = {
+    [LINK_RESULT_OK] = "ok",
+    [LINK_RESULT_TIMEOUT] = "timeout",
+    [LINK_RESULT_FAIL] = "fail" };
+  char* rssi = strtok( arg, " \t" );
+  char* ms = strtok( NULL, " \t" );
+  char* result = strtok( NULL, " \t" );
+
+  if ( ( rssi == NULL ) || ( ms == NULL ) || ( result == NULL ) )
+  {
+    _error( "%s", "link needs <rssi> <ms> <result>" );
+    return;
+  }
+
+  for ( int i = 0; i < sizeof( result_name ) / sizeof( result_name[0] ); i++ )
+  {
+    if ( strcmp( result, result_name[i] ) == 0 )
+    {
+      LinkStats_Record( atoi( rssi ), strtoul( ms, NULL, 10 ) * 1000, i );
+      return;
+    }
+  }
+
+  _error( "unknown link result '%s'", result );
+}
+
+static void _link_dump( const char* name )
+{
+  char path[512];
+
+  snprintf( path, sizeof( path ), "%s/%s.csv", ctx.out_dir, name );
+  FILE* file = fopen( path, "w" );
+  if ( file == NULL )
+  {
+    _error( "cannot write '%s'", path );
+    return;
+  }
+
+  LinkStats_Export( _link_write, file );
+  fclose( file );
+}
+
+static void _heap( const char* arg )
+{
+  if ( strcmp( arg, "mark" ) == 0 )
+  {
+    heap_mark = HeapProf_GetCurrent();
+  }
+  else if ( strcmp( arg, "check" ) == 0 )
+  {
+    if ( HeapProf_GetCurrent() != heap_mark )
+    {
+      char leak[16];
+      snprintf( leak, sizeof( leak ), "%d", (int) ( HeapProf_GetCurrent() - heap_mark ) );
+      HeapProf_Print();
+      _error( "heap changed by %s bytes since the mark", leak );
+    }
+  }
+  else if ( strcmp( arg, "sample" ) == 0 )
+  {
+    HeapProf_Sample();
+  }
+  else
+  {
+    _error( "unknown heap command '%s'", arg );
+  }
+}
+
+static void _expect_crc( const char* arg )
+{
+  uint32_t expected = strtoul( arg, NULL, 16 );
+  uint32_t crc = Sim_FramebufferCrc();
+
+  if ( crc != expected )
+  {
+    char actual[16];
+    snprintf( actual, sizeof( actual ), "%08x", crc );
+    _error( "framebuffer crc %s", actual );
+  }
+}
+
+static void _expect_screen( const char* arg )
+{
+  menu_token_t* menu = Sim_MenuDrvGetActive();
+  const char* name = menu != NULL ? dictionary_get_string( menu->name_dict ) : "";
+
+  if ( strcmp( name, arg ) != 0 )
+  {
+    _error( "active screen '%s'", name );
+  }
+}
+
+static void _execute( char* line )
+{
+  char* cmd = strtok( line, " \t\r\n" );
+  char* arg = strtok( NULL, "\r\n" );
+  char* arg2 = NULL;
+  sim_button_t button;
+
+  if ( ( cmd == NULL ) || ( cmd[0] == '#' ) )
+  {
+    return;
+  }
+
+  if ( arg != NULL )
+  {
+    arg += strspn( arg, " \t" );
+  }
+
+  if ( arg == NULL || *arg == '\0' )
+  {
+    _error( "missing argument for '%s'", cmd );
+    return;
+  }
+
+  if ( ( strcmp( cmd, "param" ) == 0 ) || ( strcmp( cmd, "set" ) == 0 ) )
+  {
+    arg = strtok( arg, " \t" );
+    arg2 = strtok( NULL, " \t" );
+    if ( arg2 == NULL )
+    {
+      _error( "missing value for '%s'", arg );
+      return;
+    }
+  }
+
+  if ( strcmp( cmd, "init" ) == 0 )
+  {
+    _init( arg );
+  }
+  else if ( strcmp( cmd, "frames" ) == 0 )
+  {
+    _run_frames( strtoul( arg, NULL, 0 ) );
+  }
+  else if ( strcmp( cmd, "wait" ) == 0 )
+  {
+    _wait( strtoul( arg, NULL, 0 ) );
+  }
+  else if ( ( strcmp( cmd, "press" ) == 0 ) || ( strcmp( cmd, "release" ) == 0 ) || ( strcmp( cmd, "hold" ) == 0 )
+            || ( strcmp( cmd, "click" ) == 0 ) )
+  {
+    if ( !_find_button( arg, &button ) )
+    {
+      _error( "unknown button '%s'", arg );
+    }
+    else if ( strcmp( cmd, "click" ) == 0 )
+    {
+      Sim_MenuDrvButton( button, SIM_BUTTON_PRESS );
+      Sim_MenuDrvButton( button, SIM_BUTTON_RELEASE );
+    }
+    else
+    {
+      Sim_MenuDrvButton( button, cmd[0] == 'p' ? SIM_BUTTON_PRESS : cmd[0] == 'r' ? SIM_BUTTON_RELEASE
+                                                                                  : SIM_BUTTON_HOLD );
+    }
+  }
+  else if ( strcmp( cmd, "param" ) == 0 )
+  {
+    parameter_value_t param;
+    if ( !Sim_ParametersFind( arg, &param ) )
+    {
+      _error( "unknown parameter '%s'", arg );
+    }
+    else if ( !parameters_setValue( param, strtoul( arg2, NULL, 0 ) ) )
+    {
+      _error( "value out of range for '%s'", arg );
+    }
+  }
+  else if ( strcmp( cmd, "set" ) == 0 )
+  {
+    _set( arg, arg2 );
+  }
+  else if ( strcmp( cmd, "scan" ) == 0 )
+  {
+    sim_wifi_t* wifi = Sim_Wifi();
+    if ( wifi->scan_cnt < sizeof( wifi->scan_list ) / sizeof( wifi->scan_list[0] ) )
+    {
+      snprintf( wifi->scan_list[wifi->scan_cnt++], sizeof( wifi->scan_list[0] ), "%s", arg );
+    }
+  }
+  else if ( strcmp( cmd, "dump" ) == 0 )
+  {
+    _dump( arg );
+  }
+  else if ( strcmp( cmd, "trace_dump" ) == 0 )
+  {
+    _trace_dump( arg );
+  }
+  else if ( strcmp( cmd, "link" ) == 0 )
+  {
+    _link( arg );
+  }
+  else if ( strcmp( cmd, "link_dump" ) == 0 )
+  {
+    _link_dump( arg );
+  }
+  else if ( strcmp( cmd, "heap" ) == 0 )
+  {
+    _heap( arg );
+  }
+  else if ( strcmp( cmd, "expect_crc" ) == 0 )
+  {
+    _expect_crc( arg );
+  }
+  else if ( strcmp( cmd, "expect_screen" ) == 0 )
+  {
+    _expect_screen( arg );
+  }
+  else
+  {
+    _error( "unknown command '%s'", cmd );
+  }
+}
+
+int main( int argc, char** argv )
+{
+  bool bench = false;
+  int opt;
+
+  while ( ( opt = getopt( argc, argv, "o:br" ) ) != -1 )
+  {
+    switch ( opt )
+    {
+      case 'o':
+        ctx.out_dir = optarg;
+        break;
+
+      case 'b':
+        bench = true;
+        break;
+
+      case 'r':
+        ctx.record = true;
+        break;
+
+      default:
+        fprintf( stderr, "usage: %s [-o out_dir] [-b] [-r] script\n", argv[0] );
+        return 2;
+    }
+  }
+
+  if ( optind >= argc )
+  {
+    fprintf( stderr, "usage: %s [-o out_dir] [-b] [-r] script\n", argv[0] );
+    return 2;
+  }
+
+  ctx.script = argv[optind];
+  FILE* file = fopen( ctx.script, "r" );
+
+  if ( file == NULL )
+  {
+    fprintf( stderr, "%s: %s\n", ctx.script, strerror( errno ) );
+    return 2;
+  }
+
+  if ( ctx.record )
+  {
+    Sim_SetUpdateHook( _record_frame );
+  }
+
+  char line[SCRIPT_LINE_SIZE];
+  while ( fgets( line, sizeof( line ), file ) != NULL )
+  {
+    ctx.line++;
+    _execute( line );
+  }
+
+  fclose( file );
+
+  if ( bench )
+  {
+    Sim_BenchReport();
+  }
+
+  return ctx.errors == 0 ? 0 : 1;
+}
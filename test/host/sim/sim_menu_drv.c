@@ -0,0 +1,299 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "freertos/task.h"
+#include "oled.h"
+#include "sim.h"
+
+#define MENU_STACK_SIZE 8
+
+extern void menuInitBootUpMenu( void );
+
+typedef struct
+{
+  menu_token_t* active;
+  menu_token_t* main;
+  menu_token_t* stack[MENU_STACK_SIZE];
+  uint8_t depth;
+  bool emergency_disable;
+
+  void ( *emergency_disable_cb )( void );
+  const char* ( *get_msg_cb )( menuDrvMsg_t msg );
+  void ( *draw_battery_cb )( uint8_t x, uint8_t y, float accum_voltage, bool is_charging );
+  void ( *draw_signal_cb )( uint8_t x, uint8_t y, uint8_t signal_lvl );
+} sim_menu_drv_t;
+
+static sim_menu_drv_t ctx;
+
+static void _activate( menu_token_t* menu )
+{
+  memset( &menu->button, 0, sizeof( menu->button ) );
+
+  if ( menu->menu_cb.enter != NULL )
+  {
+    menu->menu_cb.enter( menu );
+  }
+
+  if ( menu->menu_cb.button_init_cb != NULL )
+  {
+    menu->menu_cb.button_init_cb( menu );
+  }
+
+  ctx.active = menu;
+}
+
+static void _leave( menu_token_t* menu )
+{
+  if ( ( menu != NULL ) && ( menu->menu_cb.exit != NULL ) )
+  {
+    menu->menu_cb.exit( menu );
+  }
+}
+
+static uint8_t _signal_lvl( void )
+{
+  static const int rssi_lvl[] = { -90, -80, -72, -65, -55 };
+  sim_wifi_t* wifi = Sim_Wifi();
+  uint8_t lvl = 0;
+
+  if ( !wifi->connected )
+  {
+    return 0;
+  }
+
+  while ( ( lvl < sizeof( rssi_lvl ) / sizeof( rssi_lvl[0] ) ) && ( wifi->rssi >= rssi_lvl[lvl] ) )
+  {
+    lvl++;
+  }
+
+  return lvl;
+}
+
+static void _draw_status_bar( void )
+{
+  if ( ctx.draw_signal_cb != NULL )
+  {
+    ctx.draw_signal_cb( SSD1306_WIDTH - 27, 0, _signal_lvl() );
+  }
+
+  if ( ctx.draw_battery_cb != NULL )
+  {
+    ctx.draw_battery_cb( SSD1306_WIDTH - 12, 0, Sim_Battery()->accum_voltage, Sim_Battery()->is_charging );
+  }
+}
+
+void menuDrvInit( menu_drv_init_t init_type, void ( *emergency_disable_cb )( void ) )
+{
+  ctx.emergency_disable_cb = emergency_disable_cb;
+
+  if ( init_type == MENU_DRV_NORMAL_INIT )
+  {
+    menuInitBootUpMenu();
+  }
+  else
+  {
+    mainMenuInit( MENU_DRV_LOW_BATTERY_INIT );
+  }
+}
+
+void menuEnter( menu_token_t* menu )
+{
+  assert( menu );
+
+  if ( ctx.active != NULL )
+  {
+    _leave( ctx.active );
+    if ( ctx.depth < MENU_STACK_SIZE )
+    {
+      ctx.stack[ctx.depth++] = ctx.active;
+    }
+  }
+
+  _activate( menu );
+}
+
+void menuDrv_Exit( menu_token_t* menu )
+{
+  _leave( menu );
+
+  menu_token_t* prev = ctx.depth > 0 ? ctx.stack[--ctx.depth] : ctx.main;
+
+  if ( prev != NULL )
+  {
+    _activate( prev );
+  }
+}
+
+void menuSetMain( menu_token_t* menu )
+{
+  assert( menu );
+
+  if ( ( ctx.active != NULL ) && ( ctx.active != menu ) )
+  {
+    _leave( ctx.active );
+  }
+
+  ctx.main = menu;
+  ctx.depth = 0;
+  _activate( menu );
+}
+
+int menuDrvElementsCnt( menu_token_t* menu )
+{
+  int cnt = 0;
+
+  if ( ( menu == NULL ) || ( menu->menu_list == NULL ) )
+  {
+    return 0;
+  }
+
+  while ( menu->menu_list[cnt] != NULL )
+  {
+    cnt++;
+  }
+
+  return cnt;
+}
+
+void menuPrintfInfo( const char* format, ... )
+{
+  char buff[64];
+  va_list args;
+
+  va_start( args, format );
+  vsnprintf( buff, sizeof( buff ), format, args );
+  va_end( args );
+
+  oled_printFixed( 2, MENU_HEIGHT, buff, OLED_FONT_SIZE_11 );
+}
+
+void menuDrvSaveParameters( void )
+{
+  parameters_save();
+}
+
+void menuDrvEnterEmergencyDisable( void )
+{
+  ctx.emergency_disable = true;
+}
+
+void menuDrvExitEmergencyDisable( void )
+{
+  ctx.emergency_disable = false;
+}
+
+void menuDrvSetGetMsgCb( const char* ( *cb )( menuDrvMsg_t msg ) )
+{
+  ctx.get_msg_cb = cb;
+}
+
+void menuDrvSetDrawBatteryCb( void ( *cb )( uint8_t x, uint8_t y, float accum_voltage, bool is_charging ) )
+{
+  ctx.draw_battery_cb = cb;
+}
+
+void menuDrvSetDrawSignalCb( void ( *cb )( uint8_t x, uint8_t y, uint8_t signal_lvl ) )
+{
+  ctx.draw_signal_cb = cb;
+}
+
+menu_token_t* Sim_MenuDrvGetActive( void )
+{
+  return ctx.active;
+}
+
+void Sim_MenuDrvStep( void )
+{
+  menu_token_t* menu = ctx.active;
+
+  if ( menu == NULL )
+  {
+    vTaskDelay( MS2ST( 1000 / MENU_TARGET_FPS ) );
+    return;
+  }
+
+  if ( ctx.emergency_disable )
+  {
+    oled_clearScreen();
+    if ( ctx.get_msg_cb != NULL )
+    {
+      oled_printFixed( 2, MENU_HEIGHT, ctx.get_msg_cb( MENU_DRV_MSG_MENU_STOP ), OLED_FONT_SIZE_11 );
+    }
+    vTaskDelay( MS2ST( 1000 / MENU_TARGET_FPS ) );
+  }
+  else if ( menu->menu_cb.process != NULL )
+  {
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    oled_clearScreen();
+    menu->menu_cb.process( menu );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    Sim_BenchRecord( menu, (uint64_t) ( end.tv_sec - start.tv_sec ) * 1000000000ull + end.tv_nsec - start.tv_nsec );
+  }
+
+  _draw_status_bar();
+  oled_update();
+  Sim_FastAddStep();
+}
+
+void Sim_MenuDrvButton( sim_button_t button, sim_button_event_t event )
+{
+  menu_token_t* menu = ctx.active;
+
+  if ( menu == NULL )
+  {
+    return;
+  }
+
+  menu_button_t* buttons[] =
+    {
+      [SIM_BUTTON_UP] = &menu->button.up,
+      [SIM_BUTTON_DOWN] = &menu->button.down,
+      [SIM_BUTTON_ENTER] = &menu->button.enter,
+      [SIM_BUTTON_EXIT] = &menu->button.exit,
+      [SIM_BUTTON_UP_MINUS] = &menu->button.up_minus,
+      [SIM_BUTTON_UP_PLUS] = &menu->button.up_plus,
+      [SIM_BUTTON_DOWN_MINUS] = &menu->button.down_minus,
+      [SIM_BUTTON_DOWN_PLUS] = &menu->button.down_plus,
+      [SIM_BUTTON_MOTOR_ON] = &menu->button.motor_on,
+      [SIM_BUTTON_ON_OFF] = &menu->button.on_off,
+    };
+
+  if ( button >= SIM_BUTTON_TOP )
+  {
+    return;
+  }
+
+  menu_button_t* but = buttons[button];
+
+  switch ( event )
+  {
+    case SIM_BUTTON_PRESS:
+      if ( but->fall_callback != NULL )
+      {
+        but->fall_callback( menu );
+      }
+      break;
+
+    case SIM_BUTTON_RELEASE:
+      if ( but->rise_callback != NULL )
+      {
+        but->rise_callback( menu );
+      }
+      break;
+
+    case SIM_BUTTON_HOLD:
+      if ( but->timer_callback != NULL )
+      {
+        but->timer_callback( menu );
+      }
+      break;
+
+    default:
+      break;
+  }
+}
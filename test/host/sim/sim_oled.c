@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "oled.h"
+#include "sim.h"
+#include "sim_font.h"
+#include "ssd1306.h"
+
+typedef struct
+{
+  uint8_t fb[SIM_FB_SIZE];
+  enum oledFontSize font;
+  uint32_t update_cnt;
+  void ( *update_hook )( void );
+} sim_oled_t;
+
+static sim_oled_t ctx;
+
+/* Glyph cell scale per font, the sizes only have to be close to the target fonts */
+static const struct
+{
+  uint8_t x;
+  uint8_t y;
+} font_scale[] =
+  {
+    [OLED_FONT_SIZE_11] = { 1, 1 },
+    [OLED_FONT_SIZE_16] = { 1, 2 },
+    [OLED_FONT_SIZE_26] = { 2, 3 },
+};
+
+static const struct
+{
+  uint32_t code;
+  char ascii;
+} latin_map[] =
+  {
+    { 0x0104, 'A' },
+    { 0x0105, 'a' },
+    { 0x0106, 'C' },
+    { 0x0107, 'c' },
+    { 0x0118, 'E' },
+    { 0x0119, 'e' },
+    { 0x0141, 'L' },
+    { 0x0142, 'l' },
+    { 0x0143, 'N' },
+    { 0x0144, 'n' },
+    { 0x00D3, 'O' },
+    { 0x00F3, 'o' },
+    { 0x015A, 'S' },
+    { 0x015B, 's' },
+    { 0x0179, 'Z' },
+    { 0x017A, 'z' },
+    { 0x017B, 'Z' },
+    { 0x017C, 'z' },
+    { 0x00C4, 'A' },
+    { 0x00E4, 'a' },
+    { 0x00D6, 'O' },
+    { 0x00F6, 'o' },
+    { 0x00DC, 'U' },
+    { 0x00FC, 'u' },
+    { 0x00DF, 's' },
+};
+
+static void _set_pixel( int x, int y, bool on )
+{
+  if ( ( x < 0 ) || ( y < 0 ) || ( x >= SSD1306_WIDTH ) || ( y >= SSD1306_HEIGHT ) )
+  {
+    return;
+  }
+
+  uint8_t mask = 0x80 >> ( x % 8 );
+
+  if ( on )
+  {
+    ctx.fb[y * SIM_FB_ROW_BYTES + x / 8] |= mask;
+  }
+  else
+  {
+    ctx.fb[y * SIM_FB_ROW_BYTES + x / 8] &= ~mask;
+  }
+}
+
+static const char* _next_char( const char* str, char* out )
+{
+  uint8_t c = (uint8_t) *str++;
+
+  if ( c < 0x80 )
+  {
+    *out = c;
+    return str;
+  }
+
+  uint32_t code = 0;
+  int extra = 0;
+
+  if ( ( c & 0xE0 ) == 0xC0 )
+  {
+    code = c & 0x1F;
+    extra = 1;
+  }
+  else if ( ( c & 0xF0 ) == 0xE0 )
+  {
+    code = c & 0x0F;
+    extra = 2;
+  }
+  else if ( ( c & 0xF8 ) == 0xF0 )
+  {
+    code = c & 0x07;
+    extra = 3;
+  }
+
+  while ( extra-- > 0 && ( ( (uint8_t) *str & 0xC0 ) == 0x80 ) )
+  {
+    code = ( code << 6 ) | ( (uint8_t) *str++ & 0x3F );
+  }
+
+  *out = '?';
+  for ( size_t i = 0; i < sizeof( latin_map ) / sizeof( latin_map[0] ); i++ )
+  {
+    if ( latin_map[i].code == code )
+    {
+      *out = latin_map[i].ascii;
+      break;
+    }
+  }
+
+  return str;
+}
+
+static void _print( uint8_t x, uint8_t y, const char* str, enum oledFontSize size, bool on )
+{
+  if ( str == NULL )
+  {
+    return;
+  }
+
+  uint8_t sx = font_scale[size].x;
+  uint8_t sy = font_scale[size].y;
+  int cx = x;
+  int cy = y;
+
+  while ( *str != '\0' )
+  {
+    char c;
+    str = _next_char( str, &c );
+
+    if ( c == '\n' )
+    {
+      cx = x;
+      cy += 8 * sy;
+      continue;
+    }
+
+    if ( ( c < SIM_FONT_FIRST_CHAR ) || ( c > SIM_FONT_LAST_CHAR ) )
+    {
+      c = '?';
+    }
+
+    const uint8_t* glyph = sim_font5x7[c - SIM_FONT_FIRST_CHAR];
+
+    for ( int col = 0; col < SIM_FONT_WIDTH; col++ )
+    {
+      for ( int row = 0; row < 8; row++ )
+      {
+        if ( ( glyph[col] & ( 1 << row ) ) == 0 )
+        {
+          continue;
+        }
+
+        for ( int i = 0; i < sx; i++ )
+        {
+          for ( int j = 0; j < sy; j++ )
+          {
+            _set_pixel( cx + col * sx + i, cy + row * sy + j, on );
+          }
+        }
+      }
+    }
+
+    cx += ( SIM_FONT_WIDTH + 1 ) * sx;
+  }
+}
+
+void oled_init( void )
+{
+  memset( &ctx.fb, 0, sizeof( ctx.fb ) );
+  ctx.font = OLED_FONT_SIZE_11;
+}
+
+void oled_clearScreen( void )
+{
+  memset( &ctx.fb, 0, sizeof( ctx.fb ) );
+}
+
+void oled_setGLCDFont( enum oledFontSize size )
+{
+  ctx.font = size;
+}
+
+void oled_printFixed( uint8_t x, uint8_t y, const char* str, enum oledFontSize size )
+{
+  _print( x, y, str, size, true );
+}
+
+void oled_printFixedBlack( uint8_t x, uint8_t y, const char* str, enum oledFontSize size )
+{
+  _print( x, y, str, size, false );
+}
+
+void oled_putPixel( uint8_t x, uint8_t y )
+{
+  _set_pixel( x, y, true );
+}
+
+void oled_clearPixel( uint8_t x, uint8_t y )
+{
+  _set_pixel( x, y, false );
+}
+
+bool oled_getPixel( uint8_t x, uint8_t y )
+{
+  if ( ( x >= SSD1306_WIDTH ) || ( y >= SSD1306_HEIGHT ) )
+  {
+    return false;
+  }
+
+  return ( ctx.fb[y * SIM_FB_ROW_BYTES + x / 8] & ( 0x80 >> ( x % 8 ) ) ) != 0;
+}
+
+void oled_update( void )
+{
+  ctx.update_cnt++;
+
+  if ( ctx.update_hook != NULL )
+  {
+    ctx.update_hook();
+  }
+}
+
+void ssd1306_clearScreen( void )
+{
+  oled_clearScreen();
+}
+
+void ssd1306_fillScreen( uint8_t fill )
+{
+  memset( &ctx.fb, fill ? 0xFF : 0x00, sizeof( ctx.fb ) );
+}
+
+void ssd1306_setContrast( uint8_t contrast )
+{
+  (void) contrast;
+}
+
+const uint8_t* Sim_GetFramebuffer( void )
+{
+  return ctx.fb;
+}
+
+uint32_t Sim_GetUpdateCnt( void )
+{
+  return ctx.update_cnt;
+}
+
+void Sim_SetUpdateHook( void ( *hook )( void ) )
+{
+  ctx.update_hook = hook;
+}
+
+uint32_t Sim_Crc32( uint32_t crc, const uint8_t* data, uint32_t len )
+{
+  crc = ~crc;
+
+  for ( uint32_t i = 0; i < len; i++ )
+  {
+    crc ^= data[i];
+    for ( int bit = 0; bit < 8; bit++ )
+    {
+      crc = ( crc >> 1 ) ^ ( 0xEDB88320 & -( crc & 1 ) );
+    }
+  }
+
+  return ~crc;
+}
+
+uint32_t Sim_FramebufferCrc( void )
+{
+  return Sim_Crc32( 0, ctx.fb, sizeof( ctx.fb ) );
+}
+
+bool Sim_DumpPbm( const char* path )
+{
+  FILE* file = fopen( path, "wb" );
+
+  if ( file == NULL )
+  {
+    return false;
+  }
+
+  /* PBM marks black pixels, so the dump shows dark text on a white page */
+  fprintf( file, "P4\n%d %d\n", SSD1306_WIDTH, SSD1306_HEIGHT );
+  bool ret = fwrite( ctx.fb, 1, sizeof( ctx.fb ), file ) == sizeof( ctx.fb );
+
+  return ( fclose( file ) == 0 ) && ret;
+}
+
+static void _put_u32_be( uint8_t* buff, uint32_t value )
+{
+  buff[0] = value >> 24;
+  buff[1] = value >> 16;
+  buff[2] = value >> 8;
+  buff[3] = value;
+}
+
+static bool _png_chunk( FILE* file, const char* type, const uint8_t* data, uint32_t len )
+{
+  uint8_t head[8];
+  uint8_t tail[4];
+
+  _put_u32_be( head, len );
+  memcpy( &head[4], type, 4 );
+  uint32_t crc = Sim_Crc32( 0, &head[4], 4 );
+  crc = Sim_Crc32( crc, data, len );
+  _put_u32_be( tail, crc );
+
+  return ( fwrite( head, 1, sizeof( head ), file ) == sizeof( head ) )
+         && ( ( len == 0 ) || ( fwrite( data, 1, len, file ) == len ) )
+         && ( fwrite( tail, 1, sizeof( tail ), file ) == sizeof( tail ) );
+}
+
+bool Sim_DumpPng( const char* path, uint32_t scale )
+{
+  static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  if ( ( scale == 0 ) || ( scale > 8 ) )
+  {
+    return false;
+  }
+
+  uint32_t width = SSD1306_WIDTH * scale;
+  uint32_t height = SSD1306_HEIGHT * scale;
+  uint32_t row_len = 1 + width / 8;
+  uint32_t raw_len = row_len * height;
+
+  /* 1 bit grayscale rows, each prefixed with filter type 0 */
+  uint8_t* raw = calloc( 1, raw_len );
+  assert( raw );
+  for ( uint32_t y = 0; y < height; y++ )
+  {
+    for ( uint32_t x = 0; x < width; x++ )
+    {
+      if ( oled_getPixel( x / scale, y / scale ) )
+      {
+        raw[y * row_len + 1 + x / 8] |= 0x80 >> ( x % 8 );
+      }
+    }
+  }
+
+  /* zlib stream made of stored deflate blocks, no compressor needed */
+  uint32_t blocks = ( raw_len + 0xFFFE ) / 0xFFFF;
+  uint32_t zlib_len = 2 + blocks * 5 + raw_len + 4;
+  uint8_t* zlib = malloc( zlib_len );
+  assert( zlib );
+
+  uint32_t pos = 0;
+  zlib[pos++] = 0x78;
+  zlib[pos++] = 0x01;
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for ( uint32_t off = 0; off < raw_len; off += 0xFFFF )
+  {
+    uint32_t len = raw_len - off > 0xFFFF ? 0xFFFF : raw_len - off;
+    zlib[pos++] = off + len == raw_len ? 1 : 0;
+    zlib[pos++] = len & 0xFF;
+    zlib[pos++] = len >> 8;
+    zlib[pos++] = ~len & 0xFF;
+    zlib[pos++] = ( ~len >> 8 ) & 0xFF;
+    memcpy( &zlib[pos], &raw[off], len );
+    pos += len;
+
+    for ( uint32_t i = 0; i < len; i++ )
+    {
+      a = ( a + raw[off + i] ) % 65521;
+      b = ( b + a ) % 65521;
+    }
+  }
+  _put_u32_be( &zlib[pos], ( b << 16 ) | a );
+
+  uint8_t ihdr[13];
+  _put_u32_be( &ihdr[0], width );
+  _put_u32_be( &ihdr[4], height );
+  ihdr[8] = 1;   // bit depth
+  ihdr[9] = 0;   // grayscale
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering
+  ihdr[12] = 0;  // no interlace
+
+  bool ret = false;
+  FILE* file = fopen( path, "wb" );
+
+  if ( file != NULL )
+  {
+    ret = ( fwrite( signature, 1, sizeof( signature ), file ) == sizeof( signature ) )
+          && _png_chunk( file, "IHDR", ihdr, sizeof( ihdr ) )
+          && _png_chunk( file, "IDAT", zlib, zlib_len )
+          && _png_chunk( file, "IEND", NULL, 0 );
+    ret = ( fclose( file ) == 0 ) && ret;
+  }
+
+  free( zlib );
+  free( raw );
+
+  return ret;
+}
@@ -0,0 +1,494 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "battery.h"
+#include "dictionary.h"
+#include "driver/gpio.h"
+#include "fast_add.h"
+#include "freertos/task.h"
+#include "http_parameters_client.h"
+#include "led.h"
+#include "nvs.h"
+#include "param_store.h"
+#include "parameters.h"
+#include "sim.h"
+#include "wifidrv.h"
+
+#define FAST_ADD_PERIOD_MS 100
+#define BENCH_SCREENS_CNT  16
+
+typedef struct
+{
+  menu_token_t* menu;
+  uint32_t frames;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} sim_bench_t;
+
+typedef struct
+{
+  char serial_number[32];
+
+  sim_wifi_t wifi;
+  sim_battery_t battery;
+  uint32_t connect_start;
+  bool trying_connect;
+
+  uint32_t* fast_value;
+  uint32_t fast_max;
+  uint32_t fast_min;
+  fast_process_type_t fast_type;
+  void ( *fast_cb )( uint32_t value );
+  uint32_t fast_last;
+
+  sim_bench_t bench[BENCH_SCREENS_CNT];
+} sim_platform_t;
+
+static sim_platform_t ctx =
+  {
+    .serial_number = "SIM000001",
+    .wifi = { .link = true, .connect_ms = 300, .rssi = -60, .ap_name = "VALVE_SIM" },
+    .battery = { .accum_voltage = 4.0f },
+};
+
+/* Parameters, backed by the generated store -----------------------------------*/
+
+void parameters_init( void )
+{
+  ParamStore_Init();
+}
+
+bool parameters_save( void )
+{
+  return true;
+}
+
+uint32_t parameters_getValue( parameter_value_t val )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_Get( val );
+}
+
+bool parameters_setValue( parameter_value_t val, uint32_t value )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_Set( val, value );
+}
+
+uint32_t parameters_getMaxValue( parameter_value_t val )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_GetDef( val )->max;
+}
+
+uint32_t parameters_getMinValue( parameter_value_t val )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_GetDef( val )->min;
+}
+
+uint32_t parameters_getDefaultValue( parameter_value_t val )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_GetDef( val )->def;
+}
+
+const char* parameters_getName( parameter_value_t val )
+{
+  assert( val < PARAM_VALUE_TOP );
+  return ParamStore_GetDef( val )->name;
+}
+
+bool parameters_getString( parameter_string_t val, char* str, uint32_t str_len )
+{
+  if ( ( val != PARAM_STR_CONTROLLER_SN ) || ( str == NULL ) || ( str_len == 0 ) )
+  {
+    return false;
+  }
+
+  snprintf( str, str_len, "%s", ctx.serial_number );
+  return true;
+}
+
+bool parameters_setString( parameter_string_t val, const char* str )
+{
+  if ( ( val != PARAM_STR_CONTROLLER_SN ) || ( str == NULL ) )
+  {
+    return false;
+  }
+
+  snprintf( ctx.serial_number, sizeof( ctx.serial_number ), "%s", str );
+  return true;
+}
+
+bool Sim_ParametersFind( const char* name, parameter_value_t* param )
+{
+  return ParamStore_Find( name, param );
+}
+
+/* Http parameters client, the local parameters stand in for the server ------*/
+
+error_code_t HTTPParamClient_SetU32Value( parameter_value_t param, uint32_t value, uint32_t timeout )
+{
+  if ( !ctx.wifi.connected )
+  {
+    vTaskDelay( MS2ST( timeout ) );
+    return ERROR_CODE_TIMEOUT;
+  }
+
+  return parameters_setValue( param, value ) ? ERROR_CODE_OK : ERROR_CODE_FAIL;
+}
+
+error_code_t HTTPParamClient_SetU32ValueDontWait( parameter_value_t param, uint32_t value )
+{
+  if ( ctx.wifi.connected )
+  {
+    parameters_setValue( param, value );
+  }
+
+  return ERROR_CODE_OK;
+}
+
+error_code_t HTTPParamClient_GetU32Value( parameter_value_t param, uint32_t* value, uint32_t timeout )
+{
+  if ( !ctx.wifi.connected )
+  {
+    vTaskDelay( MS2ST( timeout ) );
+    return ERROR_CODE_TIMEOUT;
+  }
+
+  if ( value != NULL )
+  {
+    *value = parameters_getValue( param );
+  }
+
+  return ERROR_CODE_OK;
+}
+
+error_code_t HTTPParamClient_GetStrValue( parameter_string_t param, char* value, uint32_t value_len, uint32_t timeout )
+{
+  if ( !ctx.wifi.connected )
+  {
+    vTaskDelay( MS2ST( timeout ) );
+    return ERROR_CODE_TIMEOUT;
+  }
+
+  if ( value != NULL )
+  {
+    parameters_getString( param, value, value_len );
+  }
+
+  return ERROR_CODE_OK;
+}
+
+/* Wifi ------------------------------------------------------------------------*/
+
+sim_wifi_t* Sim_Wifi( void )
+{
+  return &ctx.wifi;
+}
+
+static void _connect_process( void )
+{
+  if ( ctx.trying_connect && ( Sim_GetTimeMs() - ctx.connect_start >= ctx.wifi.connect_ms ) )
+  {
+    ctx.trying_connect = false;
+    ctx.wifi.connected = ctx.wifi.link;
+  }
+}
+
+bool wifiDrvIsConnected( void )
+{
+  _connect_process();
+  return ctx.wifi.connected;
+}
+
+bool wifiDrvTryingConnect( void )
+{
+  _connect_process();
+  return ctx.trying_connect;
+}
+
+bool wifiDrvReadyToConnect( void )
+{
+  return true;
+}
+
+bool wifiDrvIsReadData( void )
+{
+  return true;
+}
+
+bool wifiDrvIsReadyToScan( void )
+{
+  return true;
+}
+
+bool wifiDrvConnect( void )
+{
+  ctx.connect_start = Sim_GetTimeMs();
+  ctx.trying_connect = true;
+  ctx.wifi.connected = false;
+  return true;
+}
+
+esp_err_t wifiDrvDisconnect( void )
+{
+  ctx.trying_connect = false;
+  ctx.wifi.connected = false;
+  return ESP_OK;
+}
+
+bool wifiDrvStartScan( void )
+{
+  return true;
+}
+
+void wifiDrvGetScanResult( uint16_t* ap_count )
+{
+  *ap_count = ctx.wifi.scan_cnt;
+}
+
+void wifiDrvGetNameFromScannedList( uint16_t number, char* name )
+{
+  if ( number < ctx.wifi.scan_cnt )
+  {
+    strcpy( name, ctx.wifi.scan_list[number] );
+  }
+  else
+  {
+    name[0] = '\0';
+  }
+}
+
+void wifiDrvGetAPName( char* name )
+{
+  strcpy( name, ctx.wifi.ap_name );
+}
+
+void wifiDrvSetAPName( const char* name, size_t len )
+{
+  snprintf( ctx.wifi.ap_name, sizeof( ctx.wifi.ap_name ), "%.*s", (int) len, name );
+}
+
+void wifiDrvSetPassword( const char* passwd, size_t len )
+{
+  (void) passwd;
+  (void) len;
+}
+
+int wifiDrvGetRssi( void )
+{
+  return ctx.wifi.rssi;
+}
+
+void wifiDrvPowerSave( bool state )
+{
+  (void) state;
+}
+
+/* Battery, leds, console ------------------------------------------------------*/
+
+sim_battery_t* Sim_Battery( void )
+{
+  return &ctx.battery;
+}
+
+float battery_get_voltage( void )
+{
+  return ctx.battery.accum_voltage;
+}
+
+int gpio_set_level( gpio_num_t gpio, uint32_t level )
+{
+  (void) gpio;
+  (void) level;
+  return ESP_OK;
+}
+
+void set_motor_red_led( bool on_off )
+{
+  (void) on_off;
+}
+
+void set_motor_green_led( bool on_off )
+{
+  (void) on_off;
+}
+
+void set_servo_red_led( bool on_off )
+{
+  (void) on_off;
+}
+
+void set_servo_green_led( bool on_off )
+{
+  (void) on_off;
+}
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... )
+{
+  if ( ( msg_lvl < module_lvl ) || ( getenv( "MENU_SIM_LOG" ) == NULL ) )
+  {
+    return;
+  }
+
+  va_list args;
+  va_start( args, format );
+  fprintf( stderr, "[%6u] ", Sim_GetTimeMs() );
+  vfprintf( stderr, format, args );
+  fprintf( stderr, "\n" );
+  va_end( args );
+}
+
+const char* DevConfig_GetSerialNumber( void )
+{
+  return ctx.serial_number;
+}
+
+esp_err_t esp_register_shutdown_handler( shutdown_handler_t handler )
+{
+  (void) handler;
+  return ESP_OK;
+}
+
+/* NVS, no flash on the host ---------------------------------------------------*/
+
+esp_err_t nvs_open( const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle )
+{
+  (void) name;
+  (void) open_mode;
+  (void) out_handle;
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char* key, void* out_value, size_t* length )
+{
+  (void) handle;
+  (void) key;
+  (void) out_value;
+  (void) length;
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char* key, const void* value, size_t length )
+{
+  (void) handle;
+  (void) key;
+  (void) value;
+  (void) length;
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_get_u32( nvs_handle_t handle, const char* key, uint32_t* out_value )
+{
+  (void) handle;
+  (void) key;
+  (void) out_value;
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_set_u32( nvs_handle_t handle, const char* key, uint32_t value )
+{
+  (void) handle;
+  (void) key;
+  (void) value;
+  return ESP_FAIL;
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+  (void) handle;
+  return ESP_FAIL;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+  (void) handle;
+}
+
+/* Fast add, stepped from the frame loop -----------------------------------------*/
+
+void fastProcessStart( uint32_t* value, uint32_t max, uint32_t min, fast_process_type_t type, void ( *cb )( uint32_t value ) )
+{
+  ctx.fast_value = value;
+  ctx.fast_max = max;
+  ctx.fast_min = min;
+  ctx.fast_type = type;
+  ctx.fast_cb = cb;
+  ctx.fast_last = Sim_GetTimeMs();
+}
+
+void fastProcessStop( uint32_t* value )
+{
+  if ( ctx.fast_value == value )
+  {
+    ctx.fast_value = NULL;
+  }
+}
+
+void Sim_FastAddStep( void )
+{
+  if ( ( ctx.fast_value == NULL ) || ( Sim_GetTimeMs() - ctx.fast_last < FAST_ADD_PERIOD_MS ) )
+  {
+    return;
+  }
+
+  static const int32_t step[] = { [FP_PLUS] = 1, [FP_MINUS] = -1, [FP_PLUS_10] = 10, [FP_MINUS_10] = -10 };
+  int64_t value = (int64_t) *ctx.fast_value + step[ctx.fast_type];
+
+  if ( value > ctx.fast_max )
+  {
+    value = ctx.fast_max;
+  }
+
+  if ( value < ctx.fast_min )
+  {
+    value = ctx.fast_min;
+  }
+
+  *ctx.fast_value = value;
+  ctx.fast_last = Sim_GetTimeMs();
+
+  if ( ctx.fast_cb != NULL )
+  {
+    ctx.fast_cb( *ctx.fast_value );
+  }
+}
+
+/* Per screen draw cost ----------------------------------------------------------*/
+
+void Sim_BenchRecord( menu_token_t* menu, uint64_t ns )
+{
+  for ( int i = 0; i < BENCH_SCREENS_CNT; i++ )
+  {
+    sim_bench_t* bench = &ctx.bench[i];
+
+    if ( ( bench->menu != NULL ) && ( bench->menu != menu ) )
+    {
+      continue;
+    }
+
+    bench->menu = menu;
+    bench->frames++;
+    bench->total_ns += ns;
+    if ( ns > bench->max_ns )
+    {
+      bench->max_ns = ns;
+    }
+    return;
+  }
+}
+
+void Sim_BenchReport( void )
+{
+  printf( "%-24s %8s %10s %10s\n", "screen", "frames", "avg [us]", "max [us]" );
+
+  for ( int i = 0; i < BENCH_SCREENS_CNT && ctx.bench[i].menu != NULL; i++ )
+  {
+    sim_bench_t* bench = &ctx.bench[i];
+    printf( "%-24s %8u %10.1f %10.1f\n", dictionary_get_string( bench->menu->name_dict ), bench->frames,
+            bench->total_ns / 1000.0 / bench->frames, bench->max_ns / 1000.0 );
+  }
+}
@@ -0,0 +1,6 @@
+#ifndef SIM_BATTERY_H_
+#define SIM_BATTERY_H_
+
+float battery_get_voltage( void );
+
+#endif
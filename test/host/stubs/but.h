@@ -0,0 +1,4 @@
+#ifndef SIM_BUT_H_
+#define SIM_BUT_H_
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef SIM_BUZZER_H_
+#define SIM_BUZZER_H_
+
+#endif
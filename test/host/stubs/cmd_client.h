@@ -0,0 +1,4 @@
+#ifndef SIM_CMD_CLIENT_H_
+#define SIM_CMD_CLIENT_H_
+
+#endif
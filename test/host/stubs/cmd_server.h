@@ -0,0 +1,4 @@
+#ifndef SIM_CMD_SERVER_H_
+#define SIM_CMD_SERVER_H_
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SIM_DEV_CONFIG_H_
+#define SIM_DEV_CONFIG_H_
+
+enum
+{
+  PRINT_DEBUG,
+  PRINT_INFO,
+  PRINT_WARNING,
+  PRINT_ERROR,
+};
+
+void DevConfig_Printf( int module_lvl, int msg_lvl, const char* format, ... );
+const char* DevConfig_GetSerialNumber( void );
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SIM_GPIO_H_
+#define SIM_GPIO_H_
+
+#include <stdint.h>
+
+#ifndef BIT64
+#define BIT64( nr ) ( 1ULL << ( nr ) )
+#endif
+
+typedef enum
+{
+  GPIO_NUM_12 = 12,
+  GPIO_NUM_15 = 15,
+  GPIO_NUM_23 = 23,
+  GPIO_NUM_25 = 25,
+  GPIO_NUM_26 = 26,
+  GPIO_NUM_27 = 27,
+} gpio_num_t;
+
+typedef enum
+{
+  GPIO_MODE_INPUT,
+  GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef enum
+{
+  GPIO_INTR_DISABLE,
+} gpio_int_type_t;
+
+typedef struct
+{
+  uint64_t pin_bit_mask;
+  gpio_mode_t mode;
+  int pull_up_en;
+  int pull_down_en;
+  gpio_int_type_t intr_type;
+} gpio_config_t;
+
+int gpio_config( const gpio_config_t* config );
+int gpio_set_level( gpio_num_t gpio, uint32_t level );
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef SIM_ESP_ATTR_H_
+#define SIM_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef SIM_ESP_HEAP_CAPS_H_
+#define SIM_ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT ( 1 << 2 )
+
+/* Simulated heap of SIM_HEAP_SIZE bytes, see sim/sim_heap.c */
+size_t heap_caps_get_free_size( uint32_t caps );
+size_t heap_caps_get_minimum_free_size( uint32_t caps );
+size_t heap_caps_get_largest_free_block( uint32_t caps );
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SIM_ESP_ROM_CRC_H_
+#define SIM_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+/* The ROM routine, CRC-32 with the initial and final inversion done inside */
+static inline uint32_t esp_rom_crc32_le( uint32_t crc, const uint8_t* buf, uint32_t len )
+{
+  crc = ~crc;
+  while ( len-- > 0 )
+  {
+    crc ^= *buf++;
+    for ( int bit = 0; bit < 8; bit++ )
+    {
+      crc = ( crc >> 1 ) ^ ( 0xEDB88320u & -( crc & 1 ) );
+    }
+  }
+
+  return ~crc;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SIM_ESP_SPIFFS_H_
+#define SIM_ESP_SPIFFS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_system.h"
+
+typedef struct
+{
+  const char* base_path;
+  const char* partition_label;
+  size_t max_files;
+  bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+esp_err_t esp_vfs_spiffs_register( const esp_vfs_spiffs_conf_t* conf );
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SIM_ESP_SYSTEM_H_
+#define SIM_ESP_SYSTEM_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+typedef void ( *shutdown_handler_t )( void );
+
+esp_err_t esp_register_shutdown_handler( shutdown_handler_t handler );
+
+#endif
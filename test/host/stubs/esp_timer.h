@@ -0,0 +1,9 @@
+#ifndef SIM_ESP_TIMER_H_
+#define SIM_ESP_TIMER_H_
+
+#include <stdint.h>
+
+/* Microseconds of virtual time */
+int64_t esp_timer_get_time( void );
+
+#endif
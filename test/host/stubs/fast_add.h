@@ -0,0 +1,17 @@
+#ifndef SIM_FAST_ADD_H_
+#define SIM_FAST_ADD_H_
+
+#include <stdint.h>
+
+typedef enum
+{
+  FP_PLUS,
+  FP_MINUS,
+  FP_PLUS_10,
+  FP_MINUS_10,
+} fast_process_type_t;
+
+void fastProcessStart( uint32_t* value, uint32_t max, uint32_t min, fast_process_type_t type, void ( *cb )( uint32_t value ) );
+void fastProcessStop( uint32_t* value );
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SIM_FREERTOS_H_
+#define SIM_FREERTOS_H_
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS 2    // as in sdkconfig
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ( 1000 / configTICK_RATE_HZ )
+#define portMAX_DELAY      ( (TickType_t) 0xFFFFFFFF )
+#define pdMS_TO_TICKS( ms ) ( (TickType_t) ( ( (uint64_t) ( ms ) * configTICK_RATE_HZ ) / 1000 ) )
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  pdFALSE
+#define pdPASS  pdTRUE
+
+typedef struct
+{
+  int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED \
+  {                                  \
+    .owner = 0                       \
+  }
+
+#define portENTER_CRITICAL( mux ) ( (void) ( mux ) )
+#define portEXIT_CRITICAL( mux )  ( (void) ( mux ) )
+
+#include "freertos/task.h"
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SIM_TASK_H_
+#define SIM_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void ( *TaskFunction_t )( void* );
+typedef void ( *TlsDeleteCallbackFunction_t )( int, void* );
+
+#define taskSCHEDULER_SUSPENDED   0
+#define taskSCHEDULER_NOT_STARTED 1
+#define taskSCHEDULER_RUNNING     2
+
+TickType_t xTaskGetTickCount( void );
+TaskHandle_t xTaskGetCurrentTaskHandle( void );
+char* pcTaskGetName( TaskHandle_t task );
+BaseType_t xTaskGetSchedulerState( void );
+void vTaskDelay( TickType_t ticks );
+BaseType_t xTaskCreate( TaskFunction_t task, const char* name, uint32_t stack, void* arg, UBaseType_t prio, TaskHandle_t* handle );
+void vTaskDelete( TaskHandle_t task );
+void* pvTaskGetThreadLocalStoragePointer( TaskHandle_t task, BaseType_t index );
+void vTaskSetThreadLocalStoragePointerAndDelCallback( TaskHandle_t task, BaseType_t index, void* value,
+                                                      TlsDeleteCallbackFunction_t del );
+
+#endif
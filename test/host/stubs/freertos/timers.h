@@ -0,0 +1,6 @@
+#ifndef SIM_TIMERS_H_
+#define SIM_TIMERS_H_
+
+#include "freertos/FreeRTOS.h"
+
+#endif
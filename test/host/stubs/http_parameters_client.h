@@ -0,0 +1,20 @@
+#ifndef SIM_HTTP_PARAMETERS_CLIENT_H_
+#define SIM_HTTP_PARAMETERS_CLIENT_H_
+
+#include <stdint.h>
+
+#include "parameters.h"
+
+typedef enum
+{
+  ERROR_CODE_OK,
+  ERROR_CODE_FAIL,
+  ERROR_CODE_TIMEOUT,
+} error_code_t;
+
+error_code_t HTTPParamClient_SetU32Value( parameter_value_t param, uint32_t value, uint32_t timeout );
+error_code_t HTTPParamClient_SetU32ValueDontWait( parameter_value_t param, uint32_t value );
+error_code_t HTTPParamClient_GetU32Value( parameter_value_t param, uint32_t* value, uint32_t timeout );
+error_code_t HTTPParamClient_GetStrValue( parameter_string_t param, char* value, uint32_t value_len, uint32_t timeout );
+
+#endif
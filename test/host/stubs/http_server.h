@@ -0,0 +1,9 @@
+#ifndef SIM_HTTP_SERVER_H_
+#define SIM_HTTP_SERVER_H_
+
+#include <stdbool.h>
+
+void HTTPServer_Init( void );
+bool HTTPServer_IsClientConnected( void );
+
+#endif
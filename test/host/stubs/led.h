@@ -0,0 +1,11 @@
+#ifndef SIM_LED_H_
+#define SIM_LED_H_
+
+#include <stdbool.h>
+
+void set_motor_red_led( bool on_off );
+void set_motor_green_led( bool on_off );
+void set_servo_red_led( bool on_off );
+void set_servo_green_led( bool on_off );
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef SIM_LWIP_ARCH_H_
+#define SIM_LWIP_ARCH_H_
+
+#endif
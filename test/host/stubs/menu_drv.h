@@ -0,0 +1,107 @@
+#ifndef SIM_MENU_DRV_H_
+#define SIM_MENU_DRV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dictionary.h"
+
+#define MENU_HEIGHT 18
+#define LINE_HEIGHT 11
+#define MAX_LINE    4
+
+#define NULL_ERROR_MSG() printf( "%s: NULL pointer\n\r", __func__ )
+
+typedef enum
+{
+  T_ARG_TYPE_BOOL,
+  T_ARG_TYPE_VALUE,
+  T_ARG_TYPE_MENU,
+  T_ARG_TYPE_PARAMETERS,
+} menu_arg_type_t;
+
+typedef enum
+{
+  LAST_BUTTON_UP,
+  LAST_BUTTON_DOWN,
+} last_button_t;
+
+typedef enum
+{
+  MENU_DRV_NORMAL_INIT,
+  MENU_DRV_LOW_BATTERY_INIT,
+} menu_drv_init_t;
+
+typedef enum
+{
+  MENU_DRV_MSG_WAIT_TO_INIT,
+  MENU_DRV_MSG_IDLE_STATE,
+  MENU_DRV_MSG_MENU_STOP,
+  MENU_DRV_MSG_POWER_OFF,
+} menuDrvMsg_t;
+
+typedef struct
+{
+  void ( *fall_callback )( void* arg );
+  void ( *rise_callback )( void* arg );
+  void ( *timer_callback )( void* arg );
+} menu_button_t;
+
+typedef struct menu_token
+{
+  enum dictionary_phrase name_dict;
+  menu_arg_type_t arg_type;
+  struct menu_token** menu_list;
+  void* value;
+
+  struct
+  {
+    bool ( *process )( void* arg );
+    bool ( *enter )( void* arg );
+    bool ( *exit )( void* arg );
+    bool ( *button_init_cb )( void* arg );
+  } menu_cb;
+
+  struct
+  {
+    menu_button_t up;
+    menu_button_t down;
+    menu_button_t enter;
+    menu_button_t exit;
+    menu_button_t up_minus;
+    menu_button_t up_plus;
+    menu_button_t down_minus;
+    menu_button_t down_plus;
+    menu_button_t motor_on;
+    menu_button_t on_off;
+  } button;
+
+  int position;
+  last_button_t last_button;
+
+  struct
+  {
+    int start;
+    int end;
+  } line;
+} menu_token_t;
+
+void menuDrvInit( menu_drv_init_t init_type, void ( *emergency_disable_cb )( void ) );
+void menuEnter( menu_token_t* menu );
+void menuDrv_Exit( menu_token_t* menu );
+void menuSetMain( menu_token_t* menu );
+int menuDrvElementsCnt( menu_token_t* menu );
+void menuPrintfInfo( const char* format, ... );
+void menuDrvSaveParameters( void );
+void menuDrvEnterEmergencyDisable( void );
+void menuDrvExitEmergencyDisable( void );
+void menuDrvSetGetMsgCb( const char* ( *cb )( menuDrvMsg_t msg ) );
+void menuDrvSetDrawBatteryCb( void ( *cb )( uint8_t x, uint8_t y, float accum_voltage, bool is_charging ) );
+void menuDrvSetDrawSignalCb( void ( *cb )( uint8_t x, uint8_t y, uint8_t signal_lvl ) );
+
+void mainMenuInit( menu_drv_init_t init_type );
+void menuDrv_EnterToParameters( void );
+void enterMenuStart( void );
+
+#endif
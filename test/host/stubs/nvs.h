@@ -0,0 +1,26 @@
+#ifndef SIM_NVS_H_
+#define SIM_NVS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_system.h"
+
+/* No flash on the host, every namespace fails to open */
+typedef uint32_t nvs_handle_t;
+
+typedef enum
+{
+  NVS_READONLY,
+  NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open( const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle );
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char* key, void* out_value, size_t* length );
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char* key, const void* value, size_t length );
+esp_err_t nvs_get_u32( nvs_handle_t handle, const char* key, uint32_t* out_value );
+esp_err_t nvs_set_u32( nvs_handle_t handle, const char* key, uint32_t value );
+esp_err_t nvs_commit( nvs_handle_t handle );
+void nvs_close( nvs_handle_t handle );
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SIM_OLED_H_
+#define SIM_OLED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum oledFontSize
+{
+  OLED_FONT_SIZE_11,
+  OLED_FONT_SIZE_16,
+  OLED_FONT_SIZE_26,
+};
+
+void oled_init( void );
+void oled_clearScreen( void );
+void oled_setGLCDFont( enum oledFontSize size );
+void oled_printFixed( uint8_t x, uint8_t y, const char* str, enum oledFontSize size );
+void oled_printFixedBlack( uint8_t x, uint8_t y, const char* str, enum oledFontSize size );
+void oled_putPixel( uint8_t x, uint8_t y );
+void oled_clearPixel( uint8_t x, uint8_t y );
+bool oled_getPixel( uint8_t x, uint8_t y );
+void oled_update( void );
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SIM_PARAMETERS_H_
+#define SIM_PARAMETERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "project_parameters.h"
+
+/* Parameters owned by the shared drivers, followed by the project list */
+#define PARAMETERS_SIM_U32_LIST                                \
+  PARAM( PARAM_EMERGENCY_DISABLE, 0, 1, 0, "emergency_disable" ) \
+  PARAM( PARAM_BRIGHTNESS, 1, 10, 5, "brightness" )            \
+  PARAM( PARAM_BUZZER, 0, 1, 1, "buzzer" )                     \
+  PARAM( PARAM_BOOT_UP_SYSTEM, 0, 1, 0, "boot_up_system" )     \
+  PARAM( PARAM_POWER_ON_MIN, 0, 60, 10, "power_on_min" )       \
+  PARAMETERS_U32_LIST
+
+/* The simulated parameters module keeps the whole list in the store, a
+ * test of the target layout sets PARAMETERS_U32_LIST */
+#ifndef PARAM_STORE_LIST
+#define PARAM_STORE_LIST PARAMETERS_SIM_U32_LIST
+#endif
+
+typedef enum
+{
+#define PARAM( _param, _min, _max, _default, _name ) _param,
+  PARAMETERS_SIM_U32_LIST
+#undef PARAM
+  PARAM_VALUE_TOP,
+} parameter_value_t;
+
+typedef enum
+{
+  PARAM_STR_CONTROLLER_SN,
+  PARAM_STR_TOP,
+} parameter_string_t;
+
+void parameters_init( void );
+bool parameters_save( void );
+uint32_t parameters_getValue( parameter_value_t val );
+bool parameters_setValue( parameter_value_t val, uint32_t value );
+uint32_t parameters_getMaxValue( parameter_value_t val );
+uint32_t parameters_getMinValue( parameter_value_t val );
+uint32_t parameters_getDefaultValue( parameter_value_t val );
+const char* parameters_getName( parameter_value_t val );
+bool parameters_getString( parameter_string_t val, char* str, uint32_t str_len );
+bool parameters_setString( parameter_string_t val, const char* str );
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef SIM_PARSE_CMD_H_
+#define SIM_PARSE_CMD_H_
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef SIM_POWER_ON_H_
+#define SIM_POWER_ON_H_
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SIM_PWM_DRV_H_
+#define SIM_PWM_DRV_H_
+
+#include <stdint.h>
+
+typedef enum
+{
+  PWM_DRV_DUTY_MODE_HIGH,
+  PWM_DRV_DUTY_MODE_LOW,
+} pwm_drv_duty_mode_t;
+
+typedef struct
+{
+  const char* name;
+  float duty;
+} pwm_drv_t;
+
+void PWMDrv_Init( pwm_drv_t* dev, const char* name, pwm_drv_duty_mode_t mode, uint32_t freq, int channel, int gpio );
+void PWMDrv_SetDuty( pwm_drv_t* dev, float duty );
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef SIM_SSD1306_H_
+#define SIM_SSD1306_H_
+
+#include <stdint.h>
+
+void ssd1306_clearScreen( void );
+void ssd1306_fillScreen( uint8_t fill );
+void ssd1306_setContrast( uint8_t contrast );
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SIM_WATER_FLOW_SENSOR_H_
+#define SIM_WATER_FLOW_SENSOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WATER_FLOW_CONVERT_L_TO_CL( _l ) ( ( _l ) * 100 )
+
+typedef enum
+{
+  WATER_FLOW_SENSOR_EVENT_WATER_FLOW_BACK,
+  WATER_FLOW_SENSOR_EVENT_NO_WATER_SHORT_PERIOD,
+  WATER_FLOW_SENSOR_EVENT_NO_WATER_LONG_PERIOD,
+} water_flow_sensor_event_t;
+
+typedef void ( *water_flow_sensor_cb_t )( water_flow_sensor_event_t event, uint32_t value );
+
+typedef struct
+{
+  const char* name;
+  uint32_t pulses_per_liter;
+  water_flow_sensor_cb_t callback;
+  bool measuring;
+} water_flow_sensor_t;
+
+void WaterFlowSensor_Init( water_flow_sensor_t* dev, const char* name, uint32_t pulses_per_liter, water_flow_sensor_cb_t callback, int gpio );
+void WaterFlowSensor_StartMeasure( water_flow_sensor_t* dev );
+void WaterFlowSensor_StopMeasure( water_flow_sensor_t* dev );
+uint32_t WaterFlowSensor_GetValue( water_flow_sensor_t* dev );    // centiliters since the start
+void WaterFlowSensor_SetPulsesPerLiter( water_flow_sensor_t* dev, uint32_t pulses_per_liter );
+
+#endif
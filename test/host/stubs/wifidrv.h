@@ -0,0 +1,31 @@
+#ifndef SIM_WIFIDRV_H_
+#define SIM_WIFIDRV_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_system.h"
+
+#define WIFI_SIEWNIK_NAME "SIEWNIK"
+#define WIFI_SOLARKA_NAME "SOLARKA"
+#define WIFI_VALVE_NAME   "VALVE"
+#define WIFI_AP_PASSWORD  "12345678"
+
+bool wifiDrvIsConnected( void );
+bool wifiDrvTryingConnect( void );
+bool wifiDrvReadyToConnect( void );
+bool wifiDrvIsReadData( void );
+bool wifiDrvIsReadyToScan( void );
+bool wifiDrvConnect( void );
+esp_err_t wifiDrvDisconnect( void );
+bool wifiDrvStartScan( void );
+void wifiDrvGetScanResult( uint16_t* ap_count );
+void wifiDrvGetNameFromScannedList( uint16_t number, char* name );
+void wifiDrvGetAPName( char* name );
+void wifiDrvSetAPName( const char* name, size_t len );
+void wifiDrvSetPassword( const char* passwd, size_t len );
+int wifiDrvGetRssi( void );
+void wifiDrvPowerSave( bool state );
+
+#endif
@@ -21,9 +21,9 @@ void app_main(void)
      * UNITY_BEGIN() and UNITY_END() calls tell Unity to print a summary
      * (number of tests executed/failed/ignored) of tests executed between these calls.
      */
-    print_banner("Executing one test by its name");
+    print_banner("Running micro benchmarks");
     UNITY_BEGIN();
-    unity_run_test_by_name("Mean of an empty array is zero");
+    unity_run_test_by_name("Micro benchmarks");
     UNITY_END();
 
     print_banner("Starting interactive test menu");
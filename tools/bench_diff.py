@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Compare two micro benchmark runs.
+
+  bench_diff.py base.json new.json [--threshold 5]
+
+Runs are the JSON written by the host bench tool or copied from the serial
+log of the target unit test app. The median per iteration is compared, cases
+slower by more than the threshold percent are flagged and make the exit code 1.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8") as file:
+        run = json.load(file)
+    return run["unit"], {result["name"]: result for result in run["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=5.0, help="percent slower to flag")
+    args = parser.parse_args()
+
+    base_unit, base = load(args.base)
+    new_unit, new = load(args.new)
+    if base_unit != new_unit:
+        raise SystemExit("units differ: %s vs %s" % (base_unit, new_unit))
+
+    slower = 0
+    print("%-16s %12s %12s %8s" % ("case", "base [%s]" % base_unit, "new [%s]" % new_unit, "change"))
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-16s %s" % (name, "only in new" if name in new else "only in base"))
+            continue
+
+        old_median = base[name]["median"]
+        new_median = new[name]["median"]
+        change = (new_median - old_median) * 100.0 / old_median if old_median else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  slower"
+            slower += 1
+        print("%-16s %12.2f %12.2f %+7.1f%%%s" % (name, old_median, new_median, change, flag))
+
+    return 1 if slower else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
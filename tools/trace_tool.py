@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""Binary trace table generator and dump decoder.
+
+  trace_tool.py gen components/diag/trace_fmt.h -o trace_formats.json
+  trace_tool.py decode -f trace_formats.json remote.log controller.bin -o trace.json
+  trace_tool.py text -f trace_formats.json controller.bin
+
+Dumps are either the raw bytes written by Trace_Dump() or a serial log with
+the TRC: lines printed by Trace_DumpConsole(). decode writes Chrome trace
+event JSON, open it in chrome://tracing or https://ui.perfetto.dev. Every
+input becomes one process, every firmware module one thread of it.
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+DUMP_MAGIC = 0x31435254
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IHH3I")
+
+FMT_RE = re.compile(r'TRACE_FMT\(\s*(\w+)\s*,\s*"([^"]*)"\s*,\s*(\w+)\s*,\s*"([^"]*)"\s*\)')
+NAMES_RE = re.compile(r"TRACE_NAMES\(\s*(\w+)\s*,((?:\s*\"[^\"]*\"\s*,?)+|\s*\w+\s*)\)")
+INCLUDE_RE = re.compile(r'#include\s+"([^"]+)"')
+SPEC_RE = re.compile(r"%(\{\w+\}|[udx])")
+
+
+def _macro_body(text, name):
+    """Text of a #define, line continuations joined."""
+    match = re.search(r"#define\s+%s\b((?:.*\\\n)*.*)" % name, text)
+    if match is None:
+        raise SystemExit("%s not found" % name)
+    return match.group(1).replace("\\\n", " ")
+
+
+def _read_header(header_path):
+    """The header with the local headers it includes appended."""
+    with open(header_path, encoding="utf-8") as file:
+        text = file.read()
+    for include in INCLUDE_RE.findall(text):
+        path = os.path.join(os.path.dirname(header_path), include)
+        if os.path.exists(path):
+            text += "\n" + _read_header(path)
+    return text
+
+
+def _names(text, values):
+    """Literal names, or the names of a LIST(_S) state list in its order."""
+    values = values.strip()
+    if values.startswith('"'):
+        return re.findall(r'"([^"]*)"', values)
+    return re.findall(r'_S\(\s*\w+\s*,\s*"([^"]*)"\s*\)', _macro_body(text, values))
+
+
+def generate(header_path):
+    text = _read_header(header_path)
+
+    formats = [
+        {"id": ident, "module": module, "kind": kind, "format": fmt}
+        for ident, module, kind, fmt in FMT_RE.findall(_macro_body(text, "TRACE_FMT_LIST"))
+    ]
+    names = {
+        name: _names(text, values)
+        for name, values in NAMES_RE.findall(_macro_body(text, "TRACE_NAMES_LIST"))
+    }
+
+    for entry in formats:
+        for spec in SPEC_RE.findall(entry["format"]):
+            if spec.startswith("{") and spec[1:-1] not in names:
+                raise SystemExit("%s: unknown names table %s" % (entry["id"], spec))
+
+    return {"formats": formats, "names": names}
+
+
+def _dump_bytes(path):
+    """Raw dump bytes, or the TRC: hex lines of a serial log glued together."""
+    with open(path, "rb") as file:
+        data = file.read()
+
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == DUMP_MAGIC:
+        return data
+
+    hex_data = []
+    inside = False
+    for line in data.decode("utf-8", "replace").splitlines():
+        pos = line.find("TRC: ")
+        if pos < 0:
+            continue
+        payload = line[pos + 5:].strip()
+        if payload == "BEGIN":
+            # keep only the last dump of the log
+            hex_data = []
+            inside = True
+        elif payload == "END":
+            inside = False
+        elif inside:
+            hex_data.append(payload)
+
+    if not hex_data:
+        raise SystemExit("%s: no trace dump found" % path)
+
+    return bytes.fromhex("".join(hex_data))
+
+
+def read_dump(path):
+    data = _dump_bytes(path)
+    magic, record_size, fmt_cnt, records_cnt, lost = HEADER.unpack_from(data)
+
+    if magic != DUMP_MAGIC:
+        raise SystemExit("%s: bad magic %08x" % (path, magic))
+    if record_size != RECORD.size:
+        raise SystemExit("%s: record size %u, tool knows %u" % (path, record_size, RECORD.size))
+
+    records = []
+    last_ts = None
+    wraps = 0
+    for off in range(HEADER.size, min(len(data), HEADER.size + records_cnt * record_size), record_size):
+        if off + record_size > len(data):
+            break
+        ts, ident, seq, a0, a1, a2 = RECORD.unpack_from(data, off)
+        # 32 bit microsecond clock wraps every ~71 minutes
+        if last_ts is not None and ts < last_ts:
+            wraps += 1
+        last_ts = ts
+        records.append({"ts": ts + (wraps << 32), "id": ident, "seq": seq, "args": [a0, a1, a2]})
+
+    return {"fmt_cnt": fmt_cnt, "lost": lost, "records": records}
+
+
+def _signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def _name(table, names, value):
+    values = names.get(table, [])
+    return values[value] if value < len(values) else str(value)
+
+
+def format_record(table, record):
+    formats = table["formats"]
+    if record["id"] >= len(formats):
+        return None, "unknown id %u %s" % (record["id"], record["args"])
+
+    entry = formats[record["id"]]
+    args = iter(record["args"])
+
+    def _expand(match):
+        spec = match.group(1)
+        value = next(args, 0)
+        if spec == "d":
+            return str(_signed(value))
+        if spec == "x":
+            return "%x" % value
+        if spec.startswith("{"):
+            return _name(spec[1:-1], table["names"], value)
+        return str(value)
+
+    return entry, SPEC_RE.sub(_expand, entry["format"])
+
+
+def _state_label(table, entry, value):
+    spec = SPEC_RE.findall(entry["format"])
+    if len(spec) > 1 and spec[1].startswith("{"):
+        return _name(spec[1][1:-1], table["names"], value)
+    return str(value)
+
+
+def to_chrome(table, dumps):
+    events = []
+
+    for pid, (label, dump) in enumerate(dumps, start=1):
+        events.append({"ph": "M", "pid": pid, "name": "process_name", "args": {"name": label}})
+        tids = {}
+        open_state = {}
+        open_spans = {}
+        end_ts = dump["records"][-1]["ts"] if dump["records"] else 0
+
+        def _tid(module):
+            if module not in tids:
+                tids[module] = len(tids) + 1
+                events.append({"ph": "M", "pid": pid, "tid": tids[module], "name": "thread_name",
+                               "args": {"name": module}})
+            return tids[module]
+
+        def _close_state(module, ts):
+            if module in open_state:
+                name, start = open_state.pop(module)
+                events.append({"ph": "X", "pid": pid, "tid": _tid(module), "name": name,
+                               "cat": "state", "ts": start, "dur": ts - start})
+
+        for record in dump["records"]:
+            entry, text = format_record(table, record)
+            if entry is None:
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": 0, "name": text, "ts": record["ts"]})
+                continue
+
+            module = entry["module"]
+            kind = entry["kind"]
+            ts = record["ts"]
+
+            if kind == "STATE":
+                _close_state(module, ts)
+                open_state[module] = (_state_label(table, entry, record["args"][1]), ts)
+            elif kind == "BEGIN":
+                open_spans[(module, record["args"][0])] = (text, ts)
+            elif kind == "END" and (module, record["args"][0]) in open_spans:
+                name, start = open_spans.pop((module, record["args"][0]))
+                events.append({"ph": "X", "pid": pid, "tid": _tid(module), "name": name, "cat": "span",
+                               "ts": start, "dur": ts - start, "args": {"result": text}})
+            else:
+                events.append({"ph": "i", "s": "t", "pid": pid, "tid": _tid(module), "name": text, "ts": ts})
+
+        for module in list(open_state):
+            _close_state(module, end_ts)
+        for (module, _), (name, start) in open_spans.items():
+            events.append({"ph": "X", "pid": pid, "tid": _tid(module), "name": name + " (open)", "cat": "span",
+                           "ts": start, "dur": end_ts - start})
+
+        if dump["lost"]:
+            events.append({"ph": "i", "s": "p", "pid": pid, "tid": 0, "name": "%u records lost" % dump["lost"],
+                           "ts": dump["records"][0]["ts"] if dump["records"] else 0})
+
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def _load_table(path):
+    with open(path, encoding="utf-8") as file:
+        table = json.load(file)
+    if "formats" not in table:
+        raise SystemExit("%s: not a trace format table" % path)
+    return table
+
+
+def _check_fmt_cnt(table, path, dump):
+    if dump["fmt_cnt"] != len(table["formats"]):
+        print("%s: dump has %u formats, table %u, ids past the table decode as unknown"
+              % (path, dump["fmt_cnt"], len(table["formats"])), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    gen = sub.add_parser("gen", help="build the format table from trace_fmt.h")
+    gen.add_argument("header")
+    gen.add_argument("-o", "--output", required=True)
+
+    for name, help_text in (("decode", "write Chrome trace event JSON"), ("text", "print decoded records")):
+        cmd = sub.add_parser(name, help=help_text)
+        cmd.add_argument("-f", "--formats", required=True, help="table written by gen")
+        cmd.add_argument("dumps", nargs="+", help="dump or serial log, prefix with label= to name the process")
+        if name == "decode":
+            cmd.add_argument("-o", "--output", required=True)
+
+    args = parser.parse_args()
+
+    if args.cmd == "gen":
+        table = generate(args.header)
+        with open(args.output, "w", encoding="utf-8") as file:
+            json.dump(table, file, indent=1)
+        return 0
+
+    table = _load_table(args.formats)
+    dumps = []
+    for arg in args.dumps:
+        label, _, path = arg.rpartition("=")
+        dump = read_dump(path)
+        _check_fmt_cnt(table, path, dump)
+        dumps.append((label or path, dump))
+
+    if args.cmd == "text":
+        for label, dump in dumps:
+            print("# %s: %u records, %u lost" % (label, len(dump["records"]), dump["lost"]))
+            for record in dump["records"]:
+                entry, text = format_record(table, record)
+                module = entry["module"] if entry else "?"
+                print("%12.3f ms  %-12s %s" % (record["ts"] / 1000.0, module, text))
+        return 0
+
+    with open(args.output, "w", encoding="utf-8") as file:
+        json.dump(to_chrome(table, dumps), file)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())